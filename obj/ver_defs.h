@@ -0,0 +1,7 @@
+#define VER_MAJOR 0
+#define VER_MINOR 5
+#define VER_RELEASE 0
+#define VER_BUILD 0
+#define VER_STRING "0.5.0.0"
+#define PACKAGE_SUFFIX "x"
+#define GIT_REVISION "x"
@@ -25,6 +25,8 @@
 #include "bflib_memory.h"
 #include "bflib_math.h"
 #include "bflib_planar.h"
+#include "bflib_datetm.h"
+#include "bflib_jobs.h"
 #include "config_terrain.h"
 #include "ariadne_navitree.h"
 #include "ariadne_regions.h"
@@ -32,7 +34,10 @@
 #include "ariadne_points.h"
 #include "ariadne_edge.h"
 #include "ariadne_findcache.h"
+#include "ariadne_routecache.h"
+#include "ariadne_bench.h"
 #include "ariadne_naviheap.h"
+#include "ariadne_workspace.h"
 #include "thing_stats.h"
 #include "thing_navigate.h"
 #include "thing_physics.h"
@@ -44,14 +49,61 @@
 
 #define EDGEFIT_LEN           64
 #define EDGEOR_COUNT           4
+/** Max amount of areas waiting for retriangulation. */
+#define NAV_UPDATE_QUEUE_LEN  32
+/** Max amount of creature routes waiting to be traced at end of a turn. */
+#define ROUTE_REQUESTS_COUNT 128
+/** Amount of navigation rule sets for which reachability labels are kept; one for every owner, including none, with and without lava. */
+#define NAV_REACH_SLOTS_COUNT ((PLAYERS_COUNT + 1) * 2)
 
-typedef long (*NavRules)(NavColour, NavColour);
+typedef long (*NavRules)(const struct AriadneWorkspace *, NavColour, NavColour);
 
 struct QuadrantOffset {
     long x;
     long y;
 };
 
+struct NavUpdateArea {
+    long start_x;
+    long start_y;
+    long end_x;
+    long end_y;
+};
+
+struct RouteRequest {
+    ThingIndex thing_idx;
+    long creation_turn;
+    struct Coord3d pos;
+    long speed;
+    AriadneRouteFlags flags;
+    /** Whether the creature still needs the route; checked before tracing. */
+    TbBool valid;
+    /** Whether the route is traced by workers; otherwise the path is already final. */
+    TbBool needs_tracing;
+    long tri_src;
+    long tri_dst;
+    unsigned char nav_size;
+    long owner;
+    long can_travel_over_lava;
+    struct Path path;
+    /** Triangle route traced by workers, kept for the route cache if it fits there. */
+    long route_len;
+    long route[ROUTE_CACHE_TRIANGLES];
+};
+
+/**
+ * Labels of connected triangles for one navigation rule set.
+ * Triangles which can't be part of any route have label 0.
+ */
+struct NavReachSlot {
+    /** Triangulation generation for which the labels were made; 0 if they were never made. */
+    unsigned long generation;
+    /** Labels of triangles connected by moves allowed in both directions; allocated on first use. */
+    unsigned int *both_way;
+    /** Labels of triangles connected by moves allowed in any direction. */
+    unsigned int *any_way;
+};
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -60,20 +112,13 @@ static long tri_initialised;
 static unsigned long edgelen_initialised;
 static unsigned long RadiusEdgeFit[EDGEOR_COUNT][EDGEFIT_LEN];
 static NavRules nav_rulesA2B;
-static struct WayPoints wayPoints;
-static unsigned long *EdgeFit;
 static struct Pathway ap_GPathway;
 static long tree_routelen;
-static long tree_route[TREE_ROUTE_LEN];
 static long tree_routecost;
 static long tree_triA;
 static long tree_triB;
 static long tree_altA;
 static long tree_altB;
-static long tree_Ax8;
-static long tree_Ay8;
-static long tree_Bx8;
-static long tree_By8;
 static NavColour *LastTriangulatedMap;
 static NavColour *fringe_map;
 static long fringe_y1;
@@ -83,8 +128,24 @@ static long fringe_x2;
 static long fringe_y[MAX_SUBTILES_Y];
 static long ix_Border;
 static long Border[BORDER_LENGTH];
-static long route_fwd[ROUTE_LENGTH];
-static long route_bak[ROUTE_LENGTH];
+static struct NavUpdateArea nav_update_queue[NAV_UPDATE_QUEUE_LEN];
+static long nav_update_queue_len;
+static struct NavUpdateStats nav_update_stats;
+/** Whether queued areas which touch are merged; packet files made before it was introduced expect them triangulated one by one. */
+static TbBool nav_update_merging = true;
+static struct RouteRequest route_requests[ROUTE_REQUESTS_COUNT];
+static long route_requests_count;
+/** Indices of requests sorted by creature index. */
+static long route_requests_order[ROUTE_REQUESTS_COUNT];
+/** Indices of requests which need tracing, and amount of workspaces they are split between. */
+static long route_trace_list[ROUTE_REQUESTS_COUNT];
+static long route_trace_count;
+static long route_trace_slices;
+/** Whether re-routes of blocked creatures are queued; packet files made before it was introduced expect them traced at once. */
+static TbBool route_queueing = true;
+static struct NavReachSlot nav_reach_slots[NAV_REACH_SLOTS_COUNT];
+static unsigned long nav_reach_generation = 1;
+static long nav_reach_queue[TRIANLGLES_COUNT];
 
 /******************************************************************************/
 static unsigned char const actual_sizexy_to_nav_block_sizexy_table[] = {
@@ -184,8 +245,6 @@ const struct HugStart blocked_xy_hug_start[][2][2] = {
     {{  LbFPMath_PI/2, 2}, {LbFPMath_PI, 1}}},
 };
 
-static struct Path fwd_path;
-static struct Path bak_path;
 static struct Path best_path;
 /******************************************************************************/
 long thing_nav_block_sizexy(const struct Thing *thing)
@@ -226,15 +285,25 @@ long ix_Points = 0;
 long free_Points = -1;
 */
 /******************************************************************************/
-long route_to_path(long ptfind_x, long ptfind_y, long ptstart_x, long ptstart_y, const long *route, long wp_lim, struct Path *path, long *total_len);
-void path_out_a_bit(struct Path *path, const long *route);
+long route_to_path(struct AriadneWorkspace *ws, long ptfind_x, long ptfind_y, long ptstart_x, long ptstart_y, const long *route, long wp_lim, struct Path *path, long *total_len);
+void path_out_a_bit(const struct AriadneWorkspace *ws, struct Path *path, const long *route);
 void gate_navigator_init8(struct Pathway *pway, long trAx, long trAy, long trBx, long trBy, long wp_lim, unsigned char a7);
 void route_through_gates(const struct Pathway *pway, struct Path *path, long subroute);
 long ariadne_push_position_against_wall(struct Thing *thing, const struct Coord3d *pos1, struct Coord3d *pos_out);
 static TbBool ariadne_check_forward_for_wallhug_gap(struct Thing *thing, struct Ariadne *arid, struct Coord3d *pos, long hug_angle);
+static AriadneReturn ariadne_prepare_creature_route_from_path(const struct Thing *thing, struct Ariadne *arid,
+    const struct Coord3d *srcpos, const struct Coord3d *dstpos, const struct Path *path, long speed, AriadneRouteFlags flags, const char *func_name);
 long ariadne_get_blocked_flags(struct Thing *thing, const struct Coord3d *pos);
 static long triangle_findSE8(long ptfind_x, long ptfind_y);
-long ma_triangle_route(long ptfind_x, long ptfind_y, long *ptstart_x);
+static TbBool path_prepare_route(long start_x, long start_y, long end_x, long end_y, unsigned char nav_size,
+    long *tri_src, long *tri_dst, const char *func_name);
+static void path_fill_route_cache_key(struct RouteCacheKey *rckey, const struct AriadneWorkspace *ws,
+    long tri_src, long tri_dst, unsigned char nav_size);
+static void path_route_to_waypoints(struct AriadneWorkspace *ws, struct Path *path,
+    long start_x, long start_y, long end_x, long end_y, const long *route, long route_len);
+static long path_trace_route(struct AriadneWorkspace *ws, struct Path *path,
+    long start_x, long start_y, long end_x, long end_y, long tri_src, long tri_dst);
+long ma_triangle_route(struct AriadneWorkspace *ws, long ptfind_x, long ptfind_y, long *ptstart_x);
 void edgelen_init(void);
 /******************************************************************************/
 
@@ -307,7 +376,7 @@ void ariadne_compare_ways(const struct Ariadne *arid1, const struct Ariadne *ari
     }
 }
 
-unsigned long fits_thro(long tri_idx, long ormask_idx)
+unsigned long fits_thro(const struct AriadneWorkspace *ws, long tri_idx, long ormask_idx)
 {
     static unsigned long const edgelen_ORmask[] = {60, 51, 15};
     unsigned long eidx;
@@ -326,11 +395,11 @@ unsigned long fits_thro(long tri_idx, long ormask_idx)
     }
     emask = get_triangle_edgelen(tri_idx);
     eidx = edgelen_ORmask[ormask_idx] | emask;
-    if (EdgeFit != RadiusEdgeFit[0])
+    if (ws->edge_fit != RadiusEdgeFit[0])
     {
-      if (EdgeFit != RadiusEdgeFit[1])
+      if (ws->edge_fit != RadiusEdgeFit[1])
       {
-        if (EdgeFit != RadiusEdgeFit[2])
+        if (ws->edge_fit != RadiusEdgeFit[2])
         {
           ERRORLOG("table err");
           return 0;
@@ -347,7 +416,7 @@ unsigned long fits_thro(long tri_idx, long ormask_idx)
         ERRORLOG("edgebits overflow");
         return 0;
     }
-    return EdgeFit[eidx];
+    return ws->edge_fit[eidx];
 }
 
 void triangulate_map(NavColour *imap)
@@ -375,7 +444,7 @@ static PlayerBitFlags get_navtree_owner_flags(NavColour treeI)
     return treeI >> NAVMAP_OWNERSELECT_BIT;
 }
 
-long Keeper_nav_rulesA2B(NavColour treeA, NavColour treeB)
+long Keeper_nav_rulesA2B(const struct AriadneWorkspace *ws, NavColour treeA, NavColour treeB)
 {
     if ((treeB & NAVMAP_FLOORHEIGHT_MASK) - (treeA & NAVMAP_FLOORHEIGHT_MASK) > 1)
         return 0;
@@ -384,22 +453,22 @@ long Keeper_nav_rulesA2B(NavColour treeA, NavColour treeB)
     return 2;
 }
 
-long navigation_rule_normal(NavColour treeA, NavColour treeB)
+long navigation_rule_normal(const struct AriadneWorkspace *ws, NavColour treeA, NavColour treeB)
 {
     if ((treeB & NAVMAP_FLOORHEIGHT_MASK) - (treeA & NAVMAP_FLOORHEIGHT_MASK) > 1)
       return 0;
     if ((treeB & (NAVMAP_OWNERSELECT_MASK | NAVMAP_UNSAFE_SURFACE)) == 0)
       return 1;
-    if (owner_player_navigating != -1)
+    if (ws->owner != -1)
     {
-        if (get_navtree_owner_flags(treeB) & (1 << owner_player_navigating))
+        if (get_navtree_owner_flags(treeB) & (1 << ws->owner))
           return 0;
     }
     if ((treeB & NAVMAP_UNSAFE_SURFACE) == 0)
         return 1;
     if ((treeA & NAVMAP_UNSAFE_SURFACE) != 0)
         return 1;
-    return nav_thing_can_travel_over_lava;
+    return ws->can_travel_over_lava;
 }
 
 long init_navigation(void)
@@ -409,9 +478,128 @@ long init_navigation(void)
     triangulate_map(IanMap);
     nav_rulesA2B = navigation_rule_normal;
     game.map_changed_for_nagivation = 1;
+    // Whole map was just triangulated, so anything queued is already included
+    nav_update_queue_len = 0;
+    route_requests_count = 0;
     return 1;
 }
 
+static TbBool nav_update_areas_touch(const struct NavUpdateArea *area1, const struct NavUpdateArea *area2)
+{
+    return (area1->start_x <= area2->end_x + 1) && (area2->start_x <= area1->end_x + 1)
+        && (area1->start_y <= area2->end_y + 1) && (area2->start_y <= area1->end_y + 1);
+}
+
+/**
+ * Sets whether queued areas which overlap or touch are merged and triangulated once.
+ * Merging gives a different mesh than triangulating every change right after it,
+ * so it is disabled when replaying packet files which were recorded without it.
+ * @return The previous setting.
+ */
+TbBool triangulation_set_merging(TbBool merge)
+{
+    TbBool prev = nav_update_merging;
+    if (prev != merge)
+        triangulation_flush_queued();
+    nav_update_merging = merge;
+    return prev;
+}
+
+/**
+ * Prepares for change of navigation colours in given area. If areas are not merged,
+ * queued areas which overlap or touch it are triangulated first, while the map still
+ * has colours they were queued with. This way the mesh is the same as if every area
+ * was triangulated right after its change, and replays of older games stay in sync.
+ */
+void triangulation_prepare_area(long start_x, long start_y, long end_x, long end_y)
+{
+    if (nav_update_merging)
+        return;
+    struct NavUpdateArea area;
+    area.start_x = start_x;
+    area.start_y = start_y;
+    area.end_x = end_x;
+    area.end_y = end_y;
+    for (long i = 0; i < nav_update_queue_len; i++)
+    {
+        if (nav_update_areas_touch(&nav_update_queue[i], &area))
+        {
+            nav_update_stats.early_flushes++;
+            triangulation_flush_queued();
+            break;
+        }
+    }
+}
+
+/**
+ * Adds area to the list of areas waiting for retriangulation.
+ * When merging, areas which overlap or touch are merged, so they're triangulated only once;
+ * otherwise they are triangulated separately, in order of queueing.
+ * Colours of the area have to be changed after triangulation_prepare_area().
+ */
+void triangulation_queue_area(long start_x, long start_y, long end_x, long end_y)
+{
+    struct NavUpdateArea area;
+    area.start_x = start_x;
+    area.start_y = start_y;
+    area.end_x = end_x;
+    area.end_y = end_y;
+    nav_update_stats.queued++;
+    if (nav_update_merging)
+    {
+        // Merging may make the area touch other queued ones, so repeat until nothing more merges
+        long i = 0;
+        while (i < nav_update_queue_len)
+        {
+            struct NavUpdateArea* qarea = &nav_update_queue[i];
+            if (!nav_update_areas_touch(qarea, &area)) {
+                i++;
+                continue;
+            }
+            area.start_x = min(area.start_x, qarea->start_x);
+            area.start_y = min(area.start_y, qarea->start_y);
+            area.end_x = max(area.end_x, qarea->end_x);
+            area.end_y = max(area.end_y, qarea->end_y);
+            nav_update_queue_len--;
+            nav_update_queue[i] = nav_update_queue[nav_update_queue_len];
+            i = 0;
+        }
+    }
+    if (nav_update_queue_len >= NAV_UPDATE_QUEUE_LEN) {
+        triangulation_flush_queued();
+    }
+    nav_update_queue[nav_update_queue_len] = area;
+    nav_update_queue_len++;
+}
+
+/**
+ * Triangulates all areas waiting for it. Needs to be called before anything reads the triangulation.
+ */
+void triangulation_flush_queued(void)
+{
+    if (nav_update_queue_len <= 0)
+        return;
+    TbClockMicroSec started = LbTimerClockMicro();
+    for (long i = 0; i < nav_update_queue_len; i++)
+    {
+        struct NavUpdateArea* qarea = &nav_update_queue[i];
+        triangulate_area(IanMap, qarea->start_x, qarea->start_y, qarea->end_x, qarea->end_y);
+        nav_update_stats.triangulated++;
+    }
+    nav_update_queue_len = 0;
+    nav_update_stats.time_total += LbTimerClockMicro() - started;
+}
+
+void triangulation_get_update_stats(struct NavUpdateStats *stats)
+{
+    *stats = nav_update_stats;
+}
+
+void triangulation_reset_update_stats(void)
+{
+    LbMemorySet(&nav_update_stats, 0, sizeof(nav_update_stats));
+}
+
 long update_navigation_triangulation(long start_x, long start_y, long end_x, long end_y)
 {
     long sx;
@@ -439,6 +627,7 @@ long update_navigation_triangulation(long start_x, long start_y, long end_x, lon
     ey = end_y + 1;
     if (ey >= gameadd.map_subtiles_y-2)
       ey = gameadd.map_subtiles_y-2;
+    triangulation_prepare_area(sx, sy, ex, ey);
     // Fill a rectangle with nav colors (based on columns and blocks)
     for (y = sy; y <= ey; y++)
     {
@@ -447,7 +636,9 @@ long update_navigation_triangulation(long start_x, long start_y, long end_x, lon
             set_navigation_map(x, y, get_navigation_colour(x, y));
         }
     }
-    triangulate_area(IanMap, sx, sy, ex, ey);
+    nav_bench_record_update(sx, sy, ex, ey);
+    // Triangulation is delayed until something needs it, so all changes made in the meantime are done at once
+    triangulation_queue_area(sx, sy, ex, ey);
     return true;
 }
 
@@ -507,7 +698,7 @@ long fov_region(long a1, long a2, const struct FOV *fov)
     return (LbCompareMultiplications(diff_ay, diff_cx, diff_ax, diff_cy) > 0);
 }
 
-long route_to_path(long ptfind_x, long ptfind_y, long ptstart_x, long ptstart_y, const long *route, long wp_lim, struct Path *path, long *total_len)
+long route_to_path(struct AriadneWorkspace *ws, long ptfind_x, long ptfind_y, long ptstart_x, long ptstart_y, const long *route, long wp_lim, struct Path *path, long *total_len)
 {
     NAVIDBG(19,"Starting");
 
@@ -536,7 +727,7 @@ long route_to_path(long ptfind_x, long ptfind_y, long ptstart_x, long ptstart_y,
       *total_len = LbSqrL((ptstart_x - ptfind_x) * (ptstart_x - ptfind_x) + (ptstart_y - ptfind_y) * (ptstart_y - ptfind_y));
       path->waypoints[0].x = ptstart_x;
       path->waypoints[0].y = ptstart_y;
-      wayPoints.wpfield_10[0] = 0;
+      ws->way_points.wpfield_10[0] = 0;
       path->waypoints_num = 1;
       return 1;
     }
@@ -544,16 +735,16 @@ long route_to_path(long ptfind_x, long ptfind_y, long ptstart_x, long ptstart_y,
     wp1 = 0;
     wpi = 0;
     edge_points8(route[wpi+0], route[wpi+1], &fov_AC.tipB.x, &fov_AC.tipB.y, &fov_AC.tipC.x, &fov_AC.tipC.y);
-    wayPoints.wpfield_8 = wpi;
-    wayPoints.wpfield_C = wpi;
+    ws->way_points.wpfield_8 = wpi;
+    ws->way_points.wpfield_C = wpi;
     wpi++;
     while ( 1 )
     {
       if (wpi < wp_lim)
       {
           edge_points8(route[wpi+0], route[wpi+1], &edge1_x, &edge1_y, &edge2_x, &edge2_y);
-          wayPoints.wpfield_0 = wpi;
-          wayPoints.wpfield_4 = wpi;
+          ws->way_points.wpfield_0 = wpi;
+          ws->way_points.wpfield_4 = wpi;
           reg1 = fov_region(edge1_x, edge1_y, &fov_AC);
           reg2 = fov_region(edge2_x, edge2_y, &fov_AC);
       } else
@@ -567,14 +758,14 @@ long route_to_path(long ptfind_x, long ptfind_y, long ptstart_x, long ptstart_y,
       {
           fov_AC.tipB.x = edge1_x;
           fov_AC.tipB.y = edge1_y;
-          wayPoints.wpfield_8 = wayPoints.wpfield_0;
+          ws->way_points.wpfield_8 = ws->way_points.wpfield_0;
           wp1 = wpi;
       }
       if (reg2 == 0)
       {
           fov_AC.tipC.x = edge2_x;
           fov_AC.tipC.y = edge2_y;
-          wayPoints.wpfield_C = wayPoints.wpfield_4;
+          ws->way_points.wpfield_C = ws->way_points.wpfield_4;
           wp2 = wpi;
       }
       if (reg2 == -1)
@@ -588,13 +779,13 @@ long route_to_path(long ptfind_x, long ptfind_y, long ptstart_x, long ptstart_y,
         fov_AC.tipA.x = fov_AC.tipB.x;
         path->waypoints[wp_num].x = fov_AC.tipB.x;
         path->waypoints[wp_num].y = fov_AC.tipB.y;
-        wayPoints.wpfield_10[wp_num] = wayPoints.wpfield_8;
+        ws->way_points.wpfield_10[wp_num] = ws->way_points.wpfield_8;
         wp_num++;
         wpi = wp1;
         fov_AC.tipA.y = fov_AC.tipB.y;
         edge_points8(route[wpi+0], route[wpi+1], &fov_AC.tipB.x, &fov_AC.tipB.y, &fov_AC.tipC.x, &fov_AC.tipC.y);
-        wayPoints.wpfield_8 = wpi;
-        wayPoints.wpfield_C = wpi;
+        ws->way_points.wpfield_8 = wpi;
+        ws->way_points.wpfield_C = wpi;
       } else
       if (reg1 == 1)
       {
@@ -607,13 +798,13 @@ long route_to_path(long ptfind_x, long ptfind_y, long ptstart_x, long ptstart_y,
         fov_AC.tipA.x = fov_AC.tipC.x;
         path->waypoints[wp_num].x = fov_AC.tipC.x;
         path->waypoints[wp_num].y = fov_AC.tipC.y;
-        wayPoints.wpfield_10[wp_num] = wayPoints.wpfield_C;
+        ws->way_points.wpfield_10[wp_num] = ws->way_points.wpfield_C;
         wp_num++;
         wpi = wp2;
         fov_AC.tipA.y = fov_AC.tipC.y;
         edge_points8(route[wpi+0], route[wpi+1], &fov_AC.tipB.x, &fov_AC.tipB.y, &fov_AC.tipC.x, &fov_AC.tipC.y);
-        wayPoints.wpfield_8 = wpi;
-        wayPoints.wpfield_C = wpi;
+        ws->way_points.wpfield_8 = wpi;
+        ws->way_points.wpfield_C = wpi;
       }
       wpi++;
     }
@@ -624,13 +815,13 @@ long route_to_path(long ptfind_x, long ptfind_y, long ptstart_x, long ptstart_y,
         + (ptstart_y - fov_AC.tipA.y) * (ptstart_y - fov_AC.tipA.y));
     path->waypoints[wp_num].x = ptstart_x;
     path->waypoints[wp_num].y = ptstart_y;
-    wayPoints.wpfield_10[wp_num] = wp_lim;
+    ws->way_points.wpfield_10[wp_num] = wp_lim;
     wp_num++;
     path->waypoints_num = wp_num;
     return wp_num;
 }
 
-void waypoint_normal(long tri1_id, long cor1_id, long *norm_x, long *norm_y)
+void waypoint_normal(const struct AriadneWorkspace *ws, long tri1_id, long cor1_id, long *norm_x, long *norm_y)
 {
     int tri2_id;
     int tri3_id;
@@ -647,7 +838,7 @@ void waypoint_normal(long tri1_id, long cor1_id, long *norm_x, long *norm_y)
     {
         int ntri;
         ntri = Triangles[tri2_id].tags[cor2_id];
-        if (!nav_rulesA2B(get_triangle_tree_alt(tri2_id), get_triangle_tree_alt(ntri)))
+        if (!nav_rulesA2B(ws, get_triangle_tree_alt(tri2_id), get_triangle_tree_alt(ntri)))
             break;
         cor2_id = link_find(ntri, tri2_id);
         if (cor2_id < 0)
@@ -674,7 +865,7 @@ void waypoint_normal(long tri1_id, long cor1_id, long *norm_x, long *norm_y)
     {
         int ntri;
         ntri = Triangles[tri3_id].tags[cor3_id];
-        if (!nav_rulesA2B(get_triangle_tree_alt(tri3_id), get_triangle_tree_alt(ntri)))
+        if (!nav_rulesA2B(ws, get_triangle_tree_alt(tri3_id), get_triangle_tree_alt(ntri)))
             break;
         cor3_id = link_find(ntri, tri3_id);
         if (cor3_id < 0)
@@ -721,10 +912,10 @@ void waypoint_normal(long tri1_id, long cor1_id, long *norm_x, long *norm_y)
     *norm_y = ny;
 }
 
-void path_out_a_bit(struct Path *path, const long *route)
+void path_out_a_bit(const struct AriadneWorkspace *ws, struct Path *path, const long *route)
 {
     struct PathWayPoint *ppoint;
-    long *wpoint;
+    const long *wpoint;
     long tip_x;
     long tip_y;
     long norm_x;
@@ -734,7 +925,7 @@ void path_out_a_bit(struct Path *path, const long *route)
     long link_fwd;
     long link_bak;
     long i;
-    wpoint = &wayPoints.wpfield_10[0];
+    wpoint = &ws->way_points.wpfield_10[0];
     ppoint = &path->waypoints[0];
     for (i=0; i < path->waypoints_num-1; i++)
     {
@@ -746,11 +937,11 @@ void path_out_a_bit(struct Path *path, const long *route)
         tip_y = (ppoint->y >> 8);
         if (triangle_tip_equals(prev_pt, link_fwd, tip_x, tip_y))
         {
-            waypoint_normal(prev_pt, link_fwd, &norm_x, &norm_y);
+            waypoint_normal(ws, prev_pt, link_fwd, &norm_x, &norm_y);
         } else
         if (triangle_tip_equals(curr_pt, link_bak, tip_x, tip_y))
         {
-            waypoint_normal(curr_pt, link_bak, &norm_x, &norm_y);
+            waypoint_normal(ws, curr_pt, link_bak, &norm_x, &norm_y);
         } else
         {
             ERRORLOG("waypoint mismatch");
@@ -1028,10 +1219,10 @@ void cull_gate_to_best_point(struct Gate *gt, long a2)
     }
 }
 
-long gate_route_to_coords(long trAx, long trAy, long trBx, long trBy, long *a5, long a6, struct Pathway *pway, long a8)
+long gate_route_to_coords(struct AriadneWorkspace *ws, long trAx, long trAy, long trBx, long trBy, long *a5, long a6, struct Pathway *pway, long a8)
 {
     long total_len;
-    best_path.waypoints_num = route_to_path(trAx, trAy, trBx, trBy, a5, a6, &best_path, &total_len);
+    best_path.waypoints_num = route_to_path(ws, trAx, trAy, trBx, trBy, a5, a6, &best_path, &total_len);
     pway->field_0 = trAx;
     pway->field_4 = trAy;
     pway->field_8 = trBx;
@@ -1239,20 +1430,21 @@ void gate_navigator_init8(struct Pathway *pway, long trAx, long trAy, long trBx,
     pway->field_8 = trBx;
     pway->points_num = 0;
     pway->field_C = trBy;
+    struct AriadneWorkspace* ws = ariadne_main_workspace();
     tree_routelen = -1;
     tree_triA = triangle_findSE8(trAx, trAy);
     tree_triB = triangle_findSE8(trBx, trBy);
-    tree_Ax8 = trAx;
-    tree_Ay8 = trAy;
-    tree_Bx8 = trBx;
-    tree_By8 = trBy;
+    ws->tree_Ax8 = trAx;
+    ws->tree_Ay8 = trAy;
+    ws->tree_Bx8 = trBx;
+    ws->tree_By8 = trBy;
     tree_altA = get_triangle_tree_alt(tree_triA);
     tree_altB = get_triangle_tree_alt(tree_triB);
     if ((tree_triA != -1) && (tree_triB != -1))
     {
-        tree_routelen = ma_triangle_route(tree_triA, tree_triB, &tree_routecost);
+        tree_routelen = ma_triangle_route(ws, tree_triA, tree_triB, &tree_routecost);
         if (tree_routelen != -1) {
-            pway->points_num = gate_route_to_coords(trAx, trAy, trBx, trBy, tree_route, tree_routelen, pway, wp_lim);
+            pway->points_num = gate_route_to_coords(ws, trAx, trAy, trBx, trBy, ws->tree_route, tree_routelen, pway, wp_lim);
         }
     }
 }
@@ -1354,6 +1546,7 @@ unsigned long nav_same_component(long ptAx, long ptAy, long ptBx, long ptBy)
     NAVIDBG(19,"F=%d Connect %03d,%03d %03d,%03d", game.play_gameturn, ptAx, ptAy, ptBx, ptBy);
     long tri1_id;
     long tri2_id;
+    triangulation_flush_queued();
     tri1_id = triangle_findSE8(ptAx, ptAy);
     tri2_id = triangle_findSE8(ptBx, ptBy);
     if ((tree_triA == -1) || (tree_triB == -1)) {
@@ -1370,9 +1563,156 @@ TbBool navigation_points_connected(struct Coord3d *pt1, struct Coord3d *pt2)
   return nav_same_component(pt1->x.val, pt1->y.val, pt2->x.val, pt2->y.val);
 }
 
-TbBool triangulation_border_tag(void)
+/**
+ * Drops reachability labels of all rule sets. Needs to be called on every change of triangulation.
+ */
+static void nav_reach_triangulation_changed(void)
 {
-    if (border_tags_to_current(Border, ix_Border) != ix_Border)
+    nav_reach_generation++;
+    if (nav_reach_generation == 0)
+    {
+        for (int i = 0; i < NAV_REACH_SLOTS_COUNT; i++)
+            nav_reach_slots[i].generation = 0;
+        nav_reach_generation = 1;
+    }
+}
+
+static TbBool nav_reach_triangle_routable(long tri_id)
+{
+    NavColour tree_alt = get_triangle_tree_alt(tri_id);
+    if (tree_alt == NAV_COL_UNSET)
+        return false;
+    // Same condition as in regions_connected()
+    return ((tree_alt & 0x0F) != 0x0F);
+}
+
+/**
+ * Gives labels to triangles, so that triangles which can be reached from each other have the same label.
+ * @param ws Workspace with navigation rule parameters set.
+ * @param labels Output array of labels.
+ * @param both_way If true, only moves allowed in both directions connect triangles.
+ */
+static void nav_reach_fill_labels(const struct AriadneWorkspace *ws, unsigned int *labels, TbBool both_way)
+{
+    const unsigned int unlabeled = UINT_MAX;
+    long tri_id;
+    unsigned int label = 0;
+    for (tri_id = 0; tri_id < ix_Triangles; tri_id++)
+    {
+        labels[tri_id] = nav_reach_triangle_routable(tri_id) ? unlabeled : 0;
+    }
+    // Routes never enter border triangles
+    for (long i = 0; i < ix_Border; i++)
+    {
+        if ((Border[i] >= 0) && (Border[i] < ix_Triangles))
+            labels[Border[i]] = 0;
+    }
+    for (tri_id = 0; tri_id < ix_Triangles; tri_id++)
+    {
+        if (labels[tri_id] != unlabeled)
+            continue;
+        label++;
+        long queue_len = 0;
+        labels[tri_id] = label;
+        nav_reach_queue[queue_len++] = tri_id;
+        for (long qi = 0; qi < queue_len; qi++)
+        {
+            long ctri_id = nav_reach_queue[qi];
+            NavColour calt = get_triangle_tree_alt(ctri_id);
+            for (int ncor = 0; ncor < 3; ncor++)
+            {
+                long ntri_id = Triangles[ctri_id].tags[ncor];
+                if ((ntri_id < 0) || (ntri_id >= ix_Triangles) || (labels[ntri_id] != unlabeled))
+                    continue;
+                NavColour nalt = get_triangle_tree_alt(ntri_id);
+                TbBool fwd = (nav_rulesA2B(ws, calt, nalt) != 0);
+                TbBool bak = (nav_rulesA2B(ws, nalt, calt) != 0);
+                if (both_way ? (fwd && bak) : (fwd || bak))
+                {
+                    labels[ntri_id] = label;
+                    nav_reach_queue[queue_len++] = ntri_id;
+                }
+            }
+        }
+    }
+}
+
+/**
+ * Returns slot with reachability labels for navigation rules set in given workspace.
+ * Every rule set has its own slot, so labels are made only on first use after the triangulation was changed.
+ * @return The slot, or NULL if labels can't be made for given rules.
+ */
+static struct NavReachSlot *nav_reach_get_slot(const struct AriadneWorkspace *ws)
+{
+    if ((ws->owner < -1) || (ws->owner >= PLAYERS_COUNT))
+        return NULL;
+    struct NavReachSlot* slot = &nav_reach_slots[(ws->owner + 1) * 2 + (ws->can_travel_over_lava ? 1 : 0)];
+    if (slot->both_way == NULL)
+    {
+        slot->both_way = (unsigned int *)LbMemoryAlloc(2 * TRIANLGLES_COUNT * sizeof(unsigned int));
+        if (slot->both_way == NULL)
+        {
+            ERRORLOG("Cannot allocate reachability labels");
+            return NULL;
+        }
+        slot->any_way = slot->both_way + TRIANLGLES_COUNT;
+        slot->generation = 0;
+    }
+    if (slot->generation != nav_reach_generation)
+    {
+        NAVIDBG(9,"Labeling %ld triangles for owner %ld",(long)ix_Triangles,(long)ws->owner);
+        nav_reach_fill_labels(ws, slot->both_way, true);
+        nav_reach_fill_labels(ws, slot->any_way, false);
+        slot->generation = nav_reach_generation;
+    }
+    return slot;
+}
+
+/**
+ * Checks whether a creature can get to given position, without tracing the route if possible.
+ * The route is only certain if the creature fits through any passage, and it can get back
+ * the same way; if the answer is not certain, AridRch_Unknown is returned.
+ */
+AriadneReachability ariadne_creature_reachability_f(const struct Thing *thing,
+    const struct Coord3d *srcpos, const struct Coord3d *dstpos, AriadneRouteFlags flags, const char *func_name)
+{
+    triangulation_flush_queued();
+    long tri_src = triangle_findSE8(srcpos->x.val, srcpos->y.val);
+    long tri_dst = triangle_findSE8(dstpos->x.val, dstpos->y.val);
+    if ((tri_src == -1) || (tri_dst == -1))
+        return AridRch_Unknown;
+    // This also updates regions, just like when tracing a route
+    if (!regions_connected(tri_src, tri_dst))
+    {
+        NAVIDBG(19,"%s: Regions not connected",func_name);
+        return AridRch_Unreachable;
+    }
+    struct AriadneWorkspace* ws = ariadne_main_workspace();
+    ws->can_travel_over_lava = creature_can_travel_over_lava(thing);
+    if ((flags & AridRtF_NoOwner) != 0)
+        ws->owner = -1;
+    else
+        ws->owner = thing->owner;
+    struct NavReachSlot* slot = nav_reach_get_slot(ws);
+    if (slot == NULL)
+        return AridRch_Unknown;
+    if ((slot->any_way[tri_src] == 0) || (slot->any_way[tri_dst] == 0))
+        return AridRch_Unknown;
+    if (slot->any_way[tri_src] != slot->any_way[tri_dst])
+    {
+        NAVIDBG(19,"%s: Triangles %ld and %ld not connected",func_name,tri_src,tri_dst);
+        return AridRch_Unreachable;
+    }
+    long nav_sizexy = thing_nav_block_sizexy(thing);
+    if (nav_sizexy > 0) nav_sizexy--;
+    if ((nav_sizexy == 0) && (slot->both_way[tri_src] == slot->both_way[tri_dst]))
+        return AridRch_Reachable;
+    return AridRch_Unknown;
+}
+
+TbBool triangulation_border_tag(struct AriadneWorkspace *ws)
+{
+    if (border_tags_to_current(ws, Border, ix_Border) != ix_Border)
     {
         ERRORLOG("Some border Tags were outranged");
         return false;
@@ -1380,18 +1720,18 @@ TbBool triangulation_border_tag(void)
     return true;
 }
 
-long dest_node(long tri_id, long cor_id)
+long dest_node(const struct AriadneWorkspace *ws, long tri_id, long cor_id)
 {
     long n;
     n = Triangles[tri_id].tags[cor_id];
     if (n < 0)
         return -1;
-    if (!nav_rulesA2B(get_triangle_tree_alt(tri_id), get_triangle_tree_alt(n)))
+    if (!nav_rulesA2B(ws, get_triangle_tree_alt(tri_id), get_triangle_tree_alt(n)))
         return -1;
     return n;
 }
 
-void creature_radius_set(long radius)
+void creature_radius_set(struct AriadneWorkspace *ws, long radius)
 {
     edgelen_init();
     if ((radius < 1) || (radius > EDGEOR_COUNT)) {
@@ -1402,7 +1742,7 @@ void creature_radius_set(long radius)
             radius = EDGEOR_COUNT;
         }
     }
-    EdgeFit = RadiusEdgeFit[radius];
+    ws->edge_fit = RadiusEdgeFit[radius];
 }
 
 static void set_nearpoint(long tri_id, long cor_id, long dstx, long dsty, long *px, long *py)
@@ -1453,14 +1793,16 @@ static void set_nearpoint(long tri_id, long cor_id, long dstx, long dsty, long *
 
 void nearest_search_f(long sizexy, long srcx, long srcy, long dstx, long dsty, long *px, long *py, const char *func_name)
 {
-    creature_radius_set(sizexy+1);
-    tags_init();
+    triangulation_flush_queued();
+    struct AriadneWorkspace* ws = ariadne_main_workspace();
+    creature_radius_set(ws, sizexy+1);
+    tags_init(ws);
     long tri1_id;
     long tri2_id;
     tri1_id = triangle_findSE8(srcx, srcy);
     tri2_id = triangle_findSE8(dstx, dsty);
     region_store_init();
-    store_current_tag(tri1_id);
+    store_current_tag(ws, tri1_id);
     region_put(tri1_id);
     if (tri2_id == tri1_id)
     {
@@ -1510,13 +1852,13 @@ void nearest_search_f(long sizexy, long srcx, long srcy, long dstx, long dsty, l
         {
             long ntri;
             ntri = tri->tags[ncor1];
-            if ((ntri != -1) && !is_current_tag(ntri))
+            if ((ntri != -1) && !is_current_tag(ws, ntri))
             {
                 if ((Triangles[ntri].tree_alt & 0xF) != 15)
                 {
-                    if (fits_thro(regn, ncor1))
+                    if (fits_thro(ws, regn, ncor1))
                     {
-                        store_current_tag(ntri);
+                        store_current_tag(ws, ntri);
                         region_put(ntri);
                         if (tri2_id == ntri)
                         {
@@ -1550,7 +1892,7 @@ void nearest_search_f(long sizexy, long srcx, long srcy, long dstx, long dsty, l
     set_nearpoint(seltri_id, selcor_id, dstx, dsty, px, py);
 }
 
-long cost_to_start(long tri_idx)
+long cost_to_start(const struct AriadneWorkspace *ws, long tri_idx)
 {
     long long len_x;
     long long len_y;
@@ -1564,8 +1906,8 @@ long cost_to_start(long tri_idx)
     for (i=0; i < 3; i++)
     {
         pt = point_get(tri->points[i]);
-        len_x = ((tree_Ax8 >> 8) - (long)(pt->x));
-        len_y = ((tree_Ay8 >> 8) - (long)(pt->y));
+        len_x = ((ws->tree_Ax8 >> 8) - (long)(pt->x));
+        len_y = ((ws->tree_Ay8 >> 8) - (long)(pt->y));
         newcost = len_x*len_x+len_y*len_y;
         if (newcost < mincost)
             mincost = newcost;
@@ -1640,7 +1982,7 @@ long pointed_at8(long pos_x, long pos_y, long *ret_tri, long *ret_pt)
     return -1;
 }
 
-TbBool triangle_check_and_add_navitree_fwd(long ttri)
+TbBool triangle_check_and_add_navitree_fwd(struct AriadneWorkspace *ws, long ttri)
 {
     struct Triangle *tri;
     tri = get_triangle(ttri);
@@ -1657,9 +1999,9 @@ TbBool triangle_check_and_add_navitree_fwd(long ttri)
     for (i = 0; i < 3; i++)
     {
         k = tri->tags[i];
-        if (!is_current_tag(k))
+        if (!is_current_tag(ws, k))
         {
-            if ( fits_thro(ttri, n) )
+            if ( fits_thro(ws, ttri, n) )
             {
                 NavColour ttri_alt;
                 NavColour k_alt;
@@ -1669,13 +2011,13 @@ TbBool triangle_check_and_add_navitree_fwd(long ttri)
                 {
                     long mvcost;
                     long navrule;
-                    navrule = nav_rulesA2B(k_alt, ttri_alt);
+                    navrule = nav_rulesA2B(ws, k_alt, ttri_alt);
                     if (navrule)
                     {
-                        mvcost = cost_to_start(k);
+                        mvcost = cost_to_start(ws, k);
                         if (navrule == 2)
                             mvcost *= 16;
-                        if (!navitree_add(k,ttri,mvcost))
+                        if (!navitree_add(ws,k,ttri,mvcost))
                             nskipped++;
                     }
                 }
@@ -1690,7 +2032,7 @@ TbBool triangle_check_and_add_navitree_fwd(long ttri)
     return true;
 }
 
-TbBool triangle_check_and_add_navitree_bak(long ttri)
+TbBool triangle_check_and_add_navitree_bak(struct AriadneWorkspace *ws, long ttri)
 {
     struct Triangle *tri;
     tri = get_triangle(ttri);
@@ -1707,7 +2049,7 @@ TbBool triangle_check_and_add_navitree_bak(long ttri)
     for (i = 0; i < 3; i++)
     {
         k = tri->tags[i];
-        if (!is_current_tag(k))
+        if (!is_current_tag(ws, k))
         {
             NavColour ttri_alt;
             NavColour k_alt;
@@ -1717,13 +2059,13 @@ TbBool triangle_check_and_add_navitree_bak(long ttri)
             {
                 long mvcost;
                 long navrule;
-                navrule = nav_rulesA2B(ttri_alt, k_alt);
+                navrule = nav_rulesA2B(ws, ttri_alt, k_alt);
                 if (navrule)
                 {
-                    mvcost = cost_to_start(k);
+                    mvcost = cost_to_start(ws, k);
                     if (navrule == 2)
                         mvcost *= 16;
-                    if (!navitree_add(k,ttri,mvcost))
+                    if (!navitree_add(ws,k,ttri,mvcost))
                         nskipped++;
                 }
             }
@@ -1745,58 +2087,58 @@ TbBool triangle_check_and_add_navitree_bak(long ttri)
  * @param routecost Output integer where the tree route cost is returned.
  * @return Amount of points copied into the route array, or -1 on routing failure.
  */
-long triangle_route_do_fwd(long ttriA, long ttriB, long *route, long *routecost)
+long triangle_route_do_fwd(struct AriadneWorkspace *ws, long ttriA, long ttriB, long *route, long *routecost)
 {
     NAVIDBG(19,"Starting");
-    tags_init();
+    tags_init(ws);
     if ((ix_Border < 0) || (ix_Border >= BORDER_LENGTH))
     {
         ERRORLOG("Border overflow");
         ix_Border = BORDER_LENGTH-1;
     }
-    triangulation_border_tag();
+    triangulation_border_tag(ws);
 
-    naviheap_init();
+    naviheap_init(ws);
     // Add final region to navigation tree
-    if (!navitree_add(ttriB, ttriB, 1)) {
+    if (!navitree_add(ws, ttriB, ttriB, 1)) {
         ERRORLOG("Navigate heap full after cleaning");
         return -1;
     }
     // Keep adding sibling regions until we are in beginning region
     // Do two of them at a time
-    while (ttriA != naviheap_top())
+    while (ttriA != naviheap_top(ws))
     {
         long ttriH1;
         long ttriH2;
-        if (naviheap_empty())
+        if (naviheap_empty(ws))
             break;
-        ttriH1 = naviheap_remove();
-        if (naviheap_empty())
+        ttriH1 = naviheap_remove(ws);
+        if (naviheap_empty(ws))
         {
             ttriH2 = -1;
         } else
         {
-            ttriH2 = naviheap_top();
+            ttriH2 = naviheap_top(ws);
             if (ttriH2 == ttriA)
                 break;
-            naviheap_remove();
+            naviheap_remove(ws);
         }
         if (ttriH1 != -1)
         {
-            triangle_check_and_add_navitree_fwd(ttriH1);
+            triangle_check_and_add_navitree_fwd(ws, ttriH1);
         }
         if (ttriH2 != -1)
         {
-            triangle_check_and_add_navitree_fwd(ttriH2);
+            triangle_check_and_add_navitree_fwd(ws, ttriH2);
         }
     }
     NAVIDBG(19,"Almost finished");
-    if (naviheap_empty()) {
+    if (naviheap_empty(ws)) {
         // The beginning region was never reached
         return -1;
     }
     long i;
-    i = copy_tree_to_route(ttriA, ttriB, route, TRIANLGLES_COUNT+1);
+    i = copy_tree_to_route(ws, ttriA, ttriB, route, TRIANLGLES_COUNT+1);
     if (i < 0) {
         erstat_inc(ESE_BadRouteTree);
         ERRORLOG("route length overflow");
@@ -1813,58 +2155,58 @@ long triangle_route_do_fwd(long ttriA, long ttriB, long *route, long *routecost)
  * @return Amount of points copied into the route array, or -1 on routing failure.
  * @note This function should differ from triangle_route_do_bak() in only one line
  */
-long triangle_route_do_bak(long ttriA, long ttriB, long *route, long *routecost)
+long triangle_route_do_bak(struct AriadneWorkspace *ws, long ttriA, long ttriB, long *route, long *routecost)
 {
     NAVIDBG(19,"Starting");
-    tags_init();
+    tags_init(ws);
     if ((ix_Border < 0) || (ix_Border >= BORDER_LENGTH))
     {
         ERRORLOG("Border overflow");
         ix_Border = BORDER_LENGTH-1;
     }
-    triangulation_border_tag();
+    triangulation_border_tag(ws);
 
-    naviheap_init();
+    naviheap_init(ws);
     // Add final region to navigation tree
-    if (!navitree_add(ttriB, ttriB, 1)) {
+    if (!navitree_add(ws, ttriB, ttriB, 1)) {
         ERRORLOG("Navigate heap full after cleaning");
         return -1;
     }
     // Keep adding sibling regions until we are in beginning region
     // Do two of them at a time
-    while (ttriA != naviheap_top())
+    while (ttriA != naviheap_top(ws))
     {
         long ttriH1;
         long ttriH2;
-        if (naviheap_empty())
+        if (naviheap_empty(ws))
             break;
-        ttriH1 = naviheap_remove();
-        if (naviheap_empty())
+        ttriH1 = naviheap_remove(ws);
+        if (naviheap_empty(ws))
         {
             ttriH2 = -1;
         } else
         {
-            ttriH2 = naviheap_top();
+            ttriH2 = naviheap_top(ws);
             if (ttriH2 == ttriA)
                 break;
-            naviheap_remove();
+            naviheap_remove(ws);
         }
         if (ttriH1 != -1)
         {
-            triangle_check_and_add_navitree_bak(ttriH1);
+            triangle_check_and_add_navitree_bak(ws, ttriH1);
         }
         if (ttriH2 != -1)
         {
-            triangle_check_and_add_navitree_bak(ttriH2);
+            triangle_check_and_add_navitree_bak(ws, ttriH2);
         }
     }
     NAVIDBG(19,"Almost finished");
-    if (naviheap_empty()) {
+    if (naviheap_empty(ws)) {
         // The beginning region was never reached
         return -1;
     }
     long i;
-    i = copy_tree_to_route(ttriA, ttriB, route, TRIANLGLES_COUNT+1);
+    i = copy_tree_to_route(ws, ttriA, ttriB, route, TRIANLGLES_COUNT+1);
     if (i < 0) {
         erstat_inc(ESE_BadRouteTree);
         ERRORLOG("route length overflow");
@@ -1879,7 +2221,7 @@ long triangle_route_do_bak(long ttriA, long ttriB, long *route, long *routecost)
  * @param routecost Pointer where the tree route cost is returned.
  * @return
  */
-long ma_triangle_route(long ttriA, long ttriB, long *routecost)
+long ma_triangle_route(struct AriadneWorkspace *ws, long ttriA, long ttriB, long *routecost)
 {
     long len_fwd;
     long len_bak;
@@ -1895,42 +2237,42 @@ long ma_triangle_route(long ttriA, long ttriB, long *routecost)
     // Forward route
     NAVIDBG(19,"Making forward route");
     rcost_fwd = 0;
-    len_fwd = triangle_route_do_fwd(ttriA, ttriB, route_fwd, &rcost_fwd);
+    len_fwd = triangle_route_do_fwd(ws, ttriA, ttriB, ws->route_fwd, &rcost_fwd);
     if (len_fwd == -1)
     {
         NAVIDBG(19,"No forward route");
         return -1;
     }
-    route_to_path(tree_Ax8, tree_Ay8, tree_Bx8, tree_By8, route_fwd, len_fwd, &fwd_path, &par_fwd);
-    tx = tree_Ax8;
-    ty = tree_Ay8;
-    tree_Ax8 = tree_Bx8;
-    tree_Ay8 = tree_By8;
-    tree_Bx8 = tx;
-    tree_By8 = ty;
+    route_to_path(ws, ws->tree_Ax8, ws->tree_Ay8, ws->tree_Bx8, ws->tree_By8, ws->route_fwd, len_fwd, &ws->fwd_path, &par_fwd);
+    tx = ws->tree_Ax8;
+    ty = ws->tree_Ay8;
+    ws->tree_Ax8 = ws->tree_Bx8;
+    ws->tree_Ay8 = ws->tree_By8;
+    ws->tree_Bx8 = tx;
+    ws->tree_By8 = ty;
     // Backward route
     NAVIDBG(19,"Making backward route");
     rcost_bak = 0;
-    len_bak = triangle_route_do_bak(ttriB, ttriA, route_bak, &rcost_bak);
+    len_bak = triangle_route_do_bak(ws, ttriB, ttriA, ws->route_bak, &rcost_bak);
     if (len_bak == -1)
     {
         NAVIDBG(19,"No backward route");
         return -1;
     }
-    route_to_path(tree_Ax8, tree_Ay8, tree_Bx8, tree_By8, route_bak, len_bak, &bak_path, &par_bak);
-    tx = tree_Ax8;
-    ty = tree_Ay8;
-    tree_Ax8 = tree_Bx8;
-    tree_Ay8 = tree_By8;
-    tree_Bx8 = tx;
-    tree_By8 = ty;
+    route_to_path(ws, ws->tree_Ax8, ws->tree_Ay8, ws->tree_Bx8, ws->tree_By8, ws->route_bak, len_bak, &ws->bak_path, &par_bak);
+    tx = ws->tree_Ax8;
+    ty = ws->tree_Ay8;
+    ws->tree_Ax8 = ws->tree_Bx8;
+    ws->tree_Ay8 = ws->tree_By8;
+    ws->tree_Bx8 = tx;
+    ws->tree_By8 = ty;
     // Select a route
     NAVIDBG(19,"Selecting route");
     if (par_fwd < par_bak)
     {
-        for (i=0; i < sizeof(tree_route)/sizeof(tree_route[0]); i++)
+        for (i=0; i < sizeof(ws->tree_route)/sizeof(ws->tree_route[0]); i++)
         {
-             tree_route[i] = route_fwd[i];
+             ws->tree_route[i] = ws->route_fwd[i];
         }
         *routecost = rcost_fwd;
         return len_fwd;
@@ -1938,7 +2280,7 @@ long ma_triangle_route(long ttriA, long ttriB, long *routecost)
     {
         for (i=0; i <= len_bak; i++)
         {
-             tree_route[i] = route_bak[len_bak-i];
+             ws->tree_route[i] = ws->route_bak[len_bak-i];
         }
         *routecost = rcost_bak;
         return len_bak;
@@ -1951,29 +2293,28 @@ void edgelen_init(void)
         return;
     edgelen_initialised = true;
     int i;
+    unsigned long *edge_fit;
     // Fill edge values
-    EdgeFit = RadiusEdgeFit[0];
+    edge_fit = RadiusEdgeFit[0];
     for (i=0; i < EDGEFIT_LEN; i++)
     {
-        EdgeFit[i] = 0;
+        edge_fit[i] = 0;
     }
-    EdgeFit = RadiusEdgeFit[1];
+    edge_fit = RadiusEdgeFit[1];
     for (i=0; i < EDGEFIT_LEN; i++)
     {
-        EdgeFit[i] = 1;
+        edge_fit[i] = 1;
     }
-    EdgeFit = RadiusEdgeFit[2];
+    edge_fit = RadiusEdgeFit[2];
     for (i=0; i < EDGEFIT_LEN; i++)
     {
-        EdgeFit[i] = ((i & 0x2A) == 0x2A);
+        edge_fit[i] = ((i & 0x2A) == 0x2A);
     }
-    EdgeFit = RadiusEdgeFit[3];
+    edge_fit = RadiusEdgeFit[3];
     for (i=0; i < EDGEFIT_LEN; i++)
     {
-        EdgeFit[i] = ((i & 0x3F) == 0x3F);
+        edge_fit[i] = ((i & 0x3F) == 0x3F);
     }
-    // Reset pointer
-    EdgeFit = RadiusEdgeFit[1];
 }
 
 TbBool ariadne_creature_reached_position(const struct Thing *thing, const struct Coord3d *pos)
@@ -2686,6 +3027,15 @@ AriadneReturn ariadne_prepare_creature_route_to_target_f(const struct Thing *thi
     // Reset globals
     nav_thing_can_travel_over_lava = 0;
     owner_player_navigating = -1;
+    return ariadne_prepare_creature_route_from_path(thing, arid, srcpos, dstpos, &path, speed, flags, func_name);
+}
+
+/**
+ * Fills creature route from source to destination position with already traced path.
+ */
+static AriadneReturn ariadne_prepare_creature_route_from_path(const struct Thing *thing, struct Ariadne *arid,
+    const struct Coord3d *srcpos, const struct Coord3d *dstpos, const struct Path *path, long speed, AriadneRouteFlags flags, const char *func_name)
+{
     // Fill the Ariadne struct
     arid->startpos.x.val = srcpos->x.val;
     arid->startpos.y.val = srcpos->y.val;
@@ -2693,17 +3043,17 @@ AriadneReturn ariadne_prepare_creature_route_to_target_f(const struct Thing *thi
     arid->endpos.x.val = dstpos->x.val;
     arid->endpos.y.val = dstpos->y.val;
     arid->endpos.z.val = dstpos->z.val;
-    if (path.waypoints_num <= 0) {
+    if (path->waypoints_num <= 0) {
         NAVIDBG(18,"%s: Cannot find route", func_name);
         arid->total_waypoints = 0;
         arid->stored_waypoints = arid->total_waypoints;
         return AridRet_Val2;
     }
     // Fill total waypoints number
-    if (path.waypoints_num < ARID_PATH_WAYPOINTS_COUNT) {
-        arid->total_waypoints = path.waypoints_num;
+    if (path->waypoints_num < ARID_PATH_WAYPOINTS_COUNT) {
+        arid->total_waypoints = path->waypoints_num;
     } else {
-        WARNLOG("%s: The %d waypoints is too many - cutting down", func_name,(int)path.waypoints_num);
+        WARNLOG("%s: The %d waypoints is too many - cutting down", func_name,(int)path->waypoints_num);
         arid->total_waypoints = ARID_PATH_WAYPOINTS_COUNT-1;
     }
     // Fill stored waypoints (up to ARID_WAYPOINTS_COUNT)
@@ -2717,8 +3067,8 @@ AriadneReturn ariadne_prepare_creature_route_to_target_f(const struct Thing *thi
     k = 0;
     for (i = 0; i < arid->stored_waypoints; i++)
     {
-        arid->waypoints[i].x.val = path.waypoints[k].x;
-        arid->waypoints[i].y.val = path.waypoints[k].y;
+        arid->waypoints[i].x.val = path->waypoints[k].x;
+        arid->waypoints[i].y.val = path->waypoints[k].y;
         k++;
     }
     arid->current_waypoint = 0;
@@ -2778,7 +3128,12 @@ AriadneReturn ariadne_invalidate_creature_route(struct Thing *thing)
     return AridRet_OK;
 }
 
-AriadneReturn ariadne_initialise_creature_route_f(struct Thing *thing, const struct Coord3d *pos, long speed, AriadneRouteFlags flags, const char *func_name)
+/**
+ * Initialises creature route to given position.
+ * @param path Route already traced from the creature position, or NULL if the route should be traced now.
+ */
+static AriadneReturn ariadne_initialise_creature_route_with_path(struct Thing *thing, const struct Coord3d *pos, long speed,
+    AriadneRouteFlags flags, const struct Path *path, const char *func_name)
 {
     struct CreatureControl *cctrl;
     struct Ariadne *arid;
@@ -2799,7 +3154,10 @@ AriadneReturn ariadne_initialise_creature_route_f(struct Thing *thing, const str
         }
     } else
     {
-        ret = ariadne_prepare_creature_route_to_target_f(thing, arid, &thing->mappos, pos, speed, flags, func_name);
+        if (path != NULL)
+            ret = ariadne_prepare_creature_route_from_path(thing, arid, &thing->mappos, pos, path, speed, flags, func_name);
+        else
+            ret = ariadne_prepare_creature_route_to_target_f(thing, arid, &thing->mappos, pos, speed, flags, func_name);
         if (ret != AridRet_OK) {
             NAVIDBG(19,"%s: Failed to prepare route from %5d,%5d to %5d,%5d", func_name,
                 (int)thing->mappos.x.val,(int)thing->mappos.y.val, (int)pos->x.val,(int)pos->y.val);
@@ -2812,6 +3170,219 @@ AriadneReturn ariadne_initialise_creature_route_f(struct Thing *thing, const str
     return AridRet_OK;
 }
 
+AriadneReturn ariadne_initialise_creature_route_f(struct Thing *thing, const struct Coord3d *pos, long speed, AriadneRouteFlags flags, const char *func_name)
+{
+    return ariadne_initialise_creature_route_with_path(thing, pos, speed, flags, NULL, func_name);
+}
+
+/**
+ * Sets whether creature routes may be queued and traced at end of the creatures update.
+ * Queued routes make creatures wait until the end of the turn, so the game goes differently;
+ * queueing is disabled when replaying packet files which were recorded without it.
+ * @return The previous setting.
+ */
+TbBool ariadne_set_route_queueing(TbBool queue)
+{
+    TbBool prev = route_queueing;
+    route_queueing = queue;
+    return prev;
+}
+
+/**
+ * Queues creature route to be traced at end of the creatures update, together with routes of other creatures.
+ * Until the route is traced, the creature keeps its current one.
+ * @return True if the route was queued; if the queue is full or queueing is disabled, the route has to be initialised directly.
+ */
+TbBool ariadne_queue_creature_route(struct Thing *thing, const struct Coord3d *pos, long speed, AriadneRouteFlags flags)
+{
+    if (!route_queueing)
+        return false;
+    struct RouteRequest* rreq = NULL;
+    for (long i = 0; i < route_requests_count; i++)
+    {
+        if (route_requests[i].thing_idx == thing->index)
+        {
+            rreq = &route_requests[i];
+            break;
+        }
+    }
+    if (rreq == NULL)
+    {
+        if (route_requests_count >= ROUTE_REQUESTS_COUNT)
+            return false;
+        rreq = &route_requests[route_requests_count];
+        route_requests_count++;
+    }
+    NAVIDBG(18,"Route for %s index %d to %3d,%3d queued", thing_model_name(thing),(int)thing->index,
+        (int)pos->x.stl.num, (int)pos->y.stl.num);
+    rreq->thing_idx = thing->index;
+    rreq->creation_turn = thing->creation_turn;
+    rreq->pos = *pos;
+    rreq->speed = speed;
+    rreq->flags = flags;
+    return true;
+}
+
+static int compare_route_requests_thing_idx(const void *ptr1, const void *ptr2)
+{
+    const struct RouteRequest* rreq1 = &route_requests[*(const long *)ptr1];
+    const struct RouteRequest* rreq2 = &route_requests[*(const long *)ptr2];
+    return (int)rreq1->thing_idx - (int)rreq2->thing_idx;
+}
+
+/**
+ * Checks if the request is still wanted, and finds the route triangles.
+ * Works the same way as ariadne_prepare_creature_route_to_target_f(), but leaves tracing for later.
+ */
+static void ariadne_prepare_route_request(struct RouteRequest *rreq)
+{
+    struct Thing* thing = thing_get(rreq->thing_idx);
+    rreq->valid = false;
+    rreq->needs_tracing = false;
+    if (!thing_is_creature(thing) || (thing->creation_turn != rreq->creation_turn))
+        return;
+    struct CreatureControl* cctrl = creature_control_get_from_thing(thing);
+    if ((cctrl->arid.endpos.x.val != rreq->pos.x.val) || (cctrl->arid.endpos.y.val != rreq->pos.y.val))
+        return;
+    rreq->valid = true;
+    if (ariadne_creature_reached_position(thing, &rreq->pos))
+        return;
+    struct Path* path = &rreq->path;
+    LbMemorySet(path, 0, sizeof(struct Path));
+    path->start.x = thing->mappos.x.val;
+    path->start.y = thing->mappos.y.val;
+    path->finish.x = rreq->pos.x.val;
+    path->finish.y = rreq->pos.y.val;
+    rreq->can_travel_over_lava = creature_can_travel_over_lava(thing);
+    if ((rreq->flags & AridRtF_NoOwner) != 0)
+        rreq->owner = -1;
+    else
+        rreq->owner = thing->owner;
+    long nav_sizexy = thing_nav_block_sizexy(thing);
+    if (nav_sizexy > 0) nav_sizexy--;
+    rreq->nav_size = nav_sizexy;
+    if (!path_prepare_route(path->start.x, path->start.y, path->finish.x, path->finish.y, rreq->nav_size,
+        &rreq->tri_src, &rreq->tri_dst, __func__))
+        return;
+    struct RouteCacheKey rckey;
+    struct AriadneWorkspace* ws = ariadne_main_workspace();
+    ws->owner = rreq->owner;
+    ws->can_travel_over_lava = rreq->can_travel_over_lava;
+    ws->edge_fit = RadiusEdgeFit[rreq->nav_size + 1];
+    path_fill_route_cache_key(&rckey, ws, rreq->tri_src, rreq->tri_dst, rreq->nav_size);
+    switch (route_cache_get(&rckey, path, rreq->route, &rreq->route_len))
+    {
+    case RCRes_Exact:
+        return;
+    case RCRes_Triangles:
+        // Making waypoints is cheap compared to tracing, and the cache has to be updated in order anyway
+        path_route_to_waypoints(ws, path, path->start.x, path->start.y, path->finish.x, path->finish.y,
+            rreq->route, rreq->route_len);
+        route_cache_put(&rckey, path, rreq->route, rreq->route_len);
+        return;
+    default:
+        break;
+    }
+    route_trace_list[route_trace_count] = rreq - route_requests;
+    route_trace_count++;
+    rreq->needs_tracing = true;
+}
+
+/**
+ * Traces routes of requests assigned to given range of workspaces.
+ * Every workspace traces every n-th request, where n is the amount of workspaces in use.
+ */
+static void ariadne_trace_route_requests_job(void *data, long first, long last)
+{
+    for (long ws_idx = first; ws_idx < last; ws_idx++)
+    {
+        struct AriadneWorkspace* ws = ariadne_workspace_get(ws_idx);
+        for (long i = ws_idx; i < route_trace_count; i += route_trace_slices)
+        {
+            struct RouteRequest* rreq = &route_requests[route_trace_list[i]];
+            struct Path* path = &rreq->path;
+            ws->owner = rreq->owner;
+            ws->can_travel_over_lava = rreq->can_travel_over_lava;
+            ws->edge_fit = RadiusEdgeFit[rreq->nav_size + 1];
+            rreq->route_len = path_trace_route(ws, path, path->start.x, path->start.y, path->finish.x, path->finish.y,
+                rreq->tri_src, rreq->tri_dst);
+            if ((rreq->route_len >= 0) && (rreq->route_len + 1 <= ROUTE_CACHE_TRIANGLES))
+                LbMemoryCopy(rreq->route, ws->tree_route, (rreq->route_len+1)*sizeof(long));
+        }
+    }
+}
+
+/**
+ * Traces all queued creature routes and gives them to the creatures.
+ * Routes are traced in parallel; everything which changes shared state - locating route
+ * triangles before tracing, storing routes in cache and filling creature routes after it -
+ * is done on the main thread in order of creature indices, so the result does not depend
+ * on amount of threads.
+ */
+void ariadne_process_queued_routes(void)
+{
+    if (route_requests_count <= 0)
+        return;
+    SYNCDBG(9,"Starting for %d routes",(int)route_requests_count);
+    triangulation_flush_queued();
+    for (long i = 0; i < route_requests_count; i++)
+    {
+        route_requests_order[i] = i;
+    }
+    qsort(route_requests_order, route_requests_count, sizeof(route_requests_order[0]), compare_route_requests_thing_idx);
+    route_trace_count = 0;
+    for (long i = 0; i < route_requests_count; i++)
+    {
+        ariadne_prepare_route_request(&route_requests[route_requests_order[i]]);
+    }
+    if (route_trace_count > 0)
+    {
+        route_trace_slices = ariadne_workspaces_reserve(min(LbJobsWorkersCount() + 1, route_trace_count));
+        LbJobsParallelFor(ariadne_trace_route_requests_job, NULL, route_trace_slices, 1);
+    }
+    for (long i = 0; i < route_requests_count; i++)
+    {
+        struct RouteRequest* rreq = &route_requests[route_requests_order[i]];
+        if (!rreq->valid)
+            continue;
+        struct Path* path = &rreq->path;
+        if (rreq->needs_tracing)
+        {
+            struct RouteCacheKey rckey;
+            struct AriadneWorkspace* ws = ariadne_main_workspace();
+            ws->owner = rreq->owner;
+            ws->can_travel_over_lava = rreq->can_travel_over_lava;
+            path_fill_route_cache_key(&rckey, ws, rreq->tri_src, rreq->tri_dst, rreq->nav_size);
+            route_cache_put(&rckey, path, rreq->route, rreq->route_len);
+        }
+        struct Thing* thing = thing_get(rreq->thing_idx);
+        ariadne_initialise_creature_route_with_path(thing, &rreq->pos, rreq->speed, rreq->flags, path, __func__);
+    }
+    route_requests_count = 0;
+}
+
+/**
+ * Re-routes a creature whose way got blocked after the navigation map has changed.
+ * The route is queued if possible, so that many creatures re-routing at once are traced
+ * in parallel; until then, the creature stays in place.
+ * @return Non-zero if the route could not be initialised.
+ */
+static AriadneReturn ariadne_reroute_creature(struct Thing *thing, struct Ariadne *arid)
+{
+    struct Coord3d pos;
+    pos.x.val = arid->endpos.x.val;
+    pos.y.val = arid->endpos.y.val;
+    pos.z.val = arid->endpos.z.val;
+    if (ariadne_queue_creature_route(thing, &pos, arid->move_speed, arid->route_flags))
+    {
+        arid->pos_12.x.val = thing->mappos.x.val;
+        arid->pos_12.y.val = thing->mappos.y.val;
+        arid->pos_12.z.val = thing->mappos.z.val;
+        return AridRet_OK;
+    }
+    return ariadne_initialise_creature_route(thing, &pos, arid->move_speed, arid->route_flags);
+}
+
 AriadneReturn ariadne_creature_get_next_waypoint(struct Thing *thing, struct Ariadne *arid)
 {
     struct Coord3d pos;
@@ -2937,11 +3508,7 @@ AriadneReturn ariadne_update_state_on_line(struct Thing *thing, struct Ariadne *
     {
         if ( arid->may_need_reroute )
         {
-            struct Coord3d pos;
-            pos.x.val = arid->endpos.x.val;
-            pos.y.val = arid->endpos.y.val;
-            pos.z.val = arid->endpos.z.val;
-            if (ariadne_initialise_creature_route(thing, &pos, arid->move_speed, arid->route_flags)) {
+            if (ariadne_reroute_creature(thing, arid)) {
                 return AridRet_PartOK;
             }
         }
@@ -3123,11 +3690,7 @@ AriadneReturn ariadne_update_state_wallhug(struct Thing *thing, struct Ariadne *
         {
             if ( arid->may_need_reroute )
             {
-                struct Coord3d pos;
-                pos.x.val = arid->endpos.x.val;
-                pos.y.val = arid->endpos.y.val;
-                pos.z.val = arid->endpos.z.val;
-                if (ariadne_initialise_creature_route(thing, &pos, arid->move_speed, arid->route_flags)) {
+                if (ariadne_reroute_creature(thing, arid)) {
                     return AridRet_PartOK;
                 }
             }
@@ -3219,11 +3782,7 @@ AriadneReturn ariadne_update_state_wallhug(struct Thing *thing, struct Ariadne *
                 arid->pos_12.z.val = pos.z.val;
                 return AridRet_OK;
             }
-            struct Coord3d pos;
-            pos.x.val = arid->endpos.x.val;
-            pos.y.val = arid->endpos.y.val;
-            pos.z.val = arid->endpos.z.val;
-            if (ariadne_initialise_creature_route(thing, &pos, arid->move_speed, arid->route_flags)) {
+            if (ariadne_reroute_creature(thing, arid)) {
                 return 3;
             }
             return AridRet_OK;
@@ -3337,6 +3896,80 @@ AriadneReturn creature_follow_route_to_using_gates(struct Thing *thing, struct C
     return ariadne_get_next_position_for_route(thing, finalpos, speed, nextpos, flags);
 }
 
+/**
+ * Finds boundary triangles of a route and checks whether the route can be traced.
+ * May update the point location cache and regions, so it is only called on the main thread.
+ * @return True if the route should be traced.
+ */
+static TbBool path_prepare_route(long start_x, long start_y, long end_x, long end_y, unsigned char nav_size,
+    long *tri_src, long *tri_dst, const char *func_name)
+{
+    *tri_src = triangle_findSE8(start_x, start_y);
+    *tri_dst = triangle_findSE8(end_x, end_y);
+    if ((*tri_src == -1) || (*tri_dst == -1))
+    {
+        ERRORLOG("%s: Boundary triangle not found: %ld -> %ld.", func_name,*tri_src,*tri_dst);
+        return false;
+    }
+    NAVIDBG(19,"%s: prepared triangles %ld -> %ld", func_name,*tri_src,*tri_dst);
+    if (!regions_connected(*tri_src, *tri_dst))
+    {
+        NAVIDBG(9,"%s: Regions not connected, cannot trace a path.", func_name);
+        return false;
+    }
+    NAVIDBG(19,"%s: regions connected", func_name);
+    edgelen_init();
+    int creature_radius = nav_size + 1;
+    if ((creature_radius < 1) || (creature_radius > 3))
+    {
+        ERRORLOG("%s: only radius 1..3 allowed, got %d", func_name,creature_radius);
+        return false;
+    }
+    return true;
+}
+
+static void path_fill_route_cache_key(struct RouteCacheKey *rckey, const struct AriadneWorkspace *ws,
+    long tri_src, long tri_dst, unsigned char nav_size)
+{
+    rckey->tri_src = tri_src;
+    rckey->tri_dst = tri_dst;
+    rckey->owner = ws->owner;
+    rckey->nav_size = nav_size;
+    rckey->can_travel_over_lava = (ws->can_travel_over_lava != 0);
+}
+
+/**
+ * Fills path waypoints with a route going through given triangles.
+ * Waypoints are left untouched if there is no route.
+ */
+static void path_route_to_waypoints(struct AriadneWorkspace *ws, struct Path *path,
+    long start_x, long start_y, long end_x, long end_y, const long *route, long route_len)
+{
+    long route_dist;
+    if (route_len == -1)
+        return;
+    path->waypoints_num = route_to_path(ws, start_x, start_y, end_x, end_y, route, route_len, path, &route_dist);
+    path_out_a_bit(ws, path, route);
+}
+
+/**
+ * Traces route between given triangles and fills path waypoints with it.
+ * Only reads the triangulation, so routes may be traced in several workspaces at once.
+ * @return Length of the triangles route, or -1 if there is no route.
+ */
+static long path_trace_route(struct AriadneWorkspace *ws, struct Path *path,
+    long start_x, long start_y, long end_x, long end_y, long tri_src, long tri_dst)
+{
+    long route_cost;
+    ws->tree_Ax8 = start_x;
+    ws->tree_Ay8 = start_y;
+    ws->tree_Bx8 = end_x;
+    ws->tree_By8 = end_y;
+    long route_len = ma_triangle_route(ws, tri_src, tri_dst, &route_cost);
+    path_route_to_waypoints(ws, path, start_x, start_y, end_x, end_y, ws->tree_route, route_len);
+    return route_len;
+}
+
 /**
  * Initializes Path structure with path data to travel between given coordinates.
  * Note that it works a bit different than in original DK - makes more error checks.
@@ -3352,55 +3985,43 @@ AriadneReturn creature_follow_route_to_using_gates(struct Thing *thing, struct C
 void path_init8_wide_f(struct Path *path, long start_x, long start_y, long end_x, long end_y,
     long subroute, unsigned char nav_size, const char *func_name)
 {
-    long route_dist;
     NAVIDBG(9,"%s: Path from %5ld,%5ld to %5ld,%5ld on turn %lu", func_name, start_x, start_y, end_x, end_y, game.play_gameturn);
     if (subroute == -1)
       WARNLOG("%s: implement random externally", func_name);
+    triangulation_flush_queued();
     path->start.x = start_x;
     path->start.y = start_y;
     path->finish.x = end_x;
     path->finish.y = end_y;
     path->waypoints_num = 0;
-    tree_Ax8 = start_x;
-    tree_Ay8 = start_y;
-    tree_Bx8 = end_x;
-    tree_By8 = end_y;
+    struct AriadneWorkspace* ws = ariadne_main_workspace();
+    ws->owner = owner_player_navigating;
+    ws->can_travel_over_lava = nav_thing_can_travel_over_lava;
     tree_routelen = -1;
-    tree_triA = triangle_findSE8(start_x, start_y);
-    tree_triB = triangle_findSE8(end_x, end_y);
-    if ((tree_triA == -1) || (tree_triB == -1))
-    {
-        ERRORLOG("%s: Boundary triangle not found: %ld -> %ld.", func_name,tree_triA,tree_triB);
-        return;
-    }
-    NAVIDBG(19,"%s: prepared triangles %ld -> %ld", func_name,tree_triA,tree_triB);
-    if (!regions_connected(tree_triA, tree_triB))
-    {
-        NAVIDBG(9,"%s: Regions not connected, cannot trace a path.", func_name);
+    if (!path_prepare_route(start_x, start_y, end_x, end_y, nav_size, &tree_triA, &tree_triB, func_name))
         return;
-    }
-    NAVIDBG(19,"%s: regions connected", func_name);
-    edgelen_init();
-    {
-        int creature_radius;
-        creature_radius = nav_size + 1;
-        if ((creature_radius < 1) || (creature_radius > 3))
-        {
-            ERRORLOG("%s: only radius 1..3 allowed, got %d", func_name,creature_radius);
-            return;
-        }
-        EdgeFit = RadiusEdgeFit[creature_radius];
-    }
+    ws->edge_fit = RadiusEdgeFit[nav_size + 1];
     tree_altA = get_triangle_tree_alt(tree_triA);
     tree_altB = get_triangle_tree_alt(tree_triB);
     if (subroute == -2)
     {
-        tree_routelen = ma_triangle_route(tree_triA, tree_triB, &tree_routecost);
-        NAVIDBG(19,"%s: route=%d", func_name, tree_routelen);
-        if (tree_routelen != -1)
+        struct RouteCacheKey rckey;
+        path_fill_route_cache_key(&rckey, ws, tree_triA, tree_triB, nav_size);
+        switch (route_cache_get(&rckey, path, ws->tree_route, &tree_routelen))
         {
-            path->waypoints_num = route_to_path(start_x, start_y, end_x, end_y, tree_route, tree_routelen, path, &route_dist);
-            path_out_a_bit(path, tree_route);
+        case RCRes_Exact:
+            NAVIDBG(19,"%s: route taken from cache", func_name);
+            break;
+        case RCRes_Triangles:
+            path_route_to_waypoints(ws, path, start_x, start_y, end_x, end_y, ws->tree_route, tree_routelen);
+            NAVIDBG(19,"%s: triangle route taken from cache, route=%d", func_name, tree_routelen);
+            route_cache_put(&rckey, path, ws->tree_route, tree_routelen);
+            break;
+        default:
+            tree_routelen = path_trace_route(ws, path, start_x, start_y, end_x, end_y, tree_triA, tree_triB);
+            NAVIDBG(19,"%s: route=%d", func_name, tree_routelen);
+            route_cache_put(&rckey, path, ws->tree_route, tree_routelen);
+            break;
         }
     } else
     {
@@ -4901,6 +5522,8 @@ void triangulation_initxy(long startx, long starty, long endx, long endy)
         tri->tree_alt = NAV_COL_UNSET;
     }
     tri_initialised = 1;
+    route_cache_triangulation_changed();
+    nav_reach_triangulation_changed();
     triangulation_initxy_points(startx, starty, endx, endy);
     triangulation_init_triangles(0, 1, 2, 3);
     edgelen_set(0);
@@ -4951,6 +5574,9 @@ TbBool triangulate_area(NavColour *imap, long start_x, long start_y, long end_x,
         NAVIDBG(9,"Invalid area bounds");
         return false;
     }
+    // Any change in triangles may change the routes
+    route_cache_triangulation_changed();
+    nav_reach_triangulation_changed();
     // Prepare some basic logic information
     one_tile = (((end_x - start_x) == 1) && ((end_y - start_y) == 1));
     not_whole_map = (start_x != 0) || (start_y != 0) || (end_x != gameadd.map_subtiles_x + 1) || (end_y != gameadd.map_subtiles_y + 1);
@@ -41,6 +41,7 @@ struct Thing;
 
 typedef unsigned char AriadneReturn;
 typedef unsigned char AriadneRouteFlags;
+typedef unsigned char AriadneReachability;
 
 enum AriadneReturnValues {
     AridRet_OK    = 0,
@@ -49,6 +50,12 @@ enum AriadneReturnValues {
     AridRet_PartOK,
 };
 
+enum AriadneReachabilityValues {
+    AridRch_Unknown    = 0,
+    AridRch_Unreachable,
+    AridRch_Reachable,
+};
+
 enum AriadneRouteFlagValues {
     AridRtF_Default   = 0x00,
     AridRtF_NoOwner   = 0x01,
@@ -196,9 +203,27 @@ extern const struct HugStart blocked_xy_hug_start[][2][2];
 
 #pragma pack()
 /******************************************************************************/
+struct NavUpdateStats {
+    /** Amount of areas changed by map updates. */
+    unsigned long queued;
+    /** Amount of areas triangulated. */
+    unsigned long triangulated;
+    /** Amount of times queued areas were triangulated early, because a change touched them while not merging. */
+    unsigned long early_flushes;
+    /** Time spent triangulating the areas, in microseconds. */
+    long long time_total;
+};
+/******************************************************************************/
 long init_navigation(void);
+void triangulate_map(NavColour *imap);
 long update_navigation_triangulation(long start_x, long start_y, long end_x, long end_y);
 TbBool triangulate_area(NavColour *imap, long sx, long sy, long ex, long ey);
+TbBool triangulation_set_merging(TbBool merge);
+void triangulation_prepare_area(long start_x, long start_y, long end_x, long end_y);
+void triangulation_queue_area(long start_x, long start_y, long end_x, long end_y);
+void triangulation_flush_queued(void);
+void triangulation_get_update_stats(struct NavUpdateStats *stats);
+void triangulation_reset_update_stats(void);
 
 AriadneReturn ariadne_initialise_creature_route_f(struct Thing *thing, const struct Coord3d *pos, long speed, AriadneRouteFlags flags, const char *func_name);
 #define ariadne_initialise_creature_route(thing, pos, speed, flags) ariadne_initialise_creature_route_f(thing, pos, speed, flags, __func__)
@@ -208,7 +233,12 @@ AriadneReturn ariadne_prepare_creature_route_to_target_f(const struct Thing *thi
     const struct Coord3d *srcpos, const struct Coord3d *dstpos, long speed, AriadneRouteFlags flags, const char *func_name);
 long ariadne_count_waypoints_on_creature_route_to_target_f(const struct Thing *thing,
     const struct Coord3d *srcpos, const struct Coord3d *dstpos, AriadneRouteFlags flags, const char *func_name);
+AriadneReachability ariadne_creature_reachability_f(const struct Thing *thing,
+    const struct Coord3d *srcpos, const struct Coord3d *dstpos, AriadneRouteFlags flags, const char *func_name);
 AriadneReturn ariadne_invalidate_creature_route(struct Thing *thing);
+TbBool ariadne_set_route_queueing(TbBool queue);
+TbBool ariadne_queue_creature_route(struct Thing *thing, const struct Coord3d *pos, long speed, AriadneRouteFlags flags);
+void ariadne_process_queued_routes(void);
 
 TbBool navigation_points_connected(struct Coord3d *pt1, struct Coord3d *pt2);
 void path_init8_wide_f(struct Path *path, long start_x, long start_y, long end_x, long end_y, long subroute, unsigned char nav_size, const char *func_name);
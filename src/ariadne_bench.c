@@ -0,0 +1,236 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file ariadne_bench.c
+ *     Benchmark of navigation triangulation updates.
+ * @par Purpose:
+ *     Records every navigation map change made while running a benchmark,
+ *     then replays them on the initial map to measure retriangulation cost.
+ * @par Comment:
+ *     The changes are replayed twice - one by one, as every map update
+ *     used to be triangulated, and batched per game turn. The triangulation
+ *     is rebuilt from the final map after the replay.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "pre_inc.h"
+#include "ariadne_bench.h"
+
+#include "globals.h"
+#include "bflib_basics.h"
+#include "bflib_memory.h"
+#include "bflib_datetm.h"
+
+#include "ariadne.h"
+#include "ariadne_tringls.h"
+#include "map_data.h"
+#include "game_legacy.h"
+#include "game_merge.h"
+#include "post_inc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+struct NavBenchUpdate {
+    GameTurn turn;
+    long start_x;
+    long start_y;
+    long end_x;
+    long end_y;
+    /** Position of colours of the updated area in colours buffer. */
+    unsigned long colours_pos;
+};
+
+struct NavBench {
+    TbBool active;
+    /** Navigation map at the moment the benchmark was started. */
+    NavColour *initial_map;
+    struct NavBenchUpdate *updates;
+    unsigned long updates_count;
+    unsigned long updates_alloc;
+    NavColour *colours;
+    unsigned long colours_count;
+    unsigned long colours_alloc;
+};
+
+static struct NavBench nav_bench;
+/******************************************************************************/
+static unsigned long nav_bench_map_size(void)
+{
+    return gameadd.navigation_map_size_x * gameadd.navigation_map_size_y * sizeof(NavColour);
+}
+
+static void nav_bench_free(void)
+{
+    LbMemoryFree(nav_bench.initial_map);
+    LbMemoryFree(nav_bench.updates);
+    LbMemoryFree(nav_bench.colours);
+    LbMemorySet(&nav_bench, 0, sizeof(nav_bench));
+}
+
+/**
+ * Starts recording navigation map changes.
+ */
+void nav_bench_start(void)
+{
+    nav_bench_free();
+    nav_bench.initial_map = (NavColour *)LbMemoryAlloc(nav_bench_map_size());
+    if (nav_bench.initial_map == NULL)
+    {
+        WARNLOG("Cannot allocate navigation benchmark buffer");
+        return;
+    }
+    LbMemoryCopy(nav_bench.initial_map, game.navigation_map, nav_bench_map_size());
+    nav_bench.active = true;
+}
+
+/**
+ * Stores navigation colours of an updated area. Should be called after the colours are set.
+ */
+void nav_bench_record_update(long start_x, long start_y, long end_x, long end_y)
+{
+    if (!nav_bench.active)
+        return;
+    unsigned long area = (end_x - start_x + 1) * (end_y - start_y + 1);
+    if (nav_bench.updates_count >= nav_bench.updates_alloc)
+    {
+        unsigned long alloc = nav_bench.updates_alloc * 2 + 256;
+        void* mem = LbMemoryGrow(nav_bench.updates, alloc * sizeof(struct NavBenchUpdate));
+        if (mem == NULL) {
+            WARNLOG("Cannot grow navigation benchmark buffer, recording stopped");
+            nav_bench.active = false;
+            return;
+        }
+        nav_bench.updates = (struct NavBenchUpdate *)mem;
+        nav_bench.updates_alloc = alloc;
+    }
+    if (nav_bench.colours_count + area > nav_bench.colours_alloc)
+    {
+        unsigned long alloc = nav_bench.colours_alloc * 2 + area + 4096;
+        void* mem = LbMemoryGrow(nav_bench.colours, alloc * sizeof(NavColour));
+        if (mem == NULL) {
+            WARNLOG("Cannot grow navigation benchmark buffer, recording stopped");
+            nav_bench.active = false;
+            return;
+        }
+        nav_bench.colours = (NavColour *)mem;
+        nav_bench.colours_alloc = alloc;
+    }
+    struct NavBenchUpdate* upd = &nav_bench.updates[nav_bench.updates_count];
+    upd->turn = game.play_gameturn;
+    upd->start_x = start_x;
+    upd->start_y = start_y;
+    upd->end_x = end_x;
+    upd->end_y = end_y;
+    upd->colours_pos = nav_bench.colours_count;
+    NavColour* colour = &nav_bench.colours[upd->colours_pos];
+    for (long y = start_y; y <= end_y; y++)
+    {
+        for (long x = start_x; x <= end_x; x++)
+        {
+            *colour = get_navigation_map(x, y);
+            colour++;
+        }
+    }
+    nav_bench.colours_count += area;
+    nav_bench.updates_count++;
+}
+
+static void nav_bench_apply_update(const struct NavBenchUpdate *upd)
+{
+    const NavColour* colour = &nav_bench.colours[upd->colours_pos];
+    for (long y = upd->start_y; y <= upd->end_y; y++)
+    {
+        for (long x = upd->start_x; x <= upd->end_x; x++)
+        {
+            set_navigation_map(x, y, *colour);
+            colour++;
+        }
+    }
+}
+
+/**
+ * Replays recorded updates on the initial map.
+ * @param batched If true, all updates from one game turn are queued, merged and triangulated at once.
+ * @return Time spent on triangulation.
+ */
+static TbClockMicroSec nav_bench_replay(TbBool batched)
+{
+    LbMemoryCopy(game.navigation_map, nav_bench.initial_map, nav_bench_map_size());
+    triangulate_map(IanMap);
+    TbBool prev_merging = triangulation_set_merging(true);
+    TbClockMicroSec total = 0;
+    for (unsigned long i = 0; i < nav_bench.updates_count; i++)
+    {
+        const struct NavBenchUpdate* upd = &nav_bench.updates[i];
+        if (batched)
+        {
+            TbClockMicroSec started = LbTimerClockMicro();
+            triangulation_prepare_area(upd->start_x, upd->start_y, upd->end_x, upd->end_y);
+            total += LbTimerClockMicro() - started;
+        }
+        nav_bench_apply_update(upd);
+        TbClockMicroSec started = LbTimerClockMicro();
+        if (batched)
+        {
+            triangulation_queue_area(upd->start_x, upd->start_y, upd->end_x, upd->end_y);
+            if ((i+1 >= nav_bench.updates_count) || (nav_bench.updates[i+1].turn != upd->turn))
+                triangulation_flush_queued();
+        } else
+        {
+            triangulate_area(IanMap, upd->start_x, upd->start_y, upd->end_x, upd->end_y);
+        }
+        total += LbTimerClockMicro() - started;
+    }
+    triangulation_set_merging(prev_merging);
+    return total;
+}
+
+/**
+ * Writes the in-game triangulation statistics, then replays the recorded updates
+ * and writes how long they take when triangulated one by one and in batches.
+ */
+void nav_bench_report(void)
+{
+    struct NavUpdateStats nustats;
+    triangulation_get_update_stats(&nustats);
+    JUSTMSG("Benchmark: navigation %lu area updates, %lu triangulated, %lu early flushes, %.3f ms total",
+        nustats.queued,nustats.triangulated,nustats.early_flushes,(double)nustats.time_total/1000.0);
+    if (!nav_bench.active)
+        return;
+    nav_bench.active = false;
+    if (nav_bench.updates_count > 0)
+    {
+        NavColour* final_map = (NavColour *)LbMemoryAlloc(nav_bench_map_size());
+        if (final_map != NULL)
+        {
+            LbMemoryCopy(final_map, game.navigation_map, nav_bench_map_size());
+            TbClockMicroSec single_time = nav_bench_replay(false);
+            long single_tris = count_Triangles;
+            TbClockMicroSec batch_time = nav_bench_replay(true);
+            long batch_tris = count_Triangles;
+            JUSTMSG("Benchmark: navigation replay of %lu updates from turns %lu-%lu",nav_bench.updates_count,
+                (unsigned long)nav_bench.updates[0].turn,(unsigned long)nav_bench.updates[nav_bench.updates_count-1].turn);
+            JUSTMSG("Benchmark:   one by one %10.3f ms, avg %.3f ms per update, %ld triangles at end",
+                (double)single_time/1000.0,(double)single_time/nav_bench.updates_count/1000.0,single_tris);
+            JUSTMSG("Benchmark:   per turn   %10.3f ms, avg %.3f ms per update, %ld triangles at end",
+                (double)batch_time/1000.0,(double)batch_time/nav_bench.updates_count/1000.0,batch_tris);
+            // Bring back triangulation of the current map
+            LbMemoryCopy(game.navigation_map, final_map, nav_bench_map_size());
+            triangulate_map(IanMap);
+            LbMemoryFree(final_map);
+        }
+    }
+    nav_bench_free();
+}
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
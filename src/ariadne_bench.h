@@ -0,0 +1,36 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file ariadne_bench.h
+ *     Header file for ariadne_bench.c.
+ * @par Purpose:
+ *     Benchmark of navigation triangulation updates.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef DK_ARIADNE_BENCH_H
+#define DK_ARIADNE_BENCH_H
+
+#include "globals.h"
+#include "bflib_basics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+void nav_bench_start(void);
+void nav_bench_record_update(long start_x, long start_y, long end_x, long end_y);
+void nav_bench_report(void);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
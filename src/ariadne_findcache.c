@@ -31,114 +31,157 @@
 extern "C" {
 #endif
 /******************************************************************************/
-static long find_cache[4][4];
+/** Size of find cache grid cell, as shift of coordinates with 8 fractional bits; cells are 4x4 subtiles. */
+#define FIND_CACHE_CELL_SHIFT 10
+#define FIND_CACHE_CELLS_X ((MAX_SUBTILES_X >> 2) + 1)
+#define FIND_CACHE_CELLS_Y ((MAX_SUBTILES_Y >> 2) + 1)
+/** Max distance, in cells, to look for a seed triangle when the cell at searched point has none. */
+#define FIND_CACHE_SEARCH_RADIUS 4
+
+/** Seed triangle for every grid cell, or -1 if the cell has none. */
+static long find_cache[FIND_CACHE_CELLS_Y][FIND_CACHE_CELLS_X];
+/** Grid cell in which every triangle is a seed, or -1; every triangle is a seed of at most one cell. */
+static long find_cache_tri_cell[TRIANLGLES_COUNT];
 
 /******************************************************************************/
-long triangle_brute_find8_near(long pos_x, long pos_y)
+static long find_cache_cell_x(long pos_x)
 {
-    long cx = pos_x >> 14;
+    long cx = (pos_x >> FIND_CACHE_CELL_SHIFT);
     if (cx < 0)
         cx = 0;
-    if (cx > 3)
-        cx = 3;
-    long cy = pos_y >> 14;
+    if (cx >= FIND_CACHE_CELLS_X)
+        cx = FIND_CACHE_CELLS_X-1;
+    return cx;
+}
+
+static long find_cache_cell_y(long pos_y)
+{
+    long cy = (pos_y >> FIND_CACHE_CELL_SHIFT);
     if (cy < 0)
         cy = 0;
-    if (cy > 3)
-        cy = 3;
-   // Try sibling
-    long tri_id;
-    if (cx-1 >= 0)
-    {
-        tri_id = find_cache[cy][cx-1];
-        if (get_triangle_tree_alt(tri_id) != NAV_COL_UNSET)
-            return tri_id;
-    }
-    if (cx+1 < 4)
-    {
-        tri_id = find_cache[cy][cx+1];
-        if (get_triangle_tree_alt(tri_id) != NAV_COL_UNSET)
-            return tri_id;
-    }
-    if (cy-1 >= 0)
-    {
-        tri_id = find_cache[cy-1][cx];
-        if (get_triangle_tree_alt(tri_id) != NAV_COL_UNSET)
-            return tri_id;
-    }
-    if (cy+1 < 4)
-    {
-        tri_id = find_cache[cy+1][cx];
-        if (get_triangle_tree_alt(tri_id) != NAV_COL_UNSET)
-            return tri_id;
-    }
-    // Try any in cache
-    for (cy=0; cy < 4; cy++)
+    if (cy >= FIND_CACHE_CELLS_Y)
+        cy = FIND_CACHE_CELLS_Y-1;
+    return cy;
+}
+
+static void find_cache_unregister(long tri_idx)
+{
+    long cell = find_cache_tri_cell[tri_idx];
+    if (cell < 0)
+        return;
+    long *seed = &find_cache[cell / FIND_CACHE_CELLS_X][cell % FIND_CACHE_CELLS_X];
+    if (*seed == tri_idx)
+        *seed = -1;
+    find_cache_tri_cell[tri_idx] = -1;
+}
+
+static void find_cache_register(long cx, long cy, long tri_idx)
+{
+    long *seed = &find_cache[cy][cx];
+    if (*seed == tri_idx)
+        return;
+    if (*seed >= 0)
+        find_cache_tri_cell[*seed] = -1;
+    find_cache_unregister(tri_idx);
+    *seed = tri_idx;
+    find_cache_tri_cell[tri_idx] = cy * FIND_CACHE_CELLS_X + cx;
+}
+
+/**
+ * Finds seed triangle in cells around given one, searching in growing rings.
+ */
+static long triangle_find_cache_near(long cx, long cy)
+{
+    for (long radius = 1; radius <= FIND_CACHE_SEARCH_RADIUS; radius++)
     {
-        for (cx=0; cx < 4; cx++)
+        for (long dy = -radius; dy <= radius; dy++)
         {
-            tri_id = find_cache[cy][cx];
-            if (get_triangle_tree_alt(tri_id) != NAV_COL_UNSET)
-                return tri_id;
+            long ny = cy + dy;
+            if ((ny < 0) || (ny >= FIND_CACHE_CELLS_Y))
+                continue;
+            // Inside rows of the ring only have two cells
+            long step = ((dy == -radius) || (dy == radius)) ? 1 : 2*radius;
+            for (long dx = -radius; dx <= radius; dx += step)
+            {
+                long nx = cx + dx;
+                if ((nx < 0) || (nx >= FIND_CACHE_CELLS_X))
+                    continue;
+                long tri_id = find_cache[ny][nx];
+                if ((tri_id >= 0) && (get_triangle_tree_alt(tri_id) != NAV_COL_UNSET))
+                    return tri_id;
+            }
         }
     }
-    // Try any
-    tri_id = triangle_find_first_used();
-    return tri_id;
+    return triangle_find_first_used();
 }
 
 long triangle_find_cache_get(long pos_x, long pos_y)
 {
-    long cache_x = (pos_x >> 14);
-    if (cache_x > 3)
-        cache_x = 3;
-    if (cache_x < 0)
-        cache_x = 0;
-    long cache_y = (pos_y >> 14);
-    if (cache_y > 3)
-        cache_y = 3;
-    if (cache_y < 0)
-        cache_y = 0;
-
-    long ntri = find_cache[cache_y][cache_x];
-    if (get_triangle_tree_alt(ntri) == NAV_COL_UNSET)
+    long cx = find_cache_cell_x(pos_x);
+    long cy = find_cache_cell_y(pos_y);
+    long ntri = find_cache[cy][cx];
+    if ((ntri < 0) || (get_triangle_tree_alt(ntri) == NAV_COL_UNSET))
     {
-        ntri = triangle_brute_find8_near(pos_x, pos_y);
+        ntri = triangle_find_cache_near(cx, cy);
         if ((ntri < 0) || (ntri > ix_Triangles))
         {
             ERRORLOG("triangles count overflow");
             ntri = -1;
         }
-        find_cache[cache_y][cache_x] = ntri;
-  }
-  return ntri;
-
+    }
+    return ntri;
 }
 
 void triangle_find_cache_put(long pos_x, long pos_y, long ntri)
 {
-    long cache_x = (pos_x >> 14);
-    if (cache_x > 3)
-        cache_x = 3;
-    if (cache_x < 0)
-        cache_x = 0;
-    long cache_y = (pos_y >> 14);
-    if (cache_y > 3)
-        cache_y = 3;
-    if (cache_y < 0)
-        cache_y = 0;
-    find_cache[cache_y][cache_x] = ntri;
+    if ((ntri < 0) || (ntri >= TRIANLGLES_COUNT))
+        return;
+    find_cache_register(find_cache_cell_x(pos_x), find_cache_cell_y(pos_y), ntri);
+}
+
+/**
+ * Removes a triangle which is being disposed from the find cache.
+ */
+void triangle_find_cache_tri_disposed(long tri_idx)
+{
+    if ((tri_idx < 0) || (tri_idx >= TRIANLGLES_COUNT))
+        return;
+    find_cache_unregister(tri_idx);
+}
+
+/**
+ * Moves a triangle whose points were changed into the cell where its center now is.
+ */
+void triangle_find_cache_tri_changed(long tri_idx)
+{
+    if ((tri_idx < 0) || (tri_idx >= TRIANLGLES_COUNT))
+        return;
+    const struct Triangle* tri = &Triangles[tri_idx];
+    long cntr_x = 0;
+    long cntr_y = 0;
+    for (long i = 0; i < 3; i++)
+    {
+        cntr_x += ari_Points[tri->points[i]].x;
+        cntr_y += ari_Points[tri->points[i]].y;
+    }
+    find_cache_register(find_cache_cell_x((cntr_x << 8) / 3), find_cache_cell_y((cntr_y << 8) / 3), tri_idx);
 }
 
 void triangulation_init_cache(long tri_idx)
 {
-    for (long i = 0; i < 4; i++)
+    for (long cy = 0; cy < FIND_CACHE_CELLS_Y; cy++)
+    {
+        for (long cx = 0; cx < FIND_CACHE_CELLS_X; cx++)
+        {
+            find_cache[cy][cx] = -1;
+        }
+    }
+    for (long i = 0; i < TRIANLGLES_COUNT; i++)
     {
-        find_cache[i][0] = tri_idx;
-        find_cache[i][1] = tri_idx;
-        find_cache[i][2] = tri_idx;
-        find_cache[i][3] = tri_idx;
+        find_cache_tri_cell[i] = -1;
     }
+    if ((tri_idx >= 0) && (tri_idx < TRIANLGLES_COUNT))
+        find_cache_register(0, 0, tri_idx);
 }
 
 long triangle_find8(long pt_x, long pt_y)
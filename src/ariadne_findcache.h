@@ -34,6 +34,8 @@ extern "C" {
 /******************************************************************************/
 long triangle_find_cache_get(long pos_x, long pos_y);
 void triangle_find_cache_put(long pos_x, long pos_y, long ntri);
+void triangle_find_cache_tri_disposed(long tri_idx);
+void triangle_find_cache_tri_changed(long tri_idx);
 
 void triangulation_init_cache(long tri_idx);
 
@@ -23,6 +23,7 @@
 #include "bflib_basics.h"
 #include "ariadne_tringls.h"
 #include "ariadne_navitree.h"
+#include "ariadne_workspace.h"
 #include "gui_topmsg.h"
 #include "post_inc.h"
 
@@ -30,34 +31,31 @@
 extern "C" {
 #endif
 /******************************************************************************/
-static long heap_end;
-static long Heap[PATH_HEAP_LEN];
-/******************************************************************************/
 /** Initializes navigation heap for new use.
  */
-void naviheap_init(void)
+void naviheap_init(struct AriadneWorkspace *ws)
 {
-    heap_end = 0;
+    ws->heap_end = 0;
 }
 
 /** Checks if the navigation heap is empty.
  *
  * @return
  */
-TbBool naviheap_empty(void)
+TbBool naviheap_empty(const struct AriadneWorkspace *ws)
 {
-    return (heap_end == 0);
+    return (ws->heap_end == 0);
 }
 
 /** Retrieves top element of the navigation heap.
  *
  * @return
  */
-long naviheap_top(void)
+long naviheap_top(const struct AriadneWorkspace *ws)
 {
-    if (heap_end < 1)
+    if (ws->heap_end < 1)
         return -1;
-    return Heap[1];
+    return ws->heap[1];
 }
 
 /** Retrieves given element of the navigation heap.
@@ -65,72 +63,72 @@ long naviheap_top(void)
  * @param heapid
  * @return
  */
-long naviheap_get(long heapid)
+long naviheap_get(const struct AriadneWorkspace *ws, long heapid)
 {
-    if ((heapid < 0) || (heapid > heap_end+1))
+    if ((heapid < 0) || (heapid > ws->heap_end+1))
         return -1;
-    return Heap[heapid];
+    return ws->heap[heapid];
 }
 
 /** Moves heap elements down, removing element of given index.
  *
  * @param heapid
  */
-void heap_down(long heapid)
+void heap_down(struct AriadneWorkspace *ws, long heapid)
 {
     // Insert dummy value (there is no associated triangle for it)
-    Heap[heap_end+1] = TREEVALS_COUNT-1;
-    tree_val[TREEVALS_COUNT-1] = LONG_MAX;
-    unsigned long hend = (heap_end >> 1);
-    long tree_idb = Heap[heapid];
-    long tval_idb = tree_val[tree_idb];
+    ws->heap[ws->heap_end+1] = TREEVALS_COUNT-1;
+    ws->tree_val[TREEVALS_COUNT-1] = LONG_MAX;
+    unsigned long hend = (ws->heap_end >> 1);
+    long tree_idb = ws->heap[heapid];
+    long tval_idb = ws->tree_val[tree_idb];
     unsigned long hpos = heapid;
     while (hpos <= hend)
     {
         unsigned long hnew = (hpos << 1);
         /* Select the cone with smaller tree value */
-        if (naviheap_item_tree_val(hnew+1) < naviheap_item_tree_val(hnew))
+        if (naviheap_item_tree_val(ws, hnew+1) < naviheap_item_tree_val(ws, hnew))
             hnew++;
-        long tree_ids = Heap[hnew];
-        if (tree_val[tree_ids] > tval_idb)
+        long tree_ids = ws->heap[hnew];
+        if (ws->tree_val[tree_ids] > tval_idb)
             break;
-        Heap[hpos] = tree_ids;
+        ws->heap[hpos] = tree_ids;
         hpos = hnew;
     }
-    Heap[hpos] = tree_idb;
+    ws->heap[hpos] = tree_idb;
 }
 
 /** Removes one element from the heap and returns it.
  *
  * @return The removed element value.
  */
-long naviheap_remove(void)
+long naviheap_remove(struct AriadneWorkspace *ws)
 {
-  if (heap_end < 1)
+  if (ws->heap_end < 1)
   {
       erstat_inc(ESE_BadPathHeap);
       return -1;
   }
-  long popval = Heap[1];
-  Heap[1] = Heap[heap_end];
-  heap_end--;
-  heap_down(1);
+  long popval = ws->heap[1];
+  ws->heap[1] = ws->heap[ws->heap_end];
+  ws->heap_end--;
+  heap_down(ws, 1);
   return popval;
 }
 
-#define heap_up(heapid) heap_up_f(heapid, __func__)
-void heap_up_f(long heapid, const char *func_name)
+#define heap_up(ws, heapid) heap_up_f(ws, heapid, __func__)
+void heap_up_f(struct AriadneWorkspace *ws, long heapid, const char *func_name)
 {
     unsigned long pmask = heapid;
-    Heap[0] = TREEVALS_COUNT-1;
-    tree_val[TREEVALS_COUNT-1] = -1;
+    ws->heap[0] = TREEVALS_COUNT-1;
+    ws->tree_val[TREEVALS_COUNT-1] = -1;
     unsigned long nmask = pmask;
-    long k = Heap[pmask];
+    long k = ws->heap[pmask];
     while ( 1 )
     {
         nmask >>= 1;
-        long i = Heap[nmask];
-        if (tree_val[k] > tree_val[i])
+        long i = ws->heap[nmask];
+        if (ws->tree_val[k] > ws->tree_val[i])
           break;
         if (pmask == 0)
         {
@@ -138,23 +136,23 @@ void heap_up_f(long heapid, const char *func_name)
             ERRORDBG(8,"%s: sabotaged navigate heap, heapid=%d",func_name,(int)heapid);
             break;
         }
-        Heap[pmask] = i;
+        ws->heap[pmask] = i;
         pmask = nmask;
     }
-    Heap[pmask] = k;
+    ws->heap[pmask] = k;
 }
 
-TbBool naviheap_add(long heapid)
+TbBool naviheap_add(struct AriadneWorkspace *ws, long heapid)
 {
     // Always leave one unused element (not sure why, but originally 2 were left)
-    // The element is needed because we sometimes fill Heap[heap_end+1] and this must work
-    if (heap_end >= PATH_HEAP_LEN-1)
+    // The element is needed because we sometimes fill heap[heap_end+1] and this must work
+    if (ws->heap_end >= PATH_HEAP_LEN-1)
     {
         return false;
     }
-    heap_end++;
-    Heap[heap_end] = heapid;
-    heap_up(heap_end);
+    ws->heap_end++;
+    ws->heap[ws->heap_end] = heapid;
+    heap_up(ws, ws->heap_end);
     return true;
 }
 
@@ -163,15 +161,15 @@ TbBool naviheap_add(long heapid)
  * @param heapid
  * @return
  */
-long naviheap_item_tree_val(long heapid)
+long naviheap_item_tree_val(const struct AriadneWorkspace *ws, long heapid)
 {
-    long tree_id = naviheap_get(heapid);
+    long tree_id = naviheap_get(ws, heapid);
     if ((tree_id < 0) || (tree_id >= TREEVALS_COUNT))
     {
         erstat_inc(ESE_BadPathHeap);
         return -1;
     }
-    return tree_val[tree_id];
+    return ws->tree_val[tree_id];
 }
 /******************************************************************************/
 #ifdef __cplusplus
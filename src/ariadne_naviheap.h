@@ -27,16 +27,18 @@ extern "C" {
 #endif
 /******************************************************************************/
 #define PATH_HEAP_LEN 258
+
+struct AriadneWorkspace;
 /******************************************************************************/
-TbBool naviheap_empty(void);
-void naviheap_init(void);
+TbBool naviheap_empty(const struct AriadneWorkspace *ws);
+void naviheap_init(struct AriadneWorkspace *ws);
 
-long naviheap_top(void);
-long naviheap_get(long heapid);
-long naviheap_remove(void);
-TbBool naviheap_add(long heapid);
+long naviheap_top(const struct AriadneWorkspace *ws);
+long naviheap_get(const struct AriadneWorkspace *ws, long heapid);
+long naviheap_remove(struct AriadneWorkspace *ws);
+TbBool naviheap_add(struct AriadneWorkspace *ws, long heapid);
 
-long naviheap_item_tree_val(long heapid);
+long naviheap_item_tree_val(const struct AriadneWorkspace *ws, long heapid);
 /******************************************************************************/
 #ifdef __cplusplus
 }
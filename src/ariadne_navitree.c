@@ -28,6 +28,7 @@
 #include "ariadne_points.h"
 #include "ariadne_findcache.h"
 #include "ariadne_naviheap.h"
+#include "ariadne_workspace.h"
 #include "gui_topmsg.h"
 #include "post_inc.h"
 
@@ -35,12 +36,8 @@
 extern "C" {
 #endif
 /******************************************************************************/
-unsigned char Tags[TREEITEMS_COUNT];
-long tree_dad[TREEITEMS_COUNT];
-unsigned char tag_current = 0;
 long ix_delaunay = 0;
 long delaunay_stack[DELAUNAY_COUNT];
-long tree_val[TREEVALS_COUNT];
 
 /******************************************************************************/
 /******************************************************************************/
@@ -48,11 +45,11 @@ void nodes_classify(void)
 {
 }
 
-void tree_init(void)
+void tree_init(struct AriadneWorkspace *ws)
 {
     for (long i = 0; i < TREEVALS_COUNT; i++)
     {
-        tree_val[i] = -LONG_MAX;
+        ws->tree_val[i] = -LONG_MAX;
     }
 }
 
@@ -62,18 +59,18 @@ void tree_init(void)
  * @param tag_end_id Ending tag ID to place in the route.
  * @return Returns cost of the route.
  */
-long compute_tree_move_cost(long tag_start_id, long tag_end_id)
+long compute_tree_move_cost(const struct AriadneWorkspace *ws, long tag_start_id, long tag_end_id)
 {
     long long rcost = 0;
     long itag = tag_start_id;
     long ipt = 0;
     while (itag != tag_end_id)
     {
-        rcost += tree_val[itag];
+        rcost += ws->tree_val[itag];
         ipt++;
         if (ipt >= TREEITEMS_COUNT)
             return LONG_MAX;
-        itag = tree_dad[itag];
+        itag = ws->tree_dad[itag];
     }
     if (rcost >= LONG_MAX)
         return LONG_MAX;
@@ -91,7 +88,7 @@ long compute_tree_move_cost(long tag_start_id, long tag_end_id)
  * @return Returns index of the last point filled.
  *     If route_len is too small, points up to route_len are filled and -1 is returned.
  */
-long copy_tree_to_route(long tag_start_id, long tag_end_id, long *route_pts, long route_len)
+long copy_tree_to_route(const struct AriadneWorkspace *ws, long tag_start_id, long tag_end_id, long *route_pts, long route_len)
 {
     long itag = tag_start_id;
     long ipt = 0;
@@ -103,17 +100,17 @@ long copy_tree_to_route(long tag_start_id, long tag_end_id, long *route_pts, lon
         {
             return -1;
         }
-        itag = tree_dad[itag];
+        itag = ws->tree_dad[itag];
     }
     route_pts[ipt] = tag_end_id;
     return ipt;
 }
 
-long tree_to_route(long tag_start_id, long tag_end_id, long *route_pts)
+long tree_to_route(const struct AriadneWorkspace *ws, long tag_start_id, long tag_end_id, long *route_pts)
 {
-    if (tag_current != Tags[tag_start_id])
+    if (ws->tag_current != ws->tags[tag_start_id])
         return -1;
-    long ipt = copy_tree_to_route(tag_start_id, tag_end_id, route_pts, 3000 + 1);
+    long ipt = copy_tree_to_route(ws, tag_start_id, tag_end_id, route_pts, 3000 + 1);
     if (ipt < 0)
     {
         erstat_inc(ESE_BadRouteTree);
@@ -123,15 +120,15 @@ long tree_to_route(long tag_start_id, long tag_end_id, long *route_pts)
 
 }
 
-void tags_init(void)
+void tags_init(struct AriadneWorkspace *ws)
 {
     //Note that tag_current is a tag value, not tag index
-    if (tag_current >= 255)
+    if (ws->tag_current >= 255)
     {
-        LbMemorySet(Tags, 0, sizeof(Tags));
-        tag_current = 0;
+        LbMemorySet(ws->tags, 0, sizeof(ws->tags));
+        ws->tag_current = 0;
     }
-    tag_current++;
+    ws->tag_current++;
 }
 
 /** Sets tags if indices from given border to given tag_id.
@@ -141,7 +138,7 @@ void tags_init(void)
  * @param border_len
  * @return
  */
-long update_border_tags(long tag_id, long *border_pt, long border_len)
+long update_border_tags(struct AriadneWorkspace *ws, long tag_id, const long *border_pt, long border_len)
 {
     long iset = 0;
     for (long ipt = 0; ipt < border_len; ipt++)
@@ -152,41 +149,41 @@ long update_border_tags(long tag_id, long *border_pt, long border_len)
             erstat_inc(ESE_BadRouteTree);
             continue;
         }
-        Tags[n] = tag_id;
+        ws->tags[n] = tag_id;
         iset++;
     }
-    tag_current = tag_id;
+    ws->tag_current = tag_id;
     return iset;
 }
 
-long border_tags_to_current(long *border_pt, long border_len)
+long border_tags_to_current(struct AriadneWorkspace *ws, const long *border_pt, long border_len)
 {
-    return update_border_tags(tag_current, border_pt, border_len);
+    return update_border_tags(ws, ws->tag_current, border_pt, border_len);
 }
 
-TbBool is_current_tag(long tag_id)
+TbBool is_current_tag(const struct AriadneWorkspace *ws, long tag_id)
 {
-    return (tag_current == Tags[tag_id]);
+    return (ws->tag_current == ws->tags[tag_id]);
 }
 
-void store_current_tag(long tag_id)
+void store_current_tag(struct AriadneWorkspace *ws, long tag_id)
 {
-    Tags[tag_id] = tag_current;
+    ws->tags[tag_id] = ws->tag_current;
 }
 
-TbBool navitree_add(long itm_pos, long itm_dat, long mvcost)
+TbBool navitree_add(struct AriadneWorkspace *ws, long itm_pos, long itm_dat, long mvcost)
 {
-    long tag_pos = tag_current;
+    long tag_pos = ws->tag_current;
     if (itm_pos >= TRIANLGLES_COUNT) {
         WARNLOG("Inserting outranged pos %d",(int)itm_pos);
     }
     if (itm_dat >= TREEITEMS_COUNT) {
         WARNLOG("Inserting outranged dat %d",(int)itm_dat);
     }
-    tree_val[itm_pos] = mvcost;
-    Tags[itm_pos] = tag_pos;
-    tree_dad[itm_pos] = itm_dat;
-    return naviheap_add(itm_pos);
+    ws->tree_val[itm_pos] = mvcost;
+    ws->tags[itm_pos] = tag_pos;
+    ws->tree_dad[itm_pos] = itm_dat;
+    return naviheap_add(ws, itm_pos);
 }
 
 void delaunay_init(void)
@@ -194,6 +191,9 @@ void delaunay_init(void)
     ix_delaunay = 0;
 }
 
+/** Adds triangle to the Delaunay stack.
+ * Triangulation is only changed on the main thread, so the main workspace tags are used.
+ */
 TbBool delaunay_add(long itm_pos)
 {
     if (ix_delaunay >= DELAUNAY_COUNT) {
@@ -201,7 +201,7 @@ TbBool delaunay_add(long itm_pos)
     }
     delaunay_stack[ix_delaunay] = itm_pos;
     ix_delaunay++;
-    Tags[itm_pos] = tag_current;
+    store_current_tag(ariadne_main_workspace(), itm_pos);
     return true;
 }
 
@@ -210,7 +210,7 @@ TbBool delaunay_add_triangle(long tri_idx)
     NavColour i = get_triangle_tree_alt(tri_idx);
     if (i != NAV_COL_UNSET)
     {
-        if (!is_current_tag(tri_idx))
+        if (!is_current_tag(ariadne_main_workspace(), tri_idx))
         {
             if ((i & 0x0F) != 15)
             {
@@ -315,7 +315,7 @@ long optimise_heuristic(long tri_id1, long tri_id2)
 long delaunay_seeded(long start_x, long start_y, long end_x, long end_y)
 {
     NAVIDBG(19,"Starting");
-    tags_init();
+    tags_init(ariadne_main_workspace());
     delaunay_init();
     delaunay_stack_point(start_x, start_y);
     delaunay_stack_point(start_x, end_y);
@@ -30,22 +30,17 @@ extern "C" {
 #define TREEVALS_COUNT 100001
 #define DELAUNAY_COUNT 1000
 
+struct AriadneWorkspace;
 /******************************************************************************/
-#pragma pack(1)
-
-extern long tree_val[TREEVALS_COUNT];
-
-#pragma pack()
-/******************************************************************************/
-void tags_init(void);
-long update_border_tags(long tag_id, long *border_pt, long border_len);
-long border_tags_to_current(long *border_pt, long border_len);
-TbBool is_current_tag(long tag_id);
-void store_current_tag(long tag_id);
-
-TbBool navitree_add(long itm_pos, long itm_dat, long mvcost);
-long copy_tree_to_route(long tag_start_id, long tag_end_id, long *route_pts, long route_len);
-long tree_to_route(long tag_start_id, long tag_end_id, long *route_pts);
+void tags_init(struct AriadneWorkspace *ws);
+long update_border_tags(struct AriadneWorkspace *ws, long tag_id, const long *border_pt, long border_len);
+long border_tags_to_current(struct AriadneWorkspace *ws, const long *border_pt, long border_len);
+TbBool is_current_tag(const struct AriadneWorkspace *ws, long tag_id);
+void store_current_tag(struct AriadneWorkspace *ws, long tag_id);
+
+TbBool navitree_add(struct AriadneWorkspace *ws, long itm_pos, long itm_dat, long mvcost);
+long copy_tree_to_route(const struct AriadneWorkspace *ws, long tag_start_id, long tag_end_id, long *route_pts, long route_len);
+long tree_to_route(const struct AriadneWorkspace *ws, long tag_start_id, long tag_end_id, long *route_pts);
 
 void delaunay_init(void);
 TbBool delaunay_add(long itm_pos);
@@ -0,0 +1,178 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file ariadne_routecache.c
+ *     Route cache support functions for Ariadne pathfinding.
+ * @par Purpose:
+ *     Stores recently traced triangle routes, so that creatures walking
+ *     between the same places do not need the routes traced again.
+ * @par Comment:
+ *     Routes are keyed by their start and end triangles and navigation rules.
+ *     Creatures rarely start from the exact same point twice, so a route
+ *     stored for other endpoints within the same triangles gives its
+ *     triangle route, and only the waypoints are made again; waypoints
+ *     are reused only if the endpoints are also the same. Any change in
+ *     triangulation drops all the routes. The cache is cleared together
+ *     with triangulation on level load, so it is the same for all players.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "pre_inc.h"
+#include "ariadne_routecache.h"
+
+#include "globals.h"
+#include "bflib_basics.h"
+#include "bflib_memory.h"
+
+#include "ariadne.h"
+#include "post_inc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+struct RouteCacheEntry {
+    /** Triangulation generation for which the route was stored; 0 for unused entry. */
+    unsigned long generation;
+    struct RouteCacheKey key;
+    /** Endpoints for which the waypoints were made. */
+    struct PathWayPoint start;
+    struct PathWayPoint finish;
+    /** Amount of stored waypoints, or -1 if there were too many to store them. */
+    long waypoints_num;
+    struct PathWayPoint waypoints[ROUTE_CACHE_WAYPOINTS];
+    /** Whether the triangle route is stored; it isn't if it was too long. */
+    TbBool route_stored;
+    /** Length of the triangle route, or -1 if there is no route between the triangles. */
+    long route_len;
+    long route[ROUTE_CACHE_TRIANGLES];
+};
+
+static struct RouteCacheEntry route_cache[ROUTE_CACHE_ENTRIES];
+static unsigned long route_cache_generation = 1;
+static struct RouteCacheStats route_cache_stats;
+static TbBool route_cache_triangle_reuse = true;
+/******************************************************************************/
+static unsigned long route_cache_hash(const struct RouteCacheKey *key)
+{
+    unsigned long hash = (unsigned long)key->tri_src * 73856093UL;
+    hash ^= (unsigned long)key->tri_dst * 19349663UL;
+    hash ^= (unsigned long)(key->nav_size | (key->can_travel_over_lava << 4) | ((key->owner + 1) << 8)) * 83492791UL;
+    return (hash ^ (hash >> 16)) % ROUTE_CACHE_ENTRIES;
+}
+
+static TbBool route_cache_keys_equal(const struct RouteCacheKey *key1, const struct RouteCacheKey *key2)
+{
+    return (key1->tri_src == key2->tri_src) && (key1->tri_dst == key2->tri_dst)
+        && (key1->owner == key2->owner) && (key1->nav_size == key2->nav_size)
+        && (key1->can_travel_over_lava == key2->can_travel_over_lava);
+}
+
+/**
+ * Looks for route of given key, between the start and finish points of given path.
+ * @param route Buffer for triangle route, at least ROUTE_CACHE_TRIANGLES long.
+ * @param route_len Set to length of the triangle route, if only that route was found.
+ * @return RCRes_Exact if path waypoints were filled, RCRes_Triangles if the triangle
+ *     route was filled and waypoints need to be made from it, RCRes_Miss otherwise.
+ */
+enum RouteCacheResult route_cache_get(const struct RouteCacheKey *key, struct Path *path, long *route, long *route_len)
+{
+    struct RouteCacheEntry* rcentry = &route_cache[route_cache_hash(key)];
+    if ((rcentry->generation == route_cache_generation) && route_cache_keys_equal(&rcentry->key, key))
+    {
+        if ((rcentry->waypoints_num >= 0)
+          && (rcentry->start.x == path->start.x) && (rcentry->start.y == path->start.y)
+          && (rcentry->finish.x == path->finish.x) && (rcentry->finish.y == path->finish.y))
+        {
+            path->waypoints_num = rcentry->waypoints_num;
+            LbMemoryCopy(path->waypoints, rcentry->waypoints, rcentry->waypoints_num*sizeof(struct PathWayPoint));
+            route_cache_stats.hits++;
+            return RCRes_Exact;
+        }
+        if (route_cache_triangle_reuse && rcentry->route_stored)
+        {
+            *route_len = rcentry->route_len;
+            if (rcentry->route_len >= 0)
+                LbMemoryCopy(route, rcentry->route, (rcentry->route_len+1)*sizeof(long));
+            route_cache_stats.triangle_hits++;
+            return RCRes_Triangles;
+        }
+    }
+    route_cache_stats.misses++;
+    return RCRes_Miss;
+}
+
+/**
+ * Stores route of given path in the cache, replacing whatever was there.
+ * @param route The triangle route from which path waypoints were made.
+ * @param route_len Length of the triangle route, or -1 if there is no route.
+ */
+void route_cache_put(const struct RouteCacheKey *key, const struct Path *path, const long *route, long route_len)
+{
+    TbBool waypoints_fit = (path->waypoints_num >= 0) && (path->waypoints_num <= ROUTE_CACHE_WAYPOINTS);
+    TbBool route_fits = (route_len + 1 <= ROUTE_CACHE_TRIANGLES);
+    if (!waypoints_fit && !route_fits)
+        return;
+    struct RouteCacheEntry* rcentry = &route_cache[route_cache_hash(key)];
+    rcentry->generation = route_cache_generation;
+    rcentry->key = *key;
+    rcentry->start = path->start;
+    rcentry->finish = path->finish;
+    rcentry->waypoints_num = -1;
+    if (waypoints_fit)
+    {
+        rcentry->waypoints_num = path->waypoints_num;
+        LbMemoryCopy(rcentry->waypoints, path->waypoints, path->waypoints_num*sizeof(struct PathWayPoint));
+    }
+    rcentry->route_stored = route_fits;
+    rcentry->route_len = route_len;
+    if (route_fits && (route_len >= 0))
+        LbMemoryCopy(rcentry->route, route, (route_len+1)*sizeof(long));
+}
+
+/**
+ * Drops all cached routes. Needs to be called on every change of triangulation.
+ */
+void route_cache_triangulation_changed(void)
+{
+    route_cache_generation++;
+    if (route_cache_generation == 0)
+    {
+        LbMemorySet(route_cache, 0, sizeof(route_cache));
+        route_cache_generation = 1;
+    }
+    route_cache_stats.invalidations++;
+}
+
+/**
+ * Sets whether a triangle route stored for other endpoints may be used.
+ * Routes made this way differ a bit from traced ones, so replays recorded
+ * without it need it disabled.
+ * @return The previous setting.
+ */
+TbBool route_cache_set_triangle_reuse(TbBool reuse)
+{
+    TbBool prev = route_cache_triangle_reuse;
+    route_cache_triangle_reuse = reuse;
+    return prev;
+}
+
+void route_cache_get_stats(struct RouteCacheStats *stats)
+{
+    *stats = route_cache_stats;
+}
+
+void route_cache_reset_stats(void)
+{
+    LbMemorySet(&route_cache_stats, 0, sizeof(route_cache_stats));
+}
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
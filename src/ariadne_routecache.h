@@ -0,0 +1,75 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file ariadne_routecache.h
+ *     Header file for ariadne_routecache.c.
+ * @par Purpose:
+ *     Route cache support functions for Ariadne pathfinding.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef DK_ARIADNE_ROUTECACHE_H
+#define DK_ARIADNE_ROUTECACHE_H
+
+#include "globals.h"
+#include "bflib_basics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Amount of routes stored in the cache. */
+#define ROUTE_CACHE_ENTRIES    256
+/** Routes with more waypoints are not cached. */
+#define ROUTE_CACHE_WAYPOINTS  128
+/** Triangle routes longer than this are not cached, so only exact endpoints may reuse such route. */
+#define ROUTE_CACHE_TRIANGLES  256
+
+struct Path;
+
+/** Triangles and navigation rules of a route; routes between any points of these triangles share the key. */
+struct RouteCacheKey {
+    long tri_src;
+    long tri_dst;
+    long owner;
+    unsigned char nav_size;
+    unsigned char can_travel_over_lava;
+};
+
+enum RouteCacheResult {
+    RCRes_Miss = 0,
+    /** Route with the same endpoints was found; path waypoints are filled. */
+    RCRes_Exact,
+    /** Only the triangle route was found; waypoints need to be made from it for the new endpoints. */
+    RCRes_Triangles,
+};
+
+struct RouteCacheStats {
+    /** Lookups which found the route with exact same endpoints. */
+    unsigned long hits;
+    /** Lookups which found the triangle route, but with other endpoints. */
+    unsigned long triangle_hits;
+    unsigned long misses;
+    /** Amount of times the triangulation was changed, dropping all cached routes. */
+    unsigned long invalidations;
+};
+/******************************************************************************/
+enum RouteCacheResult route_cache_get(const struct RouteCacheKey *key, struct Path *path, long *route, long *route_len);
+void route_cache_put(const struct RouteCacheKey *key, const struct Path *path, const long *route, long route_len);
+void route_cache_triangulation_changed(void);
+TbBool route_cache_set_triangle_reuse(TbBool reuse);
+void route_cache_get_stats(struct RouteCacheStats *stats);
+void route_cache_reset_stats(void);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
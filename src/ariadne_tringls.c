@@ -24,6 +24,7 @@
 #include "bflib_math.h"
 #include "ariadne_points.h"
 #include "ariadne_edge.h"
+#include "ariadne_findcache.h"
 #include "ariadne.h"
 #include "gui_topmsg.h"
 #include "post_inc.h"
@@ -79,6 +80,7 @@ long tri_new(void)
 
 void tri_dispose(long tri_idx)
 {
+    triangle_find_cache_tri_disposed(tri_idx);
     long pfree_idx = free_Triangles;
     free_Triangles = tri_idx;
     Triangles[tri_idx].tags[0] = pfree_idx;
@@ -327,6 +329,8 @@ long edge_rotateAC(long tri1_id, long cor1_id)
     Triangles[tri2_id].field_D |= ((((1 << cor2_id) & tri2_fld) != 0) << cor2b_id);
     edgelen_set(tri1_id);
     edgelen_set(tri2_id);
+    triangle_find_cache_tri_changed(tri1_id);
+    triangle_find_cache_tri_changed(tri2_id);
     return true;
 }
 long reduce_point(long *pt_tri, long *pt_cor)
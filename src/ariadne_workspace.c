@@ -0,0 +1,73 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file ariadne_workspace.c
+ *     Scratch memory used by Ariadne while tracing a route.
+ * @par Purpose:
+ *     Keeps the navigation heap, tree and route buffers of the main thread,
+ *     and additional copies of them for tracing routes on worker threads.
+ * @par Comment:
+ *     The main workspace is used by everything running on the main thread,
+ *     including triangulation. Additional workspaces are allocated when
+ *     routes are traced in parallel for the first time, and then kept.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "pre_inc.h"
+#include "ariadne_workspace.h"
+
+#include "globals.h"
+#include "bflib_basics.h"
+#include "bflib_memory.h"
+#include "post_inc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+static struct AriadneWorkspace main_workspace;
+static struct AriadneWorkspace *workspaces[ARIADNE_WORKSPACES_COUNT] = { &main_workspace, };
+/******************************************************************************/
+struct AriadneWorkspace *ariadne_main_workspace(void)
+{
+    return &main_workspace;
+}
+
+/**
+ * Makes sure given amount of workspaces is allocated.
+ * @return Amount of workspaces which can be used; at least one, the main workspace.
+ */
+int ariadne_workspaces_reserve(int count)
+{
+    if (count > ARIADNE_WORKSPACES_COUNT)
+        count = ARIADNE_WORKSPACES_COUNT;
+    for (int i = 1; i < count; i++)
+    {
+        if (workspaces[i] != NULL)
+            continue;
+        workspaces[i] = (struct AriadneWorkspace *)LbMemoryAlloc(sizeof(struct AriadneWorkspace));
+        if (workspaces[i] == NULL)
+        {
+            WARNLOG("Cannot allocate Ariadne workspace %d, using %d",i,i);
+            return i;
+        }
+    }
+    return max(count,1);
+}
+
+struct AriadneWorkspace *ariadne_workspace_get(int ws_idx)
+{
+    if ((ws_idx < 0) || (ws_idx >= ARIADNE_WORKSPACES_COUNT) || (workspaces[ws_idx] == NULL))
+        return &main_workspace;
+    return workspaces[ws_idx];
+}
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
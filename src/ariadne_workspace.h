@@ -0,0 +1,76 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file ariadne_workspace.h
+ *     Header file for ariadne_workspace.c.
+ * @par Purpose:
+ *     Scratch memory used by Ariadne while tracing a route.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef DK_ARIADNE_WORKSPACE_H
+#define DK_ARIADNE_WORKSPACE_H
+
+#include "globals.h"
+#include "bflib_basics.h"
+
+#include "ariadne.h"
+#include "ariadne_naviheap.h"
+#include "ariadne_navitree.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Amount of workspaces which can be used at the same time, including the main one. */
+#define ARIADNE_WORKSPACES_COUNT 16
+
+/**
+ * Everything which is modified while a route is traced.
+ * The triangulation is only read, so routes may be traced
+ * on several threads at once, each with its own workspace.
+ */
+struct AriadneWorkspace {
+    /** Player whose locked doors block the route, or -1. */
+    long owner;
+    /** Whether the route may lead over lava. */
+    long can_travel_over_lava;
+    /** Table of edges wide enough for the routed creature. */
+    const unsigned long *edge_fit;
+    // Navigation heap
+    long heap_end;
+    long heap[PATH_HEAP_LEN];
+    // Navigation tree
+    long tree_dad[TREEITEMS_COUNT];
+    long tree_val[TREEVALS_COUNT];
+    unsigned char tag_current;
+    unsigned char tags[TREEITEMS_COUNT];
+    // Route tracing
+    long tree_Ax8;
+    long tree_Ay8;
+    long tree_Bx8;
+    long tree_By8;
+    long tree_route[TREE_ROUTE_LEN];
+    long route_fwd[ROUTE_LENGTH];
+    long route_bak[ROUTE_LENGTH];
+    struct Path fwd_path;
+    struct Path bak_path;
+    struct WayPoints way_points;
+};
+/******************************************************************************/
+struct AriadneWorkspace *ariadne_main_workspace(void);
+int ariadne_workspaces_reserve(int count);
+struct AriadneWorkspace *ariadne_workspace_get(int ws_idx);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -126,6 +126,15 @@ void frametime_end_measurement(int frametime_kind)
         frametime_set_all_measurements_to_be_displayed();
     }
 }
+
+/**
+ * Returns high resolution timestamp in microseconds.
+ * Only differences between two values are meaningful.
+ */
+TbClockMicroSec LbTimerClockMicro(void)
+{
+    return std::chrono::duration_cast<std::chrono::microseconds>(TimeNow.time_since_epoch()).count();
+}
 /******************************************************************************/
 /**
  * Returns the number of milliseconds elapsed since the program was launched.
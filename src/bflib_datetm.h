@@ -32,6 +32,8 @@ extern "C" {
 extern struct TbTime global_time;
 extern struct TbDate global_date;
 extern TbClockMSec (* LbTimerClock)(void);
+/** High resolution time value, used for measuring short intervals. */
+typedef long long TbClockMicroSec;
 /******************************************************************************/
 void LbDoMultitasking(void);
 TbBool LbSleepFor(TbClockMSec delay);
@@ -44,6 +46,7 @@ TbResult LbDateTimeDecode(const time_t *datetime,struct TbDate *curr_date, struc
 TbResult LbTimerInit(void);
 double LbMoonPhase(void);
 TbClockMSec LbTimerClock_1000(void);
+TbClockMicroSec LbTimerClockMicro(void);
 /******************************************************************************/
 
 #define TOTAL_FRAMETIME_KINDS 4
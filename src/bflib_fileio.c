@@ -290,6 +290,17 @@ long LbFileLength(const char *fname)
   return result;
 }
 
+/**
+ * Returns last modification time of given file, or 0 if the file doesn't exist.
+ */
+unsigned long LbFileModifiedTime(const char *fname)
+{
+    struct stat st;
+    if (stat(fname, &st) != 0)
+        return 0;
+    return (unsigned long)st.st_mtime;
+}
+
 //Converts file search information from platform-specific into independent form
 //Yeah, right...
 void convert_find_info(struct TbFileFind *ffind)
@@ -51,6 +51,7 @@ int LbFileRead(TbFileHandle handle, void *buffer, unsigned long len);
 long LbFileWrite(TbFileHandle handle, const void *buffer, const unsigned long len);
 long LbFileLength(const char *fname);
 long LbFileLengthHandle(TbFileHandle handle);
+unsigned long LbFileModifiedTime(const char *fname);
 int LbFileFindFirst(const char *filespec, struct TbFileFind *ffind,unsigned int attributes);
 int LbFileFindNext(struct TbFileFind *ffind);
 int LbFileFindEnd(struct TbFileFind *ffind);
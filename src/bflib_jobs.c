@@ -0,0 +1,182 @@
+/******************************************************************************/
+// Bullfrog Engine Emulation Library - for use to remake classic games like
+// Syndicate Wars, Magic Carpet or Dungeon Keeper.
+/******************************************************************************/
+/** @file bflib_jobs.c
+ *     Worker threads for splitting independent work items between CPU cores.
+ * @par Purpose:
+ *     Keeps a pool of worker threads and runs parallel loops on them.
+ * @par Comment:
+ *     Work items are split into batches, which are taken by the threads
+ *     in any order. The callback may only modify data of its own items;
+ *     anything shared must be left to the caller, once the loop is finished.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "pre_inc.h"
+#include "bflib_jobs.h"
+
+#include "bflib_basics.h"
+#include "globals.h"
+#include <SDL2/SDL.h>
+#include "post_inc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+struct JobsPool {
+    SDL_Thread *threads[JOBS_WORKERS_MAX];
+    int workers_count;
+    /** Posted once per worker when there is a loop to run. */
+    SDL_sem *start_sem;
+    /** Posted by every worker when it has no more batches to take. */
+    SDL_sem *done_sem;
+    /** Index of the first item which was not yet taken by any thread. */
+    SDL_atomic_t next_item;
+    TbJobFunc func;
+    void *data;
+    long items_count;
+    long batch_size;
+    TbBool quit;
+};
+
+static struct JobsPool jobs;
+/******************************************************************************/
+static void jobs_process_batches(void)
+{
+    for (;;)
+    {
+        long first = SDL_AtomicAdd(&jobs.next_item, jobs.batch_size);
+        if (first >= jobs.items_count)
+            break;
+        long last = first + jobs.batch_size;
+        if (last > jobs.items_count)
+            last = jobs.items_count;
+        jobs.func(jobs.data, first, last);
+    }
+}
+
+static int jobs_worker_thread(void *ptr)
+{
+    for (;;)
+    {
+        SDL_SemWait(jobs.start_sem);
+        if (jobs.quit)
+            break;
+        jobs_process_batches();
+        SDL_SemPost(jobs.done_sem);
+    }
+    return 0;
+}
+
+/**
+ * Starts the worker threads.
+ * @param workers_count Amount of threads to start; if negative, it is based on amount of CPU cores.
+ */
+TbResult LbJobsInitialise(int workers_count)
+{
+    if (jobs.workers_count > 0)
+        LbJobsShutdown();
+    if (workers_count < 0)
+        workers_count = SDL_GetCPUCount() - 1;
+    if (workers_count > JOBS_WORKERS_MAX)
+        workers_count = JOBS_WORKERS_MAX;
+    if (workers_count <= 0)
+    {
+        SYNCMSG("Parallel jobs disabled, everything runs on the main thread");
+        return Lb_SUCCESS;
+    }
+    jobs.quit = false;
+    jobs.start_sem = SDL_CreateSemaphore(0);
+    jobs.done_sem = SDL_CreateSemaphore(0);
+    if ((jobs.start_sem == NULL) || (jobs.done_sem == NULL))
+    {
+        ERRORLOG("Cannot create job semaphores: %s",SDL_GetError());
+        LbJobsShutdown();
+        return Lb_FAIL;
+    }
+    for (int i = 0; i < workers_count; i++)
+    {
+        jobs.threads[i] = SDL_CreateThread(jobs_worker_thread, "JobWorker", NULL);
+        if (jobs.threads[i] == NULL)
+        {
+            WARNLOG("Cannot create job worker thread: %s",SDL_GetError());
+            break;
+        }
+        jobs.workers_count++;
+    }
+    SYNCMSG("Parallel jobs use %d worker threads",jobs.workers_count);
+    return Lb_SUCCESS;
+}
+
+void LbJobsShutdown(void)
+{
+    jobs.quit = true;
+    for (int i = 0; i < jobs.workers_count; i++)
+    {
+        SDL_SemPost(jobs.start_sem);
+    }
+    for (int i = 0; i < jobs.workers_count; i++)
+    {
+        SDL_WaitThread(jobs.threads[i], NULL);
+        jobs.threads[i] = NULL;
+    }
+    jobs.workers_count = 0;
+    if (jobs.start_sem != NULL)
+    {
+        SDL_DestroySemaphore(jobs.start_sem);
+        jobs.start_sem = NULL;
+    }
+    if (jobs.done_sem != NULL)
+    {
+        SDL_DestroySemaphore(jobs.done_sem);
+        jobs.done_sem = NULL;
+    }
+}
+
+int LbJobsWorkersCount(void)
+{
+    return jobs.workers_count;
+}
+
+/**
+ * Calls given function for all items, splitting them between the calling thread and the workers.
+ * Returns when all items are processed.
+ */
+void LbJobsParallelFor(TbJobFunc func, void *data, long items_count, long batch_size)
+{
+    if (items_count <= 0)
+        return;
+    if (batch_size < 1)
+        batch_size = 1;
+    if ((jobs.workers_count <= 0) || (items_count <= batch_size))
+    {
+        func(data, 0, items_count);
+        return;
+    }
+    jobs.func = func;
+    jobs.data = data;
+    jobs.items_count = items_count;
+    jobs.batch_size = batch_size;
+    SDL_AtomicSet(&jobs.next_item, 0);
+    for (int i = 0; i < jobs.workers_count; i++)
+    {
+        SDL_SemPost(jobs.start_sem);
+    }
+    jobs_process_batches();
+    for (int i = 0; i < jobs.workers_count; i++)
+    {
+        SDL_SemWait(jobs.done_sem);
+    }
+}
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,43 @@
+/******************************************************************************/
+// Bullfrog Engine Emulation Library - for use to remake classic games like
+// Syndicate Wars, Magic Carpet or Dungeon Keeper.
+/******************************************************************************/
+/** @file bflib_jobs.h
+ *     Header file for bflib_jobs.c.
+ * @par Purpose:
+ *     Worker threads for splitting independent work items between CPU cores.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef BFLIB_JOBS_H
+#define BFLIB_JOBS_H
+
+#include "bflib_basics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Max amount of worker threads, not counting the calling thread. */
+#define JOBS_WORKERS_MAX 15
+
+/** Callback processing work items from first to last-1; may be called from any thread. */
+typedef void (*TbJobFunc)(void *data, long first, long last);
+/******************************************************************************/
+TbResult LbJobsInitialise(int workers_count);
+void LbJobsShutdown(void);
+int LbJobsWorkersCount(void);
+void LbJobsParallelFor(TbJobFunc func, void *data, long items_count, long batch_size);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,333 @@
+/******************************************************************************/
+// Bullfrog Engine Emulation Library - for use to remake classic games like
+// Syndicate Wars, Magic Carpet or Dungeon Keeper.
+/******************************************************************************/
+/** @file bflib_loopsp.c
+ *     Part of network support library.
+ * @par Purpose:
+ *     In-process loopback service provider with simulated clients.
+ * @par Comment:
+ *     Can only host. Clients are simulated by a callback which receives
+ *     messages sent to them and may answer. Every message is delayed by
+ *     the configured latency and random jitter; lost messages are delivered
+ *     after a retransmission delay, as the reliable transports would do.
+ *     Messages between two users are always delivered in order.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "pre_inc.h"
+#include "bflib_loopsp.h"
+
+#include "bflib_basics.h"
+#include "bflib_memory.h"
+#include "bflib_datetm.h"
+#include "post_inc.h"
+
+/** Minimal time after which a lost message is sent again, in milliseconds. */
+#define LOOPSP_RETRANSMIT_MIN 20
+/** Max wait for a message in readmsg(), which is expected to block. */
+#define LOOPSP_READ_TIMEOUT 10000
+
+struct LoopMsg
+{
+    struct LoopMsg *    next;
+    TbClockMSec         deliver_at;
+    size_t              size;
+    char                data[1];
+};
+
+/** Messages in one direction between the host and a client. */
+struct LoopLink
+{
+    struct LoopMsg *    head;
+    struct LoopMsg *    tail;
+};
+
+struct LoopClient
+{
+    TbBool              connected;
+    struct LoopLink     to_host;
+    struct LoopLink     to_client;
+};
+
+struct LoopSPState
+{
+    TbBool              ishost;
+    struct LoopSPConfig config;
+    LoopSPClientFunc    client_func;
+    NetDropCallback     drop_callback;
+    unsigned long       seed;
+    struct LoopClient   clients[MAX_N_USERS];
+};
+
+static struct LoopSPState loopstate;
+
+static TbError  loopSP_init(NetDropCallback drop_callback);
+static void     loopSP_exit(void);
+static TbError  loopSP_host(const char * session, void * options);
+static TbError  loopSP_join(const char * session, void * options);
+static void     loopSP_update(NetNewUserCallback new_user);
+static void     loopSP_sendmsg_single(NetUserId destination, const char * buffer, size_t size);
+static void     loopSP_sendmsg_all(const char * buffer, size_t size);
+static size_t   loopSP_msgready(NetUserId source, unsigned timeout);
+static size_t   loopSP_readmsg(NetUserId source, char * buffer, size_t max_size);
+static void     loopSP_drop_user(NetUserId id);
+
+const struct NetSP loopSP =
+{
+    loopSP_init,
+    loopSP_exit,
+    loopSP_host,
+    loopSP_join,
+    loopSP_update,
+    loopSP_sendmsg_single,
+    loopSP_sendmsg_all,
+    loopSP_msgready,
+    loopSP_readmsg,
+    loopSP_drop_user,
+};
+
+/**
+ * Sets up simulated network conditions. Needs to be called before the session is hosted.
+ */
+void LbLoopSP_Configure(const struct LoopSPConfig *config, LoopSPClientFunc client_func)
+{
+    loopstate.config = *config;
+    if (loopstate.config.clients > MAX_N_PEERS)
+        loopstate.config.clients = MAX_N_PEERS;
+    loopstate.client_func = client_func;
+}
+
+/**
+ * Simple generator used for jitter and losses, so that simulation runs are repeatable.
+ */
+static unsigned long loopsp_random(unsigned long range)
+{
+    loopstate.seed = loopstate.seed * 1103515245UL + 12345UL;
+    if (range == 0)
+        return 0;
+    return ((loopstate.seed >> 8) & 0xFFFFFF) % range;
+}
+
+static TbClockMSec loopsp_message_delay(void)
+{
+    TbClockMSec delay = loopstate.config.latency + loopsp_random(loopstate.config.jitter + 1);
+    // Reliable transports send lost messages again after about a round trip
+    while (loopsp_random(100) < loopstate.config.loss)
+    {
+        delay += max(2 * loopstate.config.latency, (unsigned long)LOOPSP_RETRANSMIT_MIN);
+    }
+    return delay;
+}
+
+static void loopsp_link_push(struct LoopLink *link, const char * buffer, size_t size)
+{
+    struct LoopMsg* msg = (struct LoopMsg *)LbMemoryAlloc(sizeof(struct LoopMsg) + size);
+    if (msg == NULL)
+    {
+        ERRORLOG("Cannot allocate loopback message of %lu bytes",(unsigned long)size);
+        return;
+    }
+    msg->deliver_at = LbTimerClock() + loopsp_message_delay();
+    // Keep the order, as real transports do
+    if ((link->tail != NULL) && (msg->deliver_at < link->tail->deliver_at))
+        msg->deliver_at = link->tail->deliver_at;
+    msg->size = size;
+    LbMemoryCopy(msg->data, buffer, size);
+    if (link->tail != NULL)
+        link->tail->next = msg;
+    else
+        link->head = msg;
+    link->tail = msg;
+}
+
+static void loopsp_link_pop(struct LoopLink *link)
+{
+    struct LoopMsg* msg = link->head;
+    if (msg == NULL)
+        return;
+    link->head = msg->next;
+    if (link->head == NULL)
+        link->tail = NULL;
+    LbMemoryFree(msg);
+}
+
+static void loopsp_link_clear(struct LoopLink *link)
+{
+    while (link->head != NULL)
+        loopsp_link_pop(link);
+}
+
+static struct LoopMsg *loopsp_link_ready(struct LoopLink *link)
+{
+    struct LoopMsg* msg = link->head;
+    if ((msg == NULL) || (msg->deliver_at > LbTimerClock()))
+        return NULL;
+    return msg;
+}
+
+/**
+ * Delivers messages which have arrived to simulated clients.
+ */
+static void loopsp_pump_clients(void)
+{
+    for (NetUserId id = 0; id < MAX_N_USERS; id++)
+    {
+        struct LoopClient* client = &loopstate.clients[id];
+        struct LoopMsg* msg;
+        while (client->connected && ((msg = loopsp_link_ready(&client->to_client)) != NULL))
+        {
+            if (loopstate.client_func != NULL)
+                loopstate.client_func(id, msg->data, msg->size);
+            loopsp_link_pop(&client->to_client);
+        }
+    }
+}
+
+static TbBool loopsp_valid_client(NetUserId id)
+{
+    return (id >= 0) && (id < MAX_N_USERS) && (id != SERVER_ID) && loopstate.clients[id].connected;
+}
+
+/**
+ * Sends a message from simulated client to the host.
+ */
+void LbLoopSP_ClientSend(NetUserId id, const char * buffer, size_t size)
+{
+    if (!loopsp_valid_client(id))
+        return;
+    loopsp_link_push(&loopstate.clients[id].to_host, buffer, size);
+}
+
+static TbError loopSP_init(NetDropCallback drop_callback)
+{
+    NETDBG(3, "Starting");
+    for (NetUserId id = 0; id < MAX_N_USERS; id++)
+    {
+        loopsp_link_clear(&loopstate.clients[id].to_host);
+        loopsp_link_clear(&loopstate.clients[id].to_client);
+        loopstate.clients[id].connected = false;
+    }
+    loopstate.ishost = false;
+    loopstate.seed = 1;
+    loopstate.drop_callback = drop_callback;
+    return Lb_OK;
+}
+
+static void loopSP_exit(void)
+{
+    for (NetUserId id = 0; id < MAX_N_USERS; id++)
+    {
+        loopsp_link_clear(&loopstate.clients[id].to_host);
+        loopsp_link_clear(&loopstate.clients[id].to_client);
+    }
+    LbMemorySet(&loopstate, 0, sizeof(loopstate));
+}
+
+static TbError loopSP_host(const char * session, void * options)
+{
+    NETMSG("Hosting loopback session with %d simulated clients, latency %lu ms, jitter %lu ms, loss %lu%%",
+        loopstate.config.clients, loopstate.config.latency, loopstate.config.jitter, loopstate.config.loss);
+    loopstate.ishost = true;
+    return Lb_OK;
+}
+
+static TbError loopSP_join(const char * session, void * options)
+{
+    NETMSG("Loopback service provider can only host");
+    return Lb_FAIL;
+}
+
+static void loopSP_update(NetNewUserCallback new_user)
+{
+    if (!loopstate.ishost)
+        return;
+    int connected = 0;
+    for (NetUserId id = 0; id < MAX_N_USERS; id++)
+    {
+        if (loopstate.clients[id].connected)
+            connected++;
+    }
+    while (connected < loopstate.config.clients)
+    {
+        NetUserId id;
+        if (!new_user(&id))
+            break;
+        if ((id < 0) || (id >= MAX_N_USERS) || (id == SERVER_ID))
+            break;
+        NETMSG("Simulated client %d connected", id);
+        loopstate.clients[id].connected = true;
+        connected++;
+        if (loopstate.client_func != NULL)
+            loopstate.client_func(id, NULL, 0);
+    }
+    loopsp_pump_clients();
+}
+
+static void loopSP_sendmsg_single(NetUserId destination, const char * buffer, size_t size)
+{
+    if (!loopsp_valid_client(destination))
+        return;
+    loopsp_link_push(&loopstate.clients[destination].to_client, buffer, size);
+    loopsp_pump_clients();
+}
+
+static void loopSP_sendmsg_all(const char * buffer, size_t size)
+{
+    for (NetUserId id = 0; id < MAX_N_USERS; id++)
+    {
+        if (loopsp_valid_client(id))
+            loopsp_link_push(&loopstate.clients[id].to_client, buffer, size);
+    }
+    loopsp_pump_clients();
+}
+
+static size_t loopSP_msgready(NetUserId source, unsigned timeout)
+{
+    if (!loopsp_valid_client(source))
+        return 0;
+    TbClockMSec end = LbTimerClock() + timeout;
+    for (;;)
+    {
+        loopsp_pump_clients();
+        struct LoopMsg* msg = loopsp_link_ready(&loopstate.clients[source].to_host);
+        if (msg != NULL)
+            return msg->size;
+        if (LbTimerClock() >= end)
+            break;
+        LbSleepFor(1);
+    }
+    return 0;
+}
+
+static size_t loopSP_readmsg(NetUserId source, char * buffer, size_t max_size)
+{
+    if (loopSP_msgready(source, LOOPSP_READ_TIMEOUT) == 0)
+    {
+        NETMSG("No message from simulated client %d", source);
+        return 0;
+    }
+    struct LoopMsg* msg = loopstate.clients[source].to_host.head;
+    size_t size = min(msg->size, max_size);
+    LbMemoryCopy(buffer, msg->data, size);
+    loopsp_link_pop(&loopstate.clients[source].to_host);
+    return size;
+}
+
+static void loopSP_drop_user(NetUserId id)
+{
+    if (!loopsp_valid_client(id))
+        return;
+    loopsp_link_clear(&loopstate.clients[id].to_host);
+    loopsp_link_clear(&loopstate.clients[id].to_client);
+    loopstate.clients[id].connected = false;
+    if (loopstate.drop_callback)
+        loopstate.drop_callback(id, NETDROP_MANUAL);
+}
+/******************************************************************************/
@@ -0,0 +1,56 @@
+/******************************************************************************/
+// Bullfrog Engine Emulation Library - for use to remake classic games like
+// Syndicate Wars, Magic Carpet or Dungeon Keeper.
+/******************************************************************************/
+/** @file bflib_loopsp.h
+ *     Header file for bflib_loopsp.c.
+ * @par Purpose:
+ *     In-process loopback service provider with simulated clients.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef BFLIB_LOOPSP_H
+#define BFLIB_LOOPSP_H
+
+#include "bflib_basics.h"
+#include "bflib_network.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/**
+ * Called when a message arrives to a simulated client.
+ * Buffer is NULL when the client has just connected.
+ */
+typedef void (*LoopSPClientFunc)(NetUserId id, const char * buffer, size_t size);
+
+/** Simulated network conditions. */
+struct LoopSPConfig {
+    /** Amount of simulated clients which connect to the host. */
+    int clients;
+    /** One way delay of every message, in milliseconds. */
+    unsigned long latency;
+    /** Max random delay added to the latency, in milliseconds. */
+    unsigned long jitter;
+    /** Chance of a message being lost and sent again, in percent. */
+    unsigned long loss;
+};
+/******************************************************************************/
+extern const struct NetSP loopSP;
+/******************************************************************************/
+void LbLoopSP_Configure(const struct LoopSPConfig *config, LoopSPClientFunc client_func);
+void LbLoopSP_ClientSend(NetUserId id, const char * buffer, size_t size);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
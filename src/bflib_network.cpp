@@ -22,6 +22,7 @@
 
 #include "bflib_basics.h"
 #include "bflib_enet.h"
+#include "bflib_loopsp.h"
 #include "bflib_datetm.h"
 #include "bflib_memory.h"
 #include "bflib_netsession.h"
@@ -30,6 +31,7 @@
 #include "bflib_sound.h"
 #include "globals.h"
 #include <assert.h>
+#include <limits.h>
 #include <ctype.h>
 
 //TODO: get rid of the following headers later by refactoring, they're here for testing primarily
@@ -124,13 +126,27 @@ struct UnidirectionalRTSMessage rtsMessage;
  */
 #define WAIT_FOR_CLIENT_TIMEOUT_IN_MS   10000
 #define WAIT_FOR_SERVER_TIMEOUT_IN_MS   WAIT_FOR_CLIENT_TIMEOUT_IN_MS
+/**
+ * Max wait for a step of re-synchronization; includes time other side needs to hash its state.
+ */
+#define WAIT_FOR_RESYNC_TIMEOUT_IN_MS   30000
 
 /**
- * If queued frames on client exceed > SCHEDULED_LAG_IN_FRAMES/2 game speed should
- * be faster, if queued frames < SCHEDULED_LAG_IN_FRAMES/2 game speed should be slower.
- * Server also expects there to be SCHEDULED_LAG_IN_FRAMES in TCP stream.
+ * Max amount of turns by which players input can be scheduled ahead.
+ * Packets made on turn N are used on turn N + lag, so turns of all players
+ * can be exchanged while the game runs, instead of waiting for them.
+ */
+#define SCHEDULED_LAG_MAX_IN_FRAMES 12
+/**
+ * Amount of turns the server keeps; a client may run up to lag turns ahead of server,
+ * and send packets for lag turns after that.
  */
-#define SCHEDULED_LAG_IN_FRAMES 12
+#define SCHEDULED_TURNS_COUNT   (2 * SCHEDULED_LAG_MAX_IN_FRAMES + 2)
+/**
+ * Amount of frames from server a client can keep before using them.
+ * More than server ever sends ahead, so frames are only dropped if the client is stuck.
+ */
+#define FRAME_RING_CAPACITY     64
 
 #define SESSION_COUNT 32 //not arbitrary, it's what code calling EnumerateSessions expects
 
@@ -153,12 +169,30 @@ struct NetUser
 
 struct NetFrame
 {
-    struct NetFrame *       next;
     char *                  buffer;
     int                     seq_nbr;
     size_t                  size;
 };
 
+/**
+ * Queue of frames received from server, in order of arrival.
+ * Slots are preallocated in one block, each big enough for packets of all users,
+ * so receiving a frame needs no allocation.
+ */
+struct NetFrameRing
+{
+    char *                  memory;             //buffers of all slots
+    size_t                  slot_size;
+    unsigned                head;               //index of the oldest frame
+    unsigned                count;              //frames waiting to be consumed
+    struct NetFrame         slots[FRAME_RING_CAPACITY];
+    // Statistics
+    unsigned                max_depth;
+    unsigned long           depth_sum;          //sum of depths at the moment frames were consumed
+    unsigned long           consumed;
+    unsigned long           overflows;          //frames which didn't fit because the ring was full
+};
+
 /*
  * This should be squished into TbPacketAction
  */
@@ -169,6 +203,9 @@ enum NetMessageType
     NETMSG_FRAME,           //to server: ACK of frame + packets, from server: the frame itself
     // Not used: NETMSG_LAGWARNING,      //from server: notice that some client is lagging
     NETMSG_RESYNC,          //from server: re-synchronization is occurring
+    NETMSG_RESYNCDATA,      //both directions: one step of delta re-synchronization, with sender id
+    NETMSG_TURNSTART,       //from server: scheduled turns restart with given frame size, turn frames queued so far are obsolete
+    NETMSG_TURNFRAME,       //to server: packet made on given turn, from server: all packets for given turn
 };
 
 /**
@@ -199,7 +236,11 @@ struct NetState
 {
     const struct NetSP *    sp;                 //pointer to service provider in use
     struct NetUser          users[MAX_N_USERS]; //the users
-    struct NetFrame *       exchg_queue;        //exchange queue from server
+    struct NetFrameRing     exchg_queue;        //exchange queue from server
+    struct NetFrameRing     turn_queue;         //scheduled turns queue from server
+    TbBool                  turns_started;      //server has started sending scheduled turns
+    size_t                  turn_frame_size;    //size of user frame in scheduled turns, as told by server
+    unsigned long           turn_nbr;           //scheduled turn to be used next
     char                    password[32];       //password for server
     NetUserId               my_id;              //id for user representing this machine
     int                     seq_nbr;            //sequence number of next frame to be issued
@@ -212,6 +253,47 @@ struct NetState
 //the "new" code contained in this struct
 static struct NetState netstate;
 
+/**
+ * Turn being gathered by server in scheduled exchange.
+ */
+struct ScheduledTurn
+{
+    unsigned long           turn;
+    unsigned char           received;           //bit for every user whose packet is stored
+    TbBool                  complete;           //no more packets will be accepted
+    char *                  buffer;             //packets of all users
+};
+
+/**
+ * Server side state of scheduled exchange.
+ */
+struct ScheduledExchange
+{
+    TbBool                  active;
+    int                     lag;                //amount of turns input is delayed
+    size_t                  frame_size;
+    unsigned long           next_send;          //first turn which was not sent yet
+    struct ScheduledTurn    turns[SCHEDULED_TURNS_COUNT];
+};
+
+static struct ScheduledExchange schedexchg;
+
+/**
+ * Turn frames of clients which came before server started scheduled exchange.
+ * Clients start sending as soon as their game starts, so these are moved
+ * into scheduled turns once the exchange starts.
+ */
+struct PendingTurnFrames
+{
+    size_t                  frame_size;
+    unsigned char           received[SCHEDULED_LAG_MAX_IN_FRAMES + 1]; //bit for every user whose packet is stored
+    char *                  buffer;             //packets of all users, for every turn
+};
+
+static struct PendingTurnFrames schedpending;
+/** Amount of turns by which input will be delayed when hosting a game. */
+static int scheduled_lag_setting = 0;
+
 //sessions placed here for now, would be smarter to store dynamically
 static struct TbNetworkSessionNameEntry sessions[SESSION_COUNT]; //using original because enumerate expects static life time
 
@@ -436,6 +518,239 @@ static void HandleUserUpdate(NetUserId source, char * ptr, char * end)
     strcpy(localPlayerInfoPtr[id].name, netstate.users[id].name);
 }
 
+static void FreeFrameQueue(NetFrameRing * ring)
+{
+    LbMemoryFree(ring->memory);
+    LbMemorySet(ring, 0, sizeof(*ring));
+}
+
+/**
+ * Drops all frames waiting in the queue. Slots and statistics are kept.
+ */
+static void ClearFrameQueue(NetFrameRing * ring)
+{
+    ring->head = 0;
+    ring->count = 0;
+}
+
+/**
+ * Makes sure ring slots can hold frames of all users. Queued frames are dropped
+ * if the slots have to be reallocated, as they were made for other frame size.
+ */
+static TbBool ReserveFrameQueue(NetFrameRing * ring, size_t user_frame_size)
+{
+    size_t slot_size;
+    int i;
+
+    slot_size = MAX_N_USERS * user_frame_size;
+    if ((ring->memory != NULL) && (ring->slot_size == slot_size)) {
+        return true;
+    }
+
+    if (ring->count > 0) {
+        NETMSG("Frame size changed, dropping %u queued frames", ring->count);
+    }
+    ClearFrameQueue(ring);
+    LbMemoryFree(ring->memory);
+    ring->memory = (char *) LbMemoryAlloc(FRAME_RING_CAPACITY * slot_size);
+    if (ring->memory == NULL) {
+        ERRORLOG("Cannot allocate %d network frame slots of %lu bytes", FRAME_RING_CAPACITY, (unsigned long)slot_size);
+        ring->slot_size = 0;
+        return false;
+    }
+    ring->slot_size = slot_size;
+    for (i = 0; i < FRAME_RING_CAPACITY; i++) {
+        ring->slots[i].buffer = ring->memory + i * slot_size;
+    }
+    return true;
+}
+
+/**
+ * Gives a free slot at end of the queue.
+ * @return The slot, or NULL if the queue is full; frames are never dropped, as every turn is needed.
+ */
+static NetFrame * PushFrameQueue(NetFrameRing * ring, size_t user_frame_size)
+{
+    NetFrame * frame;
+
+    if (!ReserveFrameQueue(ring, user_frame_size)) {
+        return NULL;
+    }
+    if (ring->count >= FRAME_RING_CAPACITY)
+    {
+        ERRORLOG("Frame queue full, %u frames since frame %d were not used", ring->count, ring->slots[ring->head].seq_nbr);
+        ring->overflows++;
+        return NULL;
+    }
+    frame = &ring->slots[(ring->head + ring->count) % FRAME_RING_CAPACITY];
+    ring->count++;
+    if (ring->count > ring->max_depth) {
+        ring->max_depth = ring->count;
+    }
+    return frame;
+}
+
+static NetFrame * FrontFrameQueue(NetFrameRing * ring)
+{
+    if (ring->count == 0) {
+        return NULL;
+    }
+    return &ring->slots[ring->head];
+}
+
+/**
+ * Removes the oldest frame from queue. Its buffer may not be used afterwards.
+ */
+static void PopFrameQueue(NetFrameRing * ring, TbBool consumed)
+{
+    if (ring->count == 0) {
+        return;
+    }
+    if (consumed) {
+        ring->depth_sum += ring->count;
+        ring->consumed++;
+    }
+    ring->head = (ring->head + 1) % FRAME_RING_CAPACITY;
+    ring->count--;
+}
+
+static void AddFrameQueueStats(struct TbNetworkQueueStats * stats, const NetFrameRing * ring)
+{
+    stats->depth += ring->count;
+    stats->max_depth = max(stats->max_depth, (unsigned long)ring->max_depth);
+    stats->depth_sum += ring->depth_sum;
+    stats->consumed += ring->consumed;
+    stats->overflows += ring->overflows;
+}
+
+static void FreeScheduledTurns(void)
+{
+    int i;
+
+    for (i = 0; i < SCHEDULED_TURNS_COUNT; ++i) {
+        LbMemoryFree(schedexchg.turns[i].buffer);
+    }
+    LbMemorySet(&schedexchg, 0, sizeof(schedexchg));
+}
+
+static void FreePendingTurnFrames(void)
+{
+    LbMemoryFree(schedpending.buffer);
+    LbMemorySet(&schedpending, 0, sizeof(schedpending));
+}
+
+/**
+ * Stores turn frame of a client until server starts scheduled exchange.
+ * Only frames for turns up to maximal lag after the current one are kept.
+ */
+static void StorePendingTurnFrame(unsigned long turn, NetUserId id, const char * ptr, size_t frame_size)
+{
+    unsigned long idx;
+
+    if ((turn < netstate.turn_nbr) || (turn > netstate.turn_nbr + SCHEDULED_LAG_MAX_IN_FRAMES)) {
+        NETLOG("Dropped early packet of user %d for turn %lu", id, turn);
+        return;
+    }
+    if ((schedpending.buffer == NULL) || (schedpending.frame_size != frame_size))
+    {
+        FreePendingTurnFrames();
+        schedpending.buffer = (char *) LbMemoryAlloc((SCHEDULED_LAG_MAX_IN_FRAMES + 1) * MAX_N_USERS * frame_size);
+        if (schedpending.buffer == NULL) {
+            ERRORLOG("Cannot allocate pending turn frames");
+            return;
+        }
+        schedpending.frame_size = frame_size;
+    }
+    idx = turn - netstate.turn_nbr;
+    LbMemoryCopy(schedpending.buffer + (idx * MAX_N_USERS + id) * frame_size, ptr, frame_size);
+    schedpending.received[idx] |= (1 << id);
+    NETDBG(9, "Stored early turn frame %lu of user %d", turn, id);
+}
+
+/**
+ * Gives storage of a scheduled turn, clearing it if it was used for an older turn.
+ * @return The turn, or NULL if it is not within range of turns gathered by server.
+ */
+static struct ScheduledTurn * GetScheduledTurn(unsigned long turn)
+{
+    struct ScheduledTurn * sturn;
+
+    if (!schedexchg.active) {
+        return NULL;
+    }
+    if ((turn < schedexchg.next_send) || (turn > netstate.turn_nbr + 2 * schedexchg.lag)) {
+        return NULL;
+    }
+    sturn = &schedexchg.turns[turn % SCHEDULED_TURNS_COUNT];
+    if (sturn->turn != turn) {
+        sturn->turn = turn;
+        sturn->received = 0;
+        sturn->complete = false;
+        LbMemorySet(sturn->buffer, 0, MAX_N_USERS * schedexchg.frame_size);
+    }
+    return sturn;
+}
+
+static unsigned char ScheduledUsersMask(void)
+{
+    NetUserId id;
+    unsigned char mask;
+
+    mask = (1 << netstate.my_id);
+    for (id = 0; id < MAX_N_USERS; ++id) {
+        if (netstate.users[id].progress == USER_LOGGEDIN) {
+            mask |= (1 << id);
+        }
+    }
+    return mask;
+}
+
+static void HandleClientTurnFrame(const char * ptr, const char * end)
+{
+    unsigned long turn;
+    NetUserId id;
+    size_t frame_size;
+    struct ScheduledTurn * sturn;
+
+    NETDBG(7, "Starting");
+
+    turn = *(int *) ptr;
+    ptr += 4;
+
+    //sender is sent explicitly, because not all service providers can tell it
+    id = (NetUserId) *ptr;
+    ptr += 1;
+
+    if (id < 0 || id >= MAX_N_USERS || netstate.users[id].progress != USER_LOGGEDIN) {
+        NETMSG("Turn frame from bad user %d", id);
+        return;
+    }
+    if (!schedexchg.active) {
+        //server didn't start the exchange yet, so any frame size is accepted
+        if (ptr < end) {
+            StorePendingTurnFrame(turn, id, ptr, end - ptr);
+        }
+        return;
+    }
+    frame_size = schedexchg.frame_size;
+    if (ptr + frame_size > end) {
+        NETMSG("Bad turn frame size from user %d", id);
+        return;
+    }
+
+    //packet made on given turn will be used after the lag
+    sturn = GetScheduledTurn(turn + schedexchg.lag);
+    if (sturn == NULL || sturn->complete) {
+        NETLOG("Dropped packet of user %d for turn %lu", id, turn + schedexchg.lag);
+        return;
+    }
+
+    LbMemoryCopy(sturn->buffer + id * frame_size, ptr, frame_size);
+    sturn->received |= (1 << id);
+
+    NETDBG(9, "Handled turn frame %lu of user %d", turn, id);
+}
+
 static void HandleClientFrame(NetUserId source, char *dst_ptr, const char * ptr, char * end, size_t frame_size)
 {
     NETDBG(7, "Starting");
@@ -455,11 +770,10 @@ static void HandleClientFrame(NetUserId source, char *dst_ptr, const char * ptr,
     NETDBG(9, "Handled client frame of %u bytes", frame_size);
 }
 
-static void HandleServerFrame(char * ptr, char * end, size_t user_frame_size)
+static TbError HandleServerFrame(NetFrameRing * queue, char * ptr, char * end, size_t user_frame_size)
 {
     int seq_nbr;
     NetFrame * frame;
-    NetFrame * it;
     unsigned num_user_frames;
 
     NETDBG(7, "Starting");
@@ -470,30 +784,26 @@ static void HandleServerFrame(char * ptr, char * end, size_t user_frame_size)
     num_user_frames = *ptr;
     ptr += 1;
 
-    frame = (NetFrame *) LbMemoryAlloc(sizeof(*frame));
-    if (netstate.exchg_queue == NULL)
-    {
-        netstate.exchg_queue = frame;
-    }
-    else
-    {
-        for (it = netstate.exchg_queue; it->next != NULL; it = it->next)
-        {
-        }
-        it->next = frame;
+    if ((num_user_frames > MAX_N_USERS) || (ptr + num_user_frames * user_frame_size > end)) {
+        NETMSG("Bad server frame %d with %u user frames", seq_nbr, num_user_frames);
+        return Lb_OK;
     }
 
-    frame->next = NULL;
+    frame = PushFrameQueue(queue, user_frame_size);
+    if (frame == NULL) {
+        //a turn which can't be stored would desync the game, so it is treated as lost connection
+        return Lb_FAIL;
+    }
     frame->size = num_user_frames * user_frame_size;
-    frame->buffer = (char *) LbMemoryAlloc(frame->size);
     frame->seq_nbr = seq_nbr;
 
     LbMemoryCopy(frame->buffer, ptr, frame->size);
 
     NETDBG(9, "Handled server frame of %u bytes", frame->size);
+    return Lb_OK;
 }
 
-static void HandleMessageFromServer(NetUserId source, size_t frame_size)
+static TbError HandleMessageFromServer(NetUserId source, size_t frame_size)
 {
     //this is a very bad way to do network message parsing, but it is what C offers
     //(I could also load into it memory by some complicated system with data description
@@ -523,14 +833,25 @@ static void HandleMessageFromServer(NetUserId source, size_t frame_size)
             HandleUserUpdate(source, buffer_ptr, buffer_end);
             break;
         case NETMSG_FRAME:
-            HandleServerFrame(buffer_ptr, buffer_end, frame_size);
+            return HandleServerFrame(&netstate.exchg_queue, buffer_ptr, buffer_end, frame_size);
+        case NETMSG_TURNSTART:
+            ClearFrameQueue(&netstate.turn_queue);
+            netstate.turn_frame_size = *(int *) buffer_ptr;
+            netstate.turns_started = true;
+            break;
+        case NETMSG_TURNFRAME:
+            //turns sent before the start are from previous game
+            if (netstate.turns_started) {
+                return HandleServerFrame(&netstate.turn_queue, buffer_ptr, buffer_end, frame_size);
+            }
             break;
         default:
             break;
     }
+    return Lb_OK;
 }
 
-static void HandleMessageFromClient(NetUserId source, void *server_buf, size_t frame_size)
+static void HandleMessageFromClient(NetUserId source, void *server_buf, size_t frame_size, size_t msg_size)
 {
     //this is a very bad way to do network message parsing, but it is what C offers
     //(I could also load into it memory by some complicated system with data description
@@ -563,6 +884,10 @@ static void HandleMessageFromClient(NetUserId source, void *server_buf, size_t f
             HandleClientFrame(source,((char*)server_buf) + source * frame_size,
                               buffer_ptr, buffer_end, frame_size);
             break;
+        case NETMSG_TURNFRAME:
+            //turn frames are checked against their real size, which may be unknown to the caller
+            HandleClientTurnFrame(buffer_ptr, netstate.msg_buffer + msg_size);
+            break;
         default:
             break;
     }
@@ -578,11 +903,13 @@ static TbError ProcessMessage(NetUserId source, void* server_buf, size_t frame_s
     {
         if (source == SERVER_ID)
         {
-            HandleMessageFromServer(source, frame_size);
+            if (HandleMessageFromServer(source, frame_size) == Lb_FAIL) {
+                return Lb_FAIL;
+            }
         }
         else
         {
-            HandleMessageFromClient(source, server_buf, frame_size);
+            HandleMessageFromClient(source, server_buf, frame_size, rcount);
         }
     }
     else
@@ -704,6 +1031,10 @@ TbError LbNetwork_Init(unsigned long srvcindex, unsigned long maxplayrs, struct
       netstate.sp = InitEnetSP();
       NETMSG("Selecting UDP");
       break;
+  case NS_LOOPBACK:
+      netstate.sp = &loopSP;
+      NETMSG("Selecting loopback");
+      break;
   default:
       WARNLOG("The serviceIndex value of %d is out of range", srvcindex);
       res = Lb_FAIL;
@@ -871,9 +1202,7 @@ void LbNetwork_ChangeExchangeTimeout(unsigned long tmout)
 
 TbError LbNetwork_Stop(void)
 {
-    NetFrame* frame;
-    NetFrame* nextframe;
-
+    struct TbNetworkQueueStats stats;
     /*
   if (spPtr == NULL)
   {
@@ -913,14 +1242,18 @@ TbError LbNetwork_Stop(void)
         netstate.sp->exit();
     }
 
-    frame = netstate.exchg_queue;
-    while (frame != NULL) {
-        nextframe = frame->next;
-        LbMemoryFree(frame->buffer);
-        LbMemoryFree(frame);
-        frame = nextframe;
+    LbNetwork_GetQueueStats(&stats);
+    if (stats.consumed > 0)
+    {
+        NETMSG("Frame queue depth avg %.2f, max %lu, %lu frames consumed, %lu overflows",
+            (double)stats.depth_sum / stats.consumed, stats.max_depth, stats.consumed, stats.overflows);
     }
 
+    FreeFrameQueue(&netstate.exchg_queue);
+    FreeFrameQueue(&netstate.turn_queue);
+    FreeScheduledTurns();
+    FreePendingTurnFrames();
+
     LbMemorySet(&netstate, 0, sizeof(netstate));
 
     return Lb_OK;
@@ -1045,14 +1378,12 @@ static void ConsumeServerFrame(void *server_buf, int frame_size)
 {
     NetFrame * frame;
 
-    frame = netstate.exchg_queue;
+    frame = FrontFrameQueue(&netstate.exchg_queue);
     NETDBG(8, "Consuming Server frame %d of size %u", frame->seq_nbr, frame->size);
 
-    netstate.exchg_queue = frame->next;
     netstate.seq_nbr = frame->seq_nbr;
     LbMemoryCopy(server_buf, frame->buffer, frame->size);
-    LbMemoryFree(frame->buffer);
-    LbMemoryFree(frame);
+    PopFrameQueue(&netstate.exchg_queue, true);
 }
 
 /*
@@ -1073,10 +1404,8 @@ TbError LbNetwork_ExchangeServer(void *server_buf, size_t client_frame_size)
 
         if (netstate.users[id].progress == USER_LOGGEDIN)
         {
-            //if (netstate.seq_nbr >= SCHEDULED_LAG_IN_FRAMES) { //scheduled lag in TCP stream
-                //TODO NET take time to detect a lagger which can then be announced
-                ProcessMessagesUntilNextFrame(id, server_buf, client_frame_size, WAIT_FOR_CLIENT_TIMEOUT_IN_MS);
-            //}
+            //TODO NET take time to detect a lagger which can then be announced
+            ProcessMessagesUntilNextFrame(id, server_buf, client_frame_size, WAIT_FOR_CLIENT_TIMEOUT_IN_MS);
 
             netstate.seq_nbr += 1;
             SendServerFrame(server_buf, client_frame_size, CountLoggedInClients() + 1);
@@ -1101,7 +1430,7 @@ TbError LbNetwork_ExchangeClient(void *send_buf, void *server_buf, size_t client
     SendClientFrame((char *) send_buf, client_frame_size, netstate.seq_nbr);
     ProcessMessagesUntilNextFrame(SERVER_ID, server_buf, client_frame_size, 0);
 
-    if (netstate.exchg_queue == NULL)
+    if (FrontFrameQueue(&netstate.exchg_queue) == NULL)
     {
         //connection lost
         return Lb_FAIL;
@@ -1141,6 +1470,468 @@ TbError LbNetwork_Exchange(void *send_buf, void *server_buf, size_t client_frame
     }
 }
 
+/**
+ * Moves turn frames which clients sent before the exchange started into scheduled turns.
+ */
+static void ApplyPendingTurnFrames(void)
+{
+    struct ScheduledTurn * sturn;
+    NetUserId id;
+    int i;
+
+    if (schedpending.buffer == NULL) {
+        return;
+    }
+    if (schedpending.frame_size != schedexchg.frame_size) {
+        NETMSG("Dropping early turn frames of %lu bytes", (unsigned long)schedpending.frame_size);
+        FreePendingTurnFrames();
+        return;
+    }
+    for (i = 0; i <= SCHEDULED_LAG_MAX_IN_FRAMES; ++i)
+    {
+        if (schedpending.received[i] == 0) {
+            continue;
+        }
+        //packet made on given turn will be used after the lag
+        sturn = GetScheduledTurn(netstate.turn_nbr + i + schedexchg.lag);
+        if (sturn == NULL || sturn->complete) {
+            continue;
+        }
+        for (id = 0; id < MAX_N_USERS; ++id)
+        {
+            if ((schedpending.received[i] & (1 << id)) == 0) {
+                continue;
+            }
+            LbMemoryCopy(sturn->buffer + id * schedexchg.frame_size,
+                schedpending.buffer + (i * MAX_N_USERS + id) * schedexchg.frame_size, schedexchg.frame_size);
+            sturn->received |= (1 << id);
+        }
+        NETDBG(6, "Applied early turn frames of turn %lu", netstate.turn_nbr + i);
+    }
+    FreePendingTurnFrames();
+}
+
+static TbBool StartScheduledExchange(size_t frame_size)
+{
+    unsigned long turn;
+    int i;
+
+    FreeScheduledTurns();
+    schedexchg.lag = min(max(scheduled_lag_setting, 0), SCHEDULED_LAG_MAX_IN_FRAMES);
+    schedexchg.frame_size = frame_size;
+    for (i = 0; i < SCHEDULED_TURNS_COUNT; ++i) {
+        schedexchg.turns[i].buffer = (char *) LbMemoryAlloc(MAX_N_USERS * frame_size);
+        if (schedexchg.turns[i].buffer == NULL) {
+            ERRORLOG("Cannot allocate scheduled turns");
+            FreeScheduledTurns();
+            return false;
+        }
+        schedexchg.turns[i].turn = ULONG_MAX;
+    }
+    schedexchg.active = true;
+    schedexchg.next_send = netstate.turn_nbr;
+    NETMSG("Scheduled exchange starts at turn %lu, with lag of %d turns", netstate.turn_nbr, schedexchg.lag);
+
+    //clients should forget any turns sent before
+    netstate.msg_buffer[0] = NETMSG_TURNSTART;
+    *(int *) &netstate.msg_buffer[1] = frame_size;
+    netstate.sp->sendmsg_all(netstate.msg_buffer, 5);
+
+    //nobody made packets for the first turns, these are empty
+    for (turn = netstate.turn_nbr; turn < netstate.turn_nbr + schedexchg.lag; ++turn) {
+        GetScheduledTurn(turn)->complete = true;
+    }
+    ApplyPendingTurnFrames();
+    return true;
+}
+
+static void SendScheduledTurn(struct ScheduledTurn * sturn)
+{
+    char * ptr;
+    int num_frames;
+
+    NETDBG(9, "Starting");
+
+    num_frames = CountLoggedInClients() + 1;
+
+    ptr = netstate.msg_buffer;
+    *ptr = NETMSG_TURNFRAME;
+    ptr += 1;
+
+    *(int *) ptr = sturn->turn;
+    ptr += 4;
+
+    *ptr = num_frames;
+    ptr += 1;
+
+    LbMemoryCopy(ptr, sturn->buffer, schedexchg.frame_size * num_frames);
+    ptr += schedexchg.frame_size * num_frames;
+
+    netstate.sp->sendmsg_all(netstate.msg_buffer, ptr - netstate.msg_buffer);
+    sturn->complete = true;
+}
+
+/**
+ * Sends all turns which have packets of every user, in order.
+ */
+static void SendCompleteScheduledTurns(void)
+{
+    struct ScheduledTurn * sturn;
+    unsigned char mask;
+
+    mask = ScheduledUsersMask();
+    for (;;)
+    {
+        sturn = GetScheduledTurn(schedexchg.next_send);
+        if (sturn == NULL) {
+            break;
+        }
+        if (!sturn->complete && (sturn->received & mask) != mask) {
+            break;
+        }
+        SendScheduledTurn(sturn);
+        schedexchg.next_send++;
+    }
+}
+
+/**
+ * Reads all messages which clients have sent so far.
+ */
+static void ReadScheduledTurnFrames(void *server_buf, size_t frame_size)
+{
+    NetUserId id;
+
+    for (id = 0; id < MAX_N_USERS; ++id)
+    {
+        if (id == netstate.my_id) {
+            continue;
+        }
+
+        if (netstate.users[id].progress == USER_UNUSED) {
+            continue;
+        }
+
+        while (netstate.sp->msgready(id, 1) != 0)
+        {
+            if (ProcessMessage(id, server_buf, frame_size) == Lb_FAIL) {
+                break;
+            }
+        }
+    }
+}
+
+static TbError LbNetwork_ExchangeScheduledServer(void *send_buf, void *server_buf, size_t client_frame_size)
+{
+    struct ScheduledTurn * sturn;
+    TbClockMSec start;
+    unsigned long turn;
+
+    if (!schedexchg.active || schedexchg.frame_size != client_frame_size)
+    {
+        if (!StartScheduledExchange(client_frame_size)) {
+            return Lb_FAIL;
+        }
+    }
+    turn = netstate.turn_nbr;
+
+    //our own packet will be used after the lag, same as packets of clients
+    sturn = GetScheduledTurn(turn + schedexchg.lag);
+    if (sturn != NULL && !sturn->complete) {
+        LbMemoryCopy(sturn->buffer + netstate.my_id * client_frame_size, send_buf, client_frame_size);
+        sturn->received |= (1 << netstate.my_id);
+    }
+
+    ReadScheduledTurnFrames(server_buf, client_frame_size);
+    SendCompleteScheduledTurns();
+
+    //wait for the turn to be used now; all clients are waited for at once
+    start = LbTimerClock();
+    while (schedexchg.next_send <= turn)
+    {
+        if (LbTimerClock() - start > WAIT_FOR_CLIENT_TIMEOUT_IN_MS)
+        {
+            //TODO NET a lagger could be announced instead
+            NETMSG("Timeout waiting for packets of turn %lu, missing ones are left empty", schedexchg.next_send);
+            GetScheduledTurn(schedexchg.next_send)->complete = true;
+        }
+        else
+        {
+            ReadScheduledTurnFrames(server_buf, client_frame_size);
+        }
+        SendCompleteScheduledTurns();
+    }
+
+    sturn = &schedexchg.turns[turn % SCHEDULED_TURNS_COUNT];
+    LbMemoryCopy(server_buf, sturn->buffer, client_frame_size * (CountLoggedInClients() + 1));
+    netstate.turn_nbr++;
+
+    netstate.sp->update(OnNewUser);
+
+    assert(UserIdentifiersValid());
+
+    return Lb_OK;
+}
+
+static void SendClientTurnFrame(const char * send_buf, size_t buf_size, unsigned long turn)
+{
+    char * ptr;
+
+    NETDBG(9, "Starting");
+
+    ptr = netstate.msg_buffer;
+
+    *ptr = NETMSG_TURNFRAME;
+    ptr += 1;
+
+    *(int *) ptr = turn;
+    ptr += 4;
+
+    *ptr = netstate.my_id;
+    ptr += 1;
+
+    LbMemoryCopy(ptr, send_buf, buf_size);
+    ptr += buf_size;
+
+    netstate.sp->sendmsg_single(SERVER_ID, netstate.msg_buffer,
+        ptr - netstate.msg_buffer);
+}
+
+/**
+ * Gives frame of given turn if it is first in scheduled turns queue. Older frames are dropped.
+ * Server sends turns in order, so the wanted frame can't be further in the queue.
+ */
+static NetFrame * TakeTurnFrame(unsigned long turn)
+{
+    NetFrame * frame;
+
+    frame = FrontFrameQueue(&netstate.turn_queue);
+    while ((frame != NULL) && ((unsigned long)frame->seq_nbr < turn))
+    {
+        PopFrameQueue(&netstate.turn_queue, false);
+        frame = FrontFrameQueue(&netstate.turn_queue);
+    }
+    if ((frame != NULL) && ((unsigned long)frame->seq_nbr == turn)) {
+        return frame;
+    }
+    return NULL;
+}
+
+static TbError LbNetwork_ExchangeScheduledClient(void *send_buf, void *server_buf, size_t client_frame_size)
+{
+    NetFrame * frame;
+
+    SendClientTurnFrame((char *) send_buf, client_frame_size, netstate.turn_nbr);
+
+    //server sends turns as soon as they are complete, so this usually doesn't wait
+    frame = TakeTurnFrame(netstate.turn_nbr);
+    while (frame == NULL)
+    {
+        if (ProcessMessage(SERVER_ID, server_buf, client_frame_size) == Lb_FAIL)
+        {
+            //connection lost
+            return Lb_FAIL;
+        }
+        frame = TakeTurnFrame(netstate.turn_nbr);
+    }
+
+    NETDBG(8, "Consuming turn frame %d of size %u", frame->seq_nbr, frame->size);
+    LbMemoryCopy(server_buf, frame->buffer, frame->size);
+    PopFrameQueue(&netstate.turn_queue, true);
+    netstate.turn_nbr++;
+
+    netstate.sp->update(OnNewUser);
+
+    if (!UserIdentifiersValid())
+    {
+        fprintf(stderr, "Bad network peer state\n");
+        return Lb_FAIL;
+    }
+    return Lb_OK;
+}
+
+/*
+ * Exchange of game turns, with packets used after a lag set by server.
+ * Unlike LbNetwork_Exchange(), players do not wait for each other on every turn,
+ * as long as the lag is longer than network latency.
+ * send_buf is packet made on this turn, server_buf receives packets to be used on this turn
+ */
+TbError LbNetwork_ExchangeScheduled(void *send_buf, void *server_buf, size_t client_frame_size)
+{
+    NETDBG(7, "Starting");
+
+    assert(UserIdentifiersValid());
+
+    if (netstate.users[netstate.my_id].progress == USER_SERVER)
+    {
+        return LbNetwork_ExchangeScheduledServer(send_buf, server_buf, client_frame_size);
+    }
+    else
+    { // client
+        return LbNetwork_ExchangeScheduledClient(send_buf, server_buf, client_frame_size);
+    }
+}
+
+/**
+ * Restarts counting scheduled turns. Needs to be called by all players when a game starts.
+ */
+void LbNetwork_ResetScheduledExchange(void)
+{
+    FreeScheduledTurns();
+    FreePendingTurnFrames();
+    ClearFrameQueue(&netstate.turn_queue);
+    netstate.turns_started = false;
+    netstate.turn_frame_size = 0;
+    netstate.turn_nbr = 0;
+}
+
+/**
+ * Gives statistics of frames queued by client after receiving them from server.
+ * Depth of the queue tells how many turns the client is behind server.
+ */
+void LbNetwork_GetQueueStats(struct TbNetworkQueueStats *stats)
+{
+    LbMemorySet(stats, 0, sizeof(*stats));
+    AddFrameQueueStats(stats, &netstate.exchg_queue);
+    AddFrameQueueStats(stats, &netstate.turn_queue);
+}
+
+/**
+ * Sets amount of turns by which players input is delayed in hosted games.
+ */
+void LbNetwork_ChangeScheduledLag(int lag)
+{
+    scheduled_lag_setting = min(max(lag, 0), SCHEDULED_LAG_MAX_IN_FRAMES);
+}
+
+/**
+ * Accepts new users until given amount of clients is logged in.
+ * To be used when there is no frontend which would do that.
+ */
+TbError LbNetwork_WaitForLogins(int clients_count, TbClockMSec timeout)
+{
+    TbClockMSec start;
+    NetUserId id;
+
+    start = LbTimerClock();
+    while (CountLoggedInClients() < clients_count)
+    {
+        if (LbTimerClock() - start > timeout) {
+            NETMSG("Only %d of %d clients logged in", CountLoggedInClients(), clients_count);
+            return Lb_FAIL;
+        }
+
+        netstate.sp->update(OnNewUser);
+
+        for (id = 0; id < MAX_N_USERS; ++id)
+        {
+            if (netstate.users[id].progress != USER_CONNECTED) {
+                continue;
+            }
+
+            while (netstate.sp->msgready(id, 1) != 0)
+            {
+                if (ProcessMessage(id, NULL, 0) == Lb_FAIL) {
+                    break;
+                }
+            }
+        }
+    }
+    return Lb_OK;
+}
+
+/**
+ * Simulated client used with loopback service provider. It logs in, and answers
+ * every scheduled turn with an empty packet for the next turn, without any delay.
+ */
+static void SimulatedClientMessage(NetUserId id, const char * buffer, size_t size)
+{
+    static int sim_turn[MAX_N_USERS];
+    static size_t sim_frame_size[MAX_N_USERS];
+    char reply[sizeof(netstate.msg_buffer)];
+    char * ptr;
+    int turn;
+
+    if (id < 0 || id >= MAX_N_USERS) {
+        return;
+    }
+
+    ptr = reply;
+    if (buffer == NULL)
+    {
+        //just connected
+        *ptr = NETMSG_LOGIN;
+        ptr += 1;
+
+        strcpy(ptr, netstate.password);
+        ptr += LbStringLength(netstate.password) + 1;
+
+        sprintf(ptr, "Simulated %d", id);
+        ptr += LbStringLength(ptr) + 1;
+
+        LbLoopSP_ClientSend(id, reply, ptr - reply);
+        return;
+    }
+
+    switch (buffer[0])
+    {
+        case NETMSG_TURNSTART:
+            if (size < 5) {
+                return;
+            }
+            sim_frame_size[id] = *(const int *) &buffer[1];
+            sim_turn[id] = 0;
+            turn = 0;
+            break;
+        case NETMSG_TURNFRAME:
+            if (size < 5) {
+                return;
+            }
+            turn = *(const int *) &buffer[1];
+            if (turn < sim_turn[id]) {
+                return;
+            }
+            //the turn is used, packet for the next one is sent
+            turn++;
+            sim_turn[id] = turn;
+            break;
+        default:
+            return;
+    }
+
+    if (sim_frame_size[id] + 6 > sizeof(reply)) {
+        return;
+    }
+
+    *ptr = NETMSG_TURNFRAME;
+    ptr += 1;
+
+    *(int *) ptr = turn;
+    ptr += 4;
+
+    *ptr = id;
+    ptr += 1;
+
+    LbMemorySet(ptr, 0, sim_frame_size[id]);
+    ptr += sim_frame_size[id];
+
+    LbLoopSP_ClientSend(id, reply, ptr - reply);
+}
+
+/**
+ * Sets up loopback service provider, which hosts simulated clients in this process.
+ * Needs to be called before LbNetwork_Init() with NS_LOOPBACK.
+ */
+void LbNetwork_SetupLoopback(int clients, unsigned long latency, unsigned long jitter, unsigned long loss)
+{
+    struct LoopSPConfig config;
+
+    config.clients = clients;
+    config.latency = latency;
+    config.jitter = jitter;
+    config.loss = loss;
+    LbLoopSP_Configure(&config, SimulatedClientMessage);
+}
+
 TbBool LbNetwork_Resync(void * buf, size_t len)
 {
     char * full_buf;
@@ -1179,6 +1970,122 @@ TbBool LbNetwork_Resync(void * buf, size_t len)
     return true;
 }
 
+TbBool LbNetwork_IsServer(void)
+{
+    return (netstate.users[netstate.my_id].progress == USER_SERVER);
+}
+
+/**
+ * Lists remote users which are logged in and so take part in re-synchronization.
+ * @return Amount of users stored in the array.
+ */
+int LbNetwork_ResyncUsers(NetUserId *users, int max_users)
+{
+    int count = 0;
+    for (int i = 0; i < MAX_N_USERS; ++i)
+    {
+        if (netstate.users[i].progress != USER_LOGGEDIN) {
+            continue;
+        }
+        if (count >= max_users) {
+            break;
+        }
+        users[count] = netstate.users[i].id;
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Sends a block of delta re-synchronization data to given user.
+ */
+TbBool LbNetwork_ResyncSend(NetUserId destination, const void *buf, size_t len)
+{
+    char* full_buf = (char *)LbMemoryAlloc(len + 2);
+    if (full_buf == NULL) {
+        NETMSG("Cannot allocate %lu bytes for resync message", (unsigned long)len + 2);
+        return false;
+    }
+    full_buf[0] = NETMSG_RESYNCDATA;
+    full_buf[1] = (char)netstate.my_id;
+    LbMemoryCopy(full_buf + 2, buf, len);
+    NETDBG(6, "Sending %lu bytes of resync data to user %d", (unsigned long)len, destination);
+    netstate.sp->sendmsg_single(destination, full_buf, len + 2);
+    LbMemoryFree(full_buf);
+    return true;
+}
+
+/**
+ * Handles a scheduled exchange message which came while waiting for re-synchronization data.
+ * Server sends turns ahead of the lagged ones, and clients send packets for them,
+ * so these have to be kept for exchange which continues after re-synchronization.
+ */
+static TbError KeepScheduledMessage(NetUserId source, const char * buf, size_t size)
+{
+    if ((buf[0] != NETMSG_TURNSTART) && (buf[0] != NETMSG_TURNFRAME)) {
+        NETDBG(6, "Discarding message of type %d from user %d", (int)buf[0], source);
+        return Lb_OK;
+    }
+    if (size > sizeof(netstate.msg_buffer)) {
+        NETMSG("Turn message of %lu bytes from user %d is too long", (unsigned long)size, source);
+        return Lb_OK;
+    }
+    LbMemoryCopy(netstate.msg_buffer, buf, size);
+    if (LbNetwork_IsServer()) {
+        if (buf[0] == NETMSG_TURNFRAME) {
+            HandleMessageFromClient(source, NULL, schedexchg.frame_size, size);
+        }
+        return Lb_OK;
+    }
+    return HandleMessageFromServer(source, netstate.turn_frame_size);
+}
+
+/**
+ * Waits for a block of delta re-synchronization data. Scheduled turn messages
+ * are kept for later exchange, any other messages are discarded.
+ * @param source User the data is expected from. Some service providers do not
+ *  distinguish sources when reading, so the real sender is returned separately.
+ * @param sender Receives id of the user who sent the data.
+ * @param len Receives size of the data.
+ * @return Newly allocated buffer with the data, to be freed with LbMemoryFree(); NULL on failure.
+ */
+void *LbNetwork_ResyncReceive(NetUserId source, NetUserId *sender, size_t *len)
+{
+    TbClockMSec start = LbTimerClock();
+    while (LbTimerClock() - start < WAIT_FOR_RESYNC_TIMEOUT_IN_MS)
+    {
+        size_t size = netstate.sp->msgready(source, 100);
+        if (size == 0) {
+            continue;
+        }
+        char* full_buf = (char *)LbMemoryAlloc(size);
+        if (full_buf == NULL) {
+            NETMSG("Cannot allocate %lu bytes for resync message", (unsigned long)size);
+            return NULL;
+        }
+        size = netstate.sp->readmsg(source, full_buf, size);
+        if (size < 1) {
+            NETLOG("Bad reception of resync message");
+            LbMemoryFree(full_buf);
+            return NULL;
+        }
+        if ((full_buf[0] != NETMSG_RESYNCDATA) || (size < 2)) {
+            if (KeepScheduledMessage(source, full_buf, size) == Lb_FAIL) {
+                LbMemoryFree(full_buf);
+                return NULL;
+            }
+            LbMemoryFree(full_buf);
+            continue;
+        }
+        *sender = full_buf[1];
+        *len = size - 2;
+        memmove(full_buf, full_buf + 2, size - 2);
+        return full_buf;
+    }
+    NETLOG("Timeout waiting for resync message from user %d", source);
+    return NULL;
+}
+
 TbError LbNetwork_EnableNewPlayers(TbBool allow)
 {
   /*if (spPtr == NULL)
@@ -144,6 +144,7 @@ typedef long (*Net_Callback_Func)(void);
 enum TbNetworkService {
     NS_TCP_IP,
     NS_ENET_UDP,
+    NS_LOOPBACK, // in-process simulated clients, for benchmarks
 };
 
 struct ClientDataEntry {
@@ -163,6 +164,15 @@ char name[32];
 long active;
 };
 
+/** Statistics of frames which client received from server, but hasn't used yet. */
+struct TbNetworkQueueStats {
+    unsigned long depth; //!< Frames waiting right now
+    unsigned long max_depth;
+    unsigned long depth_sum; //!< Sum of depths at the moment frames were consumed
+    unsigned long consumed;
+    unsigned long overflows; //!< Frames which didn't fit because the queue was full
+};
+
 struct TbNetworkCallbackData {
   char svc_name[12];
   char plyr_name[20];
@@ -227,7 +237,17 @@ TbError LbNetwork_Create(char *nsname_str, char *plyr_name, unsigned long *plyr_
 TbError LbNetwork_ExchangeServer(void *server_buf, size_t buf_size);
 TbError LbNetwork_ExchangeClient(void *send_buf, void *server_buf, size_t buf_size);
 TbError LbNetwork_Exchange(void *send_buf, void *server_buf, size_t buf_size);
+TbError LbNetwork_ExchangeScheduled(void *send_buf, void *server_buf, size_t buf_size);
+void    LbNetwork_ResetScheduledExchange(void);
+void    LbNetwork_ChangeScheduledLag(int lag);
+void    LbNetwork_GetQueueStats(struct TbNetworkQueueStats *stats);
+TbError LbNetwork_WaitForLogins(int clients_count, TbClockMSec timeout);
+void    LbNetwork_SetupLoopback(int clients, unsigned long latency, unsigned long jitter, unsigned long loss);
 TbBool  LbNetwork_Resync(void * buf, size_t len);
+TbBool  LbNetwork_IsServer(void);
+int     LbNetwork_ResyncUsers(NetUserId *users, int max_users);
+TbBool  LbNetwork_ResyncSend(NetUserId destination, const void *buf, size_t len);
+void   *LbNetwork_ResyncReceive(NetUserId source, NetUserId *sender, size_t *len);
 void    LbNetwork_ChangeExchangeTimeout(unsigned long tmout);
 TbError LbNetwork_EnableNewPlayers(TbBool allow);
 TbError LbNetwork_EnumerateServices(TbNetworkCallbackFunc callback, void *a2);
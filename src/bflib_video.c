@@ -55,7 +55,8 @@ volatile TbBool lbHasSecondSurface;
 /** True if we request the double buffering to be on in next mode switch. */
 TbBool lbDoubleBufferingRequested;
 /** Name of the video driver to be used. Must be set before LbScreenInitialize().
- * Under Win32 and with SDL, choises are windib or directx. */
+ * Empty string means SDL default; "dummy" allows running without any window. */
+char lbVideoDriver[16];
 /** Colour palette buffer, to be used inside lbDisplay. */
 unsigned char lbPalette[PALETTE_SIZE];
 /** Driver-specific colour palette buffer. */
@@ -503,6 +504,10 @@ TbResult LbScreenInitialize(void)
         LbRegisterStandardVideoModes();
         LbRegisterModernVideoModes(); // register modern and flexible custom modes
     }
+    // Select the video driver, if it was forced
+    if (lbVideoDriver[0] != '\0') {
+        SDL_setenv("SDL_VIDEODRIVER", lbVideoDriver, 1);
+    }
     // Initialize SDL library
     if (SDL_Init(SDL_INIT_VIDEO|SDL_INIT_NOPARACHUTE) < 0) {
         ERRORLOG("SDL init: %s",SDL_GetError());
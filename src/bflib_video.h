@@ -243,6 +243,7 @@ typedef struct SSurface TSurface;
 #pragma pack()
 /******************************************************************************/
 extern volatile TbBool lbScreenInitialised;
+extern char lbVideoDriver[16];
 extern volatile TbBool lbUseSdk;
 extern volatile TbBool lbInteruptMouse;
 extern volatile TbDisplayStructEx lbDisplayEx;
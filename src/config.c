@@ -21,6 +21,7 @@
 #include "config.h"
 
 #include <stdarg.h>
+#include <ctype.h>
 #include "globals.h"
 #include "bflib_basics.h"
 #include "bflib_memory.h"
@@ -32,6 +33,7 @@
 #include "bflib_datetm.h"
 #include "bflib_mouse.h"
 #include "bflib_sound.h"
+#include "bflib_network.h"
 #include "sounds.h"
 #include "engine_render.h"
 
@@ -140,6 +142,7 @@ const struct NamedCommand conf_commands[] = {
   {"MAX_ZOOM_DISTANCE"             , 27},
   {"DISPLAY_NUMBER"                , 28},
   {"MUSIC_FROM_DISK"               , 29},
+  {"NETWORK_INPUT_LAG"             , 30},
   {NULL,                   0},
   };
 
@@ -182,6 +185,32 @@ unsigned long features_enabled = 0;
 /** Line number, used when loading text files. */
 unsigned long text_line_number;
 
+#define CONF_BLOCKS_HASH_SIZE 256
+
+struct ConfBlockEntry {
+    /** Position of the block name, and its length. */
+    long name_pos;
+    int name_len;
+    /** Position of the block data, and line number at which it starts. */
+    long data_pos;
+    unsigned long line_number;
+    /** Next block with the same name hash, in order of the file; -1 if none. */
+    long next;
+};
+
+/** Blocks of the config file which is being loaded, so that every block can be found without going through the file. */
+struct ConfBlocksIndex {
+    const char *buf;
+    long buflen;
+    struct ConfBlockEntry *entries;
+    long count;
+    long alloc;
+    long hash_first[CONF_BLOCKS_HASH_SIZE];
+    long hash_last[CONF_BLOCKS_HASH_SIZE];
+};
+
+static struct ConfBlocksIndex conf_blocks;
+
 short is_full_moon = 0;
 short is_near_full_moon = 0;
 short is_new_moon = 0;
@@ -320,13 +349,146 @@ TbBool skip_conf_spaces(const char *buf, long *pos, long buflen)
   return ((*pos) < buflen);
 }
 
+static TbBool is_conf_space(char c)
+{
+  return (c == ' ') || (c == '\t') || (c == 26) || ((unsigned char)c < 7);
+}
+
+static unsigned long conf_block_name_hash(const char *name, int len)
+{
+  unsigned long hash = 2166136261UL;
+  for (int i = 0; i < len; i++)
+  {
+    hash ^= (unsigned char)tolower((unsigned char)name[i]);
+    hash *= 16777619UL;
+  }
+  return hash % CONF_BLOCKS_HASH_SIZE;
+}
+
+static TbBool add_conf_block_entry(const char *buf, long name_pos, int name_len, long data_pos, unsigned long line_number)
+{
+  if (conf_blocks.count >= conf_blocks.alloc)
+  {
+    long new_alloc = conf_blocks.alloc * 2 + 64;
+    void* mem = LbMemoryGrow(conf_blocks.entries, new_alloc * sizeof(struct ConfBlockEntry));
+    if (mem == NULL)
+      return false;
+    conf_blocks.entries = (struct ConfBlockEntry *)mem;
+    conf_blocks.alloc = new_alloc;
+  }
+  long idx = conf_blocks.count;
+  struct ConfBlockEntry* entry = &conf_blocks.entries[idx];
+  entry->name_pos = name_pos;
+  entry->name_len = name_len;
+  entry->data_pos = data_pos;
+  entry->line_number = line_number;
+  entry->next = -1;
+  unsigned long hash = conf_block_name_hash(&buf[name_pos], name_len);
+  if (conf_blocks.hash_last[hash] >= 0)
+    conf_blocks.entries[conf_blocks.hash_last[hash]].next = idx;
+  else
+    conf_blocks.hash_first[hash] = idx;
+  conf_blocks.hash_last[hash] = idx;
+  conf_blocks.count++;
+  return true;
+}
+
+/**
+ * Goes through loaded config file once, and remembers where every block starts.
+ * Then find_conf_block() doesn't have to go through the file again for every block.
+ * The index has to be freed with free_conf_blocks_index() before the buffer is freed.
+ */
+void create_conf_blocks_index(const char *buf, long buflen)
+{
+  free_conf_blocks_index(conf_blocks.buf);
+  if (buflen <= 0)
+    return;
+  for (int i = 0; i < CONF_BLOCKS_HASH_SIZE; i++)
+  {
+    conf_blocks.hash_first[i] = -1;
+    conf_blocks.hash_last[i] = -1;
+  }
+  text_line_number = 1;
+  long pos = 0;
+  while (pos < buflen)
+  {
+    if (!skip_conf_spaces(buf,&pos,buflen))
+      break;
+    if (buf[pos] == '[')
+    {
+      long name_pos = pos + 1;
+      skip_conf_spaces(buf,&name_pos,buflen);
+      long end_pos = name_pos;
+      while ((end_pos < buflen) && (buf[end_pos] != ']') && (buf[end_pos] != '\r') && (buf[end_pos] != '\n'))
+        end_pos++;
+      if ((end_pos < buflen) && (buf[end_pos] == ']'))
+      {
+        // Same as in find_conf_block(), spaces before the closing bracket are not a part of the name
+        while ((end_pos > name_pos) && is_conf_space(buf[end_pos-1]))
+          end_pos--;
+        long data_pos = end_pos;
+        skip_conf_to_next_line(buf,&data_pos,buflen);
+        if (!add_conf_block_entry(buf, name_pos, end_pos - name_pos, data_pos, text_line_number))
+        {
+          WARNLOG("Cannot allocate index of config blocks, blocks will be searched in file");
+          free_conf_blocks_index(NULL);
+          return;
+        }
+        pos = data_pos;
+        continue;
+      }
+    }
+    skip_conf_to_next_line(buf,&pos,buflen);
+  }
+  conf_blocks.buf = buf;
+  conf_blocks.buflen = buflen;
+  SYNCDBG(9,"Indexed %ld blocks",conf_blocks.count);
+}
+
+/**
+ * Frees index of config blocks, if it was created for given buffer; NULL frees it regardless of buffer.
+ */
+void free_conf_blocks_index(const char *buf)
+{
+  if ((buf != NULL) && (buf != conf_blocks.buf))
+    return;
+  LbMemoryFree(conf_blocks.entries);
+  conf_blocks.entries = NULL;
+  conf_blocks.count = 0;
+  conf_blocks.alloc = 0;
+  conf_blocks.buf = NULL;
+  conf_blocks.buflen = 0;
+}
+
+static short find_conf_block_indexed(const char *buf,long *pos,long buflen,const char *blockname)
+{
+  int blname_len = strlen(blockname);
+  unsigned long hash = conf_block_name_hash(blockname, blname_len);
+  for (long idx = conf_blocks.hash_first[hash]; idx >= 0; idx = conf_blocks.entries[idx].next)
+  {
+    const struct ConfBlockEntry* entry = &conf_blocks.entries[idx];
+    if ((entry->name_pos <= *pos) || (entry->name_len != blname_len) || (entry->name_pos + blname_len + 2 >= buflen))
+      continue;
+    if (strncasecmp(&buf[entry->name_pos],blockname,blname_len) != 0)
+      continue;
+    *pos = entry->data_pos;
+    text_line_number = entry->line_number;
+    return 1;
+  }
+  text_line_number = 1;
+  return -1;
+}
+
 /**
  * Searches for start of INI file block with given name.
  * Starts at position given with pos, and sets it to position of block data.
+ * If the file was indexed by create_conf_blocks_index(), the index is used.
  * @return Returns 1 if the block is found, -1 if buffer exceeded.
  */
 short find_conf_block(const char *buf,long *pos,long buflen,const char *blockname)
 {
+  if ((buf == conf_blocks.buf) && (buflen == conf_blocks.buflen))
+    return find_conf_block_indexed(buf,pos,buflen,blockname);
   text_line_number = 1;
   int blname_len = strlen(blockname);
   while ((*pos)+blname_len+2 < buflen)
@@ -1124,6 +1286,17 @@ short load_configuration(void)
           else
               features_enabled &= ~Ft_NoCdMusic;
           break;
+      case 30: // NETWORK_INPUT_LAG
+          if (get_conf_parameter_single(buf,&pos,len,word_buf,sizeof(word_buf)) > 0)
+          {
+            i = atoi(word_buf);
+          }
+          if ((i >= 0) && (i <= 12)) {
+              LbNetwork_ChangeScheduledLag(i);
+          } else {
+              CONFWRNLOG("Couldn't recognize \"%s\" command parameter in %s file.",COMMAND_TEXT(cmd_num),config_textname);
+          }
+          break;
       case 0: // comment
           break;
       case -1: // end of buffer
@@ -1184,6 +1357,13 @@ void process_cmdline_overrides(void)
   {
     features_enabled &= ~Ft_NoCdMusic;
   }
+  // Headless mode has nothing to show, and needs one turn per loop
+  if (start_params.headless)
+  {
+    features_enabled |= Ft_SkipSplashScreens;
+    features_enabled |= Ft_SkipHeartZoom;
+    features_enabled &= ~Ft_DeltaTime;
+  }
 }
 
 char *prepare_file_path_buf(char *ffullpath,short fgroup,const char *fname)
@@ -272,6 +272,8 @@ const char *get_language_lwrstr(int lang_id);
 TbBool reset_credits(struct CreditsItem *credits);
 TbBool setup_campaign_credits_data(struct GameCampaign *campgn);
 /******************************************************************************/
+void create_conf_blocks_index(const char *buf, long buflen);
+void free_conf_blocks_index(const char *buf);
 short find_conf_block(const char *buf,long *pos,long buflen,const char *blockname);
 int recognize_conf_command(const char *buf,long *pos,long buflen,const struct NamedCommand *commands);
 TbBool skip_conf_to_next_line(const char *buf,long *pos,long buflen);
@@ -0,0 +1,372 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file config_cache.c
+ *     Binary cache of configuration state parsed from text config files.
+ * @par Purpose:
+ *     Allows restoring the state parsed from creature, terrain, objects,
+ *     trapdoor, effects, lenses, magic, creature states and creature model
+ *     config files without parsing them, if none of the files has changed.
+ * @par Comment:
+ *     Text config files stay the source of truth; the cache is rewritten
+ *     whenever they have to be parsed. The state includes pointers to names
+ *     and functions inside the executable, so the cache is only valid for
+ *     the exact executable which has written it.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "pre_inc.h"
+#include "config_cache.h"
+
+#include <stdint.h>
+#include "bflib_basics.h"
+#include "bflib_memory.h"
+#include "bflib_fileio.h"
+#include "bflib_dernc.h"
+
+#include "config.h"
+#include "config_campaigns.h"
+#include "config_creature.h"
+#include "config_crtrstates.h"
+#include "config_effects.h"
+#include "config_lenses.h"
+#include "config_magic.h"
+#include "config_objects.h"
+#include "config_terrain.h"
+#include "config_trapdoor.h"
+#include "custom_sprites.h"
+#include "game_legacy.h"
+#include "game_merge.h"
+#include "version.h"
+#include "post_inc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+#define CONFIG_CACHE_MAGIC 0x4346434B //"KCFC"
+
+struct ConfigCacheRegion {
+    void *data;
+    unsigned long size;
+};
+
+#define CACHED_VALUE(val) {&(val), sizeof(val)}
+#define CACHED_ARRAY(arr, count) {(arr), (count)*sizeof((arr)[0])}
+
+/** Parts of game state which are completely defined by the cached config files. */
+static const struct ConfigCacheRegion config_cache_regions[] = {
+    // creature.cfg and creature model files
+    CACHED_VALUE(gameadd.crtr_conf),
+    CACHED_VALUE(gameadd.creature_stats),
+    CACHED_VALUE(gameadd.swap_creature_models),
+    CACHED_ARRAY(creatures, CREATURE_TYPES_MAX),
+    CACHED_ARRAY(breed_activities, CREATURE_TYPES_MAX),
+    CACHED_ARRAY(creature_desc, CREATURE_TYPES_MAX),
+    CACHED_ARRAY(newcrtr_desc, SWAP_CREATURE_TYPES_MAX),
+    CACHED_ARRAY(instance_desc, INSTANCE_TYPES_MAX),
+    CACHED_ARRAY(creaturejob_desc, INSTANCE_TYPES_MAX),
+    CACHED_ARRAY(angerjob_desc, INSTANCE_TYPES_MAX),
+    CACHED_ARRAY(attackpref_desc, INSTANCE_TYPES_MAX),
+    // crstates.cfg
+    CACHED_ARRAY(creatrstate_desc, CREATURE_STATES_MAX),
+    // terrain.cfg
+    CACHED_VALUE(game.slab_conf),
+    CACHED_VALUE(game.block_health),
+    CACHED_ARRAY(slab_attrs, TERRAIN_ITEMS_MAX),
+    CACHED_ARRAY(slab_desc, TERRAIN_ITEMS_MAX),
+    CACHED_ARRAY(room_desc, TERRAIN_ITEMS_MAX),
+    // objects.cfg
+    CACHED_VALUE(gameadd.object_conf),
+    CACHED_VALUE(gameadd.thing_objects_data),
+    CACHED_ARRAY(object_desc, OBJECT_TYPES_MAX),
+    // trapdoor.cfg
+    CACHED_VALUE(gameadd.trapdoor_conf),
+    CACHED_VALUE(gameadd.trap_stats),
+    CACHED_VALUE(gameadd.traps_config),
+    CACHED_VALUE(gameadd.doors_config),
+    CACHED_ARRAY(trap_desc, TRAPDOOR_TYPES_MAX),
+    CACHED_ARRAY(door_desc, TRAPDOOR_TYPES_MAX),
+    // effects.cfg
+    CACHED_VALUE(effects_conf),
+    CACHED_ARRAY(effect_desc, EFFECTS_TYPES_MAX),
+    // lenses.cfg
+    CACHED_VALUE(lenses_conf),
+    CACHED_ARRAY(lenses_desc, LENS_ITEMS_MAX),
+    // magic.cfg
+    CACHED_VALUE(magic_conf),
+    CACHED_VALUE(game.keeper_power_stats),
+    CACHED_ARRAY(spell_desc, MAGIC_ITEMS_MAX),
+    CACHED_ARRAY(shot_desc, MAGIC_ITEMS_MAX),
+    CACHED_ARRAY(power_desc, MAGIC_ITEMS_MAX),
+    CACHED_ARRAY(special_desc, MAGIC_ITEMS_MAX),
+};
+
+#undef CACHED_VALUE
+#undef CACHED_ARRAY
+
+/** Config files parsed by the cached loaders; each one is searched in data and campaign folders. */
+static const char * const config_cache_files[] = {
+    keeper_creaturetp_file,
+    keeper_terrain_file,
+    keeper_objects_file,
+    keeper_trapdoor_file,
+    keeper_effects_file,
+    keeper_lenses_file,
+    keeper_magic_file,
+    creature_states_file,
+};
+
+static const char config_cache_fname[] = "cfgcache.dat";
+
+/** Files other than the standard config files, which were read while building the cache. */
+static struct ConfigCacheInput config_cache_extra_inputs[CONFIG_CACHE_INPUTS_MAX/2];
+static int config_cache_extra_count = -1;
+/******************************************************************************/
+static TbBigChecksum config_cache_checksum_add(TbBigChecksum sum, const void *data, unsigned long size)
+{
+    const unsigned char *ptr = (const unsigned char *)data;
+    for (unsigned long i = 0; i < size; i++)
+        sum = (sum << 5) + sum + ptr[i];
+    return sum;
+}
+
+static TbBigChecksum config_cache_image_key(void)
+{
+    static const char build_str[] = VER_STRING " " __DATE__ " " __TIME__;
+    TbBigChecksum sum = 5381;
+    sum = config_cache_checksum_add(sum, build_str, sizeof(build_str));
+    // Names in cached state point into the executable; it must not be relocated
+    uintptr_t image_pos = (uintptr_t)&creature_desc[0];
+    sum = config_cache_checksum_add(sum, &image_pos, sizeof(image_pos));
+    for (int i = 0; i < sizeof(config_cache_regions)/sizeof(config_cache_regions[0]); i++)
+    {
+        sum = config_cache_checksum_add(sum, &config_cache_regions[i].size, sizeof(config_cache_regions[i].size));
+    }
+    return sum;
+}
+
+static TbBigChecksum config_cache_setup_key(void)
+{
+    TbBigChecksum sum = get_custom_sprites_checksum();
+    sum = config_cache_checksum_add(sum, campaign.fname, strlen(campaign.fname));
+    sum = config_cache_checksum_add(sum, campaign.configs_location, strlen(campaign.configs_location));
+    sum = config_cache_checksum_add(sum, campaign.creatures_location, strlen(campaign.creatures_location));
+    return sum;
+}
+
+static unsigned long config_cache_data_size(void)
+{
+    unsigned long size = 0;
+    for (int i = 0; i < sizeof(config_cache_regions)/sizeof(config_cache_regions[0]); i++)
+    {
+        size += config_cache_regions[i].size;
+    }
+    return size;
+}
+
+static void config_cache_fill_input(struct ConfigCacheInput *input, const char *fname)
+{
+    LbMemorySet(input, 0, sizeof(struct ConfigCacheInput));
+    snprintf(input->fname, sizeof(input->fname), "%s", fname);
+    input->size = LbFileLength(fname);
+    input->mtime = (input->size >= 0) ? LbFileModifiedTime(fname) : 0;
+}
+
+static TbBool config_cache_input_changed(const struct ConfigCacheInput *input)
+{
+    struct ConfigCacheInput current;
+    config_cache_fill_input(&current, input->fname);
+    return (current.size != input->size) || (current.mtime != input->mtime);
+}
+
+static int config_cache_add_fname(struct ConfigCacheInput *inputs, int count, const char *fname)
+{
+    if ((fname == NULL) || (strlen(fname) == 0))
+        return count;
+    if (count >= CONFIG_CACHE_INPUTS_MAX)
+    {
+        WARNLOG("Too many config files to cache");
+        return count;
+    }
+    config_cache_fill_input(&inputs[count], fname);
+    return count+1;
+}
+
+/**
+ * Lists files which the cached state depends on, using the state after parsing.
+ * @return Amount of entries filled.
+ */
+static int config_cache_list_inputs(struct ConfigCacheInput *inputs)
+{
+    int count = 0;
+    for (int i = 0; i < sizeof(config_cache_files)/sizeof(config_cache_files[0]); i++)
+    {
+        count = config_cache_add_fname(inputs, count, prepare_file_path(FGrp_FxData, config_cache_files[i]));
+        count = config_cache_add_fname(inputs, count, prepare_file_path(FGrp_CmpgConfig, config_cache_files[i]));
+    }
+    for (int i = 1; i < gameadd.crtr_conf.model_count; i++)
+    {
+        char conf_fnstr[COMMAND_WORD_LEN];
+        LbStringToLowerCopy(conf_fnstr, get_conf_parameter_text(creature_desc, i), COMMAND_WORD_LEN);
+        if (strlen(conf_fnstr) == 0)
+            continue;
+        count = config_cache_add_fname(inputs, count, prepare_file_fmtpath(FGrp_CrtrData, "%s.cfg", conf_fnstr));
+        count = config_cache_add_fname(inputs, count, prepare_file_fmtpath(FGrp_CmpgCrtrs, "%s.cfg", conf_fnstr));
+    }
+    for (int i = 0; i < config_cache_extra_count; i++)
+    {
+        if (count >= CONFIG_CACHE_INPUTS_MAX)
+            break;
+        inputs[count] = config_cache_extra_inputs[i];
+        count++;
+    }
+    return count;
+}
+
+/**
+ * Restores config state from the cache file, if it is still valid.
+ * @return True if the state was restored, false if config files have to be parsed.
+ */
+TbBool load_config_cache(void)
+{
+    char* fname = prepare_file_path(FGrp_Save, config_cache_fname);
+    long len = LbFileLength(fname);
+    if (len < (long)sizeof(struct ConfigCacheHead))
+    {
+        SYNCDBG(7,"No config cache");
+        return false;
+    }
+    unsigned char* buf = (unsigned char*)LbMemoryAlloc(len);
+    if (buf == NULL)
+        return false;
+    TbBool result = (LbFileLoadAt(fname, buf) == len);
+    const struct ConfigCacheHead* head = (const struct ConfigCacheHead*)buf;
+    if (result)
+    {
+        result = (head->magic == CONFIG_CACHE_MAGIC) && (head->version == CONFIG_CACHE_VERSION)
+            && (head->inputs_count <= CONFIG_CACHE_INPUTS_MAX) && (head->data_size == config_cache_data_size())
+            && (len == sizeof(struct ConfigCacheHead) + head->inputs_count*sizeof(struct ConfigCacheInput) + head->data_size);
+        if (!result)
+            SYNCMSG("Config cache file is outdated");
+    }
+    if (result)
+    {
+        result = (head->image_key == config_cache_image_key()) && (head->setup_key == config_cache_setup_key());
+        if (!result)
+            SYNCDBG(7,"Config cache was made for different executable or campaign");
+    }
+    const struct ConfigCacheInput* inputs = (const struct ConfigCacheInput*)(buf + sizeof(struct ConfigCacheHead));
+    for (unsigned long i = 0; result && (i < head->inputs_count); i++)
+    {
+        if (config_cache_input_changed(&inputs[i]))
+        {
+            SYNCDBG(7,"Config file \"%s\" has changed",inputs[i].fname);
+            result = false;
+        }
+    }
+    if (result)
+    {
+        const unsigned char* data = (const unsigned char*)&inputs[head->inputs_count];
+        for (int i = 0; i < sizeof(config_cache_regions)/sizeof(config_cache_regions[0]); i++)
+        {
+            LbMemoryCopy(config_cache_regions[i].data, data, config_cache_regions[i].size);
+            data += config_cache_regions[i].size;
+        }
+        SYNCMSG("Restored config state from cache, %lu files unchanged",head->inputs_count);
+    }
+    LbMemoryFree(buf);
+    return result;
+}
+
+/**
+ * Starts recording files read by config loaders, before the cached configs are parsed.
+ */
+void config_cache_record_start(void)
+{
+    config_cache_extra_count = 0;
+}
+
+/**
+ * Notes a file which the parsed config state depends on, other than the config file itself.
+ */
+void config_cache_add_input(const char *fname)
+{
+    if (config_cache_extra_count < 0)
+        return;
+    if (config_cache_extra_count >= sizeof(config_cache_extra_inputs)/sizeof(config_cache_extra_inputs[0]))
+    {
+        WARNLOG("Too many additional config files to cache");
+        return;
+    }
+    for (int i = 0; i < config_cache_extra_count; i++)
+    {
+        if (strcasecmp(config_cache_extra_inputs[i].fname, fname) == 0)
+            return;
+    }
+    config_cache_fill_input(&config_cache_extra_inputs[config_cache_extra_count], fname);
+    config_cache_extra_count++;
+}
+
+/**
+ * Writes the config state parsed since config_cache_record_start() to the cache file.
+ */
+TbBool save_config_cache(void)
+{
+    if (config_cache_extra_count < 0)
+    {
+        ERRORLOG("Config files were not recorded");
+        return false;
+    }
+    struct ConfigCacheInput* inputs = (struct ConfigCacheInput*)LbMemoryAlloc(CONFIG_CACHE_INPUTS_MAX*sizeof(struct ConfigCacheInput));
+    if (inputs == NULL)
+    {
+        config_cache_extra_count = -1;
+        return false;
+    }
+    struct ConfigCacheHead head;
+    LbMemorySet(&head, 0, sizeof(head));
+    head.magic = CONFIG_CACHE_MAGIC;
+    head.version = CONFIG_CACHE_VERSION;
+    head.image_key = config_cache_image_key();
+    head.setup_key = config_cache_setup_key();
+    head.inputs_count = config_cache_list_inputs(inputs);
+    head.data_size = config_cache_data_size();
+    config_cache_extra_count = -1;
+    char* fname = prepare_file_path(FGrp_Save, config_cache_fname);
+    TbFileHandle fh = LbFileOpen(fname, Lb_FILE_MODE_NEW);
+    if (fh == -1)
+    {
+        WARNLOG("Cannot create config cache file \"%s\"",fname);
+        LbMemoryFree(inputs);
+        return false;
+    }
+    TbBool result = (LbFileWrite(fh, &head, sizeof(head)) == sizeof(head));
+    unsigned long inputs_size = head.inputs_count*sizeof(struct ConfigCacheInput);
+    if (result)
+        result = (LbFileWrite(fh, inputs, inputs_size) == inputs_size);
+    for (int i = 0; result && (i < sizeof(config_cache_regions)/sizeof(config_cache_regions[0])); i++)
+    {
+        result = (LbFileWrite(fh, config_cache_regions[i].data, config_cache_regions[i].size) == config_cache_regions[i].size);
+    }
+    LbFileClose(fh);
+    LbMemoryFree(inputs);
+    if (!result)
+    {
+        WARNLOG("Cannot write config cache file \"%s\"",fname);
+        LbFileDelete(fname);
+        return false;
+    }
+    SYNCDBG(7,"Config cache written, %lu files",head.inputs_count);
+    return true;
+}
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
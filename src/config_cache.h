@@ -0,0 +1,66 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file config_cache.h
+ *     Header file for config_cache.c.
+ * @par Purpose:
+ *     Binary cache of configuration state parsed from text config files.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef DK_CFGCACHE_H
+#define DK_CFGCACHE_H
+
+#include "globals.h"
+#include "bflib_basics.h"
+
+#include "config_creature.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Version of the cache file; increase when the stored regions change. */
+#define CONFIG_CACHE_VERSION 1
+/** Max amount of files from which the cached state is parsed. */
+#define CONFIG_CACHE_INPUTS_MAX (2*CREATURE_TYPES_MAX+64)
+
+#pragma pack(1)
+
+struct ConfigCacheHead {
+    unsigned long magic;
+    unsigned long version;
+    /** Identifies the executable; the state contains pointers into it. */
+    TbBigChecksum image_key;
+    /** Identifies the campaign and custom sprites set. */
+    TbBigChecksum setup_key;
+    unsigned long inputs_count;
+    unsigned long data_size;
+};
+
+/** A file which contributed to the cached state; missing files are stored too. */
+struct ConfigCacheInput {
+    char fname[DISKPATH_SIZE];
+    long size;
+    unsigned long mtime;
+};
+
+#pragma pack()
+/******************************************************************************/
+TbBool load_config_cache(void);
+void config_cache_record_start(void);
+void config_cache_add_input(const char *fname);
+TbBool save_config_cache(void);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
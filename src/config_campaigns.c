@@ -1075,6 +1075,7 @@ TbBool load_campaign(const char *cmpgn_fname,struct GameCampaign *campgn,unsigne
       return false;
     // Loading file data
     len = LbFileLoadAt(fname, buf);
+    create_conf_blocks_index(buf, len);
     TbBool result = (len > 0);
     if (result)
     {
@@ -1101,6 +1102,7 @@ TbBool load_campaign(const char *cmpgn_fname,struct GameCampaign *campgn,unsigne
           WARNMSG("Parsing campaign file \"%s\" map blocks failed.",cmpgn_fname);
     }
     //Freeing and exiting
+    free_conf_blocks_index(buf);
     LbMemoryFree(buf);
     if ((flags & CnfLd_ListOnly) == 0)
     {
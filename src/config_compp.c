@@ -1105,6 +1105,7 @@ TbBool load_computer_player_config(unsigned short flags)
       return false;
     // Loading file data
     len = LbFileLoadAt(fname, buf);
+    create_conf_blocks_index(buf, len);
     if (len>0)
     {
         parse_computer_player_common_blocks(buf, len, textname, flags);
@@ -1114,6 +1115,7 @@ TbBool load_computer_player_config(unsigned short flags)
         parse_computer_player_computer_blocks(buf, len, textname, flags);
     }
     //Freeing and exiting
+    free_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return true;
 }
@@ -1634,6 +1634,7 @@ TbBool load_creaturetypes_config_file(const char *textname, const char *fname, u
         return false;
     // Loading file data
     len = LbFileLoadAt(fname, buf);
+    create_conf_blocks_index(buf, len);
     TbBool result = (len > 0);
     // Parse blocks of the config file
     if (result)
@@ -1685,6 +1686,7 @@ TbBool load_creaturetypes_config_file(const char *textname, const char *fname, u
           WARNMSG("Parsing %s file \"%s\" attackpref blocks failed.",textname,fname);
     }
     //Freeing and exiting
+    free_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return result;
 }
@@ -2456,6 +2456,7 @@ TbBool load_creaturemodel_config_file(long crtr_model,const char *textname,const
         return false;
     // Loading file data
     len = LbFileLoadAt(fname, buf);
+    create_conf_blocks_index(buf, len);
     TbBool result = (len > 0);
     if ((flags & CnfLd_AcceptPartial) == 0)
     {
@@ -2536,6 +2537,7 @@ TbBool load_creaturemodel_config_file(long crtr_model,const char *textname,const
             WARNMSG("Parsing %s file \"%s\" sounds blocks failed.",textname,fname);
     }
     // Freeing and exiting
+    free_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return result;
 }
@@ -214,6 +214,7 @@ TbBool load_creaturestates_config_file(const char *textname, const char *fname,
         return false;
     // Loading file data
     len = LbFileLoadAt(fname, buf);
+    create_conf_blocks_index(buf, len);
     TbBool result = (len > 0);
     // Parse blocks of the config file
     if (result)
@@ -233,6 +234,7 @@ TbBool load_creaturestates_config_file(const char *textname, const char *fname,
           WARNMSG("Parsing %s file \"%s\" state blocks failed.",textname,fname);
     }
     //Freeing and exiting
+    free_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return result;
 }
@@ -384,6 +384,7 @@ TbBool load_effects_config_file(const char *textname, const char *fname, unsigne
         return false;
     // Loading file data
     len = LbFileLoadAt(fname, buf);
+    create_conf_blocks_index(buf, len);
     TbBool result = (len > 0);
     // Parse blocks of the config file
     if (result)
@@ -403,6 +404,7 @@ TbBool load_effects_config_file(const char *textname, const char *fname, unsigne
             WARNMSG("Parsing %s file \"%s\" effect blocks failed.",textname,fname);
     }
     //Freeing and exiting
+    free_conf_blocks_index(buf);
     LbMemoryFree(buf);
     SYNCDBG(19,"Done");
     return result;
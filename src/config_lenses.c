@@ -26,6 +26,7 @@
 #include "bflib_dernc.h"
 
 #include "config.h"
+#include "config_cache.h"
 #include "thing_doors.h"
 
 #include "keeperfx.hpp"
@@ -276,6 +277,7 @@ TbBool parse_lenses_data_blocks(char *buf, long len, const char *config_textname
           if (get_conf_parameter_single(buf, &pos, len, word_buf, sizeof(word_buf)) > 0)
           {
               char* fname = prepare_file_path(FGrp_StdData, word_buf);
+              config_cache_add_input(fname);
               if ( LbFileLoadAt(fname, lenscfg->palette) == PALETTE_SIZE)
               {
                 n++;
@@ -322,6 +324,7 @@ TbBool load_lenses_config_file(const char *textname, const char *fname, unsigned
         return false;
     // Loading file data
     len = LbFileLoadAt(fname, buf);
+    create_conf_blocks_index(buf, len);
     TbBool result = (len > 0);
     // Parse blocks of the config file
     if (result)
@@ -341,6 +344,7 @@ TbBool load_lenses_config_file(const char *textname, const char *fname, unsigned
             WARNMSG("Parsing Lenses file \"%s\" data blocks failed.",fname);
     }
     //Freeing and exiting
+    free_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return result;
 }
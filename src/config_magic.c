@@ -2259,6 +2259,7 @@ TbBool load_magic_config_file(const char *textname, const char *fname, unsigned
         return false;
     // Loading file data
     len = LbFileLoadAt(fname, buf);
+    create_conf_blocks_index(buf, len);
     TbBool result = (len > 0);
     // Parse blocks of the config file
     if (result)
@@ -2302,6 +2303,7 @@ TbBool load_magic_config_file(const char *textname, const char *fname, unsigned
           WARNMSG("Parsing %s file \"%s\" special blocks failed.",textname,fname);
     }
     //Freeing and exiting
+    free_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return result;
 }
@@ -415,6 +415,7 @@ extern const char keeper_magic_file[];
 extern struct NamedCommand spell_desc[];
 extern struct NamedCommand shot_desc[];
 extern struct NamedCommand power_desc[];
+extern struct NamedCommand special_desc[];
 extern struct SpellData spell_data[];
 extern struct SpellConfig spell_config[];
 /******************************************************************************/
@@ -2206,6 +2206,7 @@ TbBool load_rules_config_file(const char *textname, const char *fname, unsigned
         return false;
     // Loading file data
     len = LbFileLoadAt(fname, buf);
+    create_conf_blocks_index(buf, len);
     TbBool result = (len > 0);
     // Parse blocks of the config file
     if (result)
@@ -2281,6 +2282,7 @@ TbBool load_rules_config_file(const char *textname, const char *fname, unsigned
             WARNMSG("Parsing %s file \"%s\" sacrifices blocks failed.",textname,fname);
     }
     //Freeing and exiting
+    free_conf_blocks_index(buf);
     LbMemoryFree(buf);
     return result;
 }
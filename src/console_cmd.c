@@ -66,6 +66,8 @@
 #include "thing_physics.h"
 #include "version.h"
 #include "frontmenu_ingame_map.h"
+#include "game_profiler.h"
+#include "net_desync.h"
 #include "post_inc.h"
 
 #ifdef __cplusplus
@@ -381,6 +383,28 @@ TbBool cmd_exec(PlayerNumber plyr_idx, char *msg)
         }
         return true;
     }
+    else if (strcasecmp(parstr, "profiler") == 0)
+    {
+        if (debug_display_profiler) {
+            debug_display_profiler = 0;
+        } else {
+            debug_display_profiler = 1;
+            if (debug_display_frametime == 0) {
+                debug_display_frametime = 1;
+            }
+        }
+        return true;
+    }
+    else if (strcasecmp(parstr, "profiler.csv") == 0)
+    {
+        const char* fname = (pr2str != NULL) ? pr2str : "profiler.csv";
+        if (profiler_csv_toggle(fname)) {
+            targeted_message_add(plyr_idx, plyr_idx, GUI_MESSAGES_DELAY, "Writing turn times to %s", fname);
+        } else {
+            targeted_message_add(plyr_idx, plyr_idx, GUI_MESSAGES_DELAY, "Turn times not written");
+        }
+        return true;
+    }
     else if (strcasecmp(parstr, "quit") == 0)
     {
         quit_game = 1;
@@ -1387,6 +1411,7 @@ TbBool cmd_exec(PlayerNumber plyr_idx, char *msg)
                 else
                 {
                     slb->health = atoi(pr2str);
+                    desync_tree_mark_slab(slb);
                     return true;
                 }
             }
@@ -51,6 +51,7 @@
 #include "player_instances.h"
 
 #include "keeperfx.hpp"
+#include "net_desync.h"
 #include "post_inc.h"
 
 #ifdef __cplusplus
@@ -559,6 +560,7 @@ long instf_dig(struct Thing *creatng, long *param)
     {
         if (!slab_kind_is_indestructible(slb->kind))
             slb->health -= dig_damage;
+        desync_tree_mark_slab(slb);
         struct ShotConfigStats* shotst = get_shot_model_stats(ShM_Dig);
         thing_play_sample(creatng, shotst->dig.sndsample_idx + UNSYNC_RANDOM(shotst->dig.sndsample_range), NORMAL_PITCH, 0, 3, 0, 2, FULL_LOUDNESS);
         create_effect(&creatng->mappos, shotst->dig.effect_model, creatng->owner);
@@ -652,6 +654,7 @@ long instf_destroy(struct Thing *creatng, long *param)
     if (slb->health > 1)
     {
         slb->health--;
+        desync_tree_mark_slab(slb);
         if ((player->view_type == PVT_CreatureContrl) || (player->view_type == PVT_CreaturePasngr))
         {
             volume = FULL_LOUDNESS;
@@ -691,6 +694,7 @@ long instf_attack_room_slab(struct Thing *creatng, long *param)
     {
         //TODO CONFIG damage made to room slabs is constant - doesn't look good
         slb->health -= 2;
+        desync_tree_mark_slab(slb);
         thing_play_sample(creatng, 128 + UNSYNC_RANDOM(3), NORMAL_PITCH, 0, 3, 0, 2, FULL_LOUDNESS);
         return 1;
     }
@@ -730,6 +734,7 @@ long instf_damage_wall(struct Thing *creatng, long *param)
     {
         create_effect(&pos, TngEff_RockChips, creatng->owner);
         slb->health -= 2;
+        desync_tree_mark_slab(slb);
     } else
     {
         MapSlabCoord slb_x = subtile_slab(stl_x);
@@ -1021,6 +1026,7 @@ long instf_tunnel(struct Thing *creatng, long *param)
     thing_play_sample(creatng, 69+UNSYNC_RANDOM(3), NORMAL_PITCH, 0, 3, 0, 2, FULL_LOUDNESS);
         if (slb->health > 1) {
         slb->health--;
+        desync_tree_mark_slab(slb);
         } else {
         dig_out_block(stl_x, stl_y, creatng->owner);
         }
@@ -21,6 +21,7 @@
 #include "globals.h"
 
 #include "bflib_math.h"
+#include "bflib_memory.h"
 #include "bflib_planar.h"
 #include "creature_states.h"
 #include "thing_list.h"
@@ -39,6 +40,97 @@
 const int CREATURE_EXPLORE_DISTANCE = 7;
 const int CREATURE_EXPLORE_DISTANCE_POSSESSED = 10;
 
+/** Amount of line of sight results remembered within a game turn; needs to be power of 2. */
+#define LOS_MEMO_ENTRIES 4096
+
+enum LineOfSightMemoModes {
+    LoSMM_None = 0,
+    LoSMM_Plain,
+    LoSMM_IgnoringDoor,
+    LoSMM_LavaIgnoringDoor,
+    LoSMM_LavaIgnoringOwnDoor,
+};
+
+struct LineOfSightMemoEntry {
+    /** Stamp of memo contents for which the entry was stored. */
+    unsigned long stamp;
+    struct Coord3d frpos;
+    struct Coord3d topos;
+    /** Door index or player index, depending on mode. */
+    long param;
+    unsigned char mode;
+    TbBool result;
+};
+
+struct LineOfSightMemo {
+    unsigned long stamp;
+    GameTurn turn;
+    unsigned long map_generation;
+    struct LineOfSightMemoEntry entries[LOS_MEMO_ENTRIES];
+};
+
+static struct LineOfSightMemo los_memo;
+/******************************************************************************/
+/**
+ * Drops remembered line of sight results.
+ * Needs to be called when anything besides map blocks, which affects line of sight, is changed.
+ */
+void line_of_sight_memo_clear(void)
+{
+    los_memo.stamp++;
+}
+
+static struct LineOfSightMemoEntry *line_of_sight_memo_entry(unsigned char mode, long param,
+    const struct Coord3d *frpos, const struct Coord3d *topos)
+{
+    // Results stay valid until end of the turn, unless the map changes
+    if ((los_memo.turn != game.play_gameturn) || (los_memo.map_generation != get_map_solidity_generation()))
+    {
+        los_memo.turn = game.play_gameturn;
+        los_memo.map_generation = get_map_solidity_generation();
+        los_memo.stamp++;
+    }
+    if (los_memo.stamp == 0)
+    {
+        LbMemorySet(los_memo.entries, 0, sizeof(los_memo.entries));
+        los_memo.stamp = 1;
+    }
+    unsigned long hash = (frpos->x.val * 73856093UL) ^ (frpos->y.val * 19349663UL) ^ (frpos->z.val * 83492791UL);
+    hash ^= (topos->x.val * 2654435761UL) ^ (topos->y.val * 40503UL) ^ (topos->z.val * 2246822519UL);
+    hash ^= (param * 97UL) ^ mode;
+    return &los_memo.entries[(hash ^ (hash >> 15)) & (LOS_MEMO_ENTRIES-1)];
+}
+
+static TbBool line_of_sight_memo_get(unsigned char mode, long param,
+    const struct Coord3d *frpos, const struct Coord3d *topos, TbBool *result)
+{
+    struct LineOfSightMemoEntry* entry = line_of_sight_memo_entry(mode, param, frpos, topos);
+    if ((entry->stamp != los_memo.stamp) || (entry->mode != mode) || (entry->param != param))
+        return false;
+    if ((entry->frpos.x.val != frpos->x.val) || (entry->frpos.y.val != frpos->y.val) || (entry->frpos.z.val != frpos->z.val))
+        return false;
+    if ((entry->topos.x.val != topos->x.val) || (entry->topos.y.val != topos->y.val) || (entry->topos.z.val != topos->z.val))
+        return false;
+    *result = entry->result;
+    return true;
+}
+
+static TbBool line_of_sight_memo_put(unsigned char mode, long param,
+    const struct Coord3d *frpos, const struct Coord3d *topos, TbBool result)
+{
+    struct LineOfSightMemoEntry* entry = line_of_sight_memo_entry(mode, param, frpos, topos);
+    entry->stamp = los_memo.stamp;
+    entry->mode = mode;
+    entry->param = param;
+    entry->frpos.x.val = frpos->x.val;
+    entry->frpos.y.val = frpos->y.val;
+    entry->frpos.z.val = frpos->z.val;
+    entry->topos.x.val = topos->x.val;
+    entry->topos.y.val = topos->y.val;
+    entry->topos.z.val = topos->z.val;
+    entry->result = result;
+    return result;
+}
 /******************************************************************************/
 TbBool sibling_line_of_sight_ignoring_door(const struct Coord3d *prevpos,
     const struct Coord3d *nextpos, const struct Thing *doortng)
@@ -142,7 +234,7 @@ TbBool sibling_line_of_sight_ignoring_door(const struct Coord3d *prevpos,
 }
 
 
-TbBool line_of_sight_3d_ignoring_specific_door(const struct Coord3d *frpos,
+static TbBool walk_line_of_sight_3d_ignoring_specific_door(const struct Coord3d *frpos,
     const struct Coord3d *topos, const struct Thing *doortng)
 {
     MapCoordDelta dx = topos->x.val - (MapCoordDelta)frpos->x.val;
@@ -228,6 +320,16 @@ TbBool line_of_sight_3d_ignoring_specific_door(const struct Coord3d *frpos,
     return true;
 }
 
+TbBool line_of_sight_3d_ignoring_specific_door(const struct Coord3d *frpos,
+    const struct Coord3d *topos, const struct Thing *doortng)
+{
+    TbBool result;
+    if (line_of_sight_memo_get(LoSMM_IgnoringDoor, doortng->index, frpos, topos, &result))
+        return result;
+    result = walk_line_of_sight_3d_ignoring_specific_door(frpos, topos, doortng);
+    return line_of_sight_memo_put(LoSMM_IgnoringDoor, doortng->index, frpos, topos, result);
+}
+
 TbBool sibling_line_of_sight_3d_including_lava_check_ignoring_door(const struct Coord3d *prevpos,
     const struct Coord3d *nextpos, const struct Thing *doortng)
 {
@@ -321,7 +423,7 @@ TbBool sibling_line_of_sight_3d_including_lava_check_ignoring_door(const struct
     return true;
 }
 
-TbBool jonty_line_of_sight_3d_including_lava_check_ignoring_specific_door(const struct Coord3d *frpos,
+static TbBool walk_line_of_sight_3d_including_lava_check_ignoring_specific_door(const struct Coord3d *frpos,
     const struct Coord3d *topos, const struct Thing *doortng)
 {
     MapCoordDelta dx = topos->x.val - (MapCoordDelta)frpos->x.val;
@@ -407,6 +509,16 @@ TbBool jonty_line_of_sight_3d_including_lava_check_ignoring_specific_door(const
     return true;
 }
 
+TbBool jonty_line_of_sight_3d_including_lava_check_ignoring_specific_door(const struct Coord3d *frpos,
+    const struct Coord3d *topos, const struct Thing *doortng)
+{
+    TbBool result;
+    if (line_of_sight_memo_get(LoSMM_LavaIgnoringDoor, doortng->index, frpos, topos, &result))
+        return result;
+    result = walk_line_of_sight_3d_including_lava_check_ignoring_specific_door(frpos, topos, doortng);
+    return line_of_sight_memo_put(LoSMM_LavaIgnoringDoor, doortng->index, frpos, topos, result);
+}
+
 TbBool sibling_line_of_sight_3d_including_lava_check_ignoring_own_door(const struct Coord3d *prevpos,
     const struct Coord3d *nextpos, PlayerNumber plyr_idx)
 {
@@ -496,7 +608,7 @@ TbBool sibling_line_of_sight_3d_including_lava_check_ignoring_own_door(const str
     return true;
 }
 
-TbBool jonty_line_of_sight_3d_including_lava_check_ignoring_own_door(const struct Coord3d *frpos,
+static TbBool walk_line_of_sight_3d_including_lava_check_ignoring_own_door(const struct Coord3d *frpos,
     const struct Coord3d *topos, PlayerNumber plyr_idx)
 {
     MapCoordDelta dx = topos->x.val - (MapCoordDelta)frpos->x.val;
@@ -593,6 +705,16 @@ TbBool jonty_line_of_sight_3d_including_lava_check_ignoring_own_door(const struc
     return true;
 }
 
+TbBool jonty_line_of_sight_3d_including_lava_check_ignoring_own_door(const struct Coord3d *frpos,
+    const struct Coord3d *topos, PlayerNumber plyr_idx)
+{
+    TbBool result;
+    if (line_of_sight_memo_get(LoSMM_LavaIgnoringOwnDoor, plyr_idx, frpos, topos, &result))
+        return result;
+    result = walk_line_of_sight_3d_including_lava_check_ignoring_own_door(frpos, topos, plyr_idx);
+    return line_of_sight_memo_put(LoSMM_LavaIgnoringOwnDoor, plyr_idx, frpos, topos, result);
+}
+
 TbBool creature_can_see_thing(struct Thing *creatng, struct Thing *thing)
 {
     struct Coord3d thing_pos;
@@ -802,7 +924,7 @@ TbBool line_of_sight_2d(const struct Coord3d *frpos, const struct Coord3d *topos
     return false;
 }
 
-TbBool line_of_sight_3d(const struct Coord3d *frpos, const struct Coord3d *topos)
+static TbBool walk_line_of_sight_3d(const struct Coord3d *frpos, const struct Coord3d *topos)
 {
     MapCoordDelta dx = topos->x.val - (MapCoordDelta)frpos->x.val;
     MapCoordDelta dy = topos->y.val - (MapCoordDelta)frpos->y.val;
@@ -912,6 +1034,15 @@ TbBool line_of_sight_3d(const struct Coord3d *frpos, const struct Coord3d *topos
     return true;
 }
 
+TbBool line_of_sight_3d(const struct Coord3d *frpos, const struct Coord3d *topos)
+{
+    TbBool result;
+    if (line_of_sight_memo_get(LoSMM_Plain, 0, frpos, topos, &result))
+        return result;
+    result = walk_line_of_sight_3d(frpos, topos);
+    return line_of_sight_memo_put(LoSMM_Plain, 0, frpos, topos, result);
+}
+
 TbBool nowibble_line_of_sight_3d(const struct Coord3d *frpos, const struct Coord3d *topos)
 {
     MapCoordDelta dx,dy,dz;
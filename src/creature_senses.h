@@ -39,6 +39,7 @@ TbBool sibling_line_of_sight_ignoring_door(const struct Coord3d *prevpos,
     const struct Coord3d *nextpos, const struct Thing *doortng);
 #define sibling_line_of_sight(prevpos, nextpos) sibling_line_of_sight_ignoring_door(prevpos, nextpos, INVALID_THING)
 
+void line_of_sight_memo_clear(void);
 TbBool line_of_sight_3d(const struct Coord3d *frpos, const struct Coord3d *topos);
 TbBool line_of_sight_2d(const struct Coord3d *frpos, const struct Coord3d *topos);
 TbBool line_of_sight_3d_ignoring_specific_door(const struct Coord3d *frpos, const struct Coord3d *topos, const struct Thing *doortng);
@@ -36,6 +36,7 @@
 #include "thing_physics.h"
 #include "thing_objects.h"
 #include "thing_effects.h"
+#include "thing_grid.h"
 #include "thing_navigate.h"
 #include "thing_corpses.h"
 #include "room_data.h"
@@ -2404,6 +2405,7 @@ void creature_drag_object(struct Thing *creatng, struct Thing *dragtng)
     dragtng->alloc_flags |= TAlF_IsDragged;
     dragtng->state_flags |= TF1_IsDragged1;
     dragtng->owner = game.neutral_player_num;
+    thing_grid_update_owner(dragtng);
     if (dragtng->light_id != 0) {
       light_turn_light_off(dragtng->light_id);
     }
@@ -4382,6 +4384,7 @@ short state_cleanup_dragging_body(struct Thing *creatng)
         {
             creature_drop_dragged_object(creatng, dragtng);
             dragtng->owner = game.neutral_player_num;
+            thing_grid_update_owner(dragtng);
         }
     }
     return 1;
@@ -4396,6 +4399,7 @@ short state_cleanup_dragging_object(struct Thing *creatng)
         struct Thing* objctng = thing_get(cctrl->dragtng_idx);
         creature_drop_dragged_object(creatng, objctng);
         objctng->owner = game.neutral_player_num;
+        thing_grid_update_owner(objctng);
     }
     return 1;
 }
@@ -27,7 +27,9 @@
 #include "frontend.h"
 #include "bflib_dernc.h"
 #include "sprites.h"
+#include "bflib_jobs.h"
 
+#include <stddef.h>
 #include <spng.h>
 #include <json.h>
 #include <json-dom.h>
@@ -43,6 +45,17 @@
 // Each part of RGB tuple of palette file is 1-63 actually
 #define MAX_COLOR_VALUE 64
 
+/** Size of palette lookup table, indexed by RGB components reduced to palette precision. */
+#define PALETTE_LUT_SIZE (MAX_COLOR_VALUE * MAX_COLOR_VALUE * MAX_COLOR_VALUE)
+/** Size of queued png files, above which they are decoded before reading more of them. */
+#define SPRITE_DECODE_QUEUE_SIZE (64 * 1024 * 1024)
+/** Max size of a png file; decoded image is limited to the same size. */
+#define SPRITE_PNG_SIZE_MAX (1024 * 1024 * 2)
+
+/** Version of converted sprites cache files; increase when format of sprite data changes. */
+#define SPRITE_CACHE_VERSION 1
+#define SPRITE_CACHE_MAGIC 0x43525053 //"SPRC"
+
 static short next_free_sprite = 0;
 static short next_free_icon = 0;
 
@@ -90,6 +103,91 @@ struct PaletteNode
     int size;
 };
 
+#pragma pack(1)
+
+/**
+ * Header of a file with sprites converted from one json file of a zip archive.
+ */
+struct SpriteCacheHead
+{
+    unsigned long magic;
+    unsigned long version;
+    TbBigChecksum palette_key;
+    char path[DISKPATH_SIZE];
+    char json_name[16];
+    unsigned long entries_count;
+};
+
+/**
+ * Converted png file; identified by its name, crc and position of the sprite within image.
+ * Entries are followed by sprite data.
+ */
+struct SpriteCacheEntry
+{
+    TbBigChecksum name_key;
+    unsigned long crc;
+    unsigned long raw_size;
+    unsigned short x, y;
+    unsigned short width, height;
+    unsigned long data_size;
+};
+
+#pragma pack()
+
+struct SpriteCacheItem
+{
+    struct SpriteCacheEntry entry;
+    const unsigned char *data;
+};
+
+/**
+ * Cache of converted sprites from the zip archive being processed.
+ * Loaded entries are kept in file buffer; entries used in this run are written back if anything changed.
+ */
+struct SpriteCache
+{
+    char fname[DISKPATH_SIZE];
+    struct SpriteCacheHead head;
+    unsigned char *buf;
+    struct SpriteCacheItem *loaded;
+    unsigned long loaded_count;
+    struct SpriteCacheItem *used;
+    unsigned long used_count;
+    unsigned long used_size;
+    TbBool changed;
+};
+
+/**
+ * Png file which is read from archive, and waits to be decoded and converted into sprite data.
+ * Everything except the pixels is set up while reading, so it can be done on any thread.
+ */
+struct SpriteDecodeJob
+{
+    unsigned char *png;
+    unsigned long png_size;
+    char *subpath;
+    struct TbHugeSprite sprite;
+    int x, y, w, h;
+    struct SpriteCacheEntry cache_entry;
+    TbBool failed;
+};
+
+struct SpriteDecodeQueue
+{
+    struct SpriteDecodeJob *jobs;
+    long count;
+    long allocated;
+    unsigned long png_size;
+    const char *path;
+};
+
+static struct SpriteCache sprite_cache;
+static struct SpriteDecodeQueue decode_queue;
+static TbBigChecksum palette_key;
+static TbBigChecksum pal_lut_key;
+static TbBool pal_lut_valid = false;
+static unsigned char pal_lut[PALETTE_LUT_SIZE];
+
 static struct PaletteRecord pal_records[PALETTE_COLORS]; // for each color of a palette
 static struct PaletteNode pal_tree[MAX_COLOR_VALUE]; // For each component of a palette
 static struct NamedCommand added_sprites[KEEPERSPRITE_ADD_NUM];
@@ -104,7 +202,7 @@ unsigned char *big_scratch = big_scratch_data;
 
 static void init_pal_conversion();
 
-static void compress_raw(struct TbHugeSprite *sprite, unsigned char *src_buf, int x, int y, int w, int h);
+static unsigned long compress_raw(struct TbHugeSprite *sprite, unsigned char *src_buf, int x, int y, int w, int h);
 
 static TbBool add_custom_sprite(const char *path);
 
@@ -346,6 +444,202 @@ void init_custom_sprites(LevelNumber lvnum)
     }
 }
 
+static TbBigChecksum checksum_add(TbBigChecksum sum, const void *data, size_t size)
+{
+    const unsigned char *ptr = data;
+    for (size_t i = 0; i < size; i++)
+        sum = (sum << 5) + sum + ptr[i];
+    return sum;
+}
+
+/**
+ * Loads converted sprites of given json file in zip archive, if they were converted before.
+ */
+static void sprite_cache_open(const char *path, const char *json_name)
+{
+    memset(&sprite_cache, 0, sizeof(sprite_cache));
+    TbBigChecksum file_key = checksum_add(5381, path, strlen(path));
+    file_key = checksum_add(file_key, json_name, strlen(json_name));
+    snprintf(sprite_cache.fname, sizeof(sprite_cache.fname), "%s",
+             prepare_file_fmtpath(FGrp_Save, "sprcache/%08lx.dat", (unsigned long)file_key));
+    sprite_cache.head.magic = SPRITE_CACHE_MAGIC;
+    sprite_cache.head.version = SPRITE_CACHE_VERSION;
+    sprite_cache.head.palette_key = palette_key;
+    snprintf(sprite_cache.head.path, sizeof(sprite_cache.head.path), "%s", path);
+    snprintf(sprite_cache.head.json_name, sizeof(sprite_cache.head.json_name), "%s", json_name);
+
+    long len = LbFileLength(sprite_cache.fname);
+    if (len < (long) sizeof(struct SpriteCacheHead))
+        return;
+    sprite_cache.buf = malloc(len);
+    if (sprite_cache.buf == NULL)
+        return;
+    const struct SpriteCacheHead *head = (const struct SpriteCacheHead *) sprite_cache.buf;
+    if ((LbFileLoadAt(sprite_cache.fname, sprite_cache.buf) != len)
+        || (memcmp(head, &sprite_cache.head, offsetof(struct SpriteCacheHead, entries_count)) != 0))
+    {
+        SYNCDBG(7, "Converted sprites of %s/%s are outdated", path, json_name);
+        return;
+    }
+    sprite_cache.loaded = malloc(sizeof(struct SpriteCacheItem) * (head->entries_count + 1));
+    if (sprite_cache.loaded == NULL)
+        return;
+    const unsigned char *pos = sprite_cache.buf + sizeof(struct SpriteCacheHead);
+    const unsigned char *end = sprite_cache.buf + len;
+    for (unsigned long i = 0; i < head->entries_count; i++)
+    {
+        if (pos + sizeof(struct SpriteCacheEntry) > end)
+            break;
+        struct SpriteCacheItem *item = &sprite_cache.loaded[sprite_cache.loaded_count];
+        memcpy(&item->entry, pos, sizeof(struct SpriteCacheEntry));
+        pos += sizeof(struct SpriteCacheEntry);
+        if (pos + item->entry.data_size > end)
+            break;
+        item->data = pos;
+        pos += item->entry.data_size;
+        sprite_cache.loaded_count++;
+    }
+    if (sprite_cache.loaded_count != head->entries_count)
+        WARNLOG("Converted sprites cache \"%s\" is damaged", sprite_cache.fname);
+}
+
+static void sprite_cache_use(const struct SpriteCacheEntry *entry, const unsigned char *data)
+{
+    struct SpriteCacheItem *used = realloc(sprite_cache.used, sizeof(struct SpriteCacheItem) * (sprite_cache.used_count + 1));
+    if (used == NULL)
+        return;
+    sprite_cache.used = used;
+    sprite_cache.used[sprite_cache.used_count].entry = *entry;
+    sprite_cache.used[sprite_cache.used_count].data = data;
+    sprite_cache.used_count++;
+    sprite_cache.used_size += sizeof(struct SpriteCacheEntry) + entry->data_size;
+}
+
+/**
+ * Searches for converted sprite of the current file in zip archive.
+ * @param entry Filled with key of the file, and with sprite dimensions if found.
+ * @return Converted sprite data, or NULL if the file has to be converted.
+ */
+static const unsigned char *sprite_cache_find(unzFile zip, unsigned long x, unsigned long y, struct SpriteCacheEntry *entry)
+{
+    unz_file_info64 zip_info = {0};
+    char fname[256];
+    memset(entry, 0, sizeof(struct SpriteCacheEntry));
+    if (UNZ_OK != unzGetCurrentFileInfo64(zip, &zip_info, fname, sizeof(fname) - 1, NULL, 0, NULL, 0))
+        return NULL;
+    fname[sizeof(fname) - 1] = 0;
+    entry->name_key = checksum_add(5381, fname, strlen(fname));
+    entry->crc = zip_info.crc;
+    entry->raw_size = zip_info.uncompressed_size;
+    entry->x = x;
+    entry->y = y;
+    for (unsigned long i = 0; i < sprite_cache.loaded_count; i++)
+    {
+        const struct SpriteCacheItem *item = &sprite_cache.loaded[i];
+        if ((item->entry.name_key != entry->name_key) || (item->entry.crc != entry->crc)
+            || (item->entry.raw_size != entry->raw_size) || (item->entry.x != x) || (item->entry.y != y))
+            continue;
+        // Data can't be bigger than allocated for sprite of such size
+        if (item->entry.data_size > (item->entry.width + 2) * (item->entry.height + 3))
+            break;
+        *entry = item->entry;
+        sprite_cache_use(entry, item->data);
+        return item->data;
+    }
+    return NULL;
+}
+
+/**
+ * Stores newly converted sprite in the cache.
+ */
+static void sprite_cache_add(const struct SpriteCacheEntry *entry, const unsigned char *data)
+{
+    if (entry->raw_size == 0) // Key of the file is unknown
+        return;
+    sprite_cache_use(entry, data);
+    sprite_cache.changed = true;
+}
+
+/**
+ * Writes sprites used from given json file, if they differ from these loaded; frees the cache.
+ * Needs to be called before any sprites data is freed.
+ */
+static void sprite_cache_close(void)
+{
+    if ((sprite_cache.changed || (sprite_cache.used_count != sprite_cache.loaded_count)) && (sprite_cache.fname[0] != 0))
+    {
+        sprite_cache.head.entries_count = sprite_cache.used_count;
+        TbFileHandle fh = LbFileOpen(sprite_cache.fname, Lb_FILE_MODE_NEW);
+        TbBool result = (fh != -1);
+        if (result)
+            result = (LbFileWrite(fh, &sprite_cache.head, sizeof(sprite_cache.head)) == sizeof(sprite_cache.head));
+        for (unsigned long i = 0; result && (i < sprite_cache.used_count); i++)
+        {
+            const struct SpriteCacheItem *item = &sprite_cache.used[i];
+            result = (LbFileWrite(fh, &item->entry, sizeof(item->entry)) == sizeof(item->entry))
+                && (LbFileWrite(fh, item->data, item->entry.data_size) == item->entry.data_size);
+        }
+        if (fh != -1)
+            LbFileClose(fh);
+        if (!result)
+        {
+            WARNLOG("Unable to write converted sprites cache \"%s\"", sprite_cache.fname);
+            LbFileDelete(sprite_cache.fname);
+        }
+        else
+        {
+            SYNCDBG(7, "Stored %lu converted sprites of %s/%s", sprite_cache.used_count,
+                    sprite_cache.head.path, sprite_cache.head.json_name);
+        }
+    }
+    free(sprite_cache.used);
+    free(sprite_cache.loaded);
+    free(sprite_cache.buf);
+    memset(&sprite_cache, 0, sizeof(sprite_cache));
+}
+
+/**
+ * Finds palette color nearest to given one, from colors with similar green component.
+ * @param r,g,b Color components, reduced to palette precision.
+ */
+static unsigned char find_nearest_pal_color(int r, int g, int b)
+{
+    const struct PaletteNode *node = &pal_tree[g];
+    unsigned char max_val = 255;
+    uint32_t max_dst = 3 * 64 * 64;
+    for (struct PaletteRecord *rec = node->rec; rec != node->rec + node->size; rec++)
+    {
+        int8_t dr = (rec->color & 0x00000FF) - r;
+        int8_t dg = ((rec->color & 0xFF00) >> 8) - g;
+        int8_t db = ((rec->color & 0xFF0000) >> 16) - b;
+        if (dr * dr + dg * dg + db * db < max_dst)
+        {
+            max_dst = dr * dr + dg * dg + db * db;
+            max_val = rec->color_idx;
+        }
+    }
+    return max_val;
+}
+
+/**
+ * Fills part of palette lookup table; items are values of blue component.
+ */
+static void fill_pal_lut_job(void *data, long first, long last)
+{
+    for (long b = first; b < last; b++)
+    {
+        unsigned char *lut = &pal_lut[b * MAX_COLOR_VALUE * MAX_COLOR_VALUE];
+        for (int g = 0; g < MAX_COLOR_VALUE; g++)
+        {
+            for (int r = 0; r < MAX_COLOR_VALUE; r++)
+            {
+                *lut = find_nearest_pal_color(r, g, b);
+                lut++;
+            }
+        }
+    }
+}
+
 /**
  * Setup data for rgb -> indexed conversion
  */
@@ -372,6 +666,8 @@ static void init_pal_conversion()
         ERRORLOG("Can't load palette file.");
     }
 
+    palette_key = checksum_add(5381, base_pal, sizeof(base_pal));
+
     unsigned char *pal = base_pal;
     for (int i = 0; i < PALETTE_COLORS; i++)
     {
@@ -417,6 +713,13 @@ static void init_pal_conversion()
         }
     }
 #undef NEAREST_DEPTH
+    // 5. Filling lookup table for each color
+    if (!pal_lut_valid || (pal_lut_key != palette_key))
+    {
+        LbJobsParallelFor(fill_pal_lut_job, NULL, MAX_COLOR_VALUE, 1);
+        pal_lut_key = palette_key;
+        pal_lut_valid = true;
+    }
 }
 
 /**
@@ -672,73 +975,203 @@ static int read_png_info(unzFile zip, const char *path, struct SpriteContext *co
     return 0;
 }
 
-static int read_png_icon(unzFile zip, const char *path, const char *subpath, int *icon_ptr)
+/**
+ * Reads current png file of zip archive into memory, and gets image dimensions from its header.
+ * @param job Decode job with cache key already filled; png data and sprite dimensions are set.
+ * @return 1 if success
+ */
+static int read_png_header(unzFile zip, const char *path, const char *subpath, struct SpriteDecodeJob *job)
 {
-    struct TbHugeSprite sprite = {0};
-    size_t out_size;
-
-    spng_ctx *ctx = NULL;
-    ctx = spng_ctx_new(0);
-    spng_set_crc_action(ctx, SPNG_CRC_USE, SPNG_CRC_USE);
-
-    size_t limit = 1024 * 1024 * 2;
-    spng_set_chunk_limits(ctx, limit, limit);
-
-    spng_set_png_stream(ctx, zip_read_fn, (void *) zip);
-    struct spng_ihdr ihdr;
-    int r = spng_get_ihdr(ctx, &ihdr);
-
-    if (r)
+    static const unsigned char png_signature[8] = {0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n'};
+    unsigned long size = job->cache_entry.raw_size;
+    if ((size < 33) || (size > SPRITE_PNG_SIZE_MAX))
     {
-        ERRORLOG("spng_get_ihdr() error: %s", spng_strerror(r));
-        spng_ctx_free(ctx);
+        ERRORLOG("Wrong size of %s/%s", path, subpath);
         return 0;
     }
-
-    if (ihdr.bit_depth != 8)
+    job->png = malloc(size);
+    if (job->png == NULL)
+    {
+        ERRORLOG("Can't allocate memory for %s/%s", path, subpath);
+        return 0;
+    }
+    job->png_size = size;
+    if (unzReadCurrentFile(zip, job->png, size) != size)
+    {
+        ERRORLOG("Unable to read %s/%s", path, subpath);
+        free(job->png);
+        job->png = NULL;
+        return 0;
+    }
+    const unsigned char *ihdr = job->png + sizeof(png_signature);
+    if ((memcmp(job->png, png_signature, sizeof(png_signature)) != 0) || (memcmp(ihdr + 4, "IHDR", 4) != 0))
+    {
+        ERRORLOG("Not a png file: %s/%s", path, subpath);
+        free(job->png);
+        job->png = NULL;
+        return 0;
+    }
+    if (ihdr[16] != 8) // bit depth
     {
         ERRORLOG("Wrong spec: %s/%s should be 8bit truecolor or indexed .png", path, subpath);
-        spng_ctx_free(ctx);
+        free(job->png);
+        job->png = NULL;
         return 0;
     }
-    struct spng_plte plte = {0};
-    r = spng_get_plte(ctx, &plte);
+    job->sprite.SWidth = (ihdr[8] << 24) | (ihdr[9] << 16) | (ihdr[10] << 8) | ihdr[11];
+    job->sprite.SHeight = (ihdr[12] << 24) | (ihdr[13] << 16) | (ihdr[14] << 8) | ihdr[15];
+    return 1;
+}
 
-    sprite.SWidth = ihdr.width;
-    sprite.SHeight = ihdr.height;
+/**
+ * Decodes png files of decode jobs, and converts them into sprite data.
+ */
+static void decode_png_job(void *data, long first, long last)
+{
+    struct SpriteDecodeJob *jobs = data;
+    for (long i = first; i < last; i++)
+    {
+        struct SpriteDecodeJob *job = &jobs[i];
+        size_t out_size;
+        unsigned char *dst_buf = NULL;
+        job->failed = true;
+        spng_ctx *ctx = spng_ctx_new(0);
+        if (ctx == NULL)
+            continue;
+        spng_set_crc_action(ctx, SPNG_CRC_USE, SPNG_CRC_USE);
+        spng_set_chunk_limits(ctx, SPRITE_PNG_SIZE_MAX, SPRITE_PNG_SIZE_MAX);
+        spng_set_png_buffer(ctx, job->png, job->png_size);
+        int fmt = SPNG_FMT_RGBA8; // for indexed should be SPNG_FMT_PNG
+        if ((spng_decoded_image_size(ctx, fmt, &out_size) == 0) && (out_size <= SPRITE_PNG_SIZE_MAX)
+            && (out_size == job->sprite.SWidth * job->sprite.SHeight * 4))
+        {
+            dst_buf = malloc(out_size);
+        }
+        if ((dst_buf != NULL) && (spng_decode_image(ctx, dst_buf, out_size, fmt, SPNG_DECODE_TRNS) == 0))
+        {
+            job->cache_entry.width = job->sprite.SWidth;
+            job->cache_entry.height = job->sprite.SHeight;
+            job->cache_entry.data_size = compress_raw(&job->sprite, dst_buf, job->x, job->y, job->w, job->h);
+            job->failed = false;
+        }
+        free(dst_buf);
+        spng_ctx_free(ctx);
+    }
+}
 
-    int fmt = SPNG_FMT_RGBA8; // for indexed should be SPNG_FMT_PNG
+/**
+ * Decodes all queued png files, using worker threads; then stores the results in order of reading.
+ */
+static void process_decode_queue(void)
+{
+    LbJobsParallelFor(decode_png_job, decode_queue.jobs, decode_queue.count, 1);
+    for (long i = 0; i < decode_queue.count; i++)
+    {
+        struct SpriteDecodeJob *job = &decode_queue.jobs[i];
+        if (job->failed)
+        {
+            ERRORLOG("Unable to decode %s/%s", decode_queue.path, job->subpath);
+            // Sprite is already in use, so leave it with empty lines
+            memset(job->sprite.Data, 0, job->h);
+        }
+        else
+        {
+            sprite_cache_add(&job->cache_entry, job->sprite.Data);
+        }
+        free(job->png);
+        free(job->subpath);
+    }
+    decode_queue.count = 0;
+    decode_queue.png_size = 0;
+}
 
-    spng_decoded_image_size(ctx, fmt, &out_size);
-    if (limit < out_size) // Image is too big
+static void queue_png_decode(const char *path, const char *subpath, struct SpriteDecodeJob *job)
+{
+    if (decode_queue.count >= decode_queue.allocated)
     {
-        ERRORLOG("Unable to decode %s error: %s", path, spng_strerror(r));
-        spng_ctx_free(ctx);
-        return 0;
+        long allocated = decode_queue.allocated + 256;
+        struct SpriteDecodeJob *jobs = realloc(decode_queue.jobs, sizeof(struct SpriteDecodeJob) * allocated);
+        if (jobs == NULL)
+        {
+            ERRORLOG("Can't allocate decode queue");
+            memset(job->sprite.Data, 0, job->h);
+            free(job->png);
+            return;
+        }
+        decode_queue.jobs = jobs;
+        decode_queue.allocated = allocated;
+    }
+    job->subpath = strdup(subpath);
+    decode_queue.path = path;
+    decode_queue.jobs[decode_queue.count] = *job;
+    decode_queue.count++;
+    decode_queue.png_size += job->png_size;
+    if (decode_queue.png_size > SPRITE_DECODE_QUEUE_SIZE)
+    {
+        process_decode_queue();
+    }
+}
+
+/**
+ * Fills data of a sprite, either from converted sprites cache, or by queueing png file read into the job.
+ * @param cached Sprite data found in cache, or NULL.
+ */
+static void fill_sprite_data(const char *path, const char *subpath, struct TbHugeSprite *sprite,
+                             const unsigned char *cached, struct SpriteDecodeJob *job, int x, int y, int w, int h)
+{
+    if (cached != NULL)
+    {
+        memcpy(sprite->Data, cached, job->cache_entry.data_size);
+        return;
     }
+    job->sprite = *sprite;
+    job->x = x;
+    job->y = y;
+    job->w = w;
+    job->h = h;
+    queue_png_decode(path, subpath, job);
+}
+
+static int read_png_icon(unzFile zip, const char *path, const char *subpath, int *icon_ptr)
+{
+    struct TbHugeSprite sprite = {0};
+    struct SpriteDecodeJob job = {0};
 
-    unsigned char *dst_buf = big_scratch;
-    spng_decode_image(ctx, dst_buf, out_size, fmt, SPNG_DECODE_TRNS);
+    const unsigned char *cached = sprite_cache_find(zip, 0, 0, &job.cache_entry);
+    if (cached != NULL)
+    {
+        sprite.SWidth = job.cache_entry.width;
+        sprite.SHeight = job.cache_entry.height;
+    }
+    else if (read_png_header(zip, path, subpath, &job))
+    {
+        sprite.SWidth = job.sprite.SWidth;
+        sprite.SHeight = job.sprite.SHeight;
+    }
+    else
+    {
+        return 0;
+    }
 
     if (sprite.SWidth >= 255 || sprite.SHeight >= 255)
     {
         ERRORLOG("Sprites more than 255x255 are not supported");
+        free(job.png);
         return 0;
     }
 
-    size_t sz = (sprite.SWidth + 2) * (sprite.SHeight + 3);
-    sprite.Data = malloc(sz);
-
-    compress_raw(&sprite, dst_buf, 0, 0, sprite.SWidth, sprite.SHeight);
-
-    spng_ctx_free(ctx);
-
     if (next_free_icon >= GUI_PANEL_SPRITES_NEW)
     {
         ERRORLOG("Too many custom icons allocated");
+        free(job.png);
         return 0;
     }
 
+    size_t sz = (sprite.SWidth + 2) * (sprite.SHeight + 3);
+    sprite.Data = malloc(sz);
+
+    fill_sprite_data(path, subpath, &sprite, cached, &job, 0, 0, sprite.SWidth, sprite.SHeight);
+
     gui_panel_sprites[next_free_icon + GUI_PANEL_SPRITES_COUNT].Data = sprite.Data;
     gui_panel_sprites[next_free_icon + GUI_PANEL_SPRITES_COUNT].SHeight = sprite.SHeight;
     gui_panel_sprites[next_free_icon + GUI_PANEL_SPRITES_COUNT].SWidth = sprite.SWidth;
@@ -754,56 +1187,23 @@ static int read_png_data(unzFile zip, const char *path, struct SpriteContext *co
                          int fp, VALUE *def, VALUE *itm)
 {
     struct TbHugeSprite *sprite = &context->sprite;
-    size_t out_size;
+    struct SpriteDecodeJob job = {0};
     sprite->SHeight = 0;
     sprite->SWidth = 0;
 
-    spng_ctx *ctx = NULL;
-    ctx = spng_ctx_new(0);
-    spng_set_crc_action(ctx, SPNG_CRC_USE, SPNG_CRC_USE);
-
-    size_t limit = 1024 * 1024 * 2;
-    spng_set_chunk_limits(ctx, limit, limit);
-
-    spng_set_png_stream(ctx, zip_read_fn, (void *) zip);
-    struct spng_ihdr ihdr;
-    int r = spng_get_ihdr(ctx, &ihdr);
-
-    if (r)
-    {
-        ERRORLOG("spng_get_ihdr() error: %s", spng_strerror(r));
-        spng_ctx_free(ctx);
-        return 0;
-    }
-
-    if (ihdr.bit_depth != 8)
+    const unsigned char *cached = sprite_cache_find(zip, context->x, context->y, &job.cache_entry);
+    if (cached != NULL)
     {
-        ERRORLOG("Wrong spec: %s/%s should be 8bit truecolor or indexed .png", path, subpath);
-        spng_ctx_free(ctx);
-        return 0;
+        sprite->SWidth = job.cache_entry.width;
+        sprite->SHeight = job.cache_entry.height;
     }
-    struct spng_plte plte = {0};
-    r = spng_get_plte(ctx, &plte);
-    // TODO: should we check palette?
-
-    sprite->SWidth = ihdr.width;
-    sprite->SHeight = ihdr.height;
-
-    int fmt = SPNG_FMT_RGBA8; // for indexed should be SPNG_FMT_PNG
-
-    spng_decoded_image_size(ctx, fmt, &out_size);
-    if (limit < out_size) // Image is too big
+    else if (read_png_header(zip, path, subpath, &job))
     {
-        ERRORLOG("Unable to decode %s error: %s", path, spng_strerror(r));
-        spng_ctx_free(ctx);
-        return 0;
+        sprite->SWidth = job.sprite.SWidth;
+        sprite->SHeight = job.sprite.SHeight;
     }
-
-    unsigned char *dst_buf = big_scratch;
-    if (spng_decode_image(ctx, dst_buf, out_size, fmt, SPNG_DECODE_TRNS))
+    else
     {
-        ERRORLOG("Unable to decode %s/%s", path, subpath);
-        spng_ctx_free(ctx);
         return 0;
     }
 
@@ -814,12 +1214,14 @@ static int read_png_data(unzFile zip, const char *path, struct SpriteContext *co
     if (dst_w >= 255 || dst_h >= 255)
     {
         ERRORLOG("Sprites more than 255x255 are not supported");
+        free(job.png);
         return 0;
     }
 
     if (next_free_sprite >= KEEPERSPRITE_ADD_NUM)
     {
         ERRORLOG("Too many custom sprites allocated");
+        free(job.png);
         return 0;
     }
     short sprite_idx = next_free_sprite;
@@ -831,7 +1233,7 @@ static int read_png_data(unzFile zip, const char *path, struct SpriteContext *co
     size_t sz = (dst_w + 2) * (dst_h + 3);
     keepersprite_add[sprite_idx] = malloc(sz);
     context->sprite.Data = keepersprite_add[sprite_idx];
-    compress_raw(&context->sprite, dst_buf, context->x, context->y, dst_w, dst_h);
+    fill_sprite_data(path, subpath, &context->sprite, cached, &job, context->x, context->y, dst_w, dst_h);
     struct KeeperSprite *ksprite = &creature_table_add[sprite_idx];
 
     if (context->ksp_first == NULL)
@@ -878,39 +1280,25 @@ static int read_png_data(unzFile zip, const char *path, struct SpriteContext *co
 
 #undef READ_WITH_DEFAULT
 
-    spng_ctx_free(ctx);
     return 1;
 }
 #pragma clang diagnostic pop
 
-static void convert_row(unsigned char *dst_buf, uint32_t *src_buf, int len)
+static void convert_row(unsigned char *dst_buf, const uint32_t *src_buf, int len)
 {
-#define SCALE 4
-    for (int i = 0; i < len; i++, src_buf++, dst_buf++)
+    // Palette has 6 bits per component; index is RGB with lowest 2 bits of every component dropped
+    for (int i = 0; i < len; i++)
     {
-        uint32_t data = *src_buf;
-        int idx = ((data & 0x00FF00) >> 8) / SCALE;
-        const struct PaletteNode *node = &pal_tree[idx];
-        uint8_t max_val = 255;
-        uint32_t max_dst = 3 * 64 * 64;
-
-        for (struct PaletteRecord *rec = node->rec; rec != node->rec + node->size; rec++)
-        {
-            int8_t dr = (rec->color & 0x00000FF) - (data & 0x0000FF) / SCALE;
-            int8_t dg = ((rec->color & 0xFF00) >> 8) - ((data & 0xFF00) >> 8) / SCALE;
-            int8_t db = ((rec->color & 0xFF0000) >> 16) - ((data & 0xFF0000) >> 16) / SCALE;
-            if (dr * dr + dg * dg + db * db < max_dst)
-            {
-                max_dst = dr * dr + dg * dg + db * db;
-                max_val = rec->color_idx;
-            }
-        }
-        *dst_buf = max_val;
+        uint32_t data = src_buf[i];
+        dst_buf[i] = pal_lut[((data & 0x0000FC) >> 2) | ((data & 0x00FC00) >> 4) | ((data & 0xFC0000) >> 6)];
     }
-#undef SCALE
 }
 
-static void compress_raw(struct TbHugeSprite *sprite, unsigned char *inp_buf, int x, int y, int w, int h)
+/**
+ * Converts part of RGBA image into sprite data, with RLE coded transparency.
+ * @return Size of the sprite data
+ */
+static unsigned long compress_raw(struct TbHugeSprite *sprite, unsigned char *inp_buf, int x, int y, int w, int h)
 {
 #define TEST_TRANSP(x) ((x & 0xFF000000u) < 0x40000000u)
 
@@ -973,6 +1361,7 @@ static void compress_raw(struct TbHugeSprite *sprite, unsigned char *inp_buf, in
         buf++;
         src_buf += tail;
     }
+    return buf - sprite->Data;
 }
 
 #if BFDEBUG_LEVEL > 0
@@ -1274,7 +1663,10 @@ add_custom_json(const char *path, const char *name, TbBool (*process)(const char
         WARNLOG("%s/%s should be array of dictionaries", path, name);
         goto end;
     }
+    sprite_cache_open(path, name);
     TbBool ret_ok = process(path, zip, &root);
+    process_decode_queue();
+    sprite_cache_close();
 
     value_fini(&root);
 
@@ -1422,6 +1814,31 @@ static TbBool add_custom_sprite(const char *path)
     return add_custom_json(path, "sprites.json", &process_sprite);
 }
 
+static TbBigChecksum named_commands_checksum(TbBigChecksum sum, const struct NamedCommand *commands, int count)
+{
+    for (int i = 0; i < count; i++)
+    {
+        const char *name = commands[i].name;
+        if (name == NULL)
+            continue;
+        sum = checksum_add(sum, name, strlen(name));
+        sum = checksum_add(sum, &commands[i].num, sizeof(commands[i].num));
+    }
+    return sum;
+}
+
+/**
+ * Returns checksum of names and indices of custom sprites and icons.
+ * Configs refer to custom sprites by name, so it is a part of config cache key.
+ */
+TbBigChecksum get_custom_sprites_checksum(void)
+{
+    TbBigChecksum sum = 5381;
+    sum = named_commands_checksum(sum, added_sprites, num_added_sprite);
+    sum = named_commands_checksum(sum, added_icons, num_added_icons);
+    return sum;
+}
+
 short get_icon_id(const char *name)
 {
     short ret = atoi(name);
@@ -21,6 +21,7 @@
 #define GIT_CUSTOM_SPRITES_H
 
 #include "globals.h"
+#include "bflib_basics.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -36,6 +37,7 @@ const struct TbSprite *get_button_sprite(short sprite_idx);
 const struct TbSprite *get_frontend_sprite(short sprite_idx);
 const struct TbSprite *get_new_icon_sprite(short sprite_idx);
 int is_custom_icon(short icon_idx);
+TbBigChecksum get_custom_sprites_checksum(void);
 
 extern short bad_icon_id;
 #ifdef __cplusplus
@@ -22,6 +22,7 @@
 #include "bflib_basics.h"
 
 #include "config.h"
+#include "config_cache.h"
 #include "config_creature.h"
 #include "config_crtrstates.h"
 #include "config_objects.h"
@@ -36,10 +37,13 @@
 #include "post_inc.h"
 
 /******************************************************************************/
-TbBool load_stats_files(void)
+/**
+ * Loads config files which are parsed before the rules,
+ * and have their state stored in config cache.
+ */
+static TbBool load_cacheable_stats_files(void)
 {
     TbBool result = true;
-    clear_research_for_all_players();
     if (!load_creaturetypes_config(keeper_creaturetp_file,CnfLd_ListOnly))
       result = false;
     if (!load_terrain_config(keeper_terrain_file,CnfLd_ListOnly))
@@ -72,6 +76,27 @@ TbBool load_stats_files(void)
       result = false;
     if (!load_creaturestates_config(creature_states_file,CnfLd_Standard))
       result = false;
+    // creature models don't use the rules, so can be loaded before them
+    for (int i = 1; i < gameadd.crtr_conf.model_count; i++)
+    {
+      if (!load_creaturemodel_config(i,0))
+        result = false;
+    }
+    return result;
+}
+
+TbBool load_stats_files(void)
+{
+    TbBool result = true;
+    clear_research_for_all_players();
+    if (!load_config_cache())
+    {
+        config_cache_record_start();
+        result = load_cacheable_stats_files();
+        // Don't cache state of broken configs, so that errors are reported again
+        if (result)
+            save_config_cache();
+    }
     // note that rules file requires definitions of magic and creature types
     if (!load_rules_config(keeper_rules_file,CnfLd_Standard))
       result = false;
@@ -79,11 +104,6 @@ TbBool load_stats_files(void)
       result = false;
     if (!load_textureanim_config(keeper_textureanim_file,CnfLd_Standard))
       result = false;
-    for (int i = 1; i < gameadd.crtr_conf.model_count; i++)
-    {
-      if (!load_creaturemodel_config(i,0))
-        result = false;
-    }
     SYNCDBG(3,"Finished");
     return result;
 }
@@ -3879,7 +3879,7 @@ static void find_closest_lights_on_list(struct NearestLights *nlgt, long *nlgt_d
     while (i > 0)
     {
         struct Light *lgt;
-        lgt = &game.lish.lights[i];
+        lgt = light_get_light(i);
         i = lgt->next_in_list;
         // Per-light code
         if ((lgt->flags & LgtF_Allocated) != 0)
@@ -3894,7 +3894,7 @@ static void find_closest_lights_on_list(struct NearestLights *nlgt, long *nlgt_d
         }
         // Per-light code ends
         k++;
-        if (k > LIGHTS_COUNT)
+        if (k > LIGHTS_MAX_COUNT)
         {
             ERRORLOG("Infinite loop detected when sweeping lights list");
             break;
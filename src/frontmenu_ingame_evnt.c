@@ -22,6 +22,7 @@
 #include "bflib_basics.h"
 #include "bflib_datetm.h"
 #include "bflib_guibtns.h"
+#include "bflib_network.h"
 #include "bflib_vidraw.h"
 #include "bflib_sprfnt.h"
 
@@ -41,6 +42,7 @@
 #include "front_input.h"
 #include "vidfade.h"
 #include "game_legacy.h"
+#include "game_profiler.h"
 #include "sprites.h"
 
 #include "keeperfx.hpp"
@@ -652,6 +654,33 @@ void draw_script_variable(PlayerNumber plyr_idx, unsigned char valtype, unsigned
     LbTextSetWindow(0/pixel_size, 0/pixel_size, MyScreenWidth/pixel_size, MyScreenHeight/pixel_size);
 }
 
+/**
+ * Draws rolling statistics of game turn profiler sections, one per line.
+ */
+static void draw_profiler_sections(int tx_units_per_px, int first_line)
+{
+    char *text;
+    struct ProfilerSectionSummary summary;
+    int line = first_line;
+    text = buf_sprintf("Last %d turns: avg / p95 / max ms", PROFILER_HISTORY_TURNS);
+    LbTextDrawResized(0, line*tx_units_per_px, tx_units_per_px, text);
+    line++;
+    for (int i = 0; i < PrfSec_LISTEND; i++)
+    {
+        if (!profiler_get_summary(i, &summary))
+        {
+            text = buf_sprintf("Profiler not available in this build");
+            LbTextDrawResized(0, line*tx_units_per_px, tx_units_per_px, text);
+            break;
+        }
+        // Text is right-aligned, so nested sections are marked with a prefix instead of indentation
+        text = buf_sprintf("%s%s: %.2f / %.2f / %.2f", (profiler_section_depth(i) > 0) ? "- " : "",
+            profiler_section_name(i), summary.average, summary.percentile95, summary.maximum);
+        LbTextDrawResized(0, line*tx_units_per_px, tx_units_per_px, text);
+        line++;
+    }
+}
+
 void draw_frametime()
 {
     float display_value;
@@ -685,6 +714,21 @@ void draw_frametime()
         }
         LbTextDrawResized(0, (28+i)*tx_units_per_px, tx_units_per_px, text);
     }
+    int line = 28+TOTAL_FRAMETIME_KINDS;
+    // Frames queued by client tell how many turns it is behind the server
+    if ((game.game_kind != GKind_LocalGame) && !LbNetwork_IsServer())
+    {
+        struct TbNetworkQueueStats qstats;
+        LbNetwork_GetQueueStats(&qstats);
+        text = buf_sprintf("Net queue: %lu (avg %.2f, max %lu, overflows %lu)", qstats.depth,
+            (qstats.consumed > 0) ? (double)qstats.depth_sum / qstats.consumed : 0.0, qstats.max_depth, qstats.overflows);
+        LbTextDrawResized(0, line*tx_units_per_px, tx_units_per_px, text);
+        line++;
+    }
+    if (debug_display_profiler)
+    {
+        draw_profiler_sections(tx_units_per_px, line+1);
+    }
     lbDisplay.DrawFlags = Lb_TEXT_HALIGN_LEFT;
 }
 /******************************************************************************/
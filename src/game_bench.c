@@ -0,0 +1,240 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file game_bench.c
+ *     Headless simulation benchmark driven by packet file replays.
+ * @par Purpose:
+ *     Measures how fast the game logic runs when replaying a packet file,
+ *     with drawing, sound and turn delays disabled.
+ * @par Comment:
+ *     The packet file checksums are verified on every turn, so each
+ *     benchmark run also proves the simulation stayed deterministic.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "pre_inc.h"
+#include "game_bench.h"
+
+#include "globals.h"
+#include "bflib_basics.h"
+#include "bflib_memory.h"
+#include "bflib_datetm.h"
+#include "bflib_network.h"
+
+#include "ariadne.h"
+#include "ariadne_bench.h"
+#include "ariadne_routecache.h"
+#include "game_legacy.h"
+#include "gui_topmsg.h"
+#include "net_desync.h"
+#include "net_game.h"
+#include "packets.h"
+#include "post_inc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+struct BenchmarkStats bench_stats;
+/** Upper limits of network stall time ranges, in milliseconds; the last range has no limit. */
+static const long bench_net_stall_limits[BENCH_NET_STALL_RANGES-1] = {1, 10, 50, 100};
+static struct TbNetworkPlayerInfo bench_net_players[NET_PLAYERS_COUNT];
+/******************************************************************************/
+/**
+ * Clears the benchmark statistics and starts gathering them.
+ * Should be called right before the gameplay loop is entered.
+ */
+void bench_start(void)
+{
+    LbMemorySet(&bench_stats, 0, sizeof(bench_stats));
+    bench_stats.active = true;
+    bench_stats.first_turn = game.play_gameturn;
+    bench_stats.checksum_errors_start = erstat[ESE_PacketsOutOfSync].n;
+    route_cache_reset_stats();
+    // Times of turn sections are gathered even in builds without the profiler
+    profiler_bench_timing = true;
+    desync_tree_reset_stats();
+    triangulation_reset_update_stats();
+    nav_bench_start();
+    bench_stats.started = LbTimerClockMicro();
+    SYNCMSG("Benchmark started at turn %lu, %lu turns to replay",(unsigned long)game.play_gameturn,(unsigned long)game.turns_stored);
+}
+
+void bench_turn_begin(void)
+{
+    if (!bench_stats.active)
+        return;
+    bench_stats.turn_started = LbTimerClockMicro();
+}
+
+void bench_turn_end(void)
+{
+    if (!bench_stats.active)
+        return;
+    TbClockMicroSec elapsed = LbTimerClockMicro() - bench_stats.turn_started;
+    bench_stats.logic_total += elapsed;
+    if (bench_stats.logic_worst < elapsed)
+        bench_stats.logic_worst = elapsed;
+    bench_stats.turns++;
+}
+
+/**
+ * Adds time spent in given section; used by the profiler, which makes its own measurements.
+ */
+void bench_section_add(int sect, TbClockMicroSec elapsed)
+{
+    if (!bench_stats.active)
+        return;
+    struct BenchSectionStats* bsect = &bench_stats.sections[sect];
+    bsect->total += elapsed;
+    if (bsect->worst < elapsed)
+        bsect->worst = elapsed;
+}
+
+/**
+ * Hosts a network session with simulated clients, so that replayed packets
+ * can be sent through it. Should be called after bench_start().
+ */
+TbBool bench_net_start(int clients, unsigned long latency, unsigned long jitter, unsigned long loss)
+{
+    char name[] = "Benchmark";
+    unsigned long plyr_num;
+    if ((clients < 1) || (clients > NET_PLAYERS_COUNT-1))
+    {
+        WARNLOG("Cannot simulate %d clients, benchmark continues without network",clients);
+        return false;
+    }
+    LbMemorySet(bench_net_players, 0, sizeof(bench_net_players));
+    LbNetwork_SetupLoopback(clients, latency, jitter, loss);
+    if ((LbNetwork_Init(NS_LOOPBACK, NET_PLAYERS_COUNT, bench_net_players, NULL) != Lb_OK)
+      || (LbNetwork_Create(name, name, &plyr_num, NULL) != Lb_OK))
+    {
+        WARNLOG("Cannot host simulated network session, benchmark continues without network");
+        LbNetwork_Stop();
+        return false;
+    }
+    if (LbNetwork_WaitForLogins(clients, 10000) != Lb_OK)
+    {
+        WARNLOG("Simulated clients did not log in, benchmark continues without network");
+        LbNetwork_Stop();
+        return false;
+    }
+    LbNetwork_ResetScheduledExchange();
+    bench_stats.net_active = true;
+    SYNCMSG("Benchmark sends packets to %d simulated clients, latency %lu ms, jitter %lu ms, loss %lu%%",
+        clients,latency,jitter,loss);
+    return true;
+}
+
+/**
+ * Sends the local packet through simulated network and measures how long the turn waits for it.
+ * Replayed packets are restored after the exchange, so the game runs exactly as without network.
+ */
+void bench_net_exchange(void)
+{
+    if (!bench_stats.active || !bench_stats.net_active)
+        return;
+    struct Packet replayed[PACKETS_COUNT];
+    LbMemoryCopy(replayed, game.packets, sizeof(replayed));
+    TbClockMicroSec started = LbTimerClockMicro();
+    if (LbNetwork_ExchangeScheduled(&replayed[my_player_number], game.packets, sizeof(struct Packet)) != Lb_OK)
+    {
+        WARNLOG("Simulated network exchange failed, measurement stopped");
+        bench_stats.net_active = false;
+    }
+    TbClockMicroSec elapsed = LbTimerClockMicro() - started;
+    LbMemoryCopy(game.packets, replayed, sizeof(replayed));
+    bench_stats.net_turns++;
+    bench_stats.net_stall_total += elapsed;
+    if (bench_stats.net_stall_worst < elapsed)
+        bench_stats.net_stall_worst = elapsed;
+    int i;
+    for (i = 0; i < BENCH_NET_STALL_RANGES-1; i++)
+    {
+        if (elapsed / 1000 < bench_net_stall_limits[i])
+            break;
+    }
+    bench_stats.net_stall_ranges[i]++;
+}
+
+static void bench_net_report(void)
+{
+    if (bench_stats.net_turns == 0)
+        return;
+    JUSTMSG("Benchmark: network %lu turns, stall total %.3f s, avg %.3f ms/turn, worst %.3f ms",bench_stats.net_turns,
+        (double)bench_stats.net_stall_total/1000000.0,(double)bench_stats.net_stall_total/bench_stats.net_turns/1000.0,
+        (double)bench_stats.net_stall_worst/1000.0);
+    long lower = 0;
+    for (int i = 0; i < BENCH_NET_STALL_RANGES; i++)
+    {
+        if (i == BENCH_NET_STALL_RANGES-1) {
+            JUSTMSG("Benchmark:   stall %4ld ms and more %8lu turns",lower,bench_stats.net_stall_ranges[i]);
+            break;
+        }
+        JUSTMSG("Benchmark:   stall %4ld-%-4ld ms     %8lu turns",lower,bench_net_stall_limits[i],bench_stats.net_stall_ranges[i]);
+        lower = bench_net_stall_limits[i];
+    }
+    bench_stats.net_active = false;
+    LbNetwork_Stop();
+}
+
+/**
+ * Writes the benchmark results into log file and stops gathering statistics.
+ */
+void bench_report(void)
+{
+    if (!bench_stats.active)
+        return;
+    bench_stats.active = false;
+    profiler_bench_timing = false;
+    TbClockMicroSec wall_time = LbTimerClockMicro() - bench_stats.started;
+    unsigned long turns = bench_stats.turns;
+    if (turns < 1)
+        turns = 1;
+    double wall_sec = (double)wall_time / 1000000.0;
+    double logic_sec = (double)bench_stats.logic_total / 1000000.0;
+    JUSTMSG("Benchmark: %lu turns (%lu -> %lu) in %.3f s, %.1f turns/sec",bench_stats.turns,
+        (unsigned long)bench_stats.first_turn,(unsigned long)game.play_gameturn,
+        wall_sec,(wall_sec > 0.0) ? bench_stats.turns/wall_sec : 0.0);
+    JUSTMSG("Benchmark: logic %.3f s, avg %.3f ms/turn, worst %.3f ms",logic_sec,
+        (double)bench_stats.logic_total/turns/1000.0,(double)bench_stats.logic_worst/1000.0);
+    for (int i = 0; i < PrfSec_LISTEND; i++)
+    {
+        struct BenchSectionStats* bsect = &bench_stats.sections[i];
+        if (bsect->worst == 0)
+            continue;
+        JUSTMSG("Benchmark: %*s%-*s avg %8.3f ms  worst %8.3f ms  share %5.1f%%",2+2*profiler_section_depth(i),"",
+            24-2*profiler_section_depth(i),profiler_section_name(i),
+            (double)bsect->total/turns/1000.0,(double)bsect->worst/1000.0,
+            (bench_stats.logic_total > 0) ? (100.0*bsect->total)/bench_stats.logic_total : 0.0);
+    }
+    struct RouteCacheStats rcstats;
+    route_cache_get_stats(&rcstats);
+    unsigned long routes = rcstats.hits + rcstats.triangle_hits + rcstats.misses;
+    JUSTMSG("Benchmark: route cache %lu exact hits, %lu triangle route hits, %lu misses (%.1f%% hit rate), %lu triangulation changes",
+        rcstats.hits,rcstats.triangle_hits,rcstats.misses,(routes > 0) ? (100.0*(rcstats.hits+rcstats.triangle_hits))/routes : 0.0,
+        rcstats.invalidations);
+    nav_bench_report();
+    desync_tree_bench_report();
+    bench_net_report();
+    if (game.packet_checksum_verify)
+    {
+        unsigned long errors = erstat[ESE_PacketsOutOfSync].n - bench_stats.checksum_errors_start;
+        JUSTMSG("Benchmark: determinism %s, %lu checksum mismatches, final checksum %08lx",(errors == 0) ? "OK" : "FAILED",
+            errors,(unsigned long)get_packet_save_checksum());
+    } else
+    {
+        JUSTMSG("Benchmark: determinism not verified, packet file has no checksums; final checksum %08lx",
+            (unsigned long)get_packet_save_checksum());
+    }
+}
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,71 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file game_bench.h
+ *     Header file for game_bench.c.
+ * @par Purpose:
+ *     Headless simulation benchmark driven by packet file replays.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef DK_GAME_BENCH_H
+#define DK_GAME_BENCH_H
+
+#include "globals.h"
+#include "bflib_basics.h"
+#include "bflib_datetm.h"
+#include "game_profiler.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Amount of ranges in which network stall times are counted. */
+#define BENCH_NET_STALL_RANGES 5
+
+struct BenchSectionStats {
+    TbClockMicroSec total;
+    TbClockMicroSec worst;
+};
+
+struct BenchmarkStats {
+    TbBool active;
+    GameTurn first_turn;
+    unsigned long turns;
+    TbClockMicroSec started;
+    TbClockMicroSec turn_started;
+    TbClockMicroSec logic_total;
+    TbClockMicroSec logic_worst;
+    unsigned long checksum_errors_start;
+    struct BenchSectionStats sections[PrfSec_LISTEND];
+    /** Whether replayed packets are also sent through simulated network. */
+    TbBool net_active;
+    unsigned long net_turns;
+    TbClockMicroSec net_stall_total;
+    TbClockMicroSec net_stall_worst;
+    unsigned long net_stall_ranges[BENCH_NET_STALL_RANGES];
+};
+/******************************************************************************/
+extern struct BenchmarkStats bench_stats;
+/******************************************************************************/
+void bench_start(void);
+void bench_turn_begin(void);
+void bench_turn_end(void);
+void bench_report(void);
+TbBool bench_net_start(int clients, unsigned long latency, unsigned long jitter, unsigned long loss);
+void bench_net_exchange(void);
+
+void bench_section_add(int sect, TbClockMicroSec elapsed);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -69,6 +69,7 @@ void clear_shadow_limits(struct LightsShadows * lish)
 void clear_light_system(struct LightsShadows * lish)
 {
     LbMemorySet(lish, 0, sizeof(struct LightsShadows));
+    light_clear_extra_lights();
 }
 
 /******************************************************************************/
@@ -30,7 +30,10 @@ extern "C" {
 #endif
 /******************************************************************************/
 #define SHADOW_LIMITS_COUNT  2048
+/** Amount of shadow caches within the game structure; the caches in use are allocated separately. */
 #define SHADOW_CACHE_COUNT     40
+/** Max amount of shadow caches; when there are this many, the least recently rendered one is reused. */
+#define SHADOW_CACHE_MAX_COUNT 512
 
 /******************************************************************************/
 #pragma pack(1)
@@ -55,7 +58,7 @@ struct LightsShadows {
     struct LightingTable lighting_tables[1024]; // only the first 700 elements are populated
     unsigned char shadow_limits[SHADOW_LIMITS_COUNT];
     struct Light lights[LIGHTS_COUNT];
-    struct ShadowCache shadow_cache[SHADOW_CACHE_COUNT];
+    struct ShadowCache shadow_cache[SHADOW_CACHE_COUNT]; // unused, kept for layout of saved games
     unsigned short stat_light_map[MAX_SUBTILES_X*MAX_SUBTILES_Y];
     long global_ambient_light;
     TbBool light_enabled;
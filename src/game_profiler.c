@@ -0,0 +1,275 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file game_profiler.c
+ *     Per-subsystem game turn profiler.
+ * @par Purpose:
+ *     Measures time spent in parts of the game turn, keeps history of last
+ *     turns for the on-screen overlay, and can dump every turn to CSV file.
+ * @par Comment:
+ *     Measurements are only done if PROFILER_ENABLED is set at compile time,
+ *     or while a benchmark is running; history and CSV need the profiler.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "pre_inc.h"
+#include "game_profiler.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include "globals.h"
+#include "bflib_basics.h"
+#include "bflib_memory.h"
+#include "bflib_datetm.h"
+
+#include "game_bench.h"
+#include "game_legacy.h"
+#include "post_inc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+struct ProfilerSectionInfo {
+    const char *name;
+    /** Parent section, or -1 for top level sections. */
+    int parent;
+};
+
+static const struct ProfilerSectionInfo profiler_sections[PrfSec_LISTEND] = {
+    {"input",              -1},
+    {"packets",            -1},
+    {"turn setup",         -1},
+    {"things",             -1},
+    {"creatures",          PrfSec_Things},
+    {"creatures in limbo", PrfSec_Things},
+    {"traps",              PrfSec_Things},
+    {"shots",              PrfSec_Things},
+    {"objects",            PrfSec_Things},
+    {"effects",            PrfSec_Things},
+    {"effect elements",    PrfSec_Things},
+    {"dead creatures",     PrfSec_Things},
+    {"effect generators",  PrfSec_Things},
+    {"doors",              PrfSec_Things},
+    {"ambient sounds",     PrfSec_Things},
+    {"cave-ins",           PrfSec_Things},
+    {"rooms",              -1},
+    {"dungeons",           -1},
+    {"research",           -1},
+    {"manufacture",        -1},
+    {"events",             -1},
+    {"level script",       -1},
+    {"computer players",   -1},
+    {"players",            -1},
+    {"action points",      -1},
+    {"player effects",     -1},
+    {"messages",           -1},
+    {"cameras",            -1},
+    {"sounds",             -1},
+};
+
+/** Set to non-zero to show profiler sections in the frametime overlay. */
+int debug_display_profiler = 0;
+/** Whether sections are timed in builds without the profiler; set while a benchmark is running. */
+TbBool profiler_bench_timing = false;
+
+struct ProfilerStack {
+    /** Sections which are currently being measured, innermost last. */
+    int sects[PROFILER_STACK_DEPTH];
+    TbClockMicroSec started[PROFILER_STACK_DEPTH];
+    int depth;
+};
+
+static struct ProfilerStack profiler_stack;
+
+#if PROFILER_ENABLED
+struct ProfilerState {
+    /** Time spent in every section during current turn. */
+    TbClockMicroSec turn_total[PrfSec_LISTEND];
+    /** Time spent in every section during last turns, in a ring buffer. */
+    TbClockMicroSec history[PROFILER_HISTORY_TURNS][PrfSec_LISTEND];
+    int history_pos;
+    int history_count;
+    GameTurn turn;
+    FILE *csv_file;
+};
+
+static struct ProfilerState profiler;
+#endif
+/******************************************************************************/
+const char *profiler_section_name(int sect)
+{
+    if ((sect < 0) || (sect >= PrfSec_LISTEND))
+        return "unknown";
+    return profiler_sections[sect].name;
+}
+
+int profiler_section_depth(int sect)
+{
+    int depth = 0;
+    while ((sect >= 0) && (sect < PrfSec_LISTEND) && (profiler_sections[sect].parent >= 0))
+    {
+        sect = profiler_sections[sect].parent;
+        depth++;
+    }
+    return depth;
+}
+
+void profiler_section_begin(int sect)
+{
+    struct ProfilerStack* pstack = &profiler_stack;
+    if (pstack->depth >= PROFILER_STACK_DEPTH)
+    {
+        ERRORLOG("Profiler stack overflow at section \"%s\"",profiler_section_name(sect));
+        return;
+    }
+    pstack->sects[pstack->depth] = sect;
+    pstack->started[pstack->depth] = LbTimerClockMicro();
+    pstack->depth++;
+}
+
+void profiler_section_end(int sect)
+{
+    struct ProfilerStack* pstack = &profiler_stack;
+    TbClockMicroSec now = LbTimerClockMicro();
+    if ((pstack->depth <= 0) || (pstack->sects[pstack->depth-1] != sect))
+    {
+        // Timing may start while a section is open, so without the profiler this is not an error
+        if (PROFILER_ENABLED)
+            ERRORLOG("Profiler section \"%s\" ended without being started",profiler_section_name(sect));
+        return;
+    }
+    pstack->depth--;
+    TbClockMicroSec elapsed = now - pstack->started[pstack->depth];
+#if PROFILER_ENABLED
+    profiler.turn_total[sect] += elapsed;
+#endif
+    bench_section_add(sect, elapsed);
+}
+
+#if PROFILER_ENABLED
+static void profiler_csv_write_turn(void)
+{
+    fprintf(profiler.csv_file, "%lu", (unsigned long)profiler.turn);
+    for (int i = 0; i < PrfSec_LISTEND; i++)
+    {
+        fprintf(profiler.csv_file, ",%lld", (long long)profiler.turn_total[i]);
+    }
+    fprintf(profiler.csv_file, "\n");
+}
+#endif
+
+void profiler_turn_begin(void)
+{
+    if (profiler_stack.depth != 0)
+    {
+        if (PROFILER_ENABLED)
+            WARNLOG("Profiler had %d sections unfinished at turn end",profiler_stack.depth);
+        profiler_stack.depth = 0;
+    }
+#if PROFILER_ENABLED
+    LbMemorySet(profiler.turn_total, 0, sizeof(profiler.turn_total));
+    profiler.turn = game.play_gameturn;
+#endif
+}
+
+void profiler_turn_end(void)
+{
+#if PROFILER_ENABLED
+    LbMemoryCopy(profiler.history[profiler.history_pos], profiler.turn_total, sizeof(profiler.turn_total));
+    profiler.history_pos = (profiler.history_pos + 1) % PROFILER_HISTORY_TURNS;
+    if (profiler.history_count < PROFILER_HISTORY_TURNS)
+        profiler.history_count++;
+    if (profiler.csv_file != NULL)
+        profiler_csv_write_turn();
+#endif
+}
+
+#if PROFILER_ENABLED
+static int profiler_compare_times(const void *ptr1, const void *ptr2)
+{
+    TbClockMicroSec val1 = *(const TbClockMicroSec *)ptr1;
+    TbClockMicroSec val2 = *(const TbClockMicroSec *)ptr2;
+    return (val1 > val2) - (val1 < val2);
+}
+#endif
+
+/**
+ * Computes rolling statistics of given section over the last turns.
+ * @return False if there is nothing measured.
+ */
+TbBool profiler_get_summary(int sect, struct ProfilerSectionSummary *summary)
+{
+    LbMemorySet(summary, 0, sizeof(struct ProfilerSectionSummary));
+#if PROFILER_ENABLED
+    if ((sect < 0) || (sect >= PrfSec_LISTEND) || (profiler.history_count <= 0))
+        return false;
+    TbClockMicroSec times[PROFILER_HISTORY_TURNS];
+    TbClockMicroSec total = 0;
+    for (int i = 0; i < profiler.history_count; i++)
+    {
+        times[i] = profiler.history[i][sect];
+        total += times[i];
+    }
+    qsort(times, profiler.history_count, sizeof(TbClockMicroSec), profiler_compare_times);
+    summary->average = (float)total / profiler.history_count / 1000.0f;
+    summary->percentile95 = (float)times[(profiler.history_count * 95) / 100] / 1000.0f;
+    summary->maximum = (float)times[profiler.history_count - 1] / 1000.0f;
+    return true;
+#else
+    return false;
+#endif
+}
+
+/**
+ * Starts or stops writing every turn measurements into CSV file.
+ * @return True if the file is now open for writing.
+ */
+TbBool profiler_csv_toggle(const char *fname)
+{
+#if PROFILER_ENABLED
+    if (profiler.csv_file != NULL)
+    {
+        profiler_csv_close();
+        return false;
+    }
+    profiler.csv_file = fopen(fname, "w");
+    if (profiler.csv_file == NULL)
+    {
+        WARNLOG("Cannot open profiler output file \"%s\"",fname);
+        return false;
+    }
+    fprintf(profiler.csv_file, "turn");
+    for (int i = 0; i < PrfSec_LISTEND; i++)
+    {
+        fprintf(profiler.csv_file, ",%s", profiler_section_name(i));
+    }
+    fprintf(profiler.csv_file, "\n");
+    SYNCMSG("Profiler writes turn times into \"%s\"",fname);
+    return true;
+#else
+    WARNLOG("Profiler is not compiled into this build");
+    return false;
+#endif
+}
+
+void profiler_csv_close(void)
+{
+#if PROFILER_ENABLED
+    if (profiler.csv_file != NULL)
+    {
+        fclose(profiler.csv_file);
+        profiler.csv_file = NULL;
+    }
+#endif
+}
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
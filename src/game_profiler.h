@@ -0,0 +1,103 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file game_profiler.h
+ *     Header file for game_profiler.c.
+ * @par Purpose:
+ *     Per-subsystem game turn profiler.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ *     Unless PROFILER_ENABLED is set, the measuring macros only check a flag,
+ *     and sections are timed only while a benchmark is running.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef DK_GAME_PROFILER_H
+#define DK_GAME_PROFILER_H
+
+#include "globals.h"
+#include "bflib_basics.h"
+#include "bflib_datetm.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Amount of last game turns used for computing averages and percentiles. */
+#define PROFILER_HISTORY_TURNS 128
+/** Max nesting level of profiler sections. */
+#define PROFILER_STACK_DEPTH 8
+
+/** Measured parts of the game turn. Order defines the hierarchy display order. */
+enum ProfilerSections {
+    PrfSec_Input = 0,
+    PrfSec_Packets,
+    PrfSec_TurnSetup,
+    PrfSec_Things,
+    PrfSec_ThingsCreatures,
+    PrfSec_ThingsCreaturesLimbo,
+    PrfSec_ThingsTraps,
+    PrfSec_ThingsShots,
+    PrfSec_ThingsObjects,
+    PrfSec_ThingsEffects,
+    PrfSec_ThingsEffectElems,
+    PrfSec_ThingsDeadCreatrs,
+    PrfSec_ThingsEffectGens,
+    PrfSec_ThingsDoors,
+    PrfSec_ThingsAmbientSnds,
+    PrfSec_ThingsCaveIns,
+    PrfSec_Rooms,
+    PrfSec_Dungeons,
+    PrfSec_Research,
+    PrfSec_Manufacture,
+    PrfSec_Events,
+    PrfSec_Script,
+    PrfSec_Computer,
+    PrfSec_Players,
+    PrfSec_ActionPoints,
+    PrfSec_PlayerEffects,
+    PrfSec_Messages,
+    PrfSec_Cameras,
+    PrfSec_Sounds,
+    PrfSec_LISTEND,
+};
+
+/** Summary of one section over the last PROFILER_HISTORY_TURNS turns, in milliseconds. */
+struct ProfilerSectionSummary {
+    float average;
+    float percentile95;
+    float maximum;
+};
+
+#if PROFILER_ENABLED
+#define PROFILER_BEGIN(sect) profiler_section_begin(sect)
+#define PROFILER_END(sect) profiler_section_end(sect)
+#else
+#define PROFILER_BEGIN(sect) do { if (profiler_bench_timing) profiler_section_begin(sect); } while (0)
+#define PROFILER_END(sect) do { if (profiler_bench_timing) profiler_section_end(sect); } while (0)
+#endif
+/******************************************************************************/
+extern int debug_display_profiler;
+extern TbBool profiler_bench_timing;
+/******************************************************************************/
+const char *profiler_section_name(int sect);
+int profiler_section_depth(int sect);
+
+void profiler_section_begin(int sect);
+void profiler_section_end(int sect);
+void profiler_turn_begin(void);
+void profiler_turn_end(void);
+TbBool profiler_get_summary(int sect, struct ProfilerSectionSummary *summary);
+TbBool profiler_csv_toggle(const char *fname);
+void profiler_csv_close(void);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -41,6 +41,7 @@
 #include "gui_soundmsgs.h"
 #include "game_legacy.h"
 #include "game_merge.h"
+#include "packets_stream.h"
 #include "frontmenu_ingame_map.h"
 #include "gui_boxmenu.h"
 #include "keeperfx.hpp"
@@ -100,6 +101,7 @@ TbBool save_game_chunks(TbFileHandle fhandle,struct CatalogueEntry *centry)
     long chunks_done = 0;
     // Currently there is some game data oustide of structs - make sure it is updated
     light_export_system_state(&gameadd.lightst);
+    light_export_extra_lights(&light_extra_state);
     { // Info chunk
         hdr.id = SGC_InfoBlock;
         hdr.ver = 0;
@@ -132,7 +134,19 @@ TbBool save_game_chunks(TbFileHandle fhandle,struct CatalogueEntry *centry)
         if (LbFileWrite(fhandle, &intralvl, sizeof(struct IntralevelData)) == sizeof(struct IntralevelData))
             chunks_done |= SGF_IntralevelData;
     }
-    if (chunks_done != SGF_SavedGame)
+    if (light_extra_state.count > 0)
+    { // Extra lights chunk; optional, as most games do not need them
+        size_t len = sizeof(light_extra_state.count) + light_extra_state.count * sizeof(struct Light);
+        hdr.id = SGC_ExtraLights;
+        hdr.ver = 0;
+        hdr.len = len;
+        if (LbFileWrite(fhandle, &hdr, sizeof(struct FileChunkHeader)) == sizeof(struct FileChunkHeader))
+        if (LbFileWrite(fhandle, &light_extra_state, len) == len)
+            chunks_done |= SGF_ExtraLights;
+        if ((chunks_done & SGF_ExtraLights) == 0)
+            return false;
+    }
+    if ((chunks_done & SGF_SavedGame) != SGF_SavedGame)
         return false;
     return true;
 }
@@ -179,7 +193,7 @@ TbBool save_packet_chunks(TbFileHandle fhandle,struct CatalogueEntry *centry)
     }
     { // Packet file data start indicator
         hdr.id = SGC_PacketData;
-        hdr.ver = 0;
+        hdr.ver = PACKET_STREAM_VERSION;
         hdr.len = 0;
         if (LbFileWrite(fhandle, &hdr, sizeof(struct FileChunkHeader)) == sizeof(struct FileChunkHeader))
             chunks_done |= SGF_PacketData;
@@ -192,6 +206,8 @@ TbBool save_packet_chunks(TbFileHandle fhandle,struct CatalogueEntry *centry)
 int load_game_chunks(TbFileHandle fhandle,struct CatalogueEntry *centry)
 {
     long chunks_done = 0;
+    // Games without the chunk have no extra lights
+    light_extra_state.count = 0;
     while (!LbFileEof(fhandle))
     {
         struct FileChunkHeader hdr;
@@ -288,6 +304,23 @@ int load_game_chunks(TbFileHandle fhandle,struct CatalogueEntry *centry)
                 WARNLOG("Could not read IntralevelData chunk");
             }
             break;
+        case SGC_ExtraLights:
+            if ((hdr.len < sizeof(light_extra_state.count)) || (hdr.len > sizeof(light_extra_state))
+              || ((hdr.len - sizeof(light_extra_state.count)) % sizeof(struct Light) != 0))
+            {
+                if (LbFileSeek(fhandle, hdr.len, Lb_FILE_SEEK_CURRENT) < 0)
+                    LbFileSeek(fhandle, 0, Lb_FILE_SEEK_END);
+                WARNLOG("Incompatible ExtraLights chunk");
+                break;
+            }
+            if ((LbFileRead(fhandle, &light_extra_state, hdr.len) == hdr.len)
+              && (light_extra_state.count == (long)((hdr.len - sizeof(light_extra_state.count)) / sizeof(struct Light)))) {
+                chunks_done |= SGF_ExtraLights;
+            } else {
+                WARNLOG("Could not read ExtraLights chunk");
+                light_extra_state.count = 0;
+            }
+            break;
         default:
             WARNLOG("Unrecognized chunk, ID = %08lx",hdr.id);
             break;
@@ -435,6 +468,7 @@ TbBool load_game(long slot_num)
     reinitialise_eye_lens(game.numfield_1B);
     // Update the lights system state
     light_import_system_state(&gameadd.lightst);
+    light_import_extra_lights(&light_extra_state);
     // Victory state
     if (player->victory_state != VicS_Undecided)
     {
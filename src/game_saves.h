@@ -38,6 +38,7 @@ enum SaveGameChunks {
      SGC_PacketHeader   = 0x52444850, //"PHDR"
      SGC_PacketData     = 0x544B4350, //"PCKT"
      SGC_IntralevelData = 0x4C564C49, //"ILVL"
+     SGC_ExtraLights    = 0x54474C58, //"XLGT"
 };
 
 enum SaveGameChunkFlags {
@@ -47,6 +48,7 @@ enum SaveGameChunkFlags {
      SGF_PacketHeader   = 0x0100,
      SGF_PacketData     = 0x0200,
      SGF_IntralevelData = 0x0400,
+     SGF_ExtraLights    = 0x0800,
 };
 #define SGF_SavedGame      (SGF_InfoBlock|SGF_GameOrig|SGF_GameAdd|SGF_IntralevelData)
 #define SGF_PacketStart    (SGF_PacketHeader|SGF_PacketData|SGF_InfoBlock)
@@ -39,6 +39,7 @@ enum ErrorStatisticEntries {
     ESE_BadPathHeap,
     ESE_BadRouteTree,
     ESE_CantReadPackets,
+    ESE_PacketsOutOfSync,
 };
 
 struct ErrorStatistics {
@@ -49,6 +50,8 @@ struct ErrorStatistics {
 
 #pragma pack()
 /******************************************************************************/
+extern struct ErrorStatistics erstat[];
+/******************************************************************************/
 void erstats_clear(void);
 long erstat_inc(int stat_num);
 
@@ -95,6 +95,8 @@ enum FFlags {
 enum DebugFlags {
     DFlg_ShotsDamage        =  0x01,
     DFlg_CreatrPaths        =  0x02,
+    DFlg_ResyncDump         =  0x04,
+    DFlg_DesyncLocator      =  0x08,
 };
 
 #ifdef AUTOTESTING
@@ -134,6 +136,23 @@ struct StartupParameters {
     unsigned char packet_checksum_verify;
     unsigned char force_ppro_poly;
     int frame_skip;
+    /** Run without window, sound and delays between turns. */
+    TbBool headless;
+    /** Replay packet file as fast as possible and report simulation speed. */
+    TbBool benchmark;
+    /** Amount of worker threads for parallel game updates; -1 to base it on CPU cores. */
+    int jobs_count;
+    /** Amount of simulated network clients in benchmark; 0 to replay without network. */
+    int net_bench_clients;
+    /** Simulated network latency, jitter and loss percent in benchmark. */
+    unsigned long net_bench_latency;
+    unsigned long net_bench_jitter;
+    unsigned long net_bench_loss;
+    /** Packet file to be converted into current packet data format, and name of the converted file. */
+    char packet_convert_fname[150];
+    char packet_convert_dest[150];
+    /** Turn at which packet replay should start, restored from the nearest snapshot; 0 to replay from start. */
+    unsigned long packet_seek_turn;
     char selected_campaign[CMDLN_MAXLEN+1];
     TbBool overrides[CMDLINE_OVERRIDES];
     char config_file[CMDLN_MAXLEN+1];
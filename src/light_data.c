@@ -28,6 +28,7 @@
 #include "engine_render.h"
 #include "player_data.h"
 #include "map_data.h"
+#include "map_blocks.h"
 
 #include "thing_stats.h"
 #include "game_legacy.h"
@@ -41,6 +42,45 @@ extern "C" {
 /******************************************************************************/
 static void light_stat_light_map_clear_area(MapSubtlCoord x1, MapSubtlCoord y1, MapSubtlCoord x2, MapSubtlCoord y2);
 
+/******************************************************************************/
+/** Max distance in subtiles between a light and subtiles listed in lighting tables. */
+#define LIGHT_SHADOW_DELTA_MAX 15
+/** Amount of subtile corners in one row of the corner angles lattice. */
+#define LIGHT_SHADOW_LATTICE_SIDE (2*LIGHT_SHADOW_DELTA_MAX+2)
+/** Lattice column which stores angles to points one unit left of the light subtile. */
+#define LIGHT_SHADOW_LATTICE_LEFT LIGHT_SHADOW_LATTICE_SIDE
+/** Amount of extra lights allocated at once; blocks are never moved, so pointers to lights stay valid. */
+#define LIGHTS_EXTRA_BLOCK 64
+
+/**
+ * Geometry of a lighting table item which does not depend on the light position.
+ * Coordinates are indices into light_corner_angles[].
+ */
+struct LightShadowGeometry {
+    unsigned char quadrant;
+    unsigned char corner_x;
+    unsigned char corner_y;
+    unsigned char start_x;
+    unsigned char start_y;
+    unsigned char end_x;
+    unsigned char end_y;
+};
+/** Shadow cache with data needed to reuse it for another light. */
+struct ShadowCacheSlot {
+    struct ShadowCache cache;
+    /** Index of the light which owns the cache. */
+    unsigned short owner;
+    /** Game turn when the owner was last rendered. */
+    GameTurn last_turn;
+};
+
+struct ShadowCacheStore {
+    struct ShadowCacheSlot *slots;
+    long slots_count;
+    unsigned long hits;
+    unsigned long misses;
+    unsigned long evictions;
+};
 /******************************************************************************/
 
 static unsigned long light_bitmask[32];
@@ -51,13 +91,79 @@ static long light_rendered_dynamic_lights;
 static long light_rendered_optimised_dynamic_lights;
 static long light_updated_stat_lights;
 static long light_out_of_date_stat_lights;
+static struct LightShadowGeometry light_shadow_geometry[sizeof(game.lish.lighting_tables)/sizeof(game.lish.lighting_tables[0])];
+/** Angles from the currently rendered light to corners of subtiles around it. */
+static short light_corner_angles[LIGHT_SHADOW_LATTICE_SIDE][LIGHT_SHADOW_LATTICE_SIDE+1];
+/** Lights with indices starting at LIGHTS_COUNT. */
+static struct Light *light_extra_blocks[LIGHTS_EXTRA_COUNT/LIGHTS_EXTRA_BLOCK];
+static long light_extra_count;
+/** Storage of extra lights used when saving and synchronizing the game. */
+struct LightExtraState light_extra_state;
+/** Shadow caches of dynamic lights; these are not a part of game state, and are refilled when lost. */
+static struct ShadowCacheStore shadow_caches;
 /******************************************************************************/
 
+/**
+ * Returns amount of light slots, including extra lights allocated so far.
+ */
+static long light_get_lights_count(void)
+{
+    return LIGHTS_COUNT + light_extra_count;
+}
+
+/**
+ * Returns light of given index. For invalid index, returns the unused light 0.
+ */
+struct Light *light_get_light(long idx)
+{
+    if ((idx < 0) || (idx >= light_get_lights_count()))
+        return &game.lish.lights[0];
+    if (idx < LIGHTS_COUNT)
+        return &game.lish.lights[idx];
+    idx -= LIGHTS_COUNT;
+    return &light_extra_blocks[idx / LIGHTS_EXTRA_BLOCK][idx % LIGHTS_EXTRA_BLOCK];
+}
+
+/**
+ * Adds a block of extra lights, if the limit was not reached.
+ */
+static TbBool light_grow_extra_lights(void)
+{
+    if (light_extra_count + LIGHTS_EXTRA_BLOCK > LIGHTS_EXTRA_COUNT)
+        return false;
+    long blk_idx = light_extra_count / LIGHTS_EXTRA_BLOCK;
+    if (light_extra_blocks[blk_idx] == NULL)
+    {
+        light_extra_blocks[blk_idx] = (struct Light *)LbMemoryAlloc(LIGHTS_EXTRA_BLOCK * sizeof(struct Light));
+        if (light_extra_blocks[blk_idx] == NULL) {
+            WARNLOG("Cannot allocate memory for extra lights");
+            return false;
+        }
+    }
+    LbMemorySet(light_extra_blocks[blk_idx], 0, LIGHTS_EXTRA_BLOCK * sizeof(struct Light));
+    light_extra_count += LIGHTS_EXTRA_BLOCK;
+    SYNCDBG(8,"Grown lights to %ld",light_get_lights_count());
+    return true;
+}
+
+/**
+ * Frees all extra lights. Blocks are kept allocated, to be reused later.
+ */
+void light_clear_extra_lights(void)
+{
+    for (long i = 0; i < light_extra_count; i += LIGHTS_EXTRA_BLOCK)
+    {
+        LbMemorySet(light_extra_blocks[i / LIGHTS_EXTRA_BLOCK], 0, LIGHTS_EXTRA_BLOCK * sizeof(struct Light));
+    }
+    light_extra_count = 0;
+}
+
 struct Light *light_allocate_light(void)
 {
-    for (long i = 1; i < LIGHTS_COUNT; i++)
+    long i;
+    for (i = 1; i < light_get_lights_count(); i++)
     {
-        struct Light* lgt = &game.lish.lights[i];
+        struct Light* lgt = light_get_light(i);
         if ((lgt->flags & LgtF_Allocated) == 0)
         {
             lgt->flags |= LgtF_Allocated;
@@ -65,15 +171,20 @@ struct Light *light_allocate_light(void)
             return lgt;
         }
     }
-    return NULL;
+    if (!light_grow_extra_lights())
+        return NULL;
+    struct Light* lgt = light_get_light(i);
+    lgt->flags |= LgtF_Allocated;
+    lgt->index = i;
+    return lgt;
 }
 
 int light_count_lights()
 {
     int cnt = 0;
-    for (int i = 1; i < LIGHTS_COUNT; i++)
+    for (int i = 1; i < light_get_lights_count(); i++)
     {
-        struct Light *lgt = &game.lish.lights[i];
+        struct Light *lgt = light_get_light(i);
         if (lgt->flags & LgtF_Allocated)
         {
             cnt++;
@@ -91,45 +202,108 @@ TbBool light_is_invalid(const struct Light *lgt)
 {
     if (lgt == NULL)
         return true;
-    if ((lgt < &game.lish.lights[1]) || (lgt > &game.lish.lights[LIGHTS_COUNT-1]))
-        return true;
-    return false;
+    if ((lgt >= &game.lish.lights[1]) && (lgt <= &game.lish.lights[LIGHTS_COUNT-1]))
+        return false;
+    for (long i = 0; i < light_extra_count; i += LIGHTS_EXTRA_BLOCK)
+    {
+        const struct Light *blk = light_extra_blocks[i / LIGHTS_EXTRA_BLOCK];
+        if ((lgt >= blk) && (lgt < blk + LIGHTS_EXTRA_BLOCK))
+            return false;
+    }
+    return true;
 }
 
-struct ShadowCache *light_allocate_shadow_cache(void)
+/**
+ * Frees all shadow caches. Lights which had them will refill new caches when rendered.
+ */
+static void light_shadow_caches_clear(void)
 {
-    for (long i = 1; i < SHADOW_CACHE_COUNT; i++)
+    if (shadow_caches.slots != NULL)
+        LbMemorySet(shadow_caches.slots, 0, shadow_caches.slots_count * sizeof(struct ShadowCacheSlot));
+    for (long i = 1; i < light_get_lights_count(); i++)
     {
-        struct ShadowCache* shdc = &game.lish.shadow_cache[i];
-        if ((shdc->flags & ShCF_Allocated) == 0)
-        {
-            shdc->flags |= ShCF_Allocated;
-            return shdc;
-        }
+        light_get_light(i)->shadow_index = 0;
     }
-    return NULL;
 }
 
-TbBool light_shadow_cache_invalid(struct ShadowCache *shdc)
+/**
+ * Returns shadow cache of given light, or NULL if it has none or it was reused by another light.
+ */
+static struct ShadowCache *light_get_shadow_cache(const struct Light *lgt)
 {
-    if (shdc == NULL)
-        return true;
-    if ((shdc < &game.lish.shadow_cache[1]) || (shdc > &game.lish.shadow_cache[SHADOW_CACHE_COUNT-1]))
-        return true;
-    return false;
+    long i = lgt->shadow_index;
+    if ((i <= 0) || (i >= shadow_caches.slots_count))
+        return NULL;
+    struct ShadowCacheSlot* slot = &shadow_caches.slots[i];
+    if (((slot->cache.flags & ShCF_Allocated) == 0) || (slot->owner != lgt->index))
+        return NULL;
+    return &slot->cache;
 }
 
-long light_shadow_cache_index(struct ShadowCache *shdc)
+/**
+ * Allocates shadow cache for given light. If there are too many caches,
+ * the one which was not rendered for the longest time is taken from its light.
+ */
+static struct ShadowCache *light_allocate_shadow_cache(struct Light *lgt)
 {
-    if (light_shadow_cache_invalid(shdc))
-        return 0;
-    long i = ((char*)shdc - (char*)&game.lish.shadow_cache[0]);
-    return i / sizeof(struct ShadowCache);
+    long i;
+    for (i = 1; i < shadow_caches.slots_count; i++)
+    {
+        if ((shadow_caches.slots[i].cache.flags & ShCF_Allocated) == 0)
+            break;
+    }
+    if ((i >= shadow_caches.slots_count) && (shadow_caches.slots_count < SHADOW_CACHE_MAX_COUNT))
+    {
+        long alloc = shadow_caches.slots_count * 2;
+        if (alloc < SHADOW_CACHE_COUNT)
+            alloc = SHADOW_CACHE_COUNT;
+        if (alloc > SHADOW_CACHE_MAX_COUNT)
+            alloc = SHADOW_CACHE_MAX_COUNT;
+        void* mem = LbMemoryGrow(shadow_caches.slots, alloc * sizeof(struct ShadowCacheSlot));
+        if (mem != NULL)
+        {
+            shadow_caches.slots = (struct ShadowCacheSlot *)mem;
+            LbMemorySet(&shadow_caches.slots[shadow_caches.slots_count], 0, (alloc - shadow_caches.slots_count) * sizeof(struct ShadowCacheSlot));
+            i = (shadow_caches.slots_count > 1) ? shadow_caches.slots_count : 1;
+            shadow_caches.slots_count = alloc;
+        } else
+        {
+            WARNLOG("Cannot grow shadow caches to %ld",alloc);
+        }
+    }
+    if (i >= shadow_caches.slots_count)
+    {
+        // Take the least recently rendered cache
+        i = 0;
+        for (long k = 1; k < shadow_caches.slots_count; k++)
+        {
+            if ((i == 0) || (shadow_caches.slots[k].last_turn < shadow_caches.slots[i].last_turn))
+                i = k;
+        }
+        if (i == 0)
+            return NULL;
+        struct Light* prev_lgt = light_get_light(shadow_caches.slots[i].owner);
+        if (prev_lgt->shadow_index == i)
+            prev_lgt->shadow_index = 0;
+        shadow_caches.evictions++;
+    }
+    struct ShadowCacheSlot* slot = &shadow_caches.slots[i];
+    LbMemorySet(slot, 0, sizeof(struct ShadowCacheSlot));
+    slot->cache.flags |= ShCF_Allocated;
+    slot->owner = lgt->index;
+    slot->last_turn = game.play_gameturn;
+    lgt->shadow_index = i;
+    return &slot->cache;
 }
 
-void light_shadow_cache_free(struct ShadowCache *shdc)
+static void light_shadow_cache_free(struct Light *lgt)
 {
-    LbMemorySet(shdc, 0, sizeof(struct ShadowCache));
+    struct ShadowCache* shdc = light_get_shadow_cache(lgt);
+    if (shdc != NULL)
+    {
+        LbMemorySet(&shadow_caches.slots[lgt->shadow_index], 0, sizeof(struct ShadowCacheSlot));
+    }
+    lgt->shadow_index = 0;
 }
 
 TbBool light_add_light_to_list(struct Light *lgt, struct StructureList *list)
@@ -154,15 +328,8 @@ long light_create_light(struct InitLight *ilght)
     }
     if (ilght->is_dynamic)
     {
-        struct ShadowCache* shdc = light_allocate_shadow_cache();
-        if (light_shadow_cache_invalid(shdc))
-        {
-            ERRORDBG(11,"Cannot allocate cache for dynamic light");
-            light_free_light(lgt);
-            return 0;
-        }
+        // Shadow cache will be allocated when the light is rendered
         light_total_dynamic_lights++;
-        lgt->shadow_index = light_shadow_cache_index(shdc);
         light_add_light_to_list(lgt, &game.thing_lists[TngList_DynamLights]);
     } else
     {
@@ -192,15 +359,7 @@ TbBool light_create_light_adv(VALUE *init_data)
     }
     if (value_coerce_bool(value_dict_get(init_data, "Dynamic")))
     {
-        struct ShadowCache* shdc = light_allocate_shadow_cache();
-        if (light_shadow_cache_invalid(shdc))
-        {
-            ERRORDBG(11,"Cannot allocate cache for dynamic light");
-            light_free_light(lgt);
-            return false;
-        }
         light_total_dynamic_lights++;
-        lgt->shadow_index = light_shadow_cache_index(shdc);
         light_add_light_to_list(lgt, &game.thing_lists[TngList_DynamLights]);
         set_flag_byte(&lgt->flags, LgtF_Dynamic, true);
     }
@@ -283,17 +442,65 @@ void light_import_system_state(const struct LightSystemState *lightst)
     light_rendered_optimised_dynamic_lights = lightst->rendered_optimised_dynamic_lights;
     light_updated_stat_lights = lightst->updated_stat_lights;
     light_out_of_date_stat_lights = lightst->out_of_date_stat_lights;
+    // Shadow caches are not stored; they will be refilled
+    light_shadow_caches_clear();
+}
+
+/**
+ * Copies extra lights into given state. Slots after the last allocated light are left empty.
+ */
+void light_export_extra_lights(struct LightExtraState *xlst)
+{
+    long count = light_extra_count;
+    while ((count > 0) && ((light_get_light(LIGHTS_COUNT + count - 1)->flags & LgtF_Allocated) == 0))
+        count--;
+    xlst->count = count;
+    for (long i = 0; i < count; i++)
+    {
+        xlst->lights[i] = *light_get_light(LIGHTS_COUNT + i);
+    }
+    LbMemorySet(&xlst->lights[count], 0, (LIGHTS_EXTRA_COUNT - count) * sizeof(struct Light));
+}
+
+/**
+ * Replaces extra lights with the ones from given state.
+ */
+void light_import_extra_lights(const struct LightExtraState *xlst)
+{
+    light_clear_extra_lights();
+    long count = xlst->count;
+    if ((count < 0) || (count > LIGHTS_EXTRA_COUNT))
+    {
+        WARNLOG("Invalid amount of extra lights, %ld",count);
+        count = 0;
+    }
+    while (light_extra_count < count)
+    {
+        if (!light_grow_extra_lights())
+        {
+            ERRORLOG("Cannot restore %ld extra lights",count);
+            count = light_extra_count;
+            break;
+        }
+    }
+    for (long i = 0; i < count; i++)
+    {
+        struct Light* lgt = light_get_light(LIGHTS_COUNT + i);
+        *lgt = xlst->lights[i];
+        // Shadow caches are not stored
+        lgt->shadow_index = 0;
+    }
 }
 
 TbBool lights_stats_debug_dump(void)
 {
-    long lights[LIGHTS_COUNT];
+    long lights[LIGHTS_MAX_COUNT];
     long lgh_things[THING_CLASSES_COUNT];
-    long shadowcs[SHADOW_CACHE_COUNT];
+    long shadowcs[SHADOW_CACHE_MAX_COUNT];
     long i;
-    for (i=0; i < SHADOW_CACHE_COUNT; i++)
+    for (i=0; i < shadow_caches.slots_count; i++)
     {
-        struct ShadowCache* shdc = &game.lish.shadow_cache[i];
+        struct ShadowCache* shdc = &shadow_caches.slots[i].cache;
         if ((shdc->flags & ShCF_Allocated) != 0)
             shadowcs[i] = -1;
         else
@@ -301,9 +508,9 @@ TbBool lights_stats_debug_dump(void)
     }
     long lgh_sttc = 0;
     long lgh_dynm = 0;
-    for (i=0; i < LIGHTS_COUNT; i++)
+    for (i=0; i < light_get_lights_count(); i++)
     {
-        struct Light* lgt = &game.lish.lights[i];
+        struct Light* lgt = light_get_light(i);
         if ((lgt->flags & LgtF_Allocated) != 0)
         {
             lights[i] = -1;
@@ -311,8 +518,11 @@ TbBool lights_stats_debug_dump(void)
                 lgh_dynm++;
             else
                 lgh_sttc++;
-            if ( (lgt->shadow_index > 0) && (lgt->shadow_index < SHADOW_CACHE_COUNT) )
+            if ( (lgt->shadow_index > 0) && (lgt->shadow_index < shadow_caches.slots_count) )
             {
+                if (shadow_caches.slots[lgt->shadow_index].owner != i) {
+                    WARNLOG("Shadow Cache %d is owned by light %d, but used by light %d!",(int)lgt->shadow_index,(int)shadow_caches.slots[lgt->shadow_index].owner,(int)i);
+                } else
                 if (shadowcs[lgt->shadow_index] == -1) {
                     shadowcs[lgt->shadow_index] = i;
                 } else
@@ -322,9 +532,9 @@ TbBool lights_stats_debug_dump(void)
                     WARNLOG("Shadow Cache %d is double-allocated, for lights %d and %d!",(int)lgt->shadow_index,(int)shadowcs[lgt->shadow_index],(int)i);
                 }
             } else
-            if ((lgt->flags & LgtF_Dynamic) != 0)
+            if (lgt->shadow_index != 0)
             {
-                WARNLOG("Dynamic light %d has bad Shadow Cache %d!",(int)i,(int)lgt->shadow_index);
+                WARNLOG("Light %d has bad Shadow Cache %d!",(int)i,(int)lgt->shadow_index);
             }
         } else {
             lights[i] = 0;
@@ -335,7 +545,7 @@ TbBool lights_stats_debug_dump(void)
         struct Thing* thing = thing_get(i);
         if (thing_exists(thing))
         {
-            if ((thing->light_id > 0) && (thing->light_id < LIGHTS_COUNT))
+            if ((thing->light_id > 0) && (thing->light_id < light_get_lights_count()))
             {
                 long n = 1000 + (long)thing->class_id;
                 if (lights[thing->light_id] == -1) {
@@ -354,7 +564,7 @@ TbBool lights_stats_debug_dump(void)
     long lgh_free = 0;
     for (i=0; i < THING_CLASSES_COUNT; i++)
         lgh_things[i] = 0;
-    for (i=0; i < LIGHTS_COUNT; i++)
+    for (i=0; i < light_get_lights_count(); i++)
     {
         if (lights[i] != 0)
         {
@@ -369,7 +579,7 @@ TbBool lights_stats_debug_dump(void)
     long shdc_free = 0;
     long shdc_used = 0;
     long shdc_linked = 0;
-    for (i=0; i < SHADOW_CACHE_COUNT; i++)
+    for (i=0; i < shadow_caches.slots_count; i++)
     {
         if (shadowcs[i] != 0)
         {
@@ -381,7 +591,8 @@ TbBool lights_stats_debug_dump(void)
         }
     }
     SYNCLOG("Lights: %ld free, %ld used; %ld static, %ld dynamic; for things:%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld",lgh_free,lgh_used,lgh_sttc,lgh_dynm,lgh_things[1],lgh_things[2],lgh_things[3],lgh_things[4],lgh_things[5],lgh_things[6],lgh_things[7],lgh_things[8],lgh_things[9],lgh_things[10],lgh_things[11],lgh_things[12],lgh_things[13]);
-    if ((shdc_used != shdc_linked) || (shdc_used != lgh_dynm))
+    SYNCLOG("Shadow caches: %ld free, %ld used; %lu hits, %lu misses, %lu evictions",shdc_free,shdc_used,shadow_caches.hits,shadow_caches.misses,shadow_caches.evictions);
+    if ((shdc_used != shdc_linked) || (shdc_used > lgh_dynm))
     {
         WARNLOG("Amount of shadow cache mismatches: %ld free, %ld used, %ld linked to lights, %d dyn. lights.",shdc_free,shdc_used,shdc_linked,light_total_dynamic_lights);
     }
@@ -403,7 +614,7 @@ void light_set_light_never_cache(long lgt_id)
         ERRORLOG("Attempt to set size of invalid light %d",(int)lgt_id);
         return;
     }
-    struct Light* lgt = &game.lish.lights[lgt_id];
+    struct Light* lgt = light_get_light(lgt_id);
     if ((lgt->flags & LgtF_Allocated) == 0)
     {
         ERRORLOG("Attempt to set size of unallocated light structure %d",(int)lgt_id);
@@ -416,7 +627,7 @@ long light_is_light_allocated(long lgt_id)
 {
     if (lgt_id <= 0)
         return false;
-    struct Light* lgt = &game.lish.lights[lgt_id];
+    struct Light* lgt = light_get_light(lgt_id);
     if ((lgt->flags & LgtF_Allocated) == 0)
         return false;
     return true;
@@ -428,7 +639,7 @@ void set_previous_light_position(struct Light *light) {
 
 void light_set_light_position(long lgt_id, struct Coord3d *pos)
 {
-  struct Light *lgt = &game.lish.lights[lgt_id];
+  struct Light *lgt = light_get_light(lgt_id);
 
   set_previous_light_position(lgt);
 
@@ -491,8 +702,8 @@ void light_remove_light_from_list(struct Light *lgt, struct StructureList *list)
     }
     else
     {
-      lgt2 = &game.lish.lights[list->index];
-      for ( i = 0; lgt2 != game.lish.lights; lgt2 = &game.lish.lights[lgt2->next_in_list] )
+      lgt2 = light_get_light(list->index);
+      for ( i = 0; lgt2 != &game.lish.lights[0]; lgt2 = light_get_light(lgt2->next_in_list) )
       {
         if ( lgt2 == lgt )
         {
@@ -522,9 +733,9 @@ void light_remove_light_from_list(struct Light *lgt, struct StructureList *list)
 void light_signal_stat_light_update_in_area(long x1, long y1, long x2, long y2)
 {
   int i = 0;
-  struct Light *lgt = &game.lish.lights[1];
-  do
+  for (long lgt_id = 1; lgt_id < light_get_lights_count(); lgt_id++)
   {
+    struct Light *lgt = light_get_light(lgt_id);
     if ( lgt->flags & LgtF_Allocated )
     {
       if ( !(lgt->flags & LgtF_Dynamic) )
@@ -541,18 +752,16 @@ void light_signal_stat_light_update_in_area(long x1, long y1, long x2, long y2)
         }
       }
     }
-    lgt++;
   }
-  while ( lgt < (struct Light *)game.lish.shadow_cache );
   if ( i )
     light_stat_light_map_clear_area(x1, y1, x2, y2);
 }
 
 void light_signal_update_in_area(long sx, long sy, long ex, long ey)
 {
-  struct Light *lgt = &game.lish.lights[1];
-  do
+  for (long lgt_id = 1; lgt_id < light_get_lights_count(); lgt_id++)
   {
+    struct Light *lgt = light_get_light(lgt_id);
     if ( lgt->flags & LgtF_Allocated )
     {
       if ( lgt->flags & LgtF_Dynamic )
@@ -564,9 +773,7 @@ void light_signal_update_in_area(long sx, long sy, long ex, long ey)
           lgt->flags |= LgtF_Unkn08;
       }
     }
-    lgt++;
   }
-  while ( lgt < (struct Light *)game.lish.shadow_cache );
   light_signal_stat_light_update_in_area(sx, sy, ex, ey);
 }
 
@@ -592,11 +799,11 @@ void light_signal_stat_light_update_in_own_radius(struct Light *lgt)
 
 void light_turn_light_off(long idx)
 {
-    if ((idx <= 0) || (idx >= LIGHTS_COUNT)) {
+    if ((idx <= 0) || (idx >= light_get_lights_count())) {
         ERRORLOG("Attempt to turn off light %d",(int)idx);
         return;
     }
-    struct Light* lgt = &game.lish.lights[idx];
+    struct Light* lgt = light_get_light(idx);
     if ((lgt->flags & LgtF_Allocated) == 0) {
         ERRORLOG("Attempt to turn off unallocated light structure");
         return;
@@ -616,11 +823,11 @@ void light_turn_light_off(long idx)
 
 void light_turn_light_on(long idx)
 {
-    if ((idx <= 0) || (idx >= LIGHTS_COUNT)) {
+    if ((idx <= 0) || (idx >= light_get_lights_count())) {
         ERRORLOG("Attempt to turn on light %d",(int)idx);
         return;
     }
-    struct Light* lgt = &game.lish.lights[idx];
+    struct Light* lgt = light_get_light(idx);
     if ((lgt->flags & LgtF_Allocated) == 0) {
         ERRORLOG("Attempt to turn on unallocated light structure %d",(int)idx);
         return;
@@ -645,9 +852,10 @@ unsigned char light_get_light_intensity(long idx)
 {
   if ( idx )
   {
-    if ( game.lish.lights[idx].flags & LgtF_Allocated )
+    struct Light *lgt = light_get_light(idx);
+    if ( lgt->flags & LgtF_Allocated )
     {
-      return game.lish.lights[idx].intensity;
+      return lgt->intensity;
     }
     else
     {
@@ -664,7 +872,7 @@ unsigned char light_get_light_intensity(long idx)
 
 void light_set_light_intensity(long idx, unsigned char intensity)
 {
-  struct Light *lgt = &game.lish.lights[idx];
+  struct Light *lgt = light_get_light(idx);
   long x1,x2,y1,y2;
   if ( !light_is_invalid(lgt) )
   {
@@ -722,20 +930,16 @@ void clear_stat_light_map(void)
 
 void light_delete_light(long idx)
 {
-    if ((idx <= 0) || (idx >= LIGHTS_COUNT)) {
+    if ((idx <= 0) || (idx >= light_get_lights_count())) {
         ERRORLOG("Attempt to delete light %d",(int)idx);
         return;
     }
-    struct Light* lgt = &game.lish.lights[idx];
+    struct Light* lgt = light_get_light(idx);
     if ((lgt->flags & LgtF_Allocated) == 0) {
         ERRORLOG("Attempt to delete unallocated light structure %d",(int)idx);
         return;
     }
-    if (lgt->shadow_index > 0)
-    {
-        struct ShadowCache* shdc = &game.lish.shadow_cache[lgt->shadow_index];
-        light_shadow_cache_free(shdc);
-    }
+    light_shadow_cache_free(lgt);
     if ((lgt->flags & LgtF_Dynamic) != 0)
     {
         light_total_dynamic_lights--;
@@ -1458,15 +1662,93 @@ void light_initialise_lighting_tables(void)
   game.lish.lighting_tables_count = sizeof(values) / sizeof(*values);
 }
 
+/**
+ * Prepares shadow geometry of lighting tables items; the tables are either initialised or loaded with the game.
+ * For every subtile, stores its quadrant and which corners limit the shadow it casts.
+ */
+static void light_initialise_shadow_geometry(void)
+{
+    for (int i = 0; i < game.lish.lighting_tables_count; i++)
+    {
+        const struct LightingTable *lttbl = &game.lish.lighting_tables[i];
+        struct LightShadowGeometry *geom = &light_shadow_geometry[i];
+        int delta_x = lttbl->delta_x;
+        int delta_y = lttbl->delta_y;
+        if ((delta_x < -LIGHT_SHADOW_DELTA_MAX) || (delta_x > LIGHT_SHADOW_DELTA_MAX) ||
+            (delta_y < -LIGHT_SHADOW_DELTA_MAX) || (delta_y > LIGHT_SHADOW_DELTA_MAX))
+        {
+            ERRORLOG("Lighting table item %d is too far from the light", i);
+            delta_x = 0;
+            delta_y = 0;
+        }
+        if (delta_x < 0) {
+            geom->quadrant = (delta_y < 0) ? 4 : 3;
+        } else {
+            geom->quadrant = (delta_y < 0) ? 1 : 2;
+        }
+        // Offsets of the corners, relative to top left corner of the subtile
+        int start_x;
+        int start_y;
+        int end_x;
+        int end_y;
+        if (delta_x == 0)
+        {
+            if (delta_y >= 0) {
+                start_x = 1; start_y = 0; end_x = 0; end_y = 0;
+            } else {
+                start_x = 0; start_y = 1; end_x = 1; end_y = 1;
+            }
+        } else
+        if (delta_y == 0)
+        {
+            if (delta_x > 0) {
+                start_x = 0; start_y = 0; end_x = 0; end_y = 1;
+            } else {
+                start_x = 1; start_y = 1; end_x = 1; end_y = 0;
+            }
+        } else
+        {
+            switch (geom->quadrant)
+            {
+            case 1:
+                start_x = 0; start_y = 0; end_x = 1; end_y = 1;
+                break;
+            case 2:
+                start_x = 1; start_y = 0; end_x = 0; end_y = 1;
+                break;
+            case 3:
+                start_x = 1; start_y = 1; end_x = 0; end_y = 0;
+                break;
+            case 4:
+            default:
+                start_x = 0; start_y = 1; end_x = 1; end_y = 0;
+                break;
+            }
+        }
+        geom->corner_x = LIGHT_SHADOW_DELTA_MAX + delta_x;
+        geom->corner_y = LIGHT_SHADOW_DELTA_MAX + delta_y;
+        geom->start_x = LIGHT_SHADOW_DELTA_MAX + delta_x + start_x;
+        geom->start_y = LIGHT_SHADOW_DELTA_MAX + delta_y + start_y;
+        geom->end_x = LIGHT_SHADOW_DELTA_MAX + delta_x + end_x;
+        geom->end_y = LIGHT_SHADOW_DELTA_MAX + delta_y + end_y;
+        // Shadow of subtiles straight above the light starts one unit to the left
+        if ((delta_x == 0) && (delta_y < 0)) {
+            geom->start_x = LIGHT_SHADOW_LATTICE_LEFT;
+        }
+    }
+}
+
 void light_initialise(void)
 {
     int i;
-    for (i=0; i < LIGHTS_COUNT; i++)
+    for (i=0; i < light_get_lights_count(); i++)
     {
-        struct Light* lgt = &game.lish.lights[i];
+        struct Light* lgt = light_get_light(i);
         if ((lgt->flags & LgtF_Allocated) != 0)
             light_delete_light(lgt->index);
     }
+    light_clear_extra_lights();
+    light_shadow_caches_clear();
     if (!game.lish.lighting_tables_initialised)
     {
         light_initialise_lighting_tables();
@@ -1475,6 +1757,7 @@ void light_initialise(void)
         }
         game.lish.lighting_tables_initialised = true;
     }
+    light_initialise_shadow_geometry();
     stat_light_needs_updating = 1;
     light_total_dynamic_lights = 0;
     light_total_stat_lights = 0;
@@ -1542,95 +1825,63 @@ void light_set_lights_on(char state)
     light_signal_stat_light_update_in_area(1, 1, gameadd.map_subtiles_x, gameadd.map_subtiles_y);
 }
 
-static long calculate_shadow_angle(
-        unsigned int pos_x,
-        unsigned int pos_y,
-        int quadrant,
-        MapSubtlCoord stl_x,
-        MapSubtlCoord stl_y,
-        long *shadow_limit_idx_start,
-        long *shadow_limit_idx_end)
+/**
+ * Fills angles from given light to corners of subtiles within given distance from it.
+ * The angles depend only on position of the light within its subtile.
+ */
+static void light_fill_corner_angles(const struct Light *lgt, int delta_max)
 {
-    MapSubtlCoord x = coord_subtile(pos_x);
-    MapSubtlCoord y = coord_subtile(pos_y);
-    long shadow_end;
-    long result;
-    long shadow_start = 0;
-
-  if ( x == stl_x )
-  {
-    if ( y <= stl_y )
-    {
-      shadow_start = LbArcTanAngle(subtile_coord(stl_x + 1, 0) - pos_x, subtile_coord(stl_y, 0) - pos_y) & LbFPMath_AngleMask;
-      shadow_end = LbArcTanAngle(subtile_coord(stl_x, 0) - pos_x, subtile_coord(stl_y, 0) - pos_y) & LbFPMath_AngleMask;
-    }
-    else
+    if (delta_max > LIGHT_SHADOW_DELTA_MAX)
+        delta_max = LIGHT_SHADOW_DELTA_MAX;
+    long pos_x = lgt->mappos.x.stl.pos;
+    long pos_y = lgt->mappos.y.stl.pos;
+    int first = LIGHT_SHADOW_DELTA_MAX - delta_max;
+    int last = LIGHT_SHADOW_DELTA_MAX + delta_max + 1;
+    for (int i = first; i <= last; i++)
     {
-      shadow_start = LbArcTanAngle(subtile_coord(stl_x, 0) - pos_x - 1, subtile_coord(stl_y + 1, 0) - pos_y) & LbFPMath_AngleMask;
-      shadow_end = LbArcTanAngle(subtile_coord(stl_x + 1, 0) - pos_x, subtile_coord(stl_y + 1, 0) - pos_y) & LbFPMath_AngleMask;
-    }
-  }
-  else if ( y == stl_y )
-  {
-    if ( x <= stl_x )
-    {
-      shadow_start = LbArcTanAngle(subtile_coord(stl_x, 0) - pos_x, subtile_coord(stl_y, 0) - pos_y) & LbFPMath_AngleMask;
-      shadow_end = LbArcTanAngle(subtile_coord(stl_x, 0) - pos_x, subtile_coord(stl_y + 1, 0) - pos_y) & LbFPMath_AngleMask;
-    }
-    else
-    {
-      shadow_start = LbArcTanAngle(subtile_coord(stl_x + 1, 0) - pos_x, subtile_coord(stl_y + 1, 0) - pos_y) & LbFPMath_AngleMask;
-      shadow_end = LbArcTanAngle(subtile_coord(stl_x + 1, 0) - pos_x, subtile_coord(stl_y, 0) - pos_y) & LbFPMath_AngleMask;
-    }
-  }
-  else
-  {
-    switch ( quadrant )
-    {
-      case 1:
-        shadow_start = LbArcTanAngle(subtile_coord(stl_x, 0) - pos_x, subtile_coord(stl_y, 0) - pos_y) & LbFPMath_AngleMask;
-        shadow_end = LbArcTanAngle(subtile_coord(stl_x + 1, 0) - pos_x, subtile_coord(stl_y + 1, 0) - pos_y) & LbFPMath_AngleMask;
-        break;
-      case 2:
-        shadow_start = LbArcTanAngle(subtile_coord(stl_x + 1, 0) - pos_x, subtile_coord(stl_y, 0) - pos_y) & LbFPMath_AngleMask;
-        shadow_end = LbArcTanAngle(subtile_coord(stl_x, 0) - pos_x, subtile_coord(stl_y + 1, 0) - pos_y) & LbFPMath_AngleMask;
-        break;
-      case 3:
-        shadow_start = LbArcTanAngle(subtile_coord(stl_x + 1, 0) - pos_x, subtile_coord(stl_y + 1, 0) - pos_y) & LbFPMath_AngleMask;
-        shadow_end = LbArcTanAngle(subtile_coord(stl_x, 0) - pos_x, subtile_coord(stl_y, 0) - pos_y) & LbFPMath_AngleMask;
-        break;
-      case 4:
-        shadow_start = LbArcTanAngle(subtile_coord(stl_x, 0) - pos_x, subtile_coord(stl_y + 1, 0) - pos_y) & LbFPMath_AngleMask;
-        shadow_end = LbArcTanAngle(subtile_coord(stl_x + 1, 0) - pos_x, subtile_coord(stl_y, 0) - pos_y) & LbFPMath_AngleMask;
-        break;
-      default:
-        shadow_end = shadow_start;
-        break;
+        short *angles = light_corner_angles[i];
+        long coord_y = (i - LIGHT_SHADOW_DELTA_MAX) * COORD_PER_STL - pos_y;
+        for (int k = first; k <= last; k++)
+        {
+            angles[k] = LbArcTanAngle((k - LIGHT_SHADOW_DELTA_MAX) * COORD_PER_STL - pos_x, coord_y) & LbFPMath_AngleMask;
+        }
+        angles[LIGHT_SHADOW_LATTICE_LEFT] = LbArcTanAngle(-pos_x - 1, coord_y) & LbFPMath_AngleMask;
     }
-  }
-  if ( (shadow_start / 512) << 9 != shadow_start )
-    shadow_start = (shadow_start + 1) & LbFPMath_AngleMask;
-  if ( (shadow_end / 512) << 9 != shadow_end )
-    shadow_end = (shadow_end - 1) & LbFPMath_AngleMask;
-  result = shadow_start;
-  *shadow_limit_idx_start = shadow_start;
-  *shadow_limit_idx_end = shadow_end;
-  return result;
 }
 
-static TbBool point_is_above_floor(MapSubtlCoord stl_x, MapSubtlCoord stl_y, MapSubtlCoord stl_z)
+/**
+ * Returns angle from the light to top left corner of given lighting table item.
+ * Requires light_fill_corner_angles() to be called for the light first.
+ */
+static long light_get_corner_angle(const struct LightShadowGeometry *geom)
 {
-    struct Column *col = get_column_at(stl_x, stl_y);
-    return (get_column_floor_filled_subtiles(col) > stl_z);
+    return light_corner_angles[geom->corner_y][geom->corner_x];
+}
+
+/**
+ * Gives shadow limits cast by subtile of given lighting table item.
+ * Requires light_fill_corner_angles() to be called for the light first.
+ */
+static void light_get_shadow_angles(const struct LightShadowGeometry *geom, long *shadow_limit_idx_start, long *shadow_limit_idx_end)
+{
+    long shadow_start = light_corner_angles[geom->start_y][geom->start_x];
+    long shadow_end = light_corner_angles[geom->end_y][geom->end_x];
+    if ( (shadow_start / 512) << 9 != shadow_start )
+        shadow_start = (shadow_start + 1) & LbFPMath_AngleMask;
+    if ( (shadow_end / 512) << 9 != shadow_end )
+        shadow_end = (shadow_end - 1) & LbFPMath_AngleMask;
+    *shadow_limit_idx_start = shadow_start;
+    *shadow_limit_idx_end = shadow_end;
 }
 
 //used for the hand and the illuminated property of creatures
 static char light_render_light_dynamic_uncached(struct Light *lgt, int radius, int intensity, unsigned int max_1DD41_idx)
 {
     clear_shadow_limits(&game.lish);
-    unsigned int lighting_tables_idx = get_floor_filled_subtiles_at(lgt->mappos.x.stl.num, lgt->mappos.y.stl.num);
+    unsigned int lighting_tables_idx = get_floor_filled_subtiles_cached(lgt->mappos.x.stl.num, lgt->mappos.y.stl.num);
     if ( lighting_tables_idx <= lgt->mappos.z.stl.num )
     {
+        light_fill_corner_angles(lgt, max_1DD41_idx);
         int unk_4_x = lgt->mappos.x.stl.pos;
         int unk_4_y = lgt->mappos.y.stl.pos;
         int diagonal_length = LbDiagonalLength(unk_4_x, unk_4_y);
@@ -1652,35 +1903,14 @@ static char light_render_light_dynamic_uncached(struct Light *lgt, int radius, i
                 MapSubtlCoord stl_y = lgt->mappos.y.stl.num + lighting_table_pointer->delta_y;
                 if (!subtile_coords_invalid(stl_x, stl_y))
                 {
-                    int quadrant;
-                    long shadow_limit_idx1 = LbArcTanAngle((stl_x << 8) - lgt->mappos.x.val, (stl_y << 8) - lgt->mappos.y.val) & LbFPMath_AngleMask;
-                    if ( stl_x < lgt->mappos.x.stl.num )
-                    {
-                        if (stl_y < lgt->mappos.y.stl.num)
-                        {
-                            quadrant = 4;
-                        }
-                        else
-                        {
-                            quadrant = 3;
-                        }
-                    }
-                    else
-                    {
-                        if (stl_y < lgt->mappos.y.stl.num)
-                        {
-                            quadrant = 1;
-                        }
-                        else
-                        {
-                            quadrant = 2;
-                        }
-                    }
+                    const struct LightShadowGeometry *geom = &light_shadow_geometry[lighting_table_pointer - &game.lish.lighting_tables[0]];
+                    int quadrant = geom->quadrant;
+                    long shadow_limit_idx1 = light_get_corner_angle(geom);
                     long shadow_limit_idx2, shadow_limit_idx3;
-                    unsigned char height = get_floor_filled_subtiles_at(stl_x, stl_y);
+                    unsigned char height = get_floor_filled_subtiles_cached(stl_x, stl_y);
                     if ( game.lish.shadow_limits[shadow_limit_idx1] )
                     {
-                        calculate_shadow_angle(lgt->mappos.x.val, lgt->mappos.y.val, quadrant, stl_x, stl_y, &shadow_limit_idx2, &shadow_limit_idx3);
+                        light_get_shadow_angles(geom, &shadow_limit_idx2, &shadow_limit_idx3);
                         if ( (!game.lish.shadow_limits[shadow_limit_idx2] || !game.lish.shadow_limits[shadow_limit_idx3])
                             && height > lgt->mappos.z.stl.num )
                         {
@@ -1692,7 +1922,7 @@ static char light_render_light_dynamic_uncached(struct Light *lgt, int radius, i
                         TbBool too_high = (height > lgt->mappos.z.stl.num);
                         if ( height > lgt->mappos.z.stl.num )
                         {
-                            calculate_shadow_angle(lgt->mappos.x.val, lgt->mappos.y.val, quadrant, stl_x, stl_y, &shadow_limit_idx2, &shadow_limit_idx3);
+                            light_get_shadow_angles(geom, &shadow_limit_idx2, &shadow_limit_idx3);
                             create_shadow_limits(&game.lish, shadow_limit_idx2, shadow_limit_idx3);
                         }
                         TbBool v24;
@@ -1701,10 +1931,10 @@ static char light_render_light_dynamic_uncached(struct Light *lgt, int radius, i
                         switch ( quadrant )
                         {
                             case 1:
-                            v24 = ( get_floor_filled_subtiles_at(stl_x - 1, stl_y - 1) <= lgt->mappos.z.stl.num );
+                            v24 = ( get_floor_filled_subtiles_cached(stl_x - 1, stl_y - 1) <= lgt->mappos.z.stl.num );
                             break;
                             case 3:
-                            v24 = ( !point_is_above_floor(stl_x, stl_y - 1, lgt->mappos.z.stl.num) );
+                            v24 = ( get_floor_filled_subtiles_cached(stl_x, stl_y - 1) <= lgt->mappos.z.stl.num );
                             break;
                             case 4:
                             v24 = false;
@@ -1745,13 +1975,13 @@ static char light_render_light_dynamic(struct Light *lgt, int radius, int render
 {
     unsigned char *shadow_limits;
     struct LightsShadows *lish = &game.lish;
-    struct ShadowCache *shadow_cache = &lish->shadow_cache[lgt->shadow_index];
+    struct ShadowCache *shadow_cache = light_get_shadow_cache(lgt);
     clear_shadow_limits(lish);
     memset(shadow_cache->field_1, 0, 0x80u);
-    const struct Column *col = get_column_at(lgt->mappos.x.val + 1, lgt->mappos.y.val + 1);
     SubtlCodedCoords stl_num = get_subtile_number(lgt->mappos.x.stl.num, lgt->mappos.y.stl.num);
-    if (get_column_floor_filled_subtiles(col) <= lgt->mappos.z.stl.num)
+    if (get_floor_filled_subtiles_cached(lgt->mappos.x.val + 1, lgt->mappos.y.val + 1) <= lgt->mappos.z.stl.num)
     {
+        light_fill_corner_angles(lgt, lighting_tables_idx);
         shadow_cache->field_1[lighting_tables_idx] |= 1 << (31 - lighting_tables_idx);
         int diagonal_length = LbDiagonalLength(lgt->mappos.x.stl.pos, lgt->mappos.y.stl.pos);
         int intensity = render_intensity * (radius - diagonal_length) / radius;
@@ -1776,37 +2006,28 @@ static char light_render_light_dynamic(struct Light *lgt, int radius, int render
                 {
                     unsigned int coord_y = stl_y << 8; // must be unsigned
                     unsigned int coord_x = stl_x << 8; // must be unsigned
-                    int angle = LbArcTanAngle(coord_x - lgt->mappos.x.val, coord_y - lgt->mappos.y.val) & LbFPMath_AngleMask;
-                    int quadrant;
-                    if (stl_x < lgt->mappos.x.stl.num)
-                    {
-                        quadrant = (stl_y < lgt->mappos.y.stl.num) + 3;
-                    }
-                    else
-                    {
-                        quadrant = 2 - (stl_y < lgt->mappos.y.stl.num);
-                    }
+                    const struct LightShadowGeometry *geom = &light_shadow_geometry[lighting_table - &lish->lighting_tables[0]];
+                    int angle = light_get_corner_angle(geom);
+                    int quadrant = geom->quadrant;
                     unsigned char shadow_limit = lish->shadow_limits[angle];
                     long shadow_limit_idx;
                     long shadow_limit_idx2;
                     if (shadow_limit)
                     {
-                        calculate_shadow_angle(lgt->mappos.x.val, lgt->mappos.y.val, quadrant, stl_x, stl_y, &shadow_limit_idx, &shadow_limit_idx2);
-                        const struct Column *col2 = get_column_at(stl_x + 1, stl_y + 1);
-                        if (((!lish->shadow_limits[shadow_limit_idx]) || (!lish->shadow_limits[shadow_limit_idx2])) && (get_column_floor_filled_subtiles(col2) > lgt->mappos.z.stl.num))
+                        light_get_shadow_angles(geom, &shadow_limit_idx, &shadow_limit_idx2);
+                        if (((!lish->shadow_limits[shadow_limit_idx]) || (!lish->shadow_limits[shadow_limit_idx2])) && (get_floor_filled_subtiles_cached(stl_x + 1, stl_y + 1) > lgt->mappos.z.stl.num))
                         {
                             create_shadow_limits(lish, shadow_limit_idx, shadow_limit_idx2);
                         }
                     }
                     else
                     {
-                        const struct Column *col3 = get_column_at(stl_x, stl_y);
-                        int height = get_column_floor_filled_subtiles(col3);
+                        int height = get_floor_filled_subtiles_cached(stl_x, stl_y);
                         TbBool too_high = (height > lgt->mappos.z.stl.num);
                         unsigned int shadow;
                         if (too_high)
                         {
-                            calculate_shadow_angle(lgt->mappos.x.val, lgt->mappos.y.val, quadrant, stl_x, stl_y, &shadow_limit_idx, &shadow_limit_idx2);
+                            light_get_shadow_angles(geom, &shadow_limit_idx, &shadow_limit_idx2);
                             if (shadow_limit_idx2 < shadow_limit_idx)
                             {
                                 memset(&lish->shadow_limits[shadow_limit_idx], 1u, 2047 - shadow_limit_idx);
@@ -1827,13 +2048,12 @@ static char light_render_light_dynamic(struct Light *lgt, int radius, int render
                             {
                                 case 1:
                                 {
-                                    const struct Column *col4 = get_column_at(stl_x, stl_y + 1);
-                                    bool_2 = (get_column_floor_filled_subtiles(col4) <= lgt->mappos.z.stl.num);
+                                    bool_2 = (get_floor_filled_subtiles_cached(stl_x, stl_y + 1) <= lgt->mappos.z.stl.num);
                                     break;
                                 }
                                 case 3:
                                 {
-                                    bool_2 = (!point_is_above_floor(stl_x, stl_y - 1, lgt->mappos.z.stl.num));
+                                    bool_2 = (get_floor_filled_subtiles_cached(stl_x, stl_y - 1) <= lgt->mappos.z.stl.num);
                                     break;
                                 }
                                 case 4:
@@ -1883,10 +2103,10 @@ static int light_render_light_static(struct Light *lgt, int radius, int intensit
 {
     struct LightsShadows *lish = &game.lish;
     clear_shadow_limits(lish);
-    struct Column *col = get_column_at(lgt->mappos.x.stl.num, lgt->mappos.y.stl.num);
-    int floor_filled_stls = get_column_floor_filled_subtiles(col);
+    int floor_filled_stls = get_floor_filled_subtiles_cached(lgt->mappos.x.stl.num, lgt->mappos.y.stl.num);
     if (floor_filled_stls <= lgt->mappos.z.stl.num)
     {
+        light_fill_corner_angles(lgt, stl_num);
         signed int x = lgt->mappos.x.stl.pos;
         signed int y = lgt->mappos.y.stl.pos;
         int diagonal_length = LbDiagonalLength(x, y);
@@ -1910,36 +2130,26 @@ static int light_render_light_static(struct Light *lgt, int radius, int intensit
             MapSubtlCoord stl_y = lish->lighting_tables[lighting_table_idx].delta_y + lgt->mappos.y.stl.num;
             if (!subtile_coords_invalid(stl_x, stl_y))
             {
-                unsigned char quadrant;
-                if (stl_x < lgt->mappos.x.stl.num)
-                {
-                    quadrant = (stl_y < lgt->mappos.y.stl.num) + 3;
-                }
-                else
-                {
-                    quadrant = 2 - (stl_y < lgt->mappos.y.stl.num);
-                }
-                MapCoord coord_x = subtile_coord(stl_x, 0);
-                MapCoord coord_y = subtile_coord(stl_y, 0);
-                long angle = LbArcTanAngle(coord_x - lgt->mappos.x.val, coord_y - lgt->mappos.y.val) & LbFPMath_AngleMask;
+                const struct LightShadowGeometry *geom = &light_shadow_geometry[lighting_table_idx];
+                unsigned char quadrant = geom->quadrant;
+                long angle = light_get_corner_angle(geom);
                 unsigned char shadow_limit = lish->shadow_limits[angle];
                 long shadow_start, shadow_end;
-                col = get_column_at(stl_x, stl_y);
+                int height = get_floor_filled_subtiles_cached(stl_x, stl_y);
                 if (shadow_limit)
                 {
-                    calculate_shadow_angle(lgt->mappos.x.val, lgt->mappos.y.val, quadrant, stl_x, stl_y, &shadow_start, &shadow_end);
-                    if (((!lish->shadow_limits[shadow_start]) || (!lish->shadow_limits[shadow_end])) && (get_column_floor_filled_subtiles(col) > lgt->mappos.z.stl.num))
+                    light_get_shadow_angles(geom, &shadow_start, &shadow_end);
+                    if (((!lish->shadow_limits[shadow_start]) || (!lish->shadow_limits[shadow_end])) && (height > lgt->mappos.z.stl.num))
                     {
                         create_shadow_limits(lish, shadow_start, shadow_end);
                     }
                 }
                 else
                 {
-                    int height = get_column_floor_filled_subtiles(col);
                     TbBool too_high = (height > lgt->mappos.z.stl.num);
                     if (height > lgt->mappos.z.stl.num)
                     {
-                        calculate_shadow_angle(lgt->mappos.x.val, lgt->mappos.y.val, quadrant, stl_x, stl_y, &shadow_start, &shadow_end);
+                        light_get_shadow_angles(geom, &shadow_start, &shadow_end);
                         create_shadow_limits(lish, shadow_start, shadow_end);
                     }
                     TbBool v24 = false;
@@ -1950,12 +2160,12 @@ static int light_render_light_static(struct Light *lgt, int radius, int intensit
                         {
                             case 1:
                             {
-                                v24 = (get_column_floor_filled_subtiles(col) <= lgt->mappos.z.stl.num);
+                                v24 = (height <= lgt->mappos.z.stl.num);
                                 break;
                             }
                             case 3:
                             {
-                                v24 = (!point_is_above_floor(stl_x, stl_y - 1, lgt->mappos.z.stl.num));
+                                v24 = (get_floor_filled_subtiles_cached(stl_x, stl_y - 1) <= lgt->mappos.z.stl.num);
                                 break;
                             }
                             case 4:
@@ -2062,7 +2272,26 @@ static char light_render_light(struct Light* lgt)
   {
     if ( is_dynamic )
     {
-      if ( (lgt->flags & LgtF_NeverCached) != 0 )
+      struct ShadowCache *shdc = NULL;
+      if ( (lgt->flags & LgtF_NeverCached) == 0 )
+      {
+        shdc = light_get_shadow_cache(lgt);
+        if ( shdc == NULL )
+        {
+          // Either the light was never rendered, or its cache was taken by another light
+          shdc = light_allocate_shadow_cache(lgt);
+          lgt->flags |= LgtF_Unkn08;
+        }
+        if ( shdc != NULL )
+        {
+          shadow_caches.slots[lgt->shadow_index].last_turn = game.play_gameturn;
+          if ( (lgt->flags & LgtF_Unkn08) != 0 )
+            shadow_caches.misses++;
+          else
+            shadow_caches.hits++;
+        }
+      }
+      if ( shdc == NULL )
       {
         lighting_tables_idx = light_render_light_dynamic_uncached(lgt, radius, render_intensity, lighting_tables_idx);
       }
@@ -2102,7 +2331,6 @@ static char light_render_light(struct Light* lgt)
         MapSubtlCoord stl_y = coord_subtile(y_start);
         int v33 = stl_x - coord_subtile(x_end) + gameadd.map_subtiles_x;
         unsigned short* lightness = &game.lish.subtile_lightness[get_subtile_number(stl_x, stl_y)];
-        struct ShadowCache *shdc = &game.lish.shadow_cache[lgt->shadow_index];
         lighting_tables_idx = *shdc->field_1;
         if ( y_end >= y_start )
         {
@@ -2164,9 +2392,9 @@ static void light_render_area(MapSubtlCoord startx, MapSubtlCoord starty, MapSub
   // this block applies to static lights
   if ( game.lish.light_enabled )
   {
-    for ( lgt = &game.lish.lights[game.thing_lists[TngList_StaticLights].index];
-          lgt > game.lish.lights;
-          lgt = &game.lish.lights[lgt->next_in_list] )
+    for ( lgt = light_get_light(game.thing_lists[TngList_StaticLights].index);
+          lgt != &game.lish.lights[0];
+          lgt = light_get_light(lgt->next_in_list) )
     {
       if ( (lgt->flags & (LgtF_Unkn80 | LgtF_Unkn08)) != 0 )
       {
@@ -2208,7 +2436,7 @@ static void light_render_area(MapSubtlCoord startx, MapSubtlCoord starty, MapSub
 
   if ( game.lish.light_enabled )
   {
-    for ( lgt = &game.lish.lights[game.thing_lists[TngList_DynamLights].index]; lgt > game.lish.lights; lgt = &game.lish.lights[lgt->next_in_list] )
+    for ( lgt = light_get_light(game.thing_lists[TngList_DynamLights].index); lgt != &game.lish.lights[0]; lgt = light_get_light(lgt->next_in_list) )
     {
       range = lgt->range;
       if ( (int)abs(half_width_x + startx - lgt->mappos.x.stl.num) < half_width_x + range
@@ -2337,7 +2565,7 @@ void light_set_light_minimum_size_to_cache(long lgt_id, long min_radius, long mi
   struct Light *lgt;
   if ( lgt_id )
   {
-    lgt = &game.lish.lights[lgt_id];
+    lgt = light_get_light(lgt_id);
     if ( lgt->flags & LgtF_Allocated )
     {
       if ( lgt->flags & LgtF_Unkn02 )
@@ -23,7 +23,11 @@
 #include "bflib_basics.h"
 
 #define LIGHT_MAX_RANGE       256 // Large enough to cover the whole map
+/** Amount of lights stored within the game structure. */
 #define LIGHTS_COUNT          400
+/** Amount of lights which may be allocated when these within game structure run out. */
+#define LIGHTS_EXTRA_COUNT   1600
+#define LIGHTS_MAX_COUNT     (LIGHTS_COUNT+LIGHTS_EXTRA_COUNT)
 #define MINIMUM_LIGHTNESS    8192
 
 #ifdef __cplusplus
@@ -102,16 +106,29 @@ struct LightSystemState {
     long out_of_date_stat_lights;
 };
 
+/** Lights which do not fit into the game structure, in a form which can be stored.
+ * Kept apart from GameAdd, so that its layout doesn't depend on them.
+ */
+struct LightExtraState {
+    /** Amount of extra light slots up to the last allocated light. */
+    long count;
+    struct Light lights[LIGHTS_EXTRA_COUNT];
+};
+
 /******************************************************************************/
 
 #pragma pack()
 
 typedef struct VALUE VALUE;
 
+/******************************************************************************/
+extern struct LightExtraState light_extra_state;
 /******************************************************************************/
 void clear_stat_light_map(void);
 void update_light_render_area(void);
 void light_delete_light(long idx);
+struct Light *light_get_light(long idx);
+void light_clear_extra_lights(void);
 void light_initialise(void);
 void light_turn_light_off(long num);
 void light_turn_light_on(long num);
@@ -129,6 +146,8 @@ void light_signal_update_in_area(long sx, long sy, long ex, long ey);
 long light_get_total_dynamic_lights(void);
 void light_export_system_state(struct LightSystemState *lightst);
 void light_import_system_state(const struct LightSystemState *lightst);
+void light_export_extra_lights(struct LightExtraState *xlst);
+void light_import_extra_lights(const struct LightExtraState *xlst);
 TbBool lights_stats_debug_dump(void);
 void light_signal_stat_light_update_in_area(long x1, long y1, long x2, long y2);
 
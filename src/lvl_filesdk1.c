@@ -33,6 +33,7 @@
 #include "config_slabsets.h"
 #include "config_terrain.h"
 #include "light_data.h"
+#include "map_blocks.h"
 #include "map_ceiling.h"
 #include "map_utils.h"
 #include "thing_factory.h"
@@ -737,6 +738,7 @@ TbBool load_map_data_file(LevelNumber lv_num)
             mapblk->revealed = 0;
         }
     }
+    map_solidity_invalidate_all();
     return true;
 }
 
@@ -1255,6 +1257,7 @@ short load_map_slab_file(unsigned long lv_num)
         i += 2;
       }
     LbMemoryFree(buf);
+    clear_gold_veins();
     initialise_map_collides();
     initialise_map_health();
     initialise_extra_slab_info(lv_num);
@@ -1298,14 +1301,14 @@ static TbBool load_static_light_file(unsigned long lv_num)
         total = (fsize-4)/sizeof(struct LegacyInitLight);
         WARNMSG("Bad amount of static lights in LGT file; corrected to %ld.",total);
     }
-    if (total >= LIGHTS_COUNT)
+    if (total >= LIGHTS_MAX_COUNT)
     {
-        WARNMSG("Only %d static lights supported, LGT file has %ld.",LIGHTS_COUNT,total);
-        total = LIGHTS_COUNT-1;
+        WARNMSG("Only %d static lights supported, LGT file has %ld.",LIGHTS_MAX_COUNT,total);
+        total = LIGHTS_MAX_COUNT-1;
     } else
-    if (total >= LIGHTS_COUNT/2)
+    if (total >= LIGHTS_MAX_COUNT/2)
     {
-        WARNMSG("More than %d%% of light slots used by static lights.",100*total/LIGHTS_COUNT);
+        WARNMSG("More than %d%% of light slots used by static lights.",100*total/LIGHTS_MAX_COUNT);
     }
     // Create the lights
     for (long k = 0; k < total; k++)
@@ -1335,11 +1338,11 @@ static TbBool load_static_light_file(unsigned long lv_num)
 static TbBool load_lgtfx_file(unsigned long lv_num)
 {
     TbBool ret = load_kfx_toml_file(lv_num, "lgtfx", "LGTFX",
-                             "light", "LightsCount", "light%d", LIGHTS_COUNT - 1,
+                             "light", "LightsCount", "light%d", LIGHTS_MAX_COUNT - 1,
                              &light_create_light_adv);
-    if (light_count_lights() > LIGHTS_COUNT / 2)
+    if (light_count_lights() > LIGHTS_MAX_COUNT / 2)
     {
-        WARNMSG("More than %d%% of light slots used by static lights.", 100*light_count_lights()/LIGHTS_COUNT);
+        WARNMSG("More than %d%% of light slots used by static lights.", 100*light_count_lights()/LIGHTS_MAX_COUNT);
     }
     return ret;
 }
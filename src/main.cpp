@@ -23,6 +23,7 @@
 #include "bflib_keybrd.h"
 #include "bflib_inputctrl.h"
 #include "bflib_datetm.h"
+#include "bflib_jobs.h"
 #include "bflib_sprfnt.h"
 #include "bflib_fileio.h"
 #include "bflib_dernc.h"
@@ -50,6 +51,8 @@
 #include "vidmode.h"
 #include "kjm_input.h"
 #include "packets.h"
+#include "packets_stream.h"
+#include "net_desync.h"
 #include "config.h"
 #include "config_strings.h"
 #include "config_campaigns.h"
@@ -119,6 +122,8 @@
 #include "room_list.h"
 #include "game_loop.h"
 #include "music_player.h"
+#include "game_bench.h"
+#include "game_profiler.h"
 
 #ifdef AUTOTESTING
 #include "event_monitoring.h"
@@ -1578,7 +1583,9 @@ void reinit_level_after_load(void)
     player = get_my_player();
     player->lens_palette = 0;
     init_lookups();
+    map_solidity_invalidate_all();
     init_navigation();
+    clear_gold_veins();
     reinit_packets_after_load();
     game.flags_font |= start_params.flags_font;
     parchment_loaded = 0;
@@ -1620,6 +1627,7 @@ TbBool set_default_startup_parameters(void)
     set_flag_byte(&start_params.flags_cd,MFlg_IsDemoMode,false);
     set_flag_byte(&start_params.flags_cd,MFlg_unk40,true);
     start_params.force_ppro_poly = 0;
+    start_params.jobs_count = -1;
     return true;
 }
 
@@ -1662,6 +1670,7 @@ void clear_things_and_persons_data(void)
         thing->mappos.x.val = subtile_coord_center(gameadd.map_subtiles_x/2);
         thing->mappos.y.val = subtile_coord_center(gameadd.map_subtiles_y/2);
     }
+    things_sweep_rebuild();
     for (i=0; i < CREATURES_COUNT; i++)
     {
       memset(&game.cctrl_data[i], 0, sizeof(struct CreatureControl));
@@ -2177,7 +2186,7 @@ void interp_fix_mouse_light_off_map(struct PlayerInfo *player)
 {
     // This fixes the interpolation issue of moving the mouse off map in one position then back onto the map far elsewhere.
     struct PlayerInfoAdd* playeradd = get_playeradd(player->id_number);
-    struct Light* light = &game.lish.lights[player->cursor_light_idx];
+    struct Light* light = light_get_light(player->cursor_light_idx);
 
     if (playeradd->mouse_is_offmap == true) {
         light->disable_interp_for_turns = 2;
@@ -2747,7 +2756,9 @@ void update(void)
     struct PlayerInfo *player;
     SYNCDBG(4,"Starting for turn %ld",(long)game.play_gameturn);
 
+    PROFILER_BEGIN(PrfSec_Packets);
     process_packets();
+    PROFILER_END(PrfSec_Packets);
     if (quit_game || exit_keeper) {
         return;
     }
@@ -2761,6 +2772,7 @@ void update(void)
 
     if ((game.operation_flags & GOF_Paused) == 0)
     {
+        PROFILER_BEGIN(PrfSec_TurnSetup);
         if (player->additional_flags & PlaAF_LightningPaletteIsActive)
         {
             PaletteSetPlayerPalette(player, engine_palette);
@@ -2770,18 +2782,40 @@ void update(void)
         update_creature_pool_state();
         if ((game.play_gameturn & 0x01) != 0)
             update_animating_texture_maps();
+        PROFILER_END(PrfSec_TurnSetup);
+        PROFILER_BEGIN(PrfSec_Things);
         update_things();
+        PROFILER_END(PrfSec_Things);
+        PROFILER_BEGIN(PrfSec_Rooms);
         process_rooms();
+        PROFILER_END(PrfSec_Rooms);
+        PROFILER_BEGIN(PrfSec_Dungeons);
         process_dungeons();
+        PROFILER_END(PrfSec_Dungeons);
+        PROFILER_BEGIN(PrfSec_Research);
         update_research();
+        PROFILER_END(PrfSec_Research);
+        PROFILER_BEGIN(PrfSec_Manufacture);
         update_manufacturing();
+        PROFILER_END(PrfSec_Manufacture);
+        PROFILER_BEGIN(PrfSec_Events);
         event_process_events();
         update_all_events();
+        PROFILER_END(PrfSec_Events);
+        PROFILER_BEGIN(PrfSec_Script);
         process_level_script();
+        PROFILER_END(PrfSec_Script);
+        PROFILER_BEGIN(PrfSec_Computer);
         if ((game.numfield_D & GNFldD_Unkn04) != 0)
             process_computer_players2();
+        PROFILER_END(PrfSec_Computer);
+        PROFILER_BEGIN(PrfSec_Players);
         process_players();
+        PROFILER_END(PrfSec_Players);
+        PROFILER_BEGIN(PrfSec_ActionPoints);
         process_action_points();
+        PROFILER_END(PrfSec_ActionPoints);
+        PROFILER_BEGIN(PrfSec_PlayerEffects);
         player = get_my_player();
         if (player->view_mode == PVM_CreatureView)
         {
@@ -2791,6 +2825,14 @@ void update(void)
         update_footsteps_nearest_camera(player->acamera);
         PaletteFadePlayer(player);
         process_armageddon();
+        PROFILER_END(PrfSec_PlayerEffects);
+        if ((start_params.debug_flags & DFlg_DesyncLocator) != 0)
+        {
+            // Sent in its own field, so players without this option are not out of sync
+            desync_tree_update();
+            struct Packet* pckt = get_packet(my_player_number);
+            pckt->state_hash = desync_tree_root_checksum();
+        }
 #if (BFDEBUG_LEVEL > 9)
         lights_stats_debug_dump();
         things_stats_debug_dump();
@@ -2798,9 +2840,15 @@ void update(void)
 #endif
     }
 
+    PROFILER_BEGIN(PrfSec_Messages);
     message_update();
+    PROFILER_END(PrfSec_Messages);
+    PROFILER_BEGIN(PrfSec_Cameras);
     update_all_players_cameras();
+    PROFILER_END(PrfSec_Cameras);
+    PROFILER_BEGIN(PrfSec_Sounds);
     update_player_sounds();
+    PROFILER_END(PrfSec_Sounds);
     game.map_changed_for_nagivation = 0;
     SYNCDBG(6,"Finished");
 }
@@ -3330,6 +3378,12 @@ TbBool keeper_screen_swap(void)
  */
 TbBool keeper_wait_for_next_turn(void)
 {
+    if (start_params.headless)
+    {
+        // Nobody is watching, so there's no reason to wait
+        last_loop_time = LbTimerClock();
+        return false;
+    }
     if ((game.numfield_D & GNFldD_Unkn10) != 0)
     {
         // No idea when such situation occurs
@@ -3404,8 +3458,10 @@ void gameplay_loop_logic()
 #endif
     do_draw = display_should_be_updated_this_turn() || (!LbIsActive());
     LbWindowsControl();
+    PROFILER_BEGIN(PrfSec_Input);
     input_eastegg();
     input();
+    PROFILER_END(PrfSec_Input);
     update();
     frametime_end_measurement(Frametime_Logic);
 }
@@ -3482,16 +3538,31 @@ void keeper_gameplay_loop(void)
     KeeperSpeechClearEvents();
     LbErrorParachuteUpdate(); // For some reasone parachute keeps changing; Remove when won't be needed anymore
     initial_time_point();
+    if (start_params.benchmark) {
+        bench_start();
+        if (start_params.net_bench_clients > 0) {
+            bench_net_start(start_params.net_bench_clients, start_params.net_bench_latency,
+                start_params.net_bench_jitter, start_params.net_bench_loss);
+        }
+    }
     //the main gameplay loop starts
     while ((!quit_game) && (!exit_keeper))
     {
         frametime_start_measurement(Frametime_FullFrame);
+        bench_turn_begin();
+        profiler_turn_begin();
         gameplay_loop_logic();
-        gameplay_loop_draw();
+        profiler_turn_end();
+        bench_turn_end();
+        if (!start_params.headless) {
+            gameplay_loop_draw();
+        }
         gameplay_loop_timestep();
         frametime_end_measurement(Frametime_FullFrame);
     } // end while
     SYNCDBG(0,"Gameplay loop finished after %lu turns",(unsigned long)game.play_gameturn);
+    bench_report();
+    profiler_csv_close();
 }
 
 TbBool can_thing_be_queried(struct Thing *thing, PlayerNumber plyr_idx)
@@ -4008,6 +4079,24 @@ short process_command_line(unsigned short argc, char *argv[])
          snprintf(start_params.packet_fname, sizeof(start_params.packet_fname), "%s", pr2str);
          narg++;
       } else
+      if (strcasecmp(parstr,"headless") == 0)
+      {
+         start_params.headless = true;
+         start_params.no_intro = 1;
+         SoundDisabled = 1;
+      } else
+      if (strcasecmp(parstr,"bench") == 0)
+      {
+         start_params.headless = true;
+         start_params.benchmark = true;
+         start_params.no_intro = 1;
+         SoundDisabled = 1;
+         start_params.packet_load_enable = true;
+         start_params.packet_save_enable = false;
+         start_params.packet_checksum_verify = 1;
+         snprintf(start_params.packet_fname, sizeof(start_params.packet_fname), "%s", pr2str);
+         narg++;
+      } else
       if (strcasecmp(parstr,"packetsave") == 0)
       {
          if (start_params.packet_load_enable)
@@ -4017,6 +4106,17 @@ short process_command_line(unsigned short argc, char *argv[])
          snprintf(start_params.packet_fname, sizeof(start_params.packet_fname), "%s", pr2str);
          narg++;
       } else
+      if (strcasecmp(parstr,"packetconvert") == 0)
+      {
+         snprintf(start_params.packet_convert_fname, sizeof(start_params.packet_convert_fname), "%s", pr2str);
+         snprintf(start_params.packet_convert_dest, sizeof(start_params.packet_convert_dest), "%s", pr3str);
+         narg += 2;
+      } else
+      if (strcasecmp(parstr,"packetseek") == 0)
+      {
+         start_params.packet_seek_turn = strtoul(pr2str, NULL, 10);
+         narg++;
+      } else
       if (strcasecmp(parstr,"q") == 0)
       {
          set_flag_byte(&start_params.operation_flags,GOF_SingleLevel,true);
@@ -4033,6 +4133,14 @@ short process_command_line(unsigned short argc, char *argv[])
       {
 	      start_params.debug_flags |= DFlg_CreatrPaths;
       } else
+      if (strcasecmp(parstr, "dbgresync") == 0)
+      {
+          start_params.debug_flags |= DFlg_ResyncDump;
+      } else
+      if (strcasecmp(parstr, "desynclocator") == 0)
+      {
+          start_params.debug_flags |= DFlg_DesyncLocator;
+      } else
       if (strcasecmp(parstr, "compuchat") == 0)
       {
           if (strcasecmp(pr2str,"scarce") == 0) {
@@ -4067,6 +4175,36 @@ short process_command_line(unsigned short argc, char *argv[])
       {
          start_params.frame_skip = atoi(pr2str);
          narg++;
+      } else
+      if (strcasecmp(parstr,"jobs") == 0)
+      {
+         start_params.jobs_count = atoi(pr2str);
+         narg++;
+      } else
+      if (strcasecmp(parstr,"netbench") == 0)
+      {
+         // clients,latency,jitter,loss
+         start_params.net_bench_latency = 0;
+         start_params.net_bench_jitter = 0;
+         start_params.net_bench_loss = 0;
+         if ((sscanf(pr2str, "%d,%lu,%lu,%lu", &start_params.net_bench_clients, &start_params.net_bench_latency,
+             &start_params.net_bench_jitter, &start_params.net_bench_loss) < 1) || (start_params.net_bench_clients < 1))
+         {
+             WARNMSG("Couldn't recognize network benchmark parameters \"%s\".", pr2str);
+             start_params.net_bench_clients = 0;
+         } else
+         if (start_params.net_bench_clients > NET_PLAYERS_COUNT-1)
+         {
+             // Server takes one of the player slots, and packets of all of them are copied into the game
+             WARNMSG("Network benchmark can simulate up to %d clients, not %d.", NET_PLAYERS_COUNT-1, start_params.net_bench_clients);
+             start_params.net_bench_clients = NET_PLAYERS_COUNT-1;
+         }
+         if (start_params.net_bench_loss > 100)
+         {
+             WARNMSG("Network benchmark packet loss %lu%% reduced to 100%%.", start_params.net_bench_loss);
+             start_params.net_bench_loss = 100;
+         }
+         narg++;
       }
       else if (strcasecmp(parstr, "timer") == 0)
       {
@@ -4166,8 +4304,22 @@ int LbBullfrogMain(unsigned short argc, char *argv[])
         return 0;
     }
 
+    if (start_params.packet_convert_fname[0] != '\0')
+    {
+        // Only convert the packet file, without starting the game
+        retval = packet_stream_convert_file(start_params.packet_convert_fname, start_params.packet_convert_dest);
+        LbErrorLogClose();
+        return retval;
+    }
+
     retval = true;
     retval &= (LbTimerInit() != Lb_FAIL);
+    retval &= (LbJobsInitialise(start_params.jobs_count) != Lb_FAIL);
+    if (start_params.headless)
+    {
+        // The dummy driver gives us screen surfaces without opening a window
+        snprintf(lbVideoDriver, sizeof(lbVideoDriver), "%s", "dummy");
+    }
     retval &= (LbScreenInitialize() != Lb_FAIL);
     LbSetTitle(PROGRAM_NAME);
     LbSetIcon(1);
@@ -4227,6 +4379,7 @@ int LbBullfrogMain(unsigned short argc, char *argv[])
 #endif
     reset_game();
     LbScreenReset();
+    LbJobsShutdown();
     if ( !retval )
     {
         static const char *msg_text="Setting up game failed.\n";
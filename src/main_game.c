@@ -108,6 +108,7 @@ void init_lookups(void)
         game.things.lookup[i] = &game.things_data[i];
     }
     game.things.end = &game.things_data[THINGS_COUNT];
+    things_sweep_rebuild();
 
     memset(&game.persons, 0, sizeof(struct Persons));
     for (i=0; i < CREATURES_COUNT; i++)
@@ -286,6 +287,16 @@ void startup_saved_packet_game(void)
         game.turns_fastforward = game.turns_stored;
     post_init_level();
     post_init_players();
+    if (start_params.benchmark)
+    {
+        // Replay everything as fast as possible, and quit when packets end
+        game.turns_fastforward = game.turns_stored;
+        game.turns_packetoff = game.play_gameturn + game.turns_stored;
+    }
+    if ((start_params.packet_seek_turn > 0) && (start_params.packet_seek_turn < game.turns_stored))
+    {
+        seek_packet_file(start_params.packet_seek_turn);
+    }
     set_selected_level_number(0);
     struct PlayerInfo* player = get_my_player();
     set_engine_view(player, rotate_mode_to_view_mode(game.packet_save_head.video_rotate_mode));
@@ -35,6 +35,7 @@
 #include "config_creature.h"
 #include "creature_senses.h"
 #include "player_utils.h"
+#include "player_complookup.h"
 #include "ariadne_wallhug.h"
 #include "spdigger_stack.h"
 #include "frontmenu_ingame_map.h"
@@ -42,12 +43,27 @@
 #include "engine_render.h"
 #include "thing_navigate.h"
 #include "thing_physics.h"
+#include "net_desync.h"
 #include "post_inc.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 /******************************************************************************/
+/** Set in map_solid_mask[] items which are up to date. Height 15 is always solid, so its bit is free. */
+#define MAP_SOLID_MASK_VALID 0x8000
+/** Heights starting with this one are always solid. */
+#define MAP_SOLID_MASK_HEIGHTS 15
+
+/** Set in map_floor_filled[] items which are up to date. */
+#define MAP_FLOOR_FILLED_VALID 0x80
+
+/** Solidity of subtiles, one bit for each height. */
+static unsigned short map_solid_mask[MAX_SUBTILES_X*MAX_SUBTILES_Y];
+/** Floor filled subtiles of every map block, invalidated together with solidity. */
+static unsigned char map_floor_filled[MAX_SUBTILES_X*MAX_SUBTILES_Y];
+static unsigned long map_solidity_generation = 1;
+/******************************************************************************/
 
 const signed short slab_element_around_eight[] = {
     -3, -2, 1, 4, 3, 2, -1, -4
@@ -957,7 +973,7 @@ void place_slab_object(SlabCodedCoords slb_num, MapSubtlCoord stl_x,MapSubtlCoor
                 lgt_id = light_create_light(&ilght);
                 if (lgt_id != 0) {
                     struct Light *lgt;
-                    lgt = &game.lish.lights[lgt_id];
+                    lgt = light_get_light(lgt_id);
                     lgt->attached_slb = slb_num;
                 } else {
                     WARNLOG("Cannot allocate light");
@@ -1145,7 +1161,7 @@ void delete_attached_lights_on_slab(MapSlabCoord slb_x, MapSlabCoord slb_y)
         while (i > 0)
         {
             struct Light *lgt;
-            lgt = &game.lish.lights[i];
+            lgt = light_get_light(i);
             i = lgt->next_in_list;
             // Per-light code
             int lgtstl_x;
@@ -1161,7 +1177,7 @@ void delete_attached_lights_on_slab(MapSlabCoord slb_x, MapSlabCoord slb_y)
             }
             // Per-light code ends
             k++;
-            if (k > LIGHTS_COUNT)
+            if (k > LIGHTS_MAX_COUNT)
             {
                 ERRORLOG("Infinite loop detected when sweeping lights list");
                 break;
@@ -1461,6 +1477,7 @@ void place_single_slab_type_on_map(SlabKind slbkind, MapSlabCoord slb_x, MapSlab
         struct SlabMap *slb;
         slb = get_slabmap_block(slb_x,slb_y);
         slb->health = game.block_health[place_slbattr->block_health_index];
+        desync_tree_mark_slab(slb);
     }
     place_slab_columns(slbkind, STL_PER_SLB * slb_x, STL_PER_SLB * slb_y, col_idx);
     place_slab_objects(slb_x, slb_y, slab_number_list, plyr_idx);
@@ -1546,6 +1563,7 @@ void dump_slab_on_map(SlabKind slbkind, long slabset_id, MapSubtlCoord stl_x, Ma
     struct SlabMap *slb;
     slb = get_slabmap_block(slb_x, slb_y);
     slb->health = game.block_health[slbattr->block_health_index];
+    desync_tree_mark_slab(slb);
     struct SlabSet *sset;
     sset = &game.slabset[slabset_id];
     place_slab_columns(slbkind, stl_xa, stl_ya, sset->col_idx);
@@ -1613,6 +1631,8 @@ void dump_slab_on_map(SlabKind slbkind, long slabset_id, MapSubtlCoord stl_x, Ma
 
     slb = get_slabmap_block(slb_x, slb_y);
     slb->kind = slbkind;
+    desync_tree_mark_slab(slb);
+    update_gold_vein_of_slab(slb_x, slb_y);
     pannel_map_update(stl_xa, stl_ya, STL_PER_SLB, STL_PER_SLB);
     if (slab_kind_is_animated(slbkind) && !slab_kind_is_door(slbkind))
     {
@@ -1779,6 +1799,8 @@ void place_slab_type_on_map_f(SlabKind nslab, MapSubtlCoord stl_x, MapSubtlCoord
         }
     }
     slb->kind = skind;
+    desync_tree_mark_slab(slb);
+    update_gold_vein_of_slab(slb_x, slb_y);
 
     set_slab_owner(slb_x, slb_y, owner);
     place_single_slab_type_on_map(skind, slb_x, slb_y, owner);
@@ -1800,6 +1822,7 @@ void place_slab_type_on_map_f(SlabKind nslab, MapSubtlCoord stl_x, MapSubtlCoord
                   slb->kind = SlbT_EARTH;
               else
                   slb->kind = SlbT_TORCHDIRT;
+              desync_tree_mark_slab(slb);
           }
       }
     } else
@@ -1814,6 +1837,8 @@ void place_slab_type_on_map_f(SlabKind nslab, MapSubtlCoord stl_x, MapSubtlCoord
           if (!slab_kind_is_animated(slb->kind))
           {
               slb->kind = alter_rock_style(slb->kind, spos_x, spos_y, owner);
+              desync_tree_mark_slab(slb);
+              update_gold_vein_of_slab(spos_x, spos_y);
           }
       }
     }
@@ -1961,29 +1986,109 @@ void update_floor_and_ceiling_heights_at(MapSubtlCoord stl_x, MapSubtlCoord stl_
     }
 }
 
+static void get_map_block_floor_and_ceiling_heights(MapSubtlCoord stl_x, MapSubtlCoord stl_y,
+    MapSubtlCoord *floor_height, MapSubtlCoord *ceiling_height)
+{
+    struct Map* mapblk = get_map_block_at(stl_x, stl_y);
+    if (get_map_ceiling_filled_subtiles(mapblk) > 0)
+    {
+        *floor_height = 0;
+        *ceiling_height = 15;
+        update_floor_and_ceiling_heights_at(stl_x, stl_y, floor_height, ceiling_height);
+    } else
+    {
+        *floor_height = get_map_floor_filled_subtiles(mapblk);
+        *ceiling_height = get_mapblk_filled_subtiles(mapblk);
+    }
+}
+
+/**
+ * Marks solidity and floor height of given map block as outdated. Needs to be called when its column or height changes.
+ */
+void map_solidity_invalidate_block(const struct Map *mapblk)
+{
+    if ((mapblk < &game.map[0]) || (mapblk >= &game.map[MAX_SUBTILES_X*MAX_SUBTILES_Y]))
+        return;
+    map_solid_mask[mapblk - &game.map[0]] = 0;
+    map_floor_filled[mapblk - &game.map[0]] = 0;
+    map_solidity_generation++;
+}
+
+/**
+ * Marks solidity and floor height of all map blocks as outdated. Needs to be called when columns or whole map is replaced.
+ */
+void map_solidity_invalidate_all(void)
+{
+    LbMemorySet(map_solid_mask, 0, sizeof(map_solid_mask));
+    LbMemorySet(map_floor_filled, 0, sizeof(map_floor_filled));
+    map_solidity_generation++;
+}
+
+/**
+ * Returns amount of filled subtiles at bottom of the column at given subtile.
+ * Gives the same result as get_floor_filled_subtiles_at(), but remembers it for next calls.
+ */
+MapSubtlCoord get_floor_filled_subtiles_cached(MapSubtlCoord stl_x, MapSubtlCoord stl_y)
+{
+    if ((stl_x < 0) || (stl_x > gameadd.map_subtiles_x) || (stl_y < 0) || (stl_y > gameadd.map_subtiles_y))
+        return get_floor_filled_subtiles_at(stl_x, stl_y);
+    SubtlCodedCoords stl_num = get_subtile_number(stl_x, stl_y);
+    unsigned char filled = map_floor_filled[stl_num];
+    if ((filled & MAP_FLOOR_FILLED_VALID) == 0)
+    {
+        filled = MAP_FLOOR_FILLED_VALID | get_floor_filled_subtiles_at(stl_x, stl_y);
+        map_floor_filled[stl_num] = filled;
+    }
+    return (filled & ~MAP_FLOOR_FILLED_VALID);
+}
+
+/**
+ * Returns a value which changes every time solidity of any map block changes.
+ */
+unsigned long get_map_solidity_generation(void)
+{
+    return map_solidity_generation;
+}
+
 TbBool point_in_map_is_solid(const struct Coord3d *pos)
 {
     MapSubtlCoord floor_height;
     MapSubtlCoord ceiling_height;
     unsigned long check_h;
     check_h = pos->z.stl.num;
-    struct Map *mapblk;
-    mapblk = get_map_block_at(pos->x.stl.num, pos->y.stl.num);
-    if (get_map_ceiling_filled_subtiles(mapblk) > 0)
+    MapSubtlCoord stl_x = pos->x.stl.num;
+    MapSubtlCoord stl_y = pos->y.stl.num;
+    TbBool solid;
+    if ((stl_x > gameadd.map_subtiles_x) || (stl_y > gameadd.map_subtiles_y))
+    {
+        // Outside of the map, there's no mask to use
+        get_map_block_floor_and_ceiling_heights(stl_x, stl_y, &floor_height, &ceiling_height);
+        solid = (ceiling_height <= check_h) || (floor_height > check_h);
+    } else
+    if (check_h >= MAP_SOLID_MASK_HEIGHTS)
     {
-        floor_height = 0;
-        ceiling_height = 15;
-        update_floor_and_ceiling_heights_at(pos->x.stl.num, pos->y.stl.num, &floor_height, &ceiling_height);
+        solid = true;
     } else
     {
-        floor_height = get_map_floor_filled_subtiles(mapblk);
-        ceiling_height = get_mapblk_filled_subtiles(mapblk);
+        SubtlCodedCoords stl_num = get_subtile_number(stl_x, stl_y);
+        unsigned short mask = map_solid_mask[stl_num];
+        if ((mask & MAP_SOLID_MASK_VALID) == 0)
+        {
+            get_map_block_floor_and_ceiling_heights(stl_x, stl_y, &floor_height, &ceiling_height);
+            mask = MAP_SOLID_MASK_VALID;
+            for (MapSubtlCoord h = 0; h < MAP_SOLID_MASK_HEIGHTS; h++)
+            {
+                if ((ceiling_height <= h) || (floor_height > h))
+                    mask |= (1 << h);
+            }
+            map_solid_mask[stl_num] = mask;
+        }
+        solid = ((mask & (1 << check_h)) != 0);
     }
-    if ((ceiling_height <= check_h) || (floor_height > check_h)) {
+    if (solid) {
         SYNCDBG(17, "Solid at (%d,%d,%d)",(int)pos->x.stl.num,(int)pos->y.stl.num,(int)pos->z.stl.num);
-        return true;
     }
-    return false;
+    return solid;
 }
 
 /**
@@ -53,6 +53,10 @@ void check_map_explored(struct Thing* creatng, MapSubtlCoord stl_x, MapSubtlCoor
 TbBool set_slab_explored(PlayerNumber plyr_idx, MapSlabCoord slb_x, MapSlabCoord slb_y);
 void update_floor_and_ceiling_heights_at(MapSubtlCoord stl_x, MapSubtlCoord stl_y,
     MapSubtlCoord *floor_height, MapSubtlCoord *ceiling_height);
+void map_solidity_invalidate_block(const struct Map *mapblk);
+void map_solidity_invalidate_all(void);
+unsigned long get_map_solidity_generation(void);
+MapSubtlCoord get_floor_filled_subtiles_cached(MapSubtlCoord stl_x, MapSubtlCoord stl_y);
 TbBool point_in_map_is_solid(const struct Coord3d *pos);
 TbBool point_in_map_is_solid_ignoring_door(const struct Coord3d *pos, const struct Thing *doortng);
 unsigned short get_point_in_map_solid_flags_ignoring_door(const struct Coord3d *pos, const struct Thing *doortng);
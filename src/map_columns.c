@@ -24,6 +24,7 @@
 #include "config_terrain.h"
 #include "slab_data.h"
 #include "game_legacy.h"
+#include "map_blocks.h"
 #include "post_inc.h"
 
 #ifdef __cplusplus
@@ -122,6 +123,7 @@ void set_map_floor_filled_subtiles(struct Map *mapblk, MapSubtlCoord n)
         return;
     col->bitfields &= ~0xF0;
     col->bitfields |= (n<<4) & 0xF0;
+    map_solidity_invalidate_all();
 }
 
 /**
@@ -184,6 +186,7 @@ void set_map_ceiling_filled_subtiles(struct Map *mapblk, MapSubtlCoord n)
         return;
     col->bitfields &= ~CLF_CEILING_MASK;
     col->bitfields |= (n<<1) & CLF_CEILING_MASK;
+    map_solidity_invalidate_all();
 }
 
 TbBool map_pos_solid_at_ceiling(MapSubtlCoord stl_x, MapSubtlCoord stl_y)
@@ -486,6 +489,7 @@ void init_columns(void)
             }
         }
     }
+    map_solidity_invalidate_all();
 }
 
 void init_whole_blocks(void)
@@ -146,6 +146,7 @@ void set_mapblk_column_index(struct Map *mapblk, long column_idx)
   }
   // Clear previous and set new
   mapblk->data ^= (mapblk->data ^ ((unsigned long)column_idx)) & 0x7FF;
+  map_solidity_invalidate_block(mapblk);
 }
 
 /**
@@ -189,6 +190,7 @@ void set_mapblk_filled_subtiles(struct Map *mapblk, long height)
     if (height > 15) height = 15;
     mapblk->data &= ~(0xF000000);
     mapblk->data |= (height << 24) & 0xF000000;
+    map_solidity_invalidate_block(mapblk);
 }
 
 void reveal_map_subtile(MapSubtlCoord stl_x, MapSubtlCoord stl_y, PlayerNumber plyr_idx)
@@ -552,6 +554,7 @@ void clear_mapmap(void)
             *flg = 0;
         }
     }
+    map_solidity_invalidate_all();
     clear_subtiles_lightness(&game.lish);
 }
 
@@ -0,0 +1,852 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file net_desync.c
+ *     Locating the source of desynchronization in network games.
+ * @par Purpose:
+ *     Keeps a tree of hashes over the synchronized game state, and finds the
+ *     first piece of state which differs between server and clients.
+ * @par Comment:
+ *     Leaves of the tree are things, creature controls, rooms, dungeons, rows
+ *     of slab map and random seeds. Only listed fields of every leaf are
+ *     hashed. Leaves are hashed again only after the game marks them as
+ *     changed, and so are the nodes above them. Root of the tree is sent in
+ *     its own packet field, so desync is noticed on the turn it happened.
+ *     Then clients walk down the server tree, one node at a time, to the
+ *     first differing leaf, and compare its fields.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "pre_inc.h"
+#include "net_desync.h"
+
+#include <stddef.h>
+#include <string.h>
+
+#include "globals.h"
+#include "bflib_basics.h"
+#include "bflib_memory.h"
+#include "bflib_datetm.h"
+#include "bflib_network.h"
+#include "thing_data.h"
+#include "thing_list.h"
+#include "creature_control.h"
+#include "room_data.h"
+#include "dungeon_data.h"
+#include "slab_data.h"
+#include "game_legacy.h"
+#include "game_merge.h"
+#include "post_inc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Max amount of levels in the tree; enough for any amount of leaves which fits in memory. */
+#define DESYNC_TREE_LEVELS 8
+/** Amount of fields at start of thing_fields which tell whether a thing exists, and what it is. */
+#define THING_PRESENCE_FIELDS 4
+
+typedef unsigned long long DesyncHash;
+
+enum NetDesyncStep {
+    NDStp_Request = 1, // to server: node whose children are needed
+    NDStp_Hashes,      // from server: hashes of the node children
+    NDStp_Leaf,        // from server: content of a leaf
+    NDStp_Done,        // to server: walk finished
+};
+
+enum DesyncCategoryIndex {
+    DsCat_Things = 0,
+    DsCat_CreatureControls,
+    DsCat_Rooms,
+    DsCat_Dungeons,
+    DsCat_DungeonAdds,
+    DsCat_SlabRows,
+    DsCat_Seeds,
+    DsCat_Count,
+};
+
+#pragma pack(1)
+
+struct NetDesyncHeader {
+    unsigned char step;
+    unsigned char level;
+    unsigned long index;
+    unsigned long leaves_count;
+    unsigned long gameturn;
+    /** Size of the data following the header. */
+    unsigned long data_size;
+};
+
+#pragma pack()
+
+struct DesyncField {
+    const char *name;
+    unsigned short offset;
+    unsigned short size;
+};
+
+#define DESYNC_FIELD(type, name) {#name, offsetof(type, name), sizeof(((type *)NULL)->name)}
+
+/** Kind of state stored in a range of leaves. */
+struct DesyncCategory {
+    const char *name;
+    unsigned long count;
+    /** Gives first item of a leaf, and amount of fields from the list which are hashed for it; -1 for all. */
+    const void *(*leaf)(unsigned long idx, int *fields_count);
+    /** Amount of items within a leaf, and distance between them. */
+    unsigned long items_count;
+    unsigned long item_size;
+    const struct DesyncField *fields;
+    /** Whether the leaves are hashed on every update; otherwise only after they're marked as changed. */
+    TbBool always_changed;
+};
+
+struct DesyncTree {
+    TbBool valid;
+    int levels_count;
+    unsigned long counts[DESYNC_TREE_LEVELS];
+    DesyncHash *hashes[DESYNC_TREE_LEVELS];
+    unsigned char *dirty[DESYNC_TREE_LEVELS];
+    /** Index of the first leaf of every category. */
+    unsigned long cat_first[DsCat_Count];
+    /** Buffer for fields of one leaf, big enough for any leaf. */
+    unsigned char *leaf_buf;
+    GameTurn last_update_turn;
+};
+
+struct DesyncTreeStats {
+    unsigned long updates;
+    unsigned long full_updates;
+    unsigned long long leaves_hashed;
+    TbClockMicroSec time_total;
+};
+
+struct DesyncSeeds {
+    GameTurn play_gameturn;
+    unsigned long action_rand_seed;
+};
+/******************************************************************************/
+static const struct DesyncField thing_fields[] = {
+    DESYNC_FIELD(struct Thing, alloc_flags),
+    DESYNC_FIELD(struct Thing, class_id),
+    DESYNC_FIELD(struct Thing, model),
+    DESYNC_FIELD(struct Thing, index),
+    DESYNC_FIELD(struct Thing, state_flags),
+    DESYNC_FIELD(struct Thing, next_on_mapblk),
+    DESYNC_FIELD(struct Thing, prev_on_mapblk),
+    DESYNC_FIELD(struct Thing, owner),
+    DESYNC_FIELD(struct Thing, active_state),
+    DESYNC_FIELD(struct Thing, continue_state),
+    DESYNC_FIELD(struct Thing, creation_turn),
+    DESYNC_FIELD(struct Thing, mappos),
+    DESYNC_FIELD(struct Thing, parent_idx),
+    DESYNC_FIELD(struct Thing, movement_flags),
+    DESYNC_FIELD(struct Thing, veloc_push_once),
+    DESYNC_FIELD(struct Thing, veloc_base),
+    DESYNC_FIELD(struct Thing, veloc_push_add),
+    DESYNC_FIELD(struct Thing, velocity),
+    DESYNC_FIELD(struct Thing, anim_speed),
+    DESYNC_FIELD(struct Thing, anim_time),
+    DESYNC_FIELD(struct Thing, anim_sprite),
+    DESYNC_FIELD(struct Thing, current_frame),
+    DESYNC_FIELD(struct Thing, max_frames),
+    DESYNC_FIELD(struct Thing, move_angle_xy),
+    DESYNC_FIELD(struct Thing, move_angle_z),
+    DESYNC_FIELD(struct Thing, health),
+    DESYNC_FIELD(struct Thing, floor_height),
+    DESYNC_FIELD(struct Thing, light_id),
+    DESYNC_FIELD(struct Thing, ccontrol_idx),
+    DESYNC_FIELD(struct Thing, next_of_class),
+    DESYNC_FIELD(struct Thing, prev_of_class),
+    DESYNC_FIELD(struct Thing, flags),
+    {NULL, 0, 0},
+};
+
+static const struct DesyncField cctrl_fields[] = {
+    DESYNC_FIELD(struct CreatureControl, index),
+    DESYNC_FIELD(struct CreatureControl, flgfield_1),
+    DESYNC_FIELD(struct CreatureControl, flgfield_2),
+    DESYNC_FIELD(struct CreatureControl, combat_flags),
+    DESYNC_FIELD(struct CreatureControl, wait_to_turn),
+    DESYNC_FIELD(struct CreatureControl, explevel),
+    DESYNC_FIELD(struct CreatureControl, exp_points),
+    DESYNC_FIELD(struct CreatureControl, moveto_pos),
+    DESYNC_FIELD(struct CreatureControl, hunger_level),
+    DESYNC_FIELD(struct CreatureControl, annoyance_level),
+    DESYNC_FIELD(struct CreatureControl, lair_room_id),
+    DESYNC_FIELD(struct CreatureControl, work_room_id),
+    DESYNC_FIELD(struct CreatureControl, target_room_id),
+    DESYNC_FIELD(struct CreatureControl, party),
+    DESYNC_FIELD(struct CreatureControl, instance_id),
+    DESYNC_FIELD(struct CreatureControl, inst_turn),
+    DESYNC_FIELD(struct CreatureControl, targtng_idx),
+    {NULL, 0, 0},
+};
+
+static const struct DesyncField room_fields[] = {
+    DESYNC_FIELD(struct Room, alloc_flags),
+    DESYNC_FIELD(struct Room, index),
+    DESYNC_FIELD(struct Room, owner),
+    DESYNC_FIELD(struct Room, prev_of_owner),
+    DESYNC_FIELD(struct Room, next_of_owner),
+    DESYNC_FIELD(struct Room, central_stl_x),
+    DESYNC_FIELD(struct Room, central_stl_y),
+    DESYNC_FIELD(struct Room, kind),
+    DESYNC_FIELD(struct Room, health),
+    DESYNC_FIELD(struct Room, total_capacity),
+    DESYNC_FIELD(struct Room, used_capacity),
+    DESYNC_FIELD(struct Room, content_per_model),
+    DESYNC_FIELD(struct Room, slabs_list),
+    DESYNC_FIELD(struct Room, slabs_count),
+    DESYNC_FIELD(struct Room, creatures_list),
+    DESYNC_FIELD(struct Room, efficiency),
+    {NULL, 0, 0},
+};
+
+static const struct DesyncField dungeon_fields[] = {
+    DESYNC_FIELD(struct Dungeon, dnheart_idx),
+    DESYNC_FIELD(struct Dungeon, creatr_list_start),
+    DESYNC_FIELD(struct Dungeon, digger_list_start),
+    DESYNC_FIELD(struct Dungeon, things_in_hand),
+    DESYNC_FIELD(struct Dungeon, num_things_in_hand),
+    DESYNC_FIELD(struct Dungeon, num_active_diggers),
+    DESYNC_FIELD(struct Dungeon, num_active_creatrs),
+    DESYNC_FIELD(struct Dungeon, owned_creatures_of_model),
+    DESYNC_FIELD(struct Dungeon, total_rooms),
+    DESYNC_FIELD(struct Dungeon, total_doors),
+    DESYNC_FIELD(struct Dungeon, total_area),
+    DESYNC_FIELD(struct Dungeon, total_score),
+    DESYNC_FIELD(struct Dungeon, total_money_owned),
+    DESYNC_FIELD(struct Dungeon, offmap_money_owned),
+    DESYNC_FIELD(struct Dungeon, task_count),
+    DESYNC_FIELD(struct Dungeon, research),
+    DESYNC_FIELD(struct Dungeon, current_research_idx),
+    DESYNC_FIELD(struct Dungeon, magic_level),
+    DESYNC_FIELD(struct Dungeon, turn_timers),
+    DESYNC_FIELD(struct Dungeon, digger_stack_length),
+    DESYNC_FIELD(struct Dungeon, total_research_points),
+    DESYNC_FIELD(struct Dungeon, total_manufacture_points),
+    DESYNC_FIELD(struct Dungeon, manufacture_progress),
+    DESYNC_FIELD(struct Dungeon, research_progress),
+    DESYNC_FIELD(struct Dungeon, creatures_total_pay),
+    {NULL, 0, 0},
+};
+
+static const struct DesyncField dungeonadd_fields[] = {
+    DESYNC_FIELD(struct DungeonAdd, mnfct_info),
+    DESYNC_FIELD(struct DungeonAdd, box_info),
+    DESYNC_FIELD(struct DungeonAdd, creature_entrance_level),
+    DESYNC_FIELD(struct DungeonAdd, creatures_transferred),
+    DESYNC_FIELD(struct DungeonAdd, manufacture_gold),
+    DESYNC_FIELD(struct DungeonAdd, creatures_total_backpay),
+    DESYNC_FIELD(struct DungeonAdd, script_flags),
+    DESYNC_FIELD(struct DungeonAdd, room_buildable),
+    DESYNC_FIELD(struct DungeonAdd, room_resrchable),
+    DESYNC_FIELD(struct DungeonAdd, room_slabs_count),
+    DESYNC_FIELD(struct DungeonAdd, backup_heart_idx),
+    DESYNC_FIELD(struct DungeonAdd, free_soul_idx),
+    {NULL, 0, 0},
+};
+
+static const struct DesyncField slab_fields[] = {
+    DESYNC_FIELD(struct SlabMap, kind),
+    DESYNC_FIELD(struct SlabMap, next_in_room),
+    DESYNC_FIELD(struct SlabMap, room_index),
+    DESYNC_FIELD(struct SlabMap, health),
+    DESYNC_FIELD(struct SlabMap, flags),
+    {NULL, 0, 0},
+};
+
+static const struct DesyncField seeds_fields[] = {
+    DESYNC_FIELD(struct DesyncSeeds, play_gameturn),
+    DESYNC_FIELD(struct DesyncSeeds, action_rand_seed),
+    {NULL, 0, 0},
+};
+
+static const void *desync_thing_leaf(unsigned long idx, int *fields_count)
+{
+    const struct Thing* thing = &game.things_data[idx];
+    if ((thing->alloc_flags & TAlF_Exists) == 0)
+    {
+        *fields_count = 1;
+    } else
+    if ((thing->class_id == TCls_EffectElem) || (thing->class_id == TCls_AmbientSnd))
+    {
+        // Not synchronized, only their presence matters
+        *fields_count = THING_PRESENCE_FIELDS;
+    } else
+    {
+        *fields_count = -1;
+    }
+    return thing;
+}
+
+static const void *desync_cctrl_leaf(unsigned long idx, int *fields_count)
+{
+    *fields_count = -1;
+    return &game.cctrl_data[idx];
+}
+
+static const void *desync_room_leaf(unsigned long idx, int *fields_count)
+{
+    *fields_count = -1;
+    return &game.rooms[idx];
+}
+
+static const void *desync_dungeon_leaf(unsigned long idx, int *fields_count)
+{
+    *fields_count = -1;
+    return &game.dungeon[idx];
+}
+
+static const void *desync_dungeonadd_leaf(unsigned long idx, int *fields_count)
+{
+    *fields_count = -1;
+    return &gameadd.dungeon[idx];
+}
+
+static const void *desync_slabmap_leaf(unsigned long idx, int *fields_count)
+{
+    *fields_count = -1;
+    return &game.slabmap[idx * MAX_TILES_X];
+}
+
+static const void *desync_seeds_leaf(unsigned long idx, int *fields_count)
+{
+    static struct DesyncSeeds seeds;
+    seeds.play_gameturn = game.play_gameturn;
+    seeds.action_rand_seed = game.action_rand_seed;
+    *fields_count = -1;
+    return &seeds;
+}
+
+static const struct DesyncCategory desync_categories[DsCat_Count] = {
+    {"thing",            THINGS_COUNT,    desync_thing_leaf,      1,           0,                      thing_fields,      false},
+    {"creature control", CREATURES_COUNT, desync_cctrl_leaf,      1,           0,                      cctrl_fields,      false},
+    {"room",             ROOMS_COUNT,     desync_room_leaf,       1,           0,                      room_fields,       false},
+    {"dungeon",          DUNGEONS_COUNT,  desync_dungeon_leaf,    1,           0,                      dungeon_fields,    true},
+    {"dungeon add",      DUNGEONS_COUNT,  desync_dungeonadd_leaf, 1,           0,                      dungeonadd_fields, true},
+    {"slab map row",     MAX_TILES_Y,     desync_slabmap_leaf,    MAX_TILES_X, sizeof(struct SlabMap), slab_fields,       false},
+    {"random seeds",     1,               desync_seeds_leaf,      1,           0,                      seeds_fields,      true},
+};
+
+static struct DesyncTree desync_tree;
+static struct DesyncTreeStats desync_tree_stats;
+/******************************************************************************/
+/**
+ * Fast hash which reads 8 bytes at a time.
+ */
+static DesyncHash desync_hash_bytes(const unsigned char *data, unsigned long size)
+{
+    DesyncHash hash = 0x9E3779B97F4A7C15ULL ^ size;
+    DesyncHash word;
+    while (size >= sizeof(word))
+    {
+        LbMemoryCopy(&word, data, sizeof(word));
+        hash = (hash ^ word) * 0xFF51AFD7ED558CCDULL;
+        hash ^= hash >> 29;
+        data += sizeof(word);
+        size -= sizeof(word);
+    }
+    word = 0;
+    LbMemoryCopy(&word, data, size);
+    hash = (hash ^ word) * 0xC4CEB9FE1A85EC53ULL;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+static unsigned long desync_fields_size(const struct DesyncField *fields, int fields_count)
+{
+    unsigned long size = 0;
+    for (int n = 0; (fields[n].name != NULL) && (n != fields_count); n++)
+        size += fields[n].size;
+    return size;
+}
+
+/**
+ * Copies fields of a leaf, one after another, to given buffer.
+ * Only the listed fields are copied, so padding and values which are not synchronized do not matter.
+ * @return Size of the copied data.
+ */
+static unsigned long desync_leaf_pack(const struct DesyncCategory *cat, unsigned long item_idx, unsigned char *buf)
+{
+    int fields_count;
+    const unsigned char* item = (const unsigned char *)cat->leaf(item_idx, &fields_count);
+    unsigned char* ptr = buf;
+    for (unsigned long i = 0; i < cat->items_count; i++)
+    {
+        for (int n = 0; (cat->fields[n].name != NULL) && (n != fields_count); n++)
+        {
+            LbMemoryCopy(ptr, item + cat->fields[n].offset, cat->fields[n].size);
+            ptr += cat->fields[n].size;
+        }
+        item += cat->item_size;
+    }
+    return ptr - buf;
+}
+
+static unsigned long desync_leaves_count(void)
+{
+    unsigned long count = 0;
+    for (int i = 0; i < DsCat_Count; i++)
+        count += desync_categories[i].count;
+    return count;
+}
+
+/**
+ * Gives category of a leaf.
+ * @param item_idx Receives index of the leaf within its category.
+ */
+static const struct DesyncCategory *desync_leaf_category(unsigned long leaf_idx, unsigned long *item_idx)
+{
+    for (int i = 0; i < DsCat_Count; i++)
+    {
+        const struct DesyncCategory* cat = &desync_categories[i];
+        if (leaf_idx < cat->count)
+        {
+            *item_idx = leaf_idx;
+            return cat;
+        }
+        leaf_idx -= cat->count;
+    }
+    return NULL;
+}
+
+static TbBool desync_tree_alloc(void)
+{
+    struct DesyncTree* tree = &desync_tree;
+    if (tree->levels_count > 0)
+        return true;
+    unsigned long leaf_size = 0;
+    unsigned long first = 0;
+    for (int i = 0; i < DsCat_Count; i++)
+    {
+        const struct DesyncCategory* cat = &desync_categories[i];
+        tree->cat_first[i] = first;
+        first += cat->count;
+        leaf_size = max(leaf_size, cat->items_count * desync_fields_size(cat->fields, -1));
+    }
+    tree->leaf_buf = (unsigned char *)LbMemoryAlloc(leaf_size);
+    if (tree->leaf_buf == NULL)
+    {
+        ERRORLOG("Cannot allocate state hash tree leaf buffer");
+        return false;
+    }
+    unsigned long count = desync_leaves_count();
+    int lvl = 0;
+    for (;;)
+    {
+        tree->counts[lvl] = count;
+        tree->hashes[lvl] = (DesyncHash *)LbMemoryAlloc(count * sizeof(DesyncHash));
+        tree->dirty[lvl] = (unsigned char *)LbMemoryAlloc(count);
+        if ((tree->hashes[lvl] == NULL) || (tree->dirty[lvl] == NULL))
+        {
+            ERRORLOG("Cannot allocate state hash tree level %d",lvl);
+            return false;
+        }
+        lvl++;
+        if ((count <= 1) || (lvl >= DESYNC_TREE_LEVELS))
+            break;
+        count = (count + DESYNC_TREE_FANOUT - 1) / DESYNC_TREE_FANOUT;
+    }
+    tree->levels_count = lvl;
+    tree->valid = false;
+    return true;
+}
+
+static DesyncHash desync_node_hash(int lvl, unsigned long idx)
+{
+    struct DesyncTree* tree = &desync_tree;
+    unsigned long first = idx * DESYNC_TREE_FANOUT;
+    unsigned long count = min(tree->counts[lvl-1] - first, (unsigned long)DESYNC_TREE_FANOUT);
+    return desync_hash_bytes((const unsigned char *)&tree->hashes[lvl-1][first], count * sizeof(DesyncHash));
+}
+
+static void desync_tree_mark_leaf(enum DesyncCategoryIndex cat_idx, unsigned long item_idx)
+{
+    struct DesyncTree* tree = &desync_tree;
+    // Nothing to mark until the locator is used
+    if (tree->levels_count <= 0)
+        return;
+    if (item_idx >= desync_categories[cat_idx].count)
+        return;
+    tree->dirty[0][tree->cat_first[cat_idx] + item_idx] = 1;
+}
+
+/**
+ * Marks a thing as changed, so that it is hashed again on next update. Creature control of the thing is marked too.
+ */
+void desync_tree_mark_thing(const struct Thing *thing)
+{
+    desync_tree_mark_leaf(DsCat_Things, thing - game.things_data);
+    if ((thing->alloc_flags & TAlF_Exists) && (thing->class_id == TCls_Creature))
+        desync_tree_mark_leaf(DsCat_CreatureControls, thing->ccontrol_idx);
+}
+
+void desync_tree_mark_room(const struct Room *room)
+{
+    desync_tree_mark_leaf(DsCat_Rooms, room - game.rooms);
+}
+
+void desync_tree_mark_slab(const struct SlabMap *slb)
+{
+    if ((slb < game.slabmap) || (slb >= game.slabmap + MAX_TILES_X*MAX_TILES_Y))
+        return;
+    desync_tree_mark_leaf(DsCat_SlabRows, (slb - game.slabmap) / MAX_TILES_X);
+}
+
+/**
+ * Makes the next update hash all leaves. Needed when the game state was replaced as a whole.
+ */
+void desync_tree_invalidate(void)
+{
+    desync_tree.valid = false;
+}
+
+/**
+ * Hashes the game state. Only leaves marked as changed are hashed, and nodes above them.
+ * All leaves are hashed on first update, and after the game state was replaced - which is
+ * also assumed if turns were skipped, ie. after loading or seeking.
+ */
+void desync_tree_update(void)
+{
+    struct DesyncTree* tree = &desync_tree;
+    if (!desync_tree_alloc())
+        return;
+    TbClockMicroSec started = LbTimerClockMicro();
+    if (game.play_gameturn != tree->last_update_turn + 1)
+        tree->valid = false;
+    tree->last_update_turn = game.play_gameturn;
+    TbBool all = !tree->valid;
+    for (int lvl = 0; lvl < tree->levels_count; lvl++)
+    {
+        if (all || (lvl > 0))
+            LbMemorySet(tree->dirty[lvl], all, tree->counts[lvl]);
+    }
+    for (int i = 0; i < DsCat_Count; i++)
+    {
+        if (desync_categories[i].always_changed)
+            LbMemorySet(&tree->dirty[0][tree->cat_first[i]], 1, desync_categories[i].count);
+    }
+    unsigned long hashed = 0;
+    for (int i = 0; i < DsCat_Count; i++)
+    {
+        const struct DesyncCategory* cat = &desync_categories[i];
+        unsigned long leaf_idx = tree->cat_first[i];
+        for (unsigned long n = 0; n < cat->count; n++, leaf_idx++)
+        {
+            if (!tree->dirty[0][leaf_idx])
+                continue;
+            tree->dirty[0][leaf_idx] = 0;
+            hashed++;
+            unsigned long size = desync_leaf_pack(cat, n, tree->leaf_buf);
+            DesyncHash hash = desync_hash_bytes(tree->leaf_buf, size);
+            if ((hash == tree->hashes[0][leaf_idx]) && !all)
+                continue;
+            tree->hashes[0][leaf_idx] = hash;
+            if (tree->levels_count > 1)
+                tree->dirty[1][leaf_idx / DESYNC_TREE_FANOUT] = 1;
+        }
+    }
+    for (int lvl = 1; lvl < tree->levels_count; lvl++)
+    {
+        for (unsigned long n = 0; n < tree->counts[lvl]; n++)
+        {
+            if (!tree->dirty[lvl][n])
+                continue;
+            DesyncHash hash = desync_node_hash(lvl, n);
+            if ((hash == tree->hashes[lvl][n]) && !all)
+                continue;
+            tree->hashes[lvl][n] = hash;
+            if (lvl + 1 < tree->levels_count)
+                tree->dirty[lvl+1][n / DESYNC_TREE_FANOUT] = 1;
+        }
+    }
+    tree->valid = true;
+    desync_tree_stats.updates++;
+    if (all)
+        desync_tree_stats.full_updates++;
+    desync_tree_stats.leaves_hashed += hashed;
+    desync_tree_stats.time_total += LbTimerClockMicro() - started;
+}
+
+/**
+ * Gives root of the state hash tree, folded to the size of checksum.
+ */
+TbBigChecksum desync_tree_root_checksum(void)
+{
+    struct DesyncTree* tree = &desync_tree;
+    if (!tree->valid)
+        return 0;
+    DesyncHash root = tree->hashes[tree->levels_count-1][0];
+    return (TbBigChecksum)(root ^ (root >> 32));
+}
+
+void desync_tree_reset_stats(void)
+{
+    LbMemorySet(&desync_tree_stats, 0, sizeof(desync_tree_stats));
+}
+
+/**
+ * Writes how much work keeping the state hash tree took, compared to hashing all leaves.
+ */
+void desync_tree_bench_report(void)
+{
+    const struct DesyncTreeStats* stats = &desync_tree_stats;
+    if (stats->updates <= 0)
+        return;
+    JUSTMSG("Benchmark: state tree %lu updates (%lu full), avg %.1f of %lu leaves hashed, avg %.3f ms per update",
+        stats->updates, stats->full_updates, (double)stats->leaves_hashed/stats->updates, desync_tree.counts[0],
+        (double)stats->time_total/stats->updates/1000.0);
+}
+/******************************************************************************/
+static TbBool net_desync_send_message(NetUserId destination, struct NetDesyncHeader *hdr, const void *data)
+{
+    unsigned char* buf = (unsigned char *)LbMemoryAlloc(sizeof(struct NetDesyncHeader) + hdr->data_size);
+    if (buf == NULL)
+    {
+        ERRORLOG("Cannot allocate %lu bytes for desync message",(unsigned long)(sizeof(struct NetDesyncHeader) + hdr->data_size));
+        return false;
+    }
+    hdr->leaves_count = desync_tree.counts[0];
+    hdr->gameturn = game.play_gameturn;
+    LbMemoryCopy(buf, hdr, sizeof(struct NetDesyncHeader));
+    if (hdr->data_size > 0)
+        LbMemoryCopy(buf + sizeof(struct NetDesyncHeader), data, hdr->data_size);
+    TbBool result = LbNetwork_ResyncSend(destination, buf, sizeof(struct NetDesyncHeader) + hdr->data_size);
+    LbMemoryFree(buf);
+    return result;
+}
+
+/**
+ * Receives a desync message.
+ * @return Buffer starting with the message header, to be freed with LbMemoryFree(); NULL on failure.
+ */
+static struct NetDesyncHeader *net_desync_receive_message(NetUserId source, NetUserId *sender)
+{
+    size_t len;
+    struct NetDesyncHeader* hdr = (struct NetDesyncHeader *)LbNetwork_ResyncReceive(source, sender, &len);
+    if (hdr == NULL)
+        return NULL;
+    if ((len < sizeof(struct NetDesyncHeader)) || (len - sizeof(struct NetDesyncHeader) != hdr->data_size)
+      || (hdr->leaves_count != desync_tree.counts[0]) || (hdr->gameturn != game.play_gameturn))
+    {
+        ERRORLOG("Invalid desync message from user %d",(int)*sender);
+        LbMemoryFree(hdr);
+        return NULL;
+    }
+    return hdr;
+}
+
+/**
+ * Answers requests of one client until it reaches a leaf.
+ */
+static TbBool net_desync_serve_user(NetUserId user)
+{
+    struct DesyncTree* tree = &desync_tree;
+    // Every level is requested once, and then the leaf
+    for (int step = 0; step <= tree->levels_count; step++)
+    {
+        NetUserId sender = user;
+        struct NetDesyncHeader* req = net_desync_receive_message(user, &sender);
+        if (req == NULL)
+            return false;
+        struct NetDesyncHeader hdr;
+        LbMemorySet(&hdr, 0, sizeof(hdr));
+        hdr.level = req->level;
+        hdr.index = req->index;
+        unsigned char step_kind = req->step;
+        LbMemoryFree(req);
+        if (step_kind == NDStp_Done)
+            return true;
+        if ((step_kind != NDStp_Request) || (hdr.level >= tree->levels_count) || (hdr.index >= tree->counts[hdr.level]))
+        {
+            ERRORLOG("Invalid desync request from user %d",(int)sender);
+            return false;
+        }
+        TbBool sent;
+        if (hdr.level == 0)
+        {
+            unsigned long item_idx;
+            const struct DesyncCategory* cat = desync_leaf_category(hdr.index, &item_idx);
+            hdr.step = NDStp_Leaf;
+            hdr.data_size = desync_leaf_pack(cat, item_idx, tree->leaf_buf);
+            sent = net_desync_send_message(sender, &hdr, tree->leaf_buf);
+        } else
+        {
+            unsigned long first = hdr.index * DESYNC_TREE_FANOUT;
+            unsigned long count = min(tree->counts[hdr.level-1] - first, (unsigned long)DESYNC_TREE_FANOUT);
+            hdr.step = NDStp_Hashes;
+            hdr.data_size = count * sizeof(DesyncHash);
+            sent = net_desync_send_message(sender, &hdr, &tree->hashes[hdr.level-1][first]);
+        }
+        if (!sent)
+            return false;
+    }
+    return false;
+}
+
+static TbBool net_desync_server(void)
+{
+    NetUserId users[MAX_N_USERS];
+    int users_count = LbNetwork_ResyncUsers(users, MAX_N_USERS);
+    TbBool result = true;
+    for (int i = 0; i < users_count; i++)
+    {
+        if (!net_desync_serve_user(users[i]))
+            result = false;
+    }
+    return result;
+}
+
+/**
+ * Compares fields of a leaf of the server with the local ones, and logs the first which differs.
+ */
+static void net_desync_report_leaf(unsigned long leaf_idx, const unsigned char *srv_data, unsigned long srv_size)
+{
+    unsigned long item_idx;
+    const struct DesyncCategory* cat = desync_leaf_category(leaf_idx, &item_idx);
+    if (cat == NULL)
+        return;
+    const unsigned char* data = desync_tree.leaf_buf;
+    unsigned long size = desync_leaf_pack(cat, item_idx, desync_tree.leaf_buf);
+    if (size != srv_size)
+    {
+        // Leaves of things have less fields if a thing does not exist or is not synchronized
+        ERRORLOG("Desync at turn %lu: %s %lu differs in existence or class, %lu bytes of fields instead of %lu",
+            (unsigned long)game.play_gameturn, cat->name, item_idx, size, srv_size);
+        return;
+    }
+    unsigned long pos = 0;
+    for (unsigned long i = 0; i < cat->items_count; i++)
+    {
+        for (int n = 0; cat->fields[n].name != NULL; n++)
+        {
+            const struct DesyncField* fld = &cat->fields[n];
+            if (pos + fld->size > size)
+                break;
+            if (memcmp(&data[pos], &srv_data[pos], fld->size) != 0)
+            {
+                unsigned long local_val = 0;
+                unsigned long srv_val = 0;
+                LbMemoryCopy(&local_val, &data[pos], min((unsigned long)fld->size, (unsigned long)sizeof(local_val)));
+                LbMemoryCopy(&srv_val, &srv_data[pos], min((unsigned long)fld->size, (unsigned long)sizeof(srv_val)));
+                if (cat->items_count > 1)
+                {
+                    ERRORLOG("Desync at turn %lu: %s %lu, item %lu, field %s; local %lu, server %lu",
+                        (unsigned long)game.play_gameturn, cat->name, item_idx, i, fld->name, local_val, srv_val);
+                } else
+                {
+                    ERRORLOG("Desync at turn %lu: %s %lu, field %s; local %lu, server %lu",
+                        (unsigned long)game.play_gameturn, cat->name, item_idx, fld->name, local_val, srv_val);
+                }
+                return;
+            }
+            pos += fld->size;
+        }
+    }
+    ERRORLOG("Desync at turn %lu: %s %lu has different hash but same fields",
+        (unsigned long)game.play_gameturn, cat->name, item_idx);
+}
+
+/**
+ * Walks down the server tree, always into the first child which differs from the local one.
+ */
+static TbBool net_desync_client(void)
+{
+    struct DesyncTree* tree = &desync_tree;
+    struct NetDesyncHeader hdr;
+    LbMemorySet(&hdr, 0, sizeof(hdr));
+    hdr.step = NDStp_Request;
+    hdr.level = tree->levels_count - 1;
+    hdr.index = 0;
+    TbBool result = true;
+    while (result)
+    {
+        if (!net_desync_send_message(SERVER_ID, &hdr, NULL))
+            return false;
+        NetUserId sender;
+        struct NetDesyncHeader* ans = net_desync_receive_message(SERVER_ID, &sender);
+        if (ans == NULL)
+            return false;
+        if ((ans->level != hdr.level) || (ans->index != hdr.index))
+        {
+            ERRORLOG("Desync answer for wrong node from user %d",(int)sender);
+            result = false;
+        } else
+        if (ans->step == NDStp_Leaf)
+        {
+            net_desync_report_leaf(hdr.index, (const unsigned char *)(ans + 1), ans->data_size);
+            LbMemoryFree(ans);
+            break;
+        } else
+        if (ans->step == NDStp_Hashes)
+        {
+            const DesyncHash* srv_hashes = (const DesyncHash *)(ans + 1);
+            unsigned long first = hdr.index * DESYNC_TREE_FANOUT;
+            unsigned long count = min(tree->counts[hdr.level-1] - first, (unsigned long)DESYNC_TREE_FANOUT);
+            unsigned long n;
+            if (ans->data_size != count * sizeof(DesyncHash))
+                n = count;
+            else
+            for (n = 0; n < count; n++)
+            {
+                if (tree->hashes[hdr.level-1][first + n] != srv_hashes[n])
+                    break;
+            }
+            if ((n >= count) && (hdr.level + 1 == tree->levels_count))
+            {
+                NETLOG("Game state is the same as on server");
+                LbMemoryFree(ans);
+                break;
+            } else
+            if (n >= count)
+            {
+                // Hash of the node was different, but children are the same - or answer is broken
+                WARNLOG("Desync location not found at tree level %d",(int)hdr.level);
+                result = false;
+            } else
+            {
+                hdr.level--;
+                hdr.index = first + n;
+            }
+        } else
+        {
+            result = false;
+        }
+        LbMemoryFree(ans);
+    }
+    hdr.step = NDStp_Done;
+    net_desync_send_message(SERVER_ID, &hdr, NULL);
+    return result;
+}
+
+/**
+ * Finds which part of the game state differs between server and clients, and logs it.
+ * Needs to be called on all machines at once, before the state is re-synchronized.
+ * @return True if the walk was completed.
+ */
+TbBool net_desync_locate(void)
+{
+    // Changes which were not marked would make the walk end on a wrong leaf
+    desync_tree_invalidate();
+    desync_tree_update();
+    if (!desync_tree.valid)
+        return false;
+    NETLOG("Locating desync at turn %lu",(unsigned long)game.play_gameturn);
+    if (LbNetwork_IsServer())
+        return net_desync_server();
+    return net_desync_client();
+}
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
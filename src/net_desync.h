@@ -0,0 +1,49 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file net_desync.h
+ *     Header file for net_desync.c.
+ * @par Purpose:
+ *     Locating the source of desynchronization in network games.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef DK_NET_DESYNC_H
+#define DK_NET_DESYNC_H
+
+#include "globals.h"
+#include "bflib_basics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Amount of children of every node in the state hash tree. */
+#define DESYNC_TREE_FANOUT 16
+/******************************************************************************/
+struct Thing;
+struct Room;
+struct SlabMap;
+
+void desync_tree_mark_thing(const struct Thing *thing);
+void desync_tree_mark_room(const struct Room *room);
+void desync_tree_mark_slab(const struct SlabMap *slb);
+void desync_tree_invalidate(void);
+void desync_tree_update(void);
+TbBigChecksum desync_tree_root_checksum(void);
+void desync_tree_reset_stats(void);
+void desync_tree_bench_report(void);
+TbBool net_desync_locate(void);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
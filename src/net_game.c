@@ -153,6 +153,8 @@ void init_players_network_game(CoroutineLoop *context)
 {
   SYNCDBG(4,"Starting");
   setup_select_player_number();
+  LbNetwork_ResetScheduledExchange();
+  reset_resync_turn();
   coroutine_add(context, &setup_exchange_player_number);
   coroutine_add(context, &perform_checksum_verification);
   coroutine_add(context, &setup_alliances);
@@ -0,0 +1,369 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file net_resync.c
+ *     Delta re-synchronization of game state in network games.
+ * @par Purpose:
+ *     Makes game state of clients identical to the one on server, transferring
+ *     only the parts which differ.
+ * @par Comment:
+ *     The state is split into fixed size pages. Server sends hashes of all its
+ *     pages, each client answers with a bitmap of pages which differ from its
+ *     own, and then server sends just these pages, compressed with zlib.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "pre_inc.h"
+#include "net_resync.h"
+
+#include <zlib.h>
+
+#include "globals.h"
+#include "bflib_basics.h"
+#include "bflib_memory.h"
+#include "bflib_network.h"
+#include "post_inc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+enum NetResyncStep {
+    NRStp_Hashes = 1, // from server: hashes of all pages
+    NRStp_Request,    // to server: bitmap of pages which differ
+    NRStp_Pages,      // from server: compressed content of requested pages
+};
+
+#pragma pack(1)
+
+struct NetResyncHeader {
+    unsigned char step;
+    unsigned long total_size;
+    unsigned long pages_count;
+    /** Size of the data before compression; used by pages message only. */
+    unsigned long raw_size;
+    /** Size of the data following the header. */
+    unsigned long data_size;
+};
+
+struct NetResyncPageHash {
+    unsigned long crc;
+    unsigned long adler;
+};
+
+#pragma pack()
+/******************************************************************************/
+static unsigned long net_resync_total_size(const struct NetResyncRegion *regions, int regions_count)
+{
+    unsigned long total = 0;
+    for (int i = 0; i < regions_count; i++)
+        total += regions[i].size;
+    return total;
+}
+
+/**
+ * Counts pages of all regions. Pages never cross region boundary,
+ * so last page of every region may be shorter.
+ */
+static unsigned long net_resync_pages_count(const struct NetResyncRegion *regions, int regions_count)
+{
+    unsigned long count = 0;
+    for (int i = 0; i < regions_count; i++)
+        count += (regions[i].size + NET_RESYNC_PAGE_SIZE - 1) / NET_RESYNC_PAGE_SIZE;
+    return count;
+}
+
+static unsigned char *net_resync_page(const struct NetResyncRegion *regions, int regions_count, unsigned long page_idx, unsigned long *size)
+{
+    for (int i = 0; i < regions_count; i++)
+    {
+        unsigned long region_pages = (regions[i].size + NET_RESYNC_PAGE_SIZE - 1) / NET_RESYNC_PAGE_SIZE;
+        if (page_idx < region_pages)
+        {
+            unsigned long pos = page_idx * NET_RESYNC_PAGE_SIZE;
+            *size = min(regions[i].size - pos, (unsigned long)NET_RESYNC_PAGE_SIZE);
+            return (unsigned char *)regions[i].data + pos;
+        }
+        page_idx -= region_pages;
+    }
+    *size = 0;
+    return NULL;
+}
+
+static void net_resync_hash_pages(const struct NetResyncRegion *regions, int regions_count, struct NetResyncPageHash *hashes, unsigned long pages_count)
+{
+    for (unsigned long n = 0; n < pages_count; n++)
+    {
+        unsigned long size;
+        const unsigned char* page = net_resync_page(regions, regions_count, n, &size);
+        hashes[n].crc = crc32(0L, page, size);
+        hashes[n].adler = adler32(1L, page, size);
+    }
+}
+
+static TbBool net_resync_page_requested(const unsigned char *bitmap, unsigned long page_idx)
+{
+    return ((bitmap[page_idx >> 3] & (1 << (page_idx & 7))) != 0);
+}
+
+static TbBool net_resync_send_message(NetUserId destination, const struct NetResyncHeader *hdr, const void *data)
+{
+    unsigned char* buf = (unsigned char *)LbMemoryAlloc(sizeof(struct NetResyncHeader) + hdr->data_size);
+    if (buf == NULL)
+    {
+        ERRORLOG("Cannot allocate %lu bytes for resync message",(unsigned long)(sizeof(struct NetResyncHeader) + hdr->data_size));
+        return false;
+    }
+    LbMemoryCopy(buf, hdr, sizeof(struct NetResyncHeader));
+    if (hdr->data_size > 0)
+        LbMemoryCopy(buf + sizeof(struct NetResyncHeader), data, hdr->data_size);
+    TbBool result = LbNetwork_ResyncSend(destination, buf, sizeof(struct NetResyncHeader) + hdr->data_size);
+    LbMemoryFree(buf);
+    return result;
+}
+
+/**
+ * Receives a resync message of given step.
+ * @return Buffer starting with the message header, to be freed with LbMemoryFree(); NULL on failure.
+ */
+static struct NetResyncHeader *net_resync_receive_message(NetUserId source, NetUserId *sender, unsigned char step)
+{
+    size_t len;
+    struct NetResyncHeader* hdr = (struct NetResyncHeader *)LbNetwork_ResyncReceive(source, sender, &len);
+    if (hdr == NULL)
+        return NULL;
+    if ((len < sizeof(struct NetResyncHeader)) || (hdr->step != step) || (len - sizeof(struct NetResyncHeader) != hdr->data_size))
+    {
+        ERRORLOG("Invalid resync message from user %d, step %d expected",(int)*sender,(int)step);
+        LbMemoryFree(hdr);
+        return NULL;
+    }
+    return hdr;
+}
+
+/**
+ * Packs pages requested by a client and sends them.
+ */
+static TbBool net_resync_send_pages(NetUserId destination, const struct NetResyncRegion *regions, int regions_count,
+    unsigned long pages_count, const unsigned char *bitmap)
+{
+    unsigned long raw_size = 0;
+    unsigned long requested = 0;
+    for (unsigned long n = 0; n < pages_count; n++)
+    {
+        if (!net_resync_page_requested(bitmap, n))
+            continue;
+        unsigned long size;
+        net_resync_page(regions, regions_count, n, &size);
+        raw_size += size;
+        requested++;
+    }
+    unsigned char* raw_buf = (unsigned char *)LbMemoryAlloc(raw_size + 1);
+    uLongf packed_size = compressBound(raw_size);
+    unsigned char* packed_buf = (unsigned char *)LbMemoryAlloc(packed_size + 1);
+    if ((raw_buf == NULL) || (packed_buf == NULL))
+    {
+        ERRORLOG("Cannot allocate buffers for %lu bytes of resync pages",raw_size);
+        LbMemoryFree(raw_buf);
+        LbMemoryFree(packed_buf);
+        return false;
+    }
+    unsigned long pos = 0;
+    for (unsigned long n = 0; n < pages_count; n++)
+    {
+        if (!net_resync_page_requested(bitmap, n))
+            continue;
+        unsigned long size;
+        const unsigned char* page = net_resync_page(regions, regions_count, n, &size);
+        LbMemoryCopy(raw_buf + pos, page, size);
+        pos += size;
+    }
+    if (compress2(packed_buf, &packed_size, raw_buf, raw_size, Z_BEST_SPEED) != Z_OK)
+    {
+        ERRORLOG("Cannot compress resync pages");
+        LbMemoryFree(raw_buf);
+        LbMemoryFree(packed_buf);
+        return false;
+    }
+    NETLOG("User %d needs %lu of %lu pages, %lu bytes packed into %lu",(int)destination,
+        requested,pages_count,raw_size,(unsigned long)packed_size);
+    struct NetResyncHeader hdr;
+    LbMemorySet(&hdr, 0, sizeof(hdr));
+    hdr.step = NRStp_Pages;
+    hdr.total_size = net_resync_total_size(regions, regions_count);
+    hdr.pages_count = pages_count;
+    hdr.raw_size = raw_size;
+    hdr.data_size = packed_size;
+    TbBool result = net_resync_send_message(destination, &hdr, packed_buf);
+    LbMemoryFree(raw_buf);
+    LbMemoryFree(packed_buf);
+    return result;
+}
+
+static TbBool net_resync_server(const struct NetResyncRegion *regions, int regions_count)
+{
+    NetUserId users[MAX_N_USERS];
+    int users_count = LbNetwork_ResyncUsers(users, MAX_N_USERS);
+    unsigned long pages_count = net_resync_pages_count(regions, regions_count);
+    struct NetResyncPageHash* hashes = (struct NetResyncPageHash *)LbMemoryAlloc(pages_count * sizeof(struct NetResyncPageHash) + 1);
+    if (hashes == NULL)
+    {
+        ERRORLOG("Cannot allocate resync hashes for %lu pages",pages_count);
+        return false;
+    }
+    net_resync_hash_pages(regions, regions_count, hashes, pages_count);
+    struct NetResyncHeader hdr;
+    LbMemorySet(&hdr, 0, sizeof(hdr));
+    hdr.step = NRStp_Hashes;
+    hdr.total_size = net_resync_total_size(regions, regions_count);
+    hdr.pages_count = pages_count;
+    hdr.data_size = pages_count * sizeof(struct NetResyncPageHash);
+    TbBool result = true;
+    for (int i = 0; i < users_count; i++)
+    {
+        if (!net_resync_send_message(users[i], &hdr, hashes))
+            result = false;
+    }
+    LbMemoryFree(hashes);
+    // Clients may answer in any order; each answer says who sent it
+    for (int i = 0; i < users_count; i++)
+    {
+        NetUserId sender = users[i];
+        struct NetResyncHeader* req = net_resync_receive_message(users[i], &sender, NRStp_Request);
+        if (req == NULL)
+        {
+            result = false;
+            continue;
+        }
+        if ((req->total_size != hdr.total_size) || (req->pages_count != pages_count)
+          || (req->data_size != (pages_count + 7) / 8))
+        {
+            ERRORLOG("User %d has incompatible game state, %lu bytes instead of %lu",(int)sender,req->total_size,hdr.total_size);
+            result = false;
+        } else
+        if (!net_resync_send_pages(sender, regions, regions_count, pages_count, (const unsigned char *)(req + 1)))
+        {
+            result = false;
+        }
+        LbMemoryFree(req);
+    }
+    return result;
+}
+
+static TbBool net_resync_client(const struct NetResyncRegion *regions, int regions_count)
+{
+    NetUserId sender;
+    struct NetResyncHeader* srv = net_resync_receive_message(SERVER_ID, &sender, NRStp_Hashes);
+    if (srv == NULL)
+        return false;
+    unsigned long pages_count = net_resync_pages_count(regions, regions_count);
+    unsigned long bitmap_size = (pages_count + 7) / 8;
+    struct NetResyncHeader hdr;
+    LbMemorySet(&hdr, 0, sizeof(hdr));
+    hdr.step = NRStp_Request;
+    hdr.total_size = net_resync_total_size(regions, regions_count);
+    hdr.pages_count = pages_count;
+    if ((srv->total_size != hdr.total_size) || (srv->pages_count != pages_count)
+      || (srv->data_size != pages_count * sizeof(struct NetResyncPageHash)))
+    {
+        ERRORLOG("Server has incompatible game state, %lu bytes instead of %lu",srv->total_size,hdr.total_size);
+        LbMemoryFree(srv);
+        // Let the server know it should not wait for us
+        net_resync_send_message(SERVER_ID, &hdr, NULL);
+        return false;
+    }
+    const struct NetResyncPageHash* srv_hashes = (const struct NetResyncPageHash *)(srv + 1);
+    struct NetResyncPageHash* hashes = (struct NetResyncPageHash *)LbMemoryAlloc(pages_count * sizeof(struct NetResyncPageHash) + 1);
+    unsigned char* bitmap = (unsigned char *)LbMemoryAlloc(bitmap_size + 1);
+    if ((hashes == NULL) || (bitmap == NULL))
+    {
+        ERRORLOG("Cannot allocate resync hashes for %lu pages",pages_count);
+        LbMemoryFree(hashes);
+        LbMemoryFree(bitmap);
+        LbMemoryFree(srv);
+        net_resync_send_message(SERVER_ID, &hdr, NULL);
+        return false;
+    }
+    net_resync_hash_pages(regions, regions_count, hashes, pages_count);
+    unsigned long raw_size = 0;
+    unsigned long requested = 0;
+    for (unsigned long n = 0; n < pages_count; n++)
+    {
+        if ((hashes[n].crc == srv_hashes[n].crc) && (hashes[n].adler == srv_hashes[n].adler))
+            continue;
+        unsigned long size;
+        net_resync_page(regions, regions_count, n, &size);
+        bitmap[n >> 3] |= (1 << (n & 7));
+        raw_size += size;
+        requested++;
+    }
+    LbMemoryFree(hashes);
+    LbMemoryFree(srv);
+    NETLOG("Requesting %lu of %lu pages, %lu bytes",requested,pages_count,raw_size);
+    hdr.data_size = bitmap_size;
+    if (!net_resync_send_message(SERVER_ID, &hdr, bitmap))
+    {
+        LbMemoryFree(bitmap);
+        return false;
+    }
+    struct NetResyncHeader* pgs = net_resync_receive_message(SERVER_ID, &sender, NRStp_Pages);
+    if (pgs == NULL)
+    {
+        LbMemoryFree(bitmap);
+        return false;
+    }
+    if (pgs->raw_size != raw_size)
+    {
+        ERRORLOG("Resync pages have %lu bytes instead of %lu",pgs->raw_size,raw_size);
+        LbMemoryFree(pgs);
+        LbMemoryFree(bitmap);
+        return false;
+    }
+    unsigned char* raw_buf = (unsigned char *)LbMemoryAlloc(raw_size + 1);
+    uLongf unpacked_size = raw_size;
+    if ((raw_buf == NULL) || (uncompress(raw_buf, &unpacked_size, (const unsigned char *)(pgs + 1), pgs->data_size) != Z_OK)
+      || (unpacked_size != raw_size))
+    {
+        ERRORLOG("Cannot unpack %lu bytes of resync pages",raw_size);
+        LbMemoryFree(raw_buf);
+        LbMemoryFree(pgs);
+        LbMemoryFree(bitmap);
+        return false;
+    }
+    unsigned long pos = 0;
+    for (unsigned long n = 0; n < pages_count; n++)
+    {
+        if (!net_resync_page_requested(bitmap, n))
+            continue;
+        unsigned long size;
+        unsigned char* page = net_resync_page(regions, regions_count, n, &size);
+        LbMemoryCopy(page, raw_buf + pos, size);
+        pos += size;
+    }
+    LbMemoryFree(raw_buf);
+    LbMemoryFree(pgs);
+    LbMemoryFree(bitmap);
+    return true;
+}
+
+/**
+ * Makes given memory regions on all clients identical to the ones on server.
+ * Needs to be called on all machines at once; server sends the state, clients receive it.
+ * @return True on success.
+ */
+TbBool net_resync_regions(const struct NetResyncRegion *regions, int regions_count)
+{
+    if (LbNetwork_IsServer())
+        return net_resync_server(regions, regions_count);
+    return net_resync_client(regions, regions_count);
+}
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
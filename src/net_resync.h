@@ -0,0 +1,43 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file net_resync.h
+ *     Header file for net_resync.c.
+ * @par Purpose:
+ *     Delta re-synchronization of game state in network games.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef DK_NET_RESYNC_H
+#define DK_NET_RESYNC_H
+
+#include "globals.h"
+#include "bflib_basics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Size of the pieces in which game state is compared and transferred. */
+#define NET_RESYNC_PAGE_SIZE 4096
+
+/** Block of memory which is to be identical on all machines. */
+struct NetResyncRegion {
+    void *data;
+    unsigned long size;
+};
+/******************************************************************************/
+TbBool net_resync_regions(const struct NetResyncRegion *regions, int regions_count);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
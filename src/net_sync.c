@@ -34,6 +34,9 @@
 #include "keeperfx.hpp"
 #include "frontend.h"
 #include "thing_effects.h"
+#include "light_data.h"
+#include "net_resync.h"
+#include "net_desync.h"
 #include "post_inc.h"
 
 #ifdef __cplusplus
@@ -63,6 +66,8 @@ struct Boing {
 /******************************************************************************/
 /** Structure used for storing 'localised parameters' when resyncing net game. */
 struct Boing boing;
+/** Game turn after the last re-synchronization, plus one; packets sent before it are not compared. */
+static unsigned long resync_turn_end;
 /******************************************************************************/
 long get_resync_sender(void)
 {
@@ -75,28 +80,54 @@ long get_resync_sender(void)
   return -1;
 }
 
-TbBool send_resync_game(void)
+/**
+ * Writes the game state which is about to be sent to other players into a file.
+ * Useful when looking for the reason of desync; enabled by command line option.
+ */
+static void dump_resync_game(void)
 {
-  //TODO NET see if it is necessary to dump to file... probably superfluous
-  char* fname = prepare_file_path(FGrp_Save, "resync.dat");
-  TbFileHandle fh = LbFileOpen(fname, Lb_FILE_MODE_NEW);
-  if (fh == -1)
-  {
-    ERRORLOG("Can't open resync file.");
-    return false;
-  }
+    char* fname = prepare_file_path(FGrp_Save, "resync.dat");
+    TbFileHandle fh = LbFileOpen(fname, Lb_FILE_MODE_NEW);
+    if (fh == -1)
+    {
+        ERRORLOG("Can't open resync file.");
+        return;
+    }
+    LbFileWrite(fh, &game, sizeof(game));
+    LbFileWrite(fh, &gameadd, sizeof(gameadd));
+    LbFileWrite(fh, &light_extra_state, sizeof(light_extra_state));
+    LbFileClose(fh);
+}
 
-  LbFileWrite(fh, &game, sizeof(game));
-  LbFileClose(fh);
+static TbBool resync_game_state(void)
+{
+    struct NetResyncRegion regions[] = {
+        {&game, sizeof(game)},
+        {&gameadd, sizeof(gameadd)},
+        {&light_extra_state, sizeof(light_extra_state)},
+    };
+    return net_resync_regions(regions, sizeof(regions)/sizeof(regions[0]));
+}
 
-  NETLOG("Initiating re-synchronization of network game");
-  return LbNetwork_Resync(&game, sizeof(game));
+TbBool send_resync_game(void)
+{
+    // Some of the game state is kept outside of structs - make sure it is updated
+    light_export_system_state(&gameadd.lightst);
+    light_export_extra_lights(&light_extra_state);
+    if ((start_params.debug_flags & DFlg_ResyncDump) != 0)
+        dump_resync_game();
+    NETLOG("Initiating re-synchronization of network game");
+    return resync_game_state();
 }
 
 TbBool receive_resync_game(void)
 {
     NETLOG("Initiating re-synchronization of network game");
-    return LbNetwork_Resync(&game, sizeof(game));
+    if (!resync_game_state())
+        return false;
+    light_import_system_state(&gameadd.lightst);
+    light_import_extra_lights(&light_extra_state);
+    return true;
 }
 
 void store_localised_game_structure(void)
@@ -143,12 +174,22 @@ void recall_localised_game_structure(void)
     game.manufactr_tooltip = boing.manufactr_tooltip;
 }
 
+/**
+ * Forgets the last re-synchronization. Needs to be called when a network game starts.
+ */
+void reset_resync_turn(void)
+{
+    resync_turn_end = 0;
+}
+
 void resync_game(void)
 {
     SYNCDBG(2,"Starting");
     struct PlayerInfo* player = get_my_player();
     draw_out_of_sync_box(0, 32*units_per_pixel/16, player->engine_window_x);
     reset_eye_lenses();
+    if ((start_params.debug_flags & DFlg_DesyncLocator) != 0)
+        net_desync_locate();
     store_localised_game_structure();
     int i = get_resync_sender();
     if (is_my_player_number(i))
@@ -162,6 +203,10 @@ void resync_game(void)
     reinit_level_after_load();
     set_flag_byte(&game.system_flags,GSF_NetGameNoSync,false);
     set_flag_byte(&game.system_flags,GSF_NetSeedNoSync,false);
+    // Packets made up to now, which will be used on next turns because of input lag, have outdated checksums
+    resync_turn_end = game.play_gameturn + 1;
+    // Game state was replaced as a whole, so marks of changed leaves do not cover it
+    desync_tree_invalidate();
 }
 
 /**
@@ -254,10 +299,18 @@ void player_packet_checksum_add(PlayerNumber plyr_idx, TbBigChecksum sum, const
 }
 
 /**
- * Checks if all active players packets have same checksums.
- * @return Returns false if all checksums are same; true if there's mismatch.
+ * Checks whether checksum in given packet can be compared with the others.
+ * Packets filled in by server for players who didn't send them in time have no checksum,
+ * and ones made before the last re-synchronization have checksum of the replaced state.
  */
-short checksums_different()
+static TbBool packet_checksum_is_current(const struct Packet *pckt)
+{
+    if (pckt->turn == 0)
+        return false;
+    return ((unsigned long)pckt->turn > resync_turn_end);
+}
+
+static short packets_checksums_different(TbBool only_current)
 {
     TbChecksum checksum = 0;
     unsigned short is_set = false;
@@ -268,6 +321,8 @@ short checksums_different()
         if (player_exists(player) && ((player->allocflags & PlaF_CompCtrl) == 0))
         {
             struct Packet* pckt = get_packet_direct(player->packet_num);
+            if (only_current && !packet_checksum_is_current(pckt))
+                continue;
             if (!is_set)
             {
                 checksum = pckt->chksum;
@@ -285,6 +340,61 @@ short checksums_different()
     return false;
 }
 
+/**
+ * Checks if current packets of players who use the desync locator have the same state hash.
+ * Players who don't use it send zero, and are skipped.
+ */
+static TbBool packets_state_hashes_different(void)
+{
+    TbBigChecksum state_hash = 0;
+    int plyr = -1;
+    for (int i = 0; i < PLAYERS_COUNT; i++)
+    {
+        struct PlayerInfo* player = get_player(i);
+        if (player_exists(player) && ((player->allocflags & PlaF_CompCtrl) == 0))
+        {
+            struct Packet* pckt = get_packet_direct(player->packet_num);
+            if (!packet_checksum_is_current(pckt) || (pckt->state_hash == 0))
+                continue;
+            if (plyr < 0)
+            {
+                state_hash = pckt->state_hash;
+                plyr = i;
+            }
+            else if (state_hash != pckt->state_hash)
+            {
+                ERRORLOG("State hashes %08lx(%d) != %08lx(%d) turn: %ld", (unsigned long)state_hash, plyr,
+                    (unsigned long)pckt->state_hash, i, game.play_gameturn);
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+/**
+ * Checks if all active players packets have same checksums.
+ * @return Returns false if all checksums are same; true if there's mismatch.
+ */
+short checksums_different()
+{
+    return packets_checksums_different(false);
+}
+
+/**
+ * Checks if active players packets used on this game turn have same checksums.
+ * Packets which have no checksum of the current state are skipped; replayed packets are all compared.
+ * @return Returns false if all checksums are same; true if there's mismatch.
+ */
+short turn_checksums_different(void)
+{
+    if (game.packet_load_enable || (game.game_kind == GKind_LocalGame))
+        return packets_checksums_different(false);
+    if (packets_state_hashes_different())
+        return true;
+    return packets_checksums_different(true);
+}
+
 TbBigChecksum get_thing_checksum(const struct Thing* thing)
 {
     SYNCDBG(18, "Starting");
@@ -34,6 +34,7 @@ extern "C" {
 #pragma pack()
 /******************************************************************************/
 void resync_game(void);
+void reset_resync_turn(void);
 CoroutineLoopState perform_checksum_verification(CoroutineLoop *con);
 
 /******************************************************************************/
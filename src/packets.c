@@ -41,6 +41,7 @@
 #include "front_landview.h"
 #include "front_network.h"
 #include "frontmenu_net.h"
+#include "game_bench.h"
 #include "frontend.h"
 #include "vidmode.h"
 #include "config.h"
@@ -1433,15 +1434,22 @@ void process_packets(void)
         if (!game.packet_load_enable || game.numfield_149F47)
         {
             struct Packet* pckt = get_packet_direct(player->packet_num);
-            if (LbNetwork_Exchange(pckt, game.packets, sizeof(struct Packet)) != 0)
+            // With input lag, the packet is used on a later turn; this tells whether its checksum is still valid then
+            pckt->turn = game.play_gameturn + 1;
+            if (LbNetwork_ExchangeScheduled(pckt, game.packets, sizeof(struct Packet)) != 0)
             {
-                ERRORLOG("LbNetwork_Exchange failed");
+                ERRORLOG("LbNetwork_ExchangeScheduled failed");
             }
         }
         replace_with_ai(old_active_players);
     }
+    if (game.packet_load_enable)
+    {
+        // Replayed packets may also go through simulated network, to measure its delays
+        bench_net_exchange();
+    }
   // Setting checksum problem flags
-  switch (checksums_different())
+  switch (turn_checksums_different())
   {
   case 1:
       set_flag_byte(&game.system_flags,GSF_NetGameNoSync,true);
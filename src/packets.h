@@ -249,7 +249,7 @@ extern unsigned long start_seed;
  * Stores data exchanged between players each turn and used to re-create their input.
  */
 struct Packet {
-    int field_0;
+    int turn; //! Game turn on which the packet was sent through scheduled exchange, plus one; zero if it wasn't
     TbChecksum chksum; //! Checksum of all things within the game and synchronized random seed
     unsigned char action; //! Action kind performed by the player which owns this packet
     long actn_par1; //! Players action parameter #1
@@ -260,6 +260,7 @@ struct Packet {
     unsigned char additional_packet_values; // uses the flags and values from TbPacketAddValues
     long actn_par3; //! Players action parameter #3
     long actn_par4; //! Players action parameter #4
+    TbBigChecksum state_hash; //! Root of game state hash tree of the desync locator; zero if the player doesn't use it
 };
 
 struct PacketSaveHead {
@@ -311,12 +312,15 @@ void clear_packets(void);
 TbBigChecksum compute_players_checksum(void);
 void player_packet_checksum_add(PlayerNumber plyr_idx, TbBigChecksum sum, const char *area_name);
 short checksums_different(void);
+short turn_checksums_different(void);
 void post_init_packets(void);
 
 TbBool open_new_packet_file_for_save(void);
 void load_packets_for_turn(GameTurn nturn);
+TbBigChecksum get_packet_save_checksum(void);
 TbBool open_packet_file_for_load(char *fname, struct CatalogueEntry *centry);
 short save_packets(void);
+TbBool seek_packet_file(unsigned long pckt_turn);
 void close_packet_file(void);
 TbBool reinit_packets_after_load(void);
 struct Room *keeper_build_room(long stl_x,long stl_y,long plyr_idx,long rkind);
@@ -18,23 +18,34 @@
 /******************************************************************************/
 #include "pre_inc.h"
 #include "packets.h"
+#include "packets_stream.h"
 
+#include <stddef.h>
 #include "bflib_fileio.h"
 #include "bflib_memory.h"
+#include "ariadne.h"
+#include "ariadne_routecache.h"
 #include "front_landview.h"
 #include "game_legacy.h"
+#include "game_merge.h"
+#include "light_data.h"
 #include "game_saves.h"
 #include "gui_topmsg.h"
 #include "config_settings.h"
+#include "keeperfx.hpp"
 #include "post_inc.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 /******************************************************************************/
-#define PACKET_TURN_SIZE (NET_PLAYERS_COUNT*sizeof(struct PacketEx) + sizeof(TbBigChecksum))
+/** Amount of turns between snapshots of game state stored in packet file. */
+#define PACKET_SNAPSHOT_INTERVAL 1200
+/******************************************************************************/
 struct Packet bad_packet;
 unsigned long start_seed;
+/** Version of packet data in the file opened for load. */
+static unsigned long packet_data_version;
 /******************************************************************************/
 #ifdef __cplusplus
 }
@@ -142,8 +153,32 @@ TbBool open_packet_file_for_load(char *fname, struct CatalogueEntry *centry)
         WARNMSG("Couldn't correctly read packet file \"%s\" header.",fname);
         return false;
     }
+    // The packet data chunk header, which was read last, tells the data format
+    struct FileChunkHeader hdr;
+    LbFileSeek(game.packet_save_fp, LbFilePosition(game.packet_save_fp) - sizeof(hdr), Lb_FILE_SEEK_BEGINNING);
+    if ((LbFileRead(game.packet_save_fp, &hdr, sizeof(hdr)) != sizeof(hdr))
+      || ((hdr.ver != 0) && ((hdr.ver < PACKET_STREAM_VERSION_FIRST) || (hdr.ver > PACKET_STREAM_VERSION))))
+    {
+        LbFileClose(game.packet_save_fp);
+        game.packet_save_fp = -1;
+        game.packet_fopened = 0;
+        WARNMSG("Packet file \"%s\" data format is not supported.",fname);
+        return false;
+    }
+    packet_data_version = hdr.ver;
+    // Older recordings were made with every navigation area triangulated separately, re-routes traced at once,
+    // and cached routes used only for exact same endpoints
+    triangulation_set_merging(packet_data_version >= PACKET_VERSION_QUEUED_NAVIGATION);
+    ariadne_set_route_queueing(packet_data_version >= PACKET_VERSION_QUEUED_NAVIGATION);
+    route_cache_set_triangle_reuse(packet_data_version >= PACKET_VERSION_ROUTE_TRIANGLES);
+    if (packet_data_version < PACKET_STREAM_VERSION)
+        SYNCMSG("Packet file \"%s\" data version %lu is older than %d, replaying with its navigation rules",
+            fname,packet_data_version,(int)PACKET_STREAM_VERSION);
     game.packet_file_pos = LbFilePosition(game.packet_save_fp);
-    game.turns_stored = (LbFileLengthHandle(game.packet_save_fp) - game.packet_file_pos) / PACKET_TURN_SIZE;
+    if (packet_data_version >= PACKET_STREAM_VERSION_FIRST)
+        game.turns_stored = packet_stream_reader_start(game.packet_save_fp);
+    else
+        game.turns_stored = (LbFileLengthHandle(game.packet_save_fp) - game.packet_file_pos) / PACKET_TURN_SIZE;
     if ((game.packet_checksum_verify) && (!game.packet_save_head.chksum_available))
     {
         WARNMSG("PacketSave checksum not available, checking disabled.");
@@ -176,61 +211,121 @@ static TbBigChecksum get_thing_simple_checksum(const struct Thing *tng)
          + (ulong)tng->move_angle_xy + (ulong)tng->owner;
 }
 
-static TbBigChecksum get_packet_save_checksum(void)
+TbBigChecksum get_packet_save_checksum(void)
 {
     TbBigChecksum sum = 0;
     for (long tng_idx = 0; tng_idx < THINGS_COUNT; tng_idx++)
     {
-        struct Thing* tng = thing_get(tng_idx);
-        if ((tng->alloc_flags & TAlF_Exists) != 0)
-        {
-            // It would be nice to completely ignore effects, but since
-            // thing indices are used in packets, lack of effect may cause desync too.
-            if ((tng->class_id != TCls_AmbientSnd) && (tng->class_id != TCls_EffectElem))
-            {
-                sum += get_thing_simple_checksum(tng);
-            }
-        }
+        // Use the dense sweep data to skip free slots and effects without touching the things.
+        // It would be nice to completely ignore effects, but since
+        // thing indices are used in packets, lack of effect may cause desync too.
+        if (!things_sweep.exists[tng_idx])
+            continue;
+        ThingClass sweep_class = things_sweep.class_id[tng_idx];
+        if ((sweep_class == TCls_AmbientSnd) || (sweep_class == TCls_EffectElem))
+            continue;
+        sum += get_thing_simple_checksum(thing_get(tng_idx));
     }
     return sum;
 }
 
+static int packet_snapshot_regions(struct PacketStreamRegion *regions)
+{
+    regions[0].data = &game;
+    regions[0].size = sizeof(game);
+    regions[1].data = &gameadd;
+    regions[1].size = sizeof(gameadd);
+    regions[2].data = &intralvl;
+    regions[2].size = sizeof(intralvl);
+    regions[3].data = &light_extra_state;
+    regions[3].size = sizeof(light_extra_state);
+    return 4;
+}
+
+/**
+ * Adds packets of current turn to the packet file.
+ * They are written to disk in blocks of turns, by the packet stream writer thread.
+ * Every few turns, state of the game is stored as well, so that replay can start from there.
+ */
 short save_packets(void)
 {
-    const int turn_data_size = PACKET_TURN_SIZE;
-    unsigned char pckt_buf[PACKET_TURN_SIZE+4];
     TbBigChecksum chksum;
     SYNCDBG(6,"Starting");
+    unsigned long turn = packet_stream_written_turns();
+    if ((turn > 0) && (turn % PACKET_SNAPSHOT_INTERVAL == 0))
+    {
+        struct PacketStreamRegion regions[4];
+        int count = packet_snapshot_regions(regions);
+        // Some of the game state is kept outside of structs - make sure it is updated
+        light_export_system_state(&gameadd.lightst);
+        light_export_extra_lights(&light_extra_state);
+        packet_stream_write_snapshot(regions, count);
+    }
     if (game.packet_checksum_verify)
         chksum = get_packet_save_checksum();
     else
         chksum = 0;
-    LbFileSeek(game.packet_save_fp, 0, Lb_FILE_SEEK_END);
-    // Prepare data in the buffer
-    for (int i = 0; i < NET_PLAYERS_COUNT; i++)
-        LbMemoryCopy(&pckt_buf[i*sizeof(struct Packet)], &game.packets[i], sizeof(struct Packet));
-    LbMemoryCopy(&pckt_buf[NET_PLAYERS_COUNT*sizeof(struct Packet)], &chksum, sizeof(TbBigChecksum));
-    // Write buffer into file
-    if (LbFileWrite(game.packet_save_fp, &pckt_buf, turn_data_size) != turn_data_size)
+    packet_stream_write_turn(game.packets, chksum);
+    return true;
+}
+
+/**
+ * Restores game state from the last snapshot stored in packet file before given turn.
+ * Turns between the snapshot and the given one are then replayed in fast forward.
+ * @return True if a snapshot was restored.
+ */
+TbBool seek_packet_file(unsigned long pckt_turn)
+{
+    if (!game.packet_fopened || (packet_data_version < PACKET_STREAM_VERSION_FIRST))
     {
-        ERRORLOG("Packet file write error");
+        WARNLOG("Packet file has no snapshots, replaying from start");
+        return false;
     }
-    if ( !LbFileFlush(game.packet_save_fp) )
-    {
-        ERRORLOG("Unable to flush PacketSave File");
+    // Packet file state is not a part of the snapshot
+    const size_t span_start = offsetof(struct Game, packet_save_enable);
+    const size_t span_size = offsetof(struct Game, numfield_149F47) + sizeof(game.numfield_149F47) - span_start;
+    unsigned char* span = (unsigned char *)LbMemoryAlloc(span_size);
+    if (span == NULL)
         return false;
+    LbMemoryCopy(span, (unsigned char *)&game + span_start, span_size);
+    PlayerNumber plyr_idx = my_player_number;
+    struct PacketStreamRegion regions[4];
+    int count = packet_snapshot_regions(regions);
+    unsigned long snap_turn;
+    TbBool result = packet_stream_seek_snapshot(pckt_turn, regions, count, &snap_turn);
+    if (result)
+    {
+        reinit_level_after_load();
+        LbMemoryCopy((unsigned char *)&game + span_start, span, span_size);
+        my_player_number = plyr_idx;
+        light_import_system_state(&gameadd.lightst);
+        light_import_extra_lights(&light_extra_state);
+        game.pckt_gameturn = snap_turn;
+        game.packet_file_pos = LbFilePosition(game.packet_save_fp);
+        if (game.turns_fastforward < pckt_turn - snap_turn)
+            game.turns_fastforward = pckt_turn - snap_turn;
+        SYNCMSG("Restored snapshot of turn %lu, replaying %lu turns to reach turn %lu", snap_turn, pckt_turn - snap_turn, pckt_turn);
+    } else
+    {
+        WARNLOG("No snapshot before turn %lu in packet file, replaying from start", pckt_turn);
     }
-    return true;
+    LbMemoryFree(span);
+    return result;
 }
 
 void close_packet_file(void)
 {
     if ( game.packet_fopened )
     {
+        packet_stream_writer_stop();
+        packet_stream_reader_stop();
         LbFileClose(game.packet_save_fp);
         game.packet_fopened = 0;
         game.packet_save_fp = -1;
     }
+    triangulation_set_merging(true);
+    ariadne_set_route_queueing(true);
+    route_cache_set_triangle_reuse(true);
 }
 
 void dump_memory_to_file(const char * fname, const char * buf, size_t len)
@@ -310,6 +405,14 @@ TbBool open_new_packet_file_for_save(void)
         game.packet_save_fp = -1;
         return false;
     }
+    if (!packet_stream_writer_start(game.packet_save_fp))
+    {
+        ERRORLOG("Cannot start writing packets to file, \"%s\".",game.packet_fname);
+        LbFileClose(game.packet_save_fp);
+        game.packet_fopened = 0;
+        game.packet_save_fp = -1;
+        return false;
+    }
     game.packet_fopened = 1;
     return true;
 }
@@ -328,16 +431,32 @@ void load_packets_for_turn(GameTurn nturn)
         return;
     }
 
-    if (LbFileRead(game.packet_save_fp, &pckt_buf, turn_data_size) == -1)
+    TbBigChecksum tot_chksum;
+    if (packet_data_version >= PACKET_STREAM_VERSION_FIRST)
     {
-        ERRORDBG(18,"Cannot read turn data from Packet File");
-        erstat_inc(ESE_CantReadPackets);
-        return;
+        if (!packet_stream_read_turn(game.packets, &tot_chksum))
+        {
+            ERRORDBG(18,"Cannot read turn data from Packet File");
+            erstat_inc(ESE_CantReadPackets);
+            return;
+        }
+        game.packet_file_pos = LbFilePosition(game.packet_save_fp);
+    } else
+    {
+        if (LbFileRead(game.packet_save_fp, &pckt_buf, turn_data_size) == -1)
+        {
+            ERRORDBG(18,"Cannot read turn data from Packet File");
+            erstat_inc(ESE_CantReadPackets);
+            return;
+        }
+        game.packet_file_pos += turn_data_size;
+        for (long i = 0; i < NET_PLAYERS_COUNT; i++)
+        {
+            LbMemorySet(&game.packets[i], 0, sizeof(struct Packet));
+            LbMemoryCopy(&game.packets[i], &pckt_buf[i * PACKET_V0_SIZE], PACKET_V0_SIZE);
+        }
+        tot_chksum = llong(&pckt_buf[NET_PLAYERS_COUNT * PACKET_V0_SIZE]);
     }
-    game.packet_file_pos += turn_data_size;
-    for (long i = 0; i < NET_PLAYERS_COUNT; i++)
-        LbMemoryCopy(&game.packets[i], &pckt_buf[i * sizeof(struct Packet)], sizeof(struct Packet));
-    TbBigChecksum tot_chksum = llong(&pckt_buf[NET_PLAYERS_COUNT * sizeof(struct Packet)]);
     if (game.turns_fastforward > 0)
         game.turns_fastforward--;
     if (game.packet_checksum_verify)
@@ -346,12 +465,14 @@ void load_packets_for_turn(GameTurn nturn)
         if (get_packet_save_checksum() != tot_chksum)
         {
             ERRORLOG("PacketSave checksum - Out of sync (GameTurn %d)", game.play_gameturn);
+            erstat_inc(ESE_PacketsOutOfSync);
             if (!is_onscreen_msg_visible())
                 show_onscreen_msg(game_num_fps, "Out of sync");
         } else
         if (pckt->chksum != pckt_chksum)
         {
             ERRORLOG("Opps we are really Out Of Sync (GameTurn %d)", game.play_gameturn);
+            erstat_inc(ESE_PacketsOutOfSync);
             if (!is_onscreen_msg_visible())
                 show_onscreen_msg(game_num_fps, "Out of sync");
         }
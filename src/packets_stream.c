@@ -0,0 +1,993 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file packets_stream.c
+ *     Compact stream of packets stored in packet replay files.
+ * @par Purpose:
+ *     Encodes packets of every turn as a difference from the previous turn,
+ *     groups the turns into compressed blocks and writes them on a separate
+ *     thread; reads such blocks back when replaying.
+ * @par Comment:
+ *     Turn record starts with a byte of flags - bit per player whose packet
+ *     changed, and a bit for changed game checksum. Changed packet is stored
+ *     as a mask of changed fields followed by zigzag varint differences of
+ *     these fields. Delta encoding restarts in every block.
+ *     Snapshots of game state are placed between the blocks, and an index
+ *     of all blocks is written at end, so that replay can start from any
+ *     snapshot.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "pre_inc.h"
+#include "packets_stream.h"
+
+#include <stddef.h>
+#include <zlib.h>
+#include <SDL2/SDL.h>
+
+#include "globals.h"
+#include "bflib_basics.h"
+#include "bflib_memory.h"
+#include "bflib_fileio.h"
+#include "game_saves.h"
+#include "post_inc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Max amount of turns in one block; a block is written when it is full. */
+#define PSTRM_BLOCK_TURNS 512
+/** A block which isn't full is written after this many milliseconds, so a crash loses only few seconds of turns. */
+#define PSTRM_BLOCK_FLUSH_MS 3000
+/** Size of uncompressed block buffer. */
+#define PSTRM_BLOCK_SIZE 32768
+/** Amount of blocks which may wait for the writer thread before the game has to wait for it. */
+#define PSTRM_QUEUE_LEN 8
+/** Every this many snapshots, a whole one is stored instead of difference from the previous one. */
+#define PSTRM_SNAPSHOT_KEY_INTERVAL 10
+#define PSTRM_CHKSUM_CHANGED 0x80
+#define PSTRM_VARINT_MAX ((sizeof(unsigned long) * 8 + 6) / 7)
+#define PACKET_FIELDS_COUNT 11
+/** Max size of an encoded turn. */
+#define PSTRM_TURN_MAX_SIZE (1 + NET_PLAYERS_COUNT * (PSTRM_VARINT_MAX + PACKET_FIELDS_COUNT * PSTRM_VARINT_MAX) + PSTRM_VARINT_MAX)
+
+struct PacketStreamField {
+    unsigned short offset;
+    unsigned short size;
+};
+
+#define PACKET_FIELD(name) {offsetof(struct Packet, name), sizeof(((struct Packet *)NULL)->name)}
+
+static const struct PacketStreamField packet_fields[PACKET_FIELDS_COUNT] = {
+    PACKET_FIELD(turn),
+    PACKET_FIELD(chksum),
+    PACKET_FIELD(action),
+    PACKET_FIELD(actn_par1),
+    PACKET_FIELD(actn_par2),
+    PACKET_FIELD(pos_x),
+    PACKET_FIELD(pos_y),
+    PACKET_FIELD(control_flags),
+    PACKET_FIELD(additional_packet_values),
+    PACKET_FIELD(actn_par3),
+    PACKET_FIELD(actn_par4),
+};
+
+/** Values of the previous turn, which the next turn is encoded against. */
+struct PacketStreamDelta {
+    struct Packet prev[NET_PLAYERS_COUNT];
+    TbBigChecksum prev_chksum;
+};
+
+struct PacketStreamSlot {
+    struct PacketStreamBlockHead head;
+    /** Set on the slot which ends writing; it may still contain turns. */
+    TbBool last;
+    /** Copy of game state for snapshot block, freed after it is written. */
+    unsigned char *snapshot;
+    unsigned char raw[PSTRM_BLOCK_SIZE];
+};
+
+struct PacketStreamWriter {
+    TbBool active;
+    TbFileHandle fhandle;
+    SDL_Thread *thread;
+    /** Counts slots which the game may fill. */
+    SDL_sem *free_sem;
+    /** Counts slots waiting for the writer thread. */
+    SDL_sem *filled_sem;
+    struct PacketStreamSlot slots[PSTRM_QUEUE_LEN];
+    /** Slot being filled by the game, or NULL. */
+    struct PacketStreamSlot *fill_slot;
+    /** Time at which filling the slot was started, in SDL ticks. */
+    Uint32 fill_start_ticks;
+    int fill_idx;
+    /** Next slot to be written; used only by the thread which writes. */
+    int write_idx;
+    unsigned long turn;
+    struct PacketStreamDelta delta;
+    unsigned char *packed;
+    unsigned long packed_size;
+    SDL_atomic_t errors;
+    // Used only by the thread which writes
+    unsigned char *prev_snapshot;
+    unsigned long prev_snapshot_size;
+    unsigned long snapshots_count;
+    struct PacketStreamIndexEntry *index;
+    unsigned long index_count;
+    unsigned long index_alloc;
+};
+
+struct PacketStreamReader {
+    TbBool active;
+    TbFileHandle fhandle;
+    /** File position of the first block. */
+    long data_start;
+    unsigned long turns_total;
+    unsigned long turn;
+    /** Turns not yet decoded from the current block. */
+    unsigned long turns_left;
+    struct PacketStreamDelta delta;
+    const unsigned char *pos;
+    const unsigned char *end;
+    unsigned char *packed;
+    unsigned long packed_size;
+    struct PacketStreamIndexEntry *index;
+    unsigned long index_count;
+    unsigned long index_alloc;
+    unsigned char raw[PSTRM_BLOCK_SIZE];
+};
+
+static struct PacketStreamWriter writer;
+static struct PacketStreamReader reader;
+/******************************************************************************/
+static unsigned char *packet_stream_put_varint(unsigned char *ptr, unsigned long val)
+{
+    while (val >= 0x80)
+    {
+        *ptr++ = (val & 0x7F) | 0x80;
+        val >>= 7;
+    }
+    *ptr++ = val;
+    return ptr;
+}
+
+static const unsigned char *packet_stream_get_varint(const unsigned char *ptr, const unsigned char *end, unsigned long *val)
+{
+    unsigned long result = 0;
+    unsigned int shift = 0;
+    while (ptr < end)
+    {
+        unsigned char c = *ptr++;
+        if (shift < sizeof(unsigned long) * 8)
+            result |= (unsigned long)(c & 0x7F) << shift;
+        shift += 7;
+        if ((c & 0x80) == 0)
+        {
+            *val = result;
+            return ptr;
+        }
+    }
+    return NULL;
+}
+
+/**
+ * Maps difference of two values to unsigned number which is small if the difference is small in either direction.
+ */
+static unsigned long packet_stream_zigzag(unsigned long diff)
+{
+    if ((long)diff < 0)
+        return ((~diff) << 1) | 1;
+    return diff << 1;
+}
+
+static unsigned long packet_stream_unzigzag(unsigned long val)
+{
+    if ((val & 1) != 0)
+        return ~(val >> 1);
+    return val >> 1;
+}
+
+static unsigned long packet_field_get(const struct Packet *pckt, int fld_idx)
+{
+    unsigned long val = 0;
+    LbMemoryCopy(&val, (const char *)pckt + packet_fields[fld_idx].offset, packet_fields[fld_idx].size);
+    return val;
+}
+
+static void packet_field_set(struct Packet *pckt, int fld_idx, unsigned long val)
+{
+    LbMemoryCopy((char *)pckt + packet_fields[fld_idx].offset, &val, packet_fields[fld_idx].size);
+}
+
+/**
+ * Stores a turn in given buffer, which has to have at least PSTRM_TURN_MAX_SIZE bytes.
+ * @return Pointer to the end of stored data.
+ */
+static unsigned char *packet_stream_encode_turn(struct PacketStreamDelta *delta, unsigned char *ptr,
+    const struct Packet *pckts, TbBigChecksum chksum)
+{
+    unsigned char* flags = ptr++;
+    *flags = 0;
+    for (int i = 0; i < NET_PLAYERS_COUNT; i++)
+    {
+        struct Packet* prev = &delta->prev[i];
+        // Only the listed fields are stored; state hash of the desync locator is not needed in replays
+        unsigned long mask = 0;
+        for (int n = 0; n < PACKET_FIELDS_COUNT; n++)
+        {
+            if (packet_field_get(&pckts[i], n) != packet_field_get(prev, n))
+                mask |= (1 << n);
+        }
+        if (mask == 0)
+            continue;
+        *flags |= (1 << i);
+        ptr = packet_stream_put_varint(ptr, mask);
+        for (int n = 0; n < PACKET_FIELDS_COUNT; n++)
+        {
+            if ((mask & (1 << n)) != 0)
+                ptr = packet_stream_put_varint(ptr, packet_stream_zigzag(packet_field_get(&pckts[i], n) - packet_field_get(prev, n)));
+        }
+        *prev = pckts[i];
+    }
+    if (chksum != delta->prev_chksum)
+    {
+        *flags |= PSTRM_CHKSUM_CHANGED;
+        ptr = packet_stream_put_varint(ptr, packet_stream_zigzag(chksum - delta->prev_chksum));
+        delta->prev_chksum = chksum;
+    }
+    return ptr;
+}
+
+/**
+ * Restores a turn from given buffer.
+ * @return Pointer to the end of turn data, or NULL if the data is damaged.
+ */
+static const unsigned char *packet_stream_decode_turn(struct PacketStreamDelta *delta, const unsigned char *ptr,
+    const unsigned char *end, struct Packet *pckts, TbBigChecksum *chksum)
+{
+    unsigned long val;
+    if (ptr >= end)
+        return NULL;
+    unsigned char flags = *ptr++;
+    for (int i = 0; i < NET_PLAYERS_COUNT; i++)
+    {
+        if ((flags & (1 << i)) == 0)
+            continue;
+        struct Packet* prev = &delta->prev[i];
+        unsigned long mask;
+        ptr = packet_stream_get_varint(ptr, end, &mask);
+        if (ptr == NULL)
+            return NULL;
+        for (int n = 0; n < PACKET_FIELDS_COUNT; n++)
+        {
+            if ((mask & (1 << n)) == 0)
+                continue;
+            ptr = packet_stream_get_varint(ptr, end, &val);
+            if (ptr == NULL)
+                return NULL;
+            packet_field_set(prev, n, packet_field_get(prev, n) + packet_stream_unzigzag(val));
+        }
+    }
+    if ((flags & PSTRM_CHKSUM_CHANGED) != 0)
+    {
+        ptr = packet_stream_get_varint(ptr, end, &val);
+        if (ptr == NULL)
+            return NULL;
+        delta->prev_chksum += packet_stream_unzigzag(val);
+    }
+    LbMemoryCopy(pckts, delta->prev, sizeof(delta->prev));
+    *chksum = delta->prev_chksum;
+    return ptr;
+}
+
+static TbBool packet_stream_block_valid(const struct PacketStreamBlockHead *head)
+{
+    switch (head->kind)
+    {
+    case PSBK_Turns:
+        return (head->turns_count > 0) && (head->raw_size <= PSTRM_BLOCK_SIZE)
+            && (head->data_size <= compressBound(PSTRM_BLOCK_SIZE));
+    case PSBK_SnapshotKey:
+    case PSBK_SnapshotDelta:
+    case PSBK_Index:
+        return (head->turns_count == 0) && (head->data_size <= compressBound(head->raw_size));
+    default:
+        return false;
+    }
+}
+
+static TbBool packet_stream_is_snapshot(unsigned long kind)
+{
+    return (kind == PSBK_SnapshotKey) || (kind == PSBK_SnapshotDelta);
+}
+
+static TbBool packet_stream_index_add(struct PacketStreamIndexEntry **index, unsigned long *count, unsigned long *alloc,
+    unsigned long kind, unsigned long turn, unsigned long offset)
+{
+    if (*count >= *alloc)
+    {
+        unsigned long new_alloc = *alloc * 2 + 64;
+        void* mem = LbMemoryGrow(*index, new_alloc * sizeof(struct PacketStreamIndexEntry));
+        if (mem == NULL)
+            return false;
+        *index = (struct PacketStreamIndexEntry *)mem;
+        *alloc = new_alloc;
+    }
+    struct PacketStreamIndexEntry* entry = &(*index)[*count];
+    entry->kind = kind;
+    entry->turn = turn;
+    entry->offset = offset;
+    (*count)++;
+    return true;
+}
+
+static void packet_stream_xor(unsigned char *dst, const unsigned char *src, unsigned long size)
+{
+    for (unsigned long i = 0; i < size; i++)
+        dst[i] ^= src[i];
+}
+/******************************************************************************/
+/**
+ * Compresses and writes a block, and adds it to the index.
+ * Called by the writer thread, or by the game if there's no thread.
+ */
+static TbBool packet_stream_write_packed(const struct PacketStreamBlockHead *head_src, const unsigned char *raw,
+    unsigned char *packed, unsigned long packed_max)
+{
+    struct PacketStreamBlockHead head = *head_src;
+    uLongf packed_size = packed_max;
+    if (compress2(packed, &packed_size, raw, head.raw_size, Z_DEFAULT_COMPRESSION) != Z_OK)
+        return false;
+    head.data_size = packed_size;
+    long offset = LbFilePosition(writer.fhandle);
+    if (LbFileWrite(writer.fhandle, &head, sizeof(struct PacketStreamBlockHead)) != sizeof(struct PacketStreamBlockHead))
+        return false;
+    if (LbFileWrite(writer.fhandle, packed, packed_size) != (long)packed_size)
+        return false;
+    if (head.kind != PSBK_Index)
+        packet_stream_index_add(&writer.index, &writer.index_count, &writer.index_alloc, head.kind, head.first_turn, offset);
+    return true;
+}
+
+/**
+ * Writes game state snapshot. Most of the state doesn't change between snapshots,
+ * so it is stored as XOR with the previous one, except every few snapshots.
+ */
+static TbBool packet_stream_write_snapshot_block(struct PacketStreamSlot *slot)
+{
+    unsigned long size = slot->head.raw_size;
+    TbBool key = (writer.prev_snapshot == NULL) || (writer.prev_snapshot_size != size)
+        || (writer.snapshots_count % PSTRM_SNAPSHOT_KEY_INTERVAL == 0);
+    slot->head.kind = key ? PSBK_SnapshotKey : PSBK_SnapshotDelta;
+    TbBool result = false;
+    unsigned long packed_max = compressBound(size);
+    unsigned char* packed = (unsigned char *)LbMemoryAlloc(packed_max);
+    if (packed != NULL)
+    {
+        if (!key)
+            packet_stream_xor(slot->snapshot, writer.prev_snapshot, size);
+        result = packet_stream_write_packed(&slot->head, slot->snapshot, packed, packed_max);
+        if (!key)
+            packet_stream_xor(slot->snapshot, writer.prev_snapshot, size);
+        LbMemoryFree(packed);
+    }
+    LbMemoryFree(writer.prev_snapshot);
+    writer.prev_snapshot = NULL;
+    writer.prev_snapshot_size = 0;
+    if (result)
+    {
+        // Next snapshot may be stored as difference from this one
+        writer.prev_snapshot = slot->snapshot;
+        writer.prev_snapshot_size = size;
+        writer.snapshots_count++;
+    } else
+    {
+        LbMemoryFree(slot->snapshot);
+    }
+    slot->snapshot = NULL;
+    return result;
+}
+
+/**
+ * Writes index of all blocks, followed by trailer which points at it.
+ */
+static TbBool packet_stream_write_index(void)
+{
+    struct PacketStreamBlockHead head;
+    head.kind = PSBK_Index;
+    head.first_turn = writer.turn;
+    head.turns_count = 0;
+    head.raw_size = writer.index_count * sizeof(struct PacketStreamIndexEntry);
+    head.data_size = 0;
+    unsigned long packed_max = compressBound(head.raw_size);
+    unsigned char* packed = (unsigned char *)LbMemoryAlloc(packed_max);
+    if (packed == NULL)
+        return false;
+    struct PacketStreamTrailer trailer;
+    trailer.index_offset = LbFilePosition(writer.fhandle);
+    trailer.kind = PSBK_Index;
+    TbBool result = packet_stream_write_packed(&head, (const unsigned char *)writer.index, packed, packed_max)
+        && (LbFileWrite(writer.fhandle, &trailer, sizeof(trailer)) == sizeof(trailer));
+    LbMemoryFree(packed);
+    return result;
+}
+
+static TbBool packet_stream_write_slot(struct PacketStreamSlot *slot)
+{
+    TbBool result = true;
+    if (slot->snapshot != NULL)
+        result = packet_stream_write_snapshot_block(slot);
+    else if (slot->head.turns_count > 0)
+        result = packet_stream_write_packed(&slot->head, slot->raw, writer.packed, writer.packed_size);
+    if (slot->last)
+        result = packet_stream_write_index() && result;
+    return LbFileFlush(writer.fhandle) && result;
+}
+
+static int packet_stream_writer_thread(void *ptr)
+{
+    for (;;)
+    {
+        SDL_SemWait(writer.filled_sem);
+        struct PacketStreamSlot* slot = &writer.slots[writer.write_idx];
+        writer.write_idx = (writer.write_idx + 1) % PSTRM_QUEUE_LEN;
+        TbBool last = slot->last;
+        if (!packet_stream_write_slot(slot))
+            SDL_AtomicAdd(&writer.errors, 1);
+        SDL_SemPost(writer.free_sem);
+        if (last)
+            break;
+    }
+    return 0;
+}
+
+/**
+ * Gives the slot being filled, or starts filling the next one, waiting until it is written if needed.
+ */
+static struct PacketStreamSlot *packet_stream_fill_slot(void)
+{
+    if (writer.fill_slot != NULL)
+        return writer.fill_slot;
+    if (writer.thread != NULL)
+        SDL_SemWait(writer.free_sem);
+    struct PacketStreamSlot* slot = &writer.slots[writer.fill_idx];
+    writer.fill_idx = (writer.fill_idx + 1) % PSTRM_QUEUE_LEN;
+    slot->head.kind = PSBK_Turns;
+    slot->head.first_turn = writer.turn;
+    slot->head.turns_count = 0;
+    slot->head.raw_size = 0;
+    slot->head.data_size = 0;
+    slot->last = false;
+    slot->snapshot = NULL;
+    LbMemorySet(&writer.delta, 0, sizeof(writer.delta));
+    writer.fill_slot = slot;
+    writer.fill_start_ticks = SDL_GetTicks();
+    return slot;
+}
+
+static void packet_stream_submit_slot(void)
+{
+    struct PacketStreamSlot* slot = writer.fill_slot;
+    if (slot == NULL)
+        return;
+    writer.fill_slot = NULL;
+    if (writer.thread != NULL)
+    {
+        SDL_SemPost(writer.filled_sem);
+        return;
+    }
+    if (!packet_stream_write_slot(slot))
+        SDL_AtomicAdd(&writer.errors, 1);
+}
+
+/**
+ * Starts writing packet data into given file, at its current position.
+ * Needs to be stopped by packet_stream_writer_stop() before the file is closed.
+ */
+TbBool packet_stream_writer_start(TbFileHandle fhandle)
+{
+    packet_stream_writer_stop();
+    writer.packed_size = compressBound(PSTRM_BLOCK_SIZE);
+    writer.packed = (unsigned char *)LbMemoryAlloc(writer.packed_size);
+    if (writer.packed == NULL)
+    {
+        ERRORLOG("Cannot allocate packet stream buffer");
+        return false;
+    }
+    writer.fhandle = fhandle;
+    writer.fill_slot = NULL;
+    writer.fill_idx = 0;
+    writer.write_idx = 0;
+    writer.turn = 0;
+    writer.prev_snapshot = NULL;
+    writer.prev_snapshot_size = 0;
+    writer.snapshots_count = 0;
+    writer.index = NULL;
+    writer.index_count = 0;
+    writer.index_alloc = 0;
+    SDL_AtomicSet(&writer.errors, 0);
+    writer.free_sem = SDL_CreateSemaphore(PSTRM_QUEUE_LEN);
+    writer.filled_sem = SDL_CreateSemaphore(0);
+    writer.thread = NULL;
+    if ((writer.free_sem != NULL) && (writer.filled_sem != NULL))
+        writer.thread = SDL_CreateThread(packet_stream_writer_thread, "PacketWriter", NULL);
+    if (writer.thread == NULL)
+    {
+        WARNLOG("Cannot start packet writer thread, packets will be written by the game: %s", SDL_GetError());
+        if (writer.free_sem != NULL)
+            SDL_DestroySemaphore(writer.free_sem);
+        if (writer.filled_sem != NULL)
+            SDL_DestroySemaphore(writer.filled_sem);
+        writer.free_sem = NULL;
+        writer.filled_sem = NULL;
+    }
+    writer.active = true;
+    return true;
+}
+
+/**
+ * Adds packets of a turn to the stream. Blocks are written when they are full,
+ * or when they were being filled for PSTRM_BLOCK_FLUSH_MS.
+ */
+void packet_stream_write_turn(const struct Packet *pckts, TbBigChecksum chksum)
+{
+    if (!writer.active)
+        return;
+    struct PacketStreamSlot* slot = packet_stream_fill_slot();
+    unsigned char* end = packet_stream_encode_turn(&writer.delta, slot->raw + slot->head.raw_size, pckts, chksum);
+    slot->head.raw_size = end - slot->raw;
+    slot->head.turns_count++;
+    writer.turn++;
+    if ((slot->head.turns_count >= PSTRM_BLOCK_TURNS) || (slot->head.raw_size + PSTRM_TURN_MAX_SIZE > PSTRM_BLOCK_SIZE)
+      || (SDL_GetTicks() - writer.fill_start_ticks >= PSTRM_BLOCK_FLUSH_MS))
+        packet_stream_submit_slot();
+}
+
+/**
+ * Adds a snapshot of game state, from before the turn which will be written next.
+ * The state is copied, then compressed and written by the writer thread.
+ */
+void packet_stream_write_snapshot(const struct PacketStreamRegion *regions, int regions_count)
+{
+    if (!writer.active)
+        return;
+    unsigned long size = 0;
+    for (int i = 0; i < regions_count; i++)
+        size += regions[i].size;
+    unsigned char* state = (unsigned char *)LbMemoryAlloc(size);
+    if (state == NULL)
+    {
+        WARNLOG("Cannot allocate %lu bytes for snapshot at turn %lu", size, writer.turn);
+        return;
+    }
+    unsigned char* pos = state;
+    for (int i = 0; i < regions_count; i++)
+    {
+        LbMemoryCopy(pos, regions[i].data, regions[i].size);
+        pos += regions[i].size;
+    }
+    // Snapshot is placed between blocks of turns
+    packet_stream_submit_slot();
+    struct PacketStreamSlot* slot = packet_stream_fill_slot();
+    slot->head.kind = PSBK_SnapshotKey;
+    slot->head.raw_size = size;
+    slot->snapshot = state;
+    packet_stream_submit_slot();
+}
+
+unsigned long packet_stream_written_turns(void)
+{
+    return writer.turn;
+}
+
+/**
+ * Writes the remaining turns and the index, and waits until everything is in the file.
+ * @return False if any block could not be written.
+ */
+TbBool packet_stream_writer_stop(void)
+{
+    if (!writer.active)
+        return true;
+    struct PacketStreamSlot* slot = packet_stream_fill_slot();
+    slot->last = true;
+    packet_stream_submit_slot();
+    if (writer.thread != NULL)
+    {
+        SDL_WaitThread(writer.thread, NULL);
+        SDL_DestroySemaphore(writer.free_sem);
+        SDL_DestroySemaphore(writer.filled_sem);
+        writer.thread = NULL;
+        writer.free_sem = NULL;
+        writer.filled_sem = NULL;
+    }
+    LbMemoryFree(writer.packed);
+    writer.packed = NULL;
+    LbMemoryFree(writer.prev_snapshot);
+    writer.prev_snapshot = NULL;
+    LbMemoryFree(writer.index);
+    writer.index = NULL;
+    writer.active = false;
+    int errors = SDL_AtomicGet(&writer.errors);
+    if (errors > 0)
+    {
+        ERRORLOG("Packet file write error, %d blocks lost", errors);
+        return false;
+    }
+    SYNCDBG(6,"Written %lu turns and %lu snapshots", writer.turn, writer.snapshots_count);
+    return true;
+}
+/******************************************************************************/
+/**
+ * Reads index of blocks, pointed by the trailer at end of file.
+ */
+static TbBool packet_stream_read_index(long start)
+{
+    long length = LbFileLengthHandle(reader.fhandle);
+    struct PacketStreamTrailer trailer;
+    struct PacketStreamBlockHead head;
+    if (length - start < (long)(sizeof(trailer) + sizeof(head)))
+        return false;
+    LbFileSeek(reader.fhandle, length - sizeof(trailer), Lb_FILE_SEEK_BEGINNING);
+    if (LbFileRead(reader.fhandle, &trailer, sizeof(trailer)) != sizeof(trailer))
+        return false;
+    if ((trailer.kind != PSBK_Index) || ((long)trailer.index_offset < start)
+      || ((long)(trailer.index_offset + sizeof(head)) > length - (long)sizeof(trailer)))
+        return false;
+    LbFileSeek(reader.fhandle, trailer.index_offset, Lb_FILE_SEEK_BEGINNING);
+    if (LbFileRead(reader.fhandle, &head, sizeof(head)) != sizeof(head))
+        return false;
+    if ((head.kind != PSBK_Index) || !packet_stream_block_valid(&head) || (head.raw_size % sizeof(struct PacketStreamIndexEntry) != 0)
+      || ((long)(trailer.index_offset + sizeof(head) + head.data_size) > length - (long)sizeof(trailer)))
+        return false;
+    unsigned char* packed = (unsigned char *)LbMemoryAlloc(head.data_size + 1);
+    struct PacketStreamIndexEntry* index = (struct PacketStreamIndexEntry *)LbMemoryAlloc(head.raw_size + 1);
+    uLongf raw_size = head.raw_size;
+    TbBool result = (packed != NULL) && (index != NULL)
+        && (LbFileRead(reader.fhandle, packed, head.data_size) == (int)head.data_size)
+        && (uncompress((unsigned char *)index, &raw_size, packed, head.data_size) == Z_OK) && (raw_size == head.raw_size);
+    LbMemoryFree(packed);
+    if (!result)
+    {
+        LbMemoryFree(index);
+        return false;
+    }
+    reader.index = index;
+    reader.index_count = head.raw_size / sizeof(struct PacketStreamIndexEntry);
+    reader.index_alloc = reader.index_count;
+    reader.turns_total = head.first_turn;
+    return true;
+}
+
+/**
+ * Builds index of blocks by going through their headers; used if the file has no index.
+ */
+static void packet_stream_scan_blocks(long start)
+{
+    long length = LbFileLengthHandle(reader.fhandle);
+    long pos = start;
+    unsigned long turns = 0;
+    LbFileSeek(reader.fhandle, start, Lb_FILE_SEEK_BEGINNING);
+    while (pos + (long)sizeof(struct PacketStreamBlockHead) <= length)
+    {
+        struct PacketStreamBlockHead head;
+        if (LbFileRead(reader.fhandle, &head, sizeof(head)) != sizeof(head))
+            break;
+        if (head.kind == PSBK_Index)
+            break;
+        if (!packet_stream_block_valid(&head)
+          || ((head.kind == PSBK_Turns) && (head.first_turn != turns))
+          || (pos + (long)sizeof(head) + (long)head.data_size > length))
+        {
+            WARNLOG("Packet data damaged after turn %lu, rest of the file skipped", turns);
+            break;
+        }
+        packet_stream_index_add(&reader.index, &reader.index_count, &reader.index_alloc, head.kind, head.first_turn, pos);
+        if (head.kind == PSBK_Turns)
+            turns += head.turns_count;
+        pos += sizeof(head) + head.data_size;
+        LbFileSeek(reader.fhandle, pos, Lb_FILE_SEEK_BEGINNING);
+    }
+    reader.turns_total = turns;
+}
+
+/**
+ * Starts reading packet data from given file, at its current position.
+ * @return Amount of turns stored in the file.
+ */
+unsigned long packet_stream_reader_start(TbFileHandle fhandle)
+{
+    packet_stream_reader_stop();
+    reader.packed_size = compressBound(PSTRM_BLOCK_SIZE);
+    reader.packed = (unsigned char *)LbMemoryAlloc(reader.packed_size);
+    if (reader.packed == NULL)
+    {
+        ERRORLOG("Cannot allocate packet stream buffer");
+        return 0;
+    }
+    reader.fhandle = fhandle;
+    long start = LbFilePosition(fhandle);
+    if (!packet_stream_read_index(start))
+    {
+        WARNLOG("Packet data has no index, the recording was probably interrupted");
+        packet_stream_scan_blocks(start);
+    }
+    LbFileSeek(fhandle, start, Lb_FILE_SEEK_BEGINNING);
+    reader.data_start = start;
+    reader.turn = 0;
+    reader.turns_left = 0;
+    reader.active = true;
+    return reader.turns_total;
+}
+
+/**
+ * Reads the next block of turns, skipping snapshots.
+ */
+static TbBool packet_stream_read_block(void)
+{
+    struct PacketStreamBlockHead head;
+    for (;;)
+    {
+        if (LbFileRead(reader.fhandle, &head, sizeof(head)) != sizeof(head))
+            return false;
+        if (!packet_stream_block_valid(&head) || (head.kind == PSBK_Index))
+            return false;
+        if (head.kind == PSBK_Turns)
+            break;
+        LbFileSeek(reader.fhandle, head.data_size, Lb_FILE_SEEK_CURRENT);
+    }
+    if (head.first_turn != reader.turn)
+        return false;
+    if (LbFileRead(reader.fhandle, reader.packed, head.data_size) != (int)head.data_size)
+        return false;
+    uLongf raw_size = PSTRM_BLOCK_SIZE;
+    if ((uncompress(reader.raw, &raw_size, reader.packed, head.data_size) != Z_OK) || (raw_size != head.raw_size))
+        return false;
+    reader.pos = reader.raw;
+    reader.end = reader.raw + raw_size;
+    reader.turns_left = head.turns_count;
+    LbMemorySet(&reader.delta, 0, sizeof(reader.delta));
+    return true;
+}
+
+/**
+ * Reads packets of the next turn.
+ * @param pckts Array for packets of NET_PLAYERS_COUNT players.
+ */
+TbBool packet_stream_read_turn(struct Packet *pckts, TbBigChecksum *chksum)
+{
+    if (!reader.active || (reader.turn >= reader.turns_total))
+        return false;
+    if ((reader.turns_left == 0) && !packet_stream_read_block())
+    {
+        ERRORLOG("Cannot read packet data block at turn %lu", reader.turn);
+        reader.turns_total = reader.turn;
+        return false;
+    }
+    reader.pos = packet_stream_decode_turn(&reader.delta, reader.pos, reader.end, pckts, chksum);
+    if (reader.pos == NULL)
+    {
+        ERRORLOG("Packet data damaged at turn %lu", reader.turn);
+        reader.turns_total = reader.turn;
+        return false;
+    }
+    reader.turns_left--;
+    reader.turn++;
+    return true;
+}
+
+static TbBool packet_stream_read_snapshot(const struct PacketStreamIndexEntry *entry, unsigned char *state, unsigned long size)
+{
+    struct PacketStreamBlockHead head;
+    LbFileSeek(reader.fhandle, entry->offset, Lb_FILE_SEEK_BEGINNING);
+    if (LbFileRead(reader.fhandle, &head, sizeof(head)) != sizeof(head))
+        return false;
+    if ((head.kind != entry->kind) || !packet_stream_block_valid(&head) || (head.raw_size != size))
+        return false;
+    unsigned char* packed = (unsigned char *)LbMemoryAlloc(head.data_size + 1);
+    if (packed == NULL)
+        return false;
+    uLongf raw_size = size;
+    TbBool result = (LbFileRead(reader.fhandle, packed, head.data_size) == (int)head.data_size)
+        && (uncompress(state, &raw_size, packed, head.data_size) == Z_OK) && (raw_size == size);
+    LbMemoryFree(packed);
+    return result;
+}
+
+/**
+ * Restores state from the last snapshot of given regions before given turn,
+ * and sets reading position to the turn at which the snapshot was made.
+ * @param snap_turn Receives the turn which will be read next.
+ */
+TbBool packet_stream_seek_snapshot(unsigned long turn, const struct PacketStreamRegion *regions, int regions_count, unsigned long *snap_turn)
+{
+    if (!reader.active)
+        return false;
+    long snap_idx = -1;
+    for (unsigned long i = 0; i < reader.index_count; i++)
+    {
+        const struct PacketStreamIndexEntry* entry = &reader.index[i];
+        if (packet_stream_is_snapshot(entry->kind) && (entry->turn <= turn) && (entry->turn <= reader.turns_total))
+            snap_idx = i;
+    }
+    // Delta snapshots need all snapshots since the last whole one
+    long key_idx = snap_idx;
+    while ((key_idx >= 0) && (reader.index[key_idx].kind != PSBK_SnapshotKey))
+        key_idx--;
+    if (key_idx < 0)
+        return false;
+    unsigned long size = 0;
+    for (int i = 0; i < regions_count; i++)
+        size += regions[i].size;
+    unsigned char* state = (unsigned char *)LbMemoryAlloc(size);
+    unsigned char* diff = (unsigned char *)LbMemoryAlloc(size);
+    TbBool result = (state != NULL) && (diff != NULL);
+    for (long i = key_idx; (i <= snap_idx) && result; i++)
+    {
+        const struct PacketStreamIndexEntry* entry = &reader.index[i];
+        if (i == key_idx) {
+            result = packet_stream_read_snapshot(entry, state, size);
+        } else
+        if (entry->kind == PSBK_SnapshotDelta) {
+            result = packet_stream_read_snapshot(entry, diff, size);
+            if (result)
+                packet_stream_xor(state, diff, size);
+        }
+    }
+    LbMemoryFree(diff);
+    unsigned long target = reader.index[snap_idx].turn;
+    if (result)
+    {
+        // Skip to the snapshot turn within its block of turns
+        long blk_idx = -1;
+        for (unsigned long i = 0; i < reader.index_count; i++)
+        {
+            if ((reader.index[i].kind == PSBK_Turns) && (reader.index[i].turn <= target))
+                blk_idx = i;
+        }
+        if (blk_idx >= 0)
+        {
+            struct Packet pckts[NET_PLAYERS_COUNT];
+            TbBigChecksum chksum;
+            LbFileSeek(reader.fhandle, reader.index[blk_idx].offset, Lb_FILE_SEEK_BEGINNING);
+            reader.turn = reader.index[blk_idx].turn;
+            reader.turns_left = 0;
+            while (result && (reader.turn < target))
+                result = packet_stream_read_turn(pckts, &chksum);
+        } else
+        {
+            result = (target == 0);
+        }
+    }
+    if (result)
+    {
+        const unsigned char* pos = state;
+        for (int i = 0; i < regions_count; i++)
+        {
+            LbMemoryCopy(regions[i].data, pos, regions[i].size);
+            pos += regions[i].size;
+        }
+        *snap_turn = target;
+    } else
+    {
+        WARNLOG("Cannot restore snapshot of turn %lu", target);
+        // Keep the reader usable for replay from start
+        LbFileSeek(reader.fhandle, reader.data_start, Lb_FILE_SEEK_BEGINNING);
+        reader.turn = 0;
+        reader.turns_left = 0;
+    }
+    LbMemoryFree(state);
+    return result;
+}
+
+void packet_stream_reader_stop(void)
+{
+    LbMemoryFree(reader.packed);
+    reader.packed = NULL;
+    LbMemoryFree(reader.index);
+    reader.index = NULL;
+    reader.index_count = 0;
+    reader.index_alloc = 0;
+    reader.turns_total = 0;
+    reader.active = false;
+}
+/******************************************************************************/
+/**
+ * Copies chunks of the source packet file up to the packet data, then writes the packet data in stream format.
+ */
+static TbBool packet_stream_convert_handles(TbFileHandle src, TbFileHandle dst, const char *src_fname)
+{
+    struct FileChunkHeader hdr;
+    TbBool found = false;
+    while (LbFileRead(src, &hdr, sizeof(hdr)) == sizeof(hdr))
+    {
+        if (hdr.id == SGC_PacketData)
+        {
+            found = true;
+            break;
+        }
+        char* buf = (char *)LbMemoryAlloc(hdr.len + 1);
+        if (buf == NULL)
+        {
+            ERRORLOG("Cannot allocate %lu bytes for chunk of \"%s\"", hdr.len, src_fname);
+            return false;
+        }
+        TbBool copied = (LbFileRead(src, buf, hdr.len) == (int)hdr.len)
+            && (LbFileWrite(dst, &hdr, sizeof(hdr)) == sizeof(hdr))
+            && (LbFileWrite(dst, buf, hdr.len) == (long)hdr.len);
+        LbMemoryFree(buf);
+        if (!copied)
+        {
+            ERRORLOG("Cannot copy chunk %08lx of \"%s\"", hdr.id, src_fname);
+            return false;
+        }
+    }
+    if (!found)
+    {
+        ERRORLOG("No packet data in \"%s\"", src_fname);
+        return false;
+    }
+    if (hdr.ver != 0)
+    {
+        ERRORLOG("Packet data of \"%s\" is already version %lu", src_fname, hdr.ver);
+        return false;
+    }
+    // Turns were recorded with navigation areas triangulated one by one and no queued routes, so keep the first stream version
+    hdr.ver = PACKET_STREAM_VERSION_FIRST;
+    if (LbFileWrite(dst, &hdr, sizeof(hdr)) != sizeof(hdr))
+        return false;
+    if (!packet_stream_writer_start(dst))
+        return false;
+    unsigned char pckt_buf[PACKET_TURN_SIZE];
+    struct Packet pckts[NET_PLAYERS_COUNT];
+    TbBigChecksum chksum;
+    while (LbFileRead(src, pckt_buf, PACKET_TURN_SIZE) == PACKET_TURN_SIZE)
+    {
+        LbMemorySet(pckts, 0, sizeof(pckts));
+        for (int i = 0; i < NET_PLAYERS_COUNT; i++)
+            LbMemoryCopy(&pckts[i], &pckt_buf[i * PACKET_V0_SIZE], PACKET_V0_SIZE);
+        LbMemoryCopy(&chksum, &pckt_buf[NET_PLAYERS_COUNT * PACKET_V0_SIZE], sizeof(chksum));
+        packet_stream_write_turn(pckts, chksum);
+    }
+    unsigned long turns = writer.turn;
+    if (!packet_stream_writer_stop())
+        return false;
+    JUSTMSG("Converted %lu turns of \"%s\"", turns, src_fname);
+    return true;
+}
+
+/**
+ * Converts packet file with raw turn records into a file with packet stream.
+ */
+TbBool packet_stream_convert_file(const char *src_fname, const char *dst_fname)
+{
+    TbFileHandle src = LbFileOpen(src_fname, Lb_FILE_MODE_READ_ONLY);
+    if (src == -1)
+    {
+        ERRORLOG("Cannot open packet file \"%s\"", src_fname);
+        return false;
+    }
+    TbFileHandle dst = LbFileOpen(dst_fname, Lb_FILE_MODE_NEW);
+    if (dst == -1)
+    {
+        ERRORLOG("Cannot create packet file \"%s\"", dst_fname);
+        LbFileClose(src);
+        return false;
+    }
+    TbBool result = packet_stream_convert_handles(src, dst, src_fname);
+    JUSTMSG("Packet file \"%s\" has %ld bytes, \"%s\" has %ld bytes", src_fname, LbFileLengthHandle(src),
+        dst_fname, LbFileLengthHandle(dst));
+    LbFileClose(dst);
+    LbFileClose(src);
+    return result;
+}
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
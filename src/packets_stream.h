@@ -0,0 +1,107 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file packets_stream.h
+ *     Header file for packets_stream.c.
+ * @par Purpose:
+ *     Compact stream of packets stored in packet replay files.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef DK_PACKETS_STREAM_H
+#define DK_PACKETS_STREAM_H
+
+#include <stddef.h>
+
+#include "globals.h"
+#include "bflib_basics.h"
+#include "bflib_fileio.h"
+
+#include "packets.h"
+#include "net_game.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Version of packet data, stored in the packet data chunk header. Version 0 are raw turn records. */
+#define PACKET_STREAM_VERSION 4
+/** First version of packet data stored as a stream of blocks. */
+#define PACKET_STREAM_VERSION_FIRST 2
+/** First version with queued navigation areas merged, and blocked creatures re-routed on turn end instead of at once. */
+#define PACKET_VERSION_QUEUED_NAVIGATION 3
+/** First version with cached triangle routes reused for other endpoints within the same triangles. */
+#define PACKET_VERSION_ROUTE_TRIANGLES 4
+/** Size of one packet in packet data version 0; fields added to the packet later are not there. */
+#define PACKET_V0_SIZE offsetof(struct Packet, state_hash)
+/** Size of one turn record in packet data version 0. */
+#define PACKET_TURN_SIZE (NET_PLAYERS_COUNT*(PACKET_V0_SIZE + CKS_MAX*sizeof(TbBigChecksum)) + sizeof(TbBigChecksum))
+
+enum PacketStreamBlockKinds {
+    PSBK_Turns         = 0x534E5254, //"TRNS"
+    PSBK_SnapshotKey   = 0x4B414E53, //"SNAK"
+    PSBK_SnapshotDelta = 0x44414E53, //"SNAD"
+    PSBK_Index         = 0x58444950, //"PIDX"
+};
+
+#pragma pack(1)
+
+/**
+ * Header of a block in packet data. Every block is compressed separately.
+ * Turns blocks restart delta encoding, so the first turn in block is stored whole.
+ * Snapshot blocks store game state from before given turn; delta snapshot is
+ * stored as XOR with the previous snapshot.
+ * Index block is the last one, and lists all other blocks.
+ */
+struct PacketStreamBlockHead {
+    unsigned long kind;
+    /** First turn in block; for snapshots, turn to be played after restoring it; for index, amount of turns. */
+    unsigned long first_turn;
+    unsigned long turns_count;
+    unsigned long raw_size;
+    unsigned long data_size;
+};
+
+struct PacketStreamIndexEntry {
+    unsigned long kind;
+    unsigned long turn;
+    unsigned long offset;
+};
+
+/** Ends packet data which has an index. */
+struct PacketStreamTrailer {
+    unsigned long index_offset;
+    unsigned long kind;
+};
+
+#pragma pack()
+
+/** Part of game state stored in snapshots. */
+struct PacketStreamRegion {
+    void *data;
+    unsigned long size;
+};
+/******************************************************************************/
+TbBool packet_stream_writer_start(TbFileHandle fhandle);
+void packet_stream_write_turn(const struct Packet *pckts, TbBigChecksum chksum);
+void packet_stream_write_snapshot(const struct PacketStreamRegion *regions, int regions_count);
+unsigned long packet_stream_written_turns(void);
+TbBool packet_stream_writer_stop(void);
+unsigned long packet_stream_reader_start(TbFileHandle fhandle);
+TbBool packet_stream_read_turn(struct Packet *pckts, TbBigChecksum *chksum);
+TbBool packet_stream_seek_snapshot(unsigned long turn, const struct PacketStreamRegion *regions, int regions_count, unsigned long *snap_turn);
+void packet_stream_reader_stop(void);
+TbBool packet_stream_convert_file(const char *src_fname, const char *dst_fname);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -20,6 +20,7 @@
 #include "player_complookup.h"
 
 #include <limits.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "globals.h"
@@ -37,6 +38,47 @@
 extern "C" {
 #endif
 /******************************************************************************/
+#define GOLD_VEINS_SLABS_MAX (MAX_TILES_X*MAX_TILES_Y)
+
+enum GoldVeinSlabClass {
+    GVSC_None = 0,
+    GVSC_Gold,
+    GVSC_Gems,
+};
+
+/**
+ * Gold vein - a group of gold slabs connected by sides, with gem slabs next to them.
+ * A gem slab belongs to the first vein which reaches it when scanning the map by rows;
+ * if no vein reaches it before the gem slab itself is scanned, it's a separate vein.
+ */
+struct GoldVein {
+    /** First slab of the vein in order of scanning the map; 0 if the vein is unused. */
+    SlabCodedCoords start;
+    unsigned long gold_slabs;
+    unsigned long gem_slabs;
+    long sum_x;
+    long sum_y;
+};
+
+/**
+ * Gold veins of the whole map, updated on every change of a valuable slab.
+ * Not stored in saved games, as it is rebuilt from the slab map.
+ */
+struct GoldVeinsMap {
+    TbBool valid;
+    unsigned short veins_count;
+    unsigned short free_count;
+    unsigned char slab_class[GOLD_VEINS_SLABS_MAX];
+    /** Index of vein plus 1 for every slab, 0 for slabs outside of veins. */
+    unsigned short slab_vein[GOLD_VEINS_SLABS_MAX];
+    struct GoldVein veins[GOLD_VEINS_SLABS_MAX];
+    unsigned short free_veins[GOLD_VEINS_SLABS_MAX];
+    unsigned short veins_order[GOLD_VEINS_SLABS_MAX];
+    SlabCodedCoords changed[GOLD_VEINS_SLABS_MAX];
+    SlabCodedCoords flood[GOLD_VEINS_SLABS_MAX];
+};
+
+static struct GoldVeinsMap gold_veins;
 /******************************************************************************/
 #ifdef __cplusplus
 }
@@ -88,133 +130,317 @@ long smaller_gold_vein_lookup_idx(long higher_gold_slabs, long higher_gem_slabs)
     return gold_idx;
 }
 
-void check_treasure_map(unsigned char *treasure_map, unsigned short *vein_list, long *gold_next_idx, MapSlabCoord veinslb_x, MapSlabCoord veinslb_y)
+static unsigned char gold_vein_slab_class(SlabCodedCoords slb_num)
 {
-    long gold_idx;
-    // First, find a vein
-    long vein_total = 0;
-    MapSlabCoord slb_x = veinslb_x;
-    MapSlabCoord slb_y = veinslb_y;
-    long gld_v1 = 0;
-    long gld_v2 = 0;
-    long gld_v3 = 0;
-    long gem_slabs = 0;
-    long gold_slabs = 0;
-    SlabCodedCoords slb_num = get_slab_number(slb_x, slb_y);
-    treasure_map[slb_num] |= 0x02;
-    for (long vein_idx = 0; vein_idx <= vein_total; vein_idx++)
-    {
-        gld_v1 += slb_x;
-        gld_v2 += slb_y;
-        gld_v3++;
-        SlabCodedCoords slb_around = get_slab_number(slb_x, slb_y);
-        struct SlabMap* slb = get_slabmap_direct(slb_around);
-        if (slb->kind == SlbT_GEMS)
+    struct SlabMap* slb = get_slabmap_direct(slb_num);
+    const struct SlabAttr* slbattr = get_slab_attrs(slb);
+    if ((slbattr->block_flags & SlbAtFlg_Valuable) == 0)
+        return GVSC_None;
+    return (slb->kind == SlbT_GEMS) ? GVSC_Gems : GVSC_Gold;
+}
+
+/**
+ * Fills given array with slabs adjacent to sides of given slab.
+ * @return Amount of adjacent slabs within the map.
+ */
+static int gold_vein_slabs_around(SlabCodedCoords slb_num, SlabCodedCoords *slbs_around)
+{
+    MapSlabCoord slb_x = slb_num_decode_x(slb_num);
+    MapSlabCoord slb_y = slb_num_decode_y(slb_num);
+    int n = 0;
+    if (slb_x > 0)
+        slbs_around[n++] = slb_num - 1;
+    if (slb_x + 1 < gameadd.map_tiles_x)
+        slbs_around[n++] = slb_num + 1;
+    if (slb_y > 0)
+        slbs_around[n++] = slb_num - gameadd.map_tiles_x;
+    if (slb_y + 1 < gameadd.map_tiles_y)
+        slbs_around[n++] = slb_num + gameadd.map_tiles_x;
+    return n;
+}
+
+static unsigned short alloc_gold_vein(SlabCodedCoords start)
+{
+    unsigned short vein_id;
+    if (gold_veins.free_count > 0)
+    {
+        gold_veins.free_count--;
+        vein_id = gold_veins.free_veins[gold_veins.free_count];
+    } else
+    {
+        gold_veins.veins_count++;
+        vein_id = gold_veins.veins_count;
+    }
+    struct GoldVein* vein = &gold_veins.veins[vein_id-1];
+    LbMemorySet(vein, 0, sizeof(struct GoldVein));
+    vein->start = start;
+    return vein_id;
+}
+
+static void free_gold_vein(unsigned short vein_id)
+{
+    struct GoldVein* vein = &gold_veins.veins[vein_id-1];
+    LbMemorySet(vein, 0, sizeof(struct GoldVein));
+    gold_veins.free_veins[gold_veins.free_count] = vein_id;
+    gold_veins.free_count++;
+}
+
+static void gold_vein_add_slab(unsigned short vein_id, SlabCodedCoords slb_num)
+{
+    struct GoldVein* vein = &gold_veins.veins[vein_id-1];
+    if (gold_veins.slab_class[slb_num] == GVSC_Gems)
+        vein->gem_slabs++;
+    else
+        vein->gold_slabs++;
+    vein->sum_x += slb_num_decode_x(slb_num);
+    vein->sum_y += slb_num_decode_y(slb_num);
+    gold_veins.slab_vein[slb_num] = vein_id;
+}
+
+static void gold_vein_remove_slab(unsigned short vein_id, SlabCodedCoords slb_num)
+{
+    struct GoldVein* vein = &gold_veins.veins[vein_id-1];
+    if (gold_veins.slab_class[slb_num] == GVSC_Gems)
+        vein->gem_slabs--;
+    else
+        vein->gold_slabs--;
+    vein->sum_x -= slb_num_decode_x(slb_num);
+    vein->sum_y -= slb_num_decode_y(slb_num);
+    gold_veins.slab_vein[slb_num] = 0;
+}
+
+/**
+ * Creates a vein from gold slabs connected to given one, which are not in any vein yet.
+ */
+static void create_gold_vein_from_slab(SlabCodedCoords first_slb_num)
+{
+    SlabCodedCoords slbs_around[4];
+    SlabCodedCoords start = first_slb_num;
+    unsigned short vein_id = alloc_gold_vein(first_slb_num);
+    long flood_count = 0;
+    gold_vein_add_slab(vein_id, first_slb_num);
+    gold_veins.flood[flood_count++] = first_slb_num;
+    for (long i = 0; i < flood_count; i++)
+    {
+        int n = gold_vein_slabs_around(gold_veins.flood[i], slbs_around);
+        for (int k = 0; k < n; k++)
         {
-            gem_slabs++;
-        } else
+            SlabCodedCoords slb_num = slbs_around[k];
+            if ((gold_veins.slab_class[slb_num] != GVSC_Gold) || (gold_veins.slab_vein[slb_num] != 0))
+                continue;
+            gold_vein_add_slab(vein_id, slb_num);
+            gold_veins.flood[flood_count++] = slb_num;
+            if (slb_num < start)
+                start = slb_num;
+        }
+    }
+    gold_veins.veins[vein_id-1].start = start;
+}
+
+/**
+ * Puts given gem slab into the vein it belongs to, or makes a separate vein of it.
+ */
+static void assign_gold_vein_to_gems(SlabCodedCoords slb_num)
+{
+    SlabCodedCoords slbs_around[4];
+    unsigned short owner_id = 0;
+    SlabCodedCoords owner_start = slb_num;
+    int n = gold_vein_slabs_around(slb_num, slbs_around);
+    for (int k = 0; k < n; k++)
+    {
+        if (gold_veins.slab_class[slbs_around[k]] != GVSC_Gold)
+            continue;
+        unsigned short vein_id = gold_veins.slab_vein[slbs_around[k]];
+        if ((vein_id != 0) && (gold_veins.veins[vein_id-1].start < owner_start))
         {
-            gold_slabs++;
-            slb_around = get_slab_number(slb_x-1, slb_y);
-            if ((treasure_map[slb_around] & 0x03) == 0)
-            {
-                treasure_map[slb_around] |= 0x02;
-                vein_list[vein_total] = slb_around;
-                vein_total++;
-            }
-            slb_around = get_slab_number(slb_x+1, slb_y);
-            if ((treasure_map[slb_around] & 0x03) == 0)
-            {
-                treasure_map[slb_around] |= 0x02;
-                vein_list[vein_total] = slb_around;
-                vein_total++;
-            }
-            slb_around = get_slab_number(slb_x, slb_y-1);
-            if ((treasure_map[slb_around] & 0x03) == 0)
-            {
-                treasure_map[slb_around] |= 0x02;
-                vein_list[vein_total] = slb_around;
-                vein_total++;
-            }
-            slb_around = get_slab_number(slb_x, slb_y+1);
-            if ((treasure_map[slb_around] & 0x03) == 0)
-            {
-                treasure_map[slb_around] |= 0x02;
-                vein_list[vein_total] = slb_around;
-                vein_total++;
-            }
+            owner_id = vein_id;
+            owner_start = gold_veins.veins[vein_id-1].start;
         }
-        // Move to next slab in list
-        slb_x = slb_num_decode_x(vein_list[vein_idx]);
-        slb_y = slb_num_decode_y(vein_list[vein_idx]);
     }
-    // Now get a GoldLookup struct to put the vein into
-    if (*gold_next_idx < GOLD_LOOKUP_COUNT)
+    unsigned short vein_id = gold_veins.slab_vein[slb_num];
+    if (vein_id != 0)
     {
-        gold_idx = *gold_next_idx;
-        (*gold_next_idx)++;
-    } else
+        if ((vein_id == owner_id) || ((owner_id == 0) && (gold_veins.veins[vein_id-1].start == slb_num)))
+            return;
+        gold_vein_remove_slab(vein_id, slb_num);
+        if (gold_veins.veins[vein_id-1].start == slb_num)
+            free_gold_vein(vein_id);
+    }
+    if (owner_id == 0)
+        owner_id = alloc_gold_vein(slb_num);
+    gold_vein_add_slab(owner_id, slb_num);
+}
+
+/**
+ * Removes a vein, adding its slabs to the list of slabs to be assigned again.
+ * @return New amount of slabs in the list.
+ */
+static long dissolve_gold_vein(unsigned short vein_id, long changed_count)
+{
+    SlabCodedCoords slbs_around[4];
+    if (vein_id == 0)
+        return changed_count;
+    long i = changed_count;
+    SlabCodedCoords start = gold_veins.veins[vein_id-1].start;
+    gold_veins.slab_vein[start] = 0;
+    gold_veins.changed[changed_count++] = start;
+    for (; i < changed_count; i++)
+    {
+        int n = gold_vein_slabs_around(gold_veins.changed[i], slbs_around);
+        for (int k = 0; k < n; k++)
+        {
+            if (gold_veins.slab_vein[slbs_around[k]] != vein_id)
+                continue;
+            gold_veins.slab_vein[slbs_around[k]] = 0;
+            gold_veins.changed[changed_count++] = slbs_around[k];
+        }
+    }
+    free_gold_vein(vein_id);
+    return changed_count;
+}
+
+/**
+ * Marks gold veins as invalid, so they will be rebuilt from the slab map when needed.
+ * Should be called when the whole slab map is replaced.
+ */
+void clear_gold_veins(void)
+{
+    gold_veins.valid = false;
+}
+
+static void rebuild_gold_veins(void)
+{
+    SYNCDBG(8,"Starting");
+    SlabCodedCoords slabs_count = gameadd.map_tiles_x * gameadd.map_tiles_y;
+    gold_veins.veins_count = 0;
+    gold_veins.free_count = 0;
+    for (SlabCodedCoords slb_num = 0; slb_num < slabs_count; slb_num++)
     {
-        gold_idx = smaller_gold_vein_lookup_idx(gold_slabs, gem_slabs);
+        gold_veins.slab_class[slb_num] = gold_vein_slab_class(slb_num);
+        gold_veins.slab_vein[slb_num] = 0;
     }
-    // Write the vein to GoldLookup item
-    if (gold_idx != -1)
+    for (SlabCodedCoords slb_num = 0; slb_num < slabs_count; slb_num++)
     {
-        struct GoldLookup* gldlook = get_gold_lookup(gold_idx);
-        LbMemorySet(gldlook, 0, sizeof(struct GoldLookup));
-        gldlook->flags |= 0x01;
-        gldlook->stl_x = slab_subtile_center(gld_v1 / gld_v3);
-        gldlook->stl_y = slab_subtile_center(gld_v2 / gld_v3);
-        gldlook->field_A = gold_slabs;
-        gldlook->field_C = 0;
-        gldlook->num_gold_slabs = gold_slabs;
-        gldlook->num_gem_slabs = gem_slabs;
-        SYNCDBG(8,"Added vein %d at (%d,%d)",(int)gold_idx,(int)gldlook->stl_x,(int)gldlook->stl_y);
+        if ((gold_veins.slab_class[slb_num] == GVSC_Gold) && (gold_veins.slab_vein[slb_num] == 0))
+            create_gold_vein_from_slab(slb_num);
+    }
+    for (SlabCodedCoords slb_num = 0; slb_num < slabs_count; slb_num++)
+    {
+        if (gold_veins.slab_class[slb_num] == GVSC_Gems)
+            assign_gold_vein_to_gems(slb_num);
+    }
+    gold_veins.valid = true;
+}
+
+/**
+ * Updates gold veins after the slab kind was changed.
+ * Only veins touching the slab are rebuilt, with gems around them.
+ */
+void update_gold_vein_of_slab(MapSlabCoord slb_x, MapSlabCoord slb_y)
+{
+    SlabCodedCoords slbs_around[4];
+    if (!gold_veins.valid)
+        return;
+    SlabCodedCoords slb_num = get_slab_number(slb_x, slb_y);
+    unsigned char slbclass = gold_vein_slab_class(slb_num);
+    if (slbclass == gold_veins.slab_class[slb_num])
+        return;
+    long changed_count = 0;
+    if (gold_veins.slab_vein[slb_num] == 0)
+        gold_veins.changed[changed_count++] = slb_num;
+    changed_count = dissolve_gold_vein(gold_veins.slab_vein[slb_num], changed_count);
+    int n = gold_vein_slabs_around(slb_num, slbs_around);
+    for (int k = 0; k < n; k++)
+    {
+        changed_count = dissolve_gold_vein(gold_veins.slab_vein[slbs_around[k]], changed_count);
+    }
+    gold_veins.slab_class[slb_num] = slbclass;
+    // Gold slabs connected to the changed slab now form new veins
+    for (long i = 0; i < changed_count; i++)
+    {
+        SlabCodedCoords chg_slb_num = gold_veins.changed[i];
+        if ((gold_veins.slab_class[chg_slb_num] == GVSC_Gold) && (gold_veins.slab_vein[chg_slb_num] == 0))
+            create_gold_vein_from_slab(chg_slb_num);
+    }
+    // Gems of removed veins, and gems around new veins, may now belong elsewhere
+    for (long i = 0; i < changed_count; i++)
+    {
+        SlabCodedCoords chg_slb_num = gold_veins.changed[i];
+        if (gold_veins.slab_class[chg_slb_num] == GVSC_Gems)
+        {
+            assign_gold_vein_to_gems(chg_slb_num);
+        } else
+        if (gold_veins.slab_class[chg_slb_num] == GVSC_Gold)
+        {
+            n = gold_vein_slabs_around(chg_slb_num, slbs_around);
+            for (int k = 0; k < n; k++)
+            {
+                if (gold_veins.slab_class[slbs_around[k]] == GVSC_Gems)
+                    assign_gold_vein_to_gems(slbs_around[k]);
+            }
+        }
     }
 }
 
+static int gold_vein_start_compare(const void *a, const void *b)
+{
+    SlabCodedCoords start_a = gold_veins.veins[*(const unsigned short *)a - 1].start;
+    SlabCodedCoords start_b = gold_veins.veins[*(const unsigned short *)b - 1].start;
+    if (start_a != start_b)
+        return (start_a < start_b) ? -1 : 1;
+    return 0;
+}
+
 /**
- * Scans map for gold veins, and fills up gold_lookup array with veins found.
+ * Fills up gold_lookup array with gold veins on map.
+ * Veins are kept up to date when slabs change, so the map doesn't have to be scanned.
  */
 void check_map_for_gold(void)
 {
-    MapSlabCoord slb_x;
-    MapSlabCoord slb_y;
-    SlabCodedCoords slb_num;
     SYNCDBG(8,"Starting");
     for (long i = 0; i < GOLD_LOOKUP_COUNT; i++)
     {
         LbMemorySet(&game.gold_lookup[i], 0, sizeof(struct GoldLookup));
     }
-    // Make a map with treasure areas marked
-    unsigned char* treasure_map = (unsigned char*)big_scratch;
-    unsigned short* vein_list = (unsigned short*)&big_scratch[gameadd.map_tiles_x * gameadd.map_tiles_y];
-    for (slb_y = 0; slb_y < gameadd.map_tiles_y; slb_y++)
+    if (!gold_veins.valid)
+        rebuild_gold_veins();
+    // Veins are added in order of scanning the map, so that weaker ones get replaced the same way
+    unsigned short* veins_order = gold_veins.veins_order;
+    long veins_count = 0;
+    for (unsigned short vein_id = 1; vein_id <= gold_veins.veins_count; vein_id++)
     {
-        for (slb_x = 0; slb_x < gameadd.map_tiles_x; slb_x++)
-        {
-            slb_num = get_slab_number(slb_x, slb_y);
-            struct SlabMap* slb = get_slabmap_direct(slb_num);
-            treasure_map[slb_num] = 0;
-            const struct SlabAttr* slbattr = get_slab_attrs(slb);
-            // Mark areas which are not valuable
-            if ((slbattr->block_flags & (SlbAtFlg_Valuable)) == 0) {
-                treasure_map[slb_num] |= 0x01;
-            }
-        }
+        struct GoldVein* vein = &gold_veins.veins[vein_id-1];
+        if (vein->gold_slabs + vein->gem_slabs > 0)
+            veins_order[veins_count++] = vein_id;
     }
-    // Add treasures to lookup as gold veins
+    qsort(veins_order, veins_count, sizeof(veins_order[0]), gold_vein_start_compare);
     long gold_next_idx = 0;
-    for (slb_y = 0; slb_y < gameadd.map_tiles_y; slb_y++)
+    for (long i = 0; i < veins_count; i++)
     {
-        for (slb_x = 0; slb_x < gameadd.map_tiles_x; slb_x++)
+        struct GoldVein* vein = &gold_veins.veins[veins_order[i]-1];
+        long gold_idx;
+        // Get a GoldLookup struct to put the vein into
+        if (gold_next_idx < GOLD_LOOKUP_COUNT)
         {
-            slb_num = get_slab_number(slb_x, slb_y);
-            if ( ((treasure_map[slb_num] & 0x01) == 0) && ((treasure_map[slb_num] & 0x02) == 0) )
-            {
-                check_treasure_map(treasure_map, vein_list, &gold_next_idx, slb_x, slb_y);
-            }
+            gold_idx = gold_next_idx;
+            gold_next_idx++;
+        } else
+        {
+            gold_idx = smaller_gold_vein_lookup_idx(vein->gold_slabs, vein->gem_slabs);
         }
+        if (gold_idx == -1)
+            continue;
+        long slabs_count = vein->gold_slabs + vein->gem_slabs;
+        struct GoldLookup* gldlook = get_gold_lookup(gold_idx);
+        LbMemorySet(gldlook, 0, sizeof(struct GoldLookup));
+        gldlook->flags |= 0x01;
+        gldlook->stl_x = slab_subtile_center(vein->sum_x / slabs_count);
+        gldlook->stl_y = slab_subtile_center(vein->sum_y / slabs_count);
+        gldlook->field_A = vein->gold_slabs;
+        gldlook->field_C = 0;
+        gldlook->num_gold_slabs = vein->gold_slabs;
+        gldlook->num_gem_slabs = vein->gem_slabs;
+        SYNCDBG(8,"Added vein %d at (%d,%d)",(int)gold_idx,(int)gldlook->stl_x,(int)gldlook->stl_y);
     }
     SYNCDBG(8,"Found %ld possible digging locations",gold_next_idx);
 }
@@ -30,6 +30,7 @@
 #include "engine_redraw.h"
 #include "frontend.h"
 #include "thing_objects.h"
+#include "creature_senses.h"
 #include "power_hand.h"
 #include "post_inc.h"
 
@@ -231,6 +232,7 @@ void toggle_ally_with_player(PlayerNumber plyr_idx, PlayerNumber ally_idx)
     if (player_invalid(player))
         return;
     toggle_flag(player->allied_players, to_flag(ally_idx)); // toggle player ally_idx in player plyridx's allies list
+    line_of_sight_memo_clear();
 }
 
 TbBool set_ally_with_player(PlayerNumber plyr_idx, PlayerNumber ally_idx, TbBool make_ally)
@@ -244,7 +246,8 @@ TbBool set_ally_with_player(PlayerNumber plyr_idx, PlayerNumber ally_idx, TbBool
         set_flag(player->allied_players, to_flag(ally_idx)); // add player ally_idx to player plyridx's allies list
     else // enemy
         clear_flag(player->allied_players, to_flag(ally_idx)); // remove player ally_idx from player plyridx's allies list
-
+    // Allied doors can be seen through
+    line_of_sight_memo_clear();
     return true;
 }
 
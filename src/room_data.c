@@ -50,6 +50,7 @@
 #include "game_legacy.h"
 #include "frontmenu_ingame_map.h"
 #include "keeperfx.hpp"
+#include "net_desync.h"
 #include "post_inc.h"
 
 #ifdef __cplusplus
@@ -1641,6 +1642,7 @@ void delete_room_structure(struct Room *room)
           }
       }
       LbMemorySet(room, 0, sizeof(struct Room));
+      desync_tree_mark_room(room);
     }
 }
 
@@ -1758,6 +1760,7 @@ void recount_and_reassociate_room_slabs(struct Room *room)
         // Per room tile code
         n++;
         slb->room_index = room->index;
+        desync_tree_mark_slab(slb);
         // Per room tile code ends
         k++;
         if (k >= gameadd.map_tiles_x*gameadd.map_tiles_y)
@@ -1931,12 +1934,14 @@ void add_slab_to_room_tiles_list(struct Room *room, MapSlabCoord slb_x, MapSlabC
     } else {
         struct SlabMap* pvslb = get_slabmap_direct(room->slabs_list_tail);
         pvslb->next_in_room = slb_num;
+        desync_tree_mark_slab(pvslb);
     }
     {
         struct SlabMap* nxslb = get_slabmap_direct(slb_num);
         nxslb->room_index = room->index;
         room->slabs_count++;
         nxslb->next_in_room = 0;
+        desync_tree_mark_slab(nxslb);
     }
     room->slabs_list_tail = slb_num;
 }
@@ -1954,12 +1959,14 @@ void add_slab_list_to_room_tiles_list(struct Room *room, SlabCodedCoords slb_num
     } else {
         struct SlabMap* pvslb = get_slabmap_direct(room->slabs_list_tail);
         pvslb->next_in_room = slb_num;
+        desync_tree_mark_slab(pvslb);
     }
     SlabCodedCoords tail_slb_num = slb_num;
     while (1)
     {
         struct SlabMap* nxslb = get_slabmap_direct(tail_slb_num);
         nxslb->room_index = room->index;
+        desync_tree_mark_slab(nxslb);
         room->slabs_count++;
         if (nxslb->next_in_room == 0) {
             break;
@@ -1988,6 +1995,7 @@ void remove_slab_from_room_tiles_list(struct Room *room, MapSlabCoord slb_x, Map
         room->slabs_count--;
         rmslb->next_in_room = 0;
         rmslb->room_index = 0;
+        desync_tree_mark_slab(rmslb);
         create_room_flag(room);
         return;
     }
@@ -2011,6 +2019,8 @@ void remove_slab_from_room_tiles_list(struct Room *room, MapSlabCoord slb_x, Map
             room->slabs_count--;
             rmslb->next_in_room = 0;
             rmslb->room_index = 0;
+            desync_tree_mark_slab(slb);
+            desync_tree_mark_slab(rmslb);
             return;
         }
         // Per room tile code ends
@@ -2024,6 +2034,7 @@ void remove_slab_from_room_tiles_list(struct Room *room, MapSlabCoord slb_x, Map
     WARNLOG("Slab %ld couldn't be found in room tiles list.",slb_num);
     rmslb->next_in_room = 0;
     rmslb->room_index = 0;
+    desync_tree_mark_slab(rmslb);
 }
 
 struct Room *prepare_new_room(PlayerNumber owner, RoomKind rkind, MapSubtlCoord stl_x, MapSubtlCoord stl_y)
@@ -2121,6 +2132,7 @@ struct Room *allocate_free_room_structure(void)
             LbMemorySet(room, 0, sizeof(struct Room));
             room->alloc_flags |= 0x01;
             room->index = i;
+            desync_tree_mark_room(room);
             return room;
         }
     }
@@ -3872,6 +3884,7 @@ void delete_room_slab_when_no_free_room_structures(MapCoord slb_x, MapCoord slb_
                 room_slab = roomslb->next_in_room;
                 kill_room_slab_and_contents(room->owner, roomslb_x, roomslb_y);
                 roomslb->next_in_room = 0;
+                desync_tree_mark_slab(roomslb);
             }
             while ( room_slab );
         }
@@ -3900,13 +3913,17 @@ void delete_room_slab_when_no_free_room_structures(MapCoord slb_x, MapCoord slb_
                 roomslb = get_slabmap_block(roomslb_x, roomslb_y);
                 room_slab = roomslb->next_in_room;
                 if ( roomslb->next_in_room == slb_num )
+                {
                     roomslb->next_in_room = slb->next_in_room;
+                    desync_tree_mark_slab(roomslb);
+                }
                 room_slab = roomslb->next_in_room;
             }
             while ( roomslb->next_in_room != 0 );
         }
         replace_room_slab(room, slb_x, slb_y, room->owner, gnd_slab);
         slb->next_in_room = 0;
+        desync_tree_mark_slab(slb);
     }
 }
 
@@ -4396,6 +4413,7 @@ void kill_room_slab_and_contents(PlayerNumber plyr_idx, MapSlabCoord slb_x, MapS
     // Get the room, and clear room index
     struct Room* room = room_get(slb->room_index);
     slb->room_index = 0;
+    desync_tree_mark_slab(slb);
     SlabCodedCoords slbnum = get_slab_number(slb_x, slb_y);
     for (MapSubtlCoord sstl_y = slab_subtile(slb_y, 0); sstl_y <= slab_subtile(slb_y, 2); sstl_y++)
     {
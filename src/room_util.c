@@ -42,6 +42,7 @@
 #include "keeperfx.hpp"
 #include "frontend.h"
 #include "math.h"
+#include "net_desync.h"
 #include "post_inc.h"
 
 /******************************************************************************/
@@ -137,6 +138,7 @@ void process_rooms(void)
   {
       if (!room_exists(room))
           continue;
+      desync_tree_mark_room(room);
       if (room_role_matches(room->kind, RoRoF_FoodSpawn)) {
           room_grow_food(room);
       }
@@ -164,6 +166,7 @@ void kill_all_room_slabs_and_contents(struct Room *room)
         kill_room_slab_and_contents(room->owner, slb_x, slb_y);
         slb->next_in_room = 0;
         slb->room_index = 0;
+        desync_tree_mark_slab(slb);
         // Per room tile code ends
         k++;
         if (k > room->slabs_count)
@@ -209,6 +212,7 @@ void recreate_rooms_from_room_slabs(struct Room *room, unsigned char gnd_slab)
         i = get_next_slab_number_in_room(i);
         // Per room tile code
         slb->room_index = 0;
+        desync_tree_mark_slab(slb);
         // Per room tile code ends
         k++;
         if (k > room->slabs_count)
@@ -22,6 +22,7 @@
 
 #include "bflib_memory.h"
 #include "player_instances.h"
+#include "player_complookup.h"
 #include "config_terrain.h"
 #include "map_blocks.h"
 #include "map_ceiling.h"
@@ -32,6 +33,7 @@
 #include "game_legacy.h"
 #include "creature_states.h"
 #include "map_data.h"
+#include "net_desync.h"
 #include "post_inc.h"
 
 #ifdef __cplusplus
@@ -183,6 +185,7 @@ void set_slab_owner(MapSlabCoord slb_x, MapSlabCoord slb_y, PlayerNumber owner)
     }
 
     slb->flags ^= (slb->flags ^ owner) & 0x07;
+    desync_tree_mark_slab(slb);
 }
 
 /**
@@ -412,6 +415,7 @@ void clear_slabs(void)
             slb->kind = SlbT_ROCK;
         }
     }
+    clear_gold_veins();
 }
 
 SlabKind find_core_slab_type(MapSlabCoord slb_x, MapSlabCoord slb_y)
@@ -579,6 +583,8 @@ void update_map_collide(SlabKind slbkind, MapSubtlCoord stl_x, MapSubtlCoord stl
     }
     mapblk->flags &= (SlbAtFlg_TaggedValuable|SlbAtFlg_Unexplored);
     mapblk->flags |= nflags;
+    // Door flags are used by line of sight checks
+    map_solidity_invalidate_block(mapblk);
 }
 
 void do_slab_efficiency_alteration(MapSlabCoord slb_x, MapSlabCoord slb_y)
@@ -57,6 +57,7 @@
 #include "thing_stats.h"
 #include "thing_factory.h"
 #include "thing_effects.h"
+#include "thing_grid.h"
 #include "thing_objects.h"
 #include "thing_navigate.h"
 #include "thing_shots.h"
@@ -1263,7 +1264,7 @@ void terminate_thing_spell_effect(struct Thing *thing, SpellKind spkind)
             if ((thing->rendering_flags & TRF_Unknown01) != 0)
             {
                 light_set_light_intensity(thing->light_id, (light_get_light_intensity(thing->light_id) - 20));
-                struct Light* lgt = &game.lish.lights[thing->light_id];
+                struct Light* lgt = light_get_light(thing->light_id);
                 lgt->radius = 2560;
             }
             else
@@ -3780,6 +3781,7 @@ void change_creature_owner(struct Thing *creatng, PlayerNumber nowner)
     }
     // Add the creature to new owner
     creatng->owner = nowner;
+    thing_grid_update_owner(creatng);
     set_first_creature(creatng);
     set_start_state(creatng);
     if (!is_neutral_thing(creatng))
@@ -5738,7 +5740,7 @@ void illuminate_creature(struct Thing *creatng)
         create_light_for_possession(creatng);
     }
     light_set_light_intensity(creatng->light_id, (light_get_light_intensity(creatng->light_id) + 20));
-    struct Light* lgt = &game.lish.lights[creatng->light_id];
+    struct Light* lgt = light_get_light(creatng->light_id);
     lgt->radius <<= 1;
 }
 
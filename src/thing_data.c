@@ -30,11 +30,13 @@
 #include "config_effects.h"
 #include "thing_stats.h"
 #include "thing_effects.h"
+#include "thing_list.h"
 #include "creature_graphics.h"
 #include "game_legacy.h"
 #include "engine_arrays.h"
 #include "kjm_input.h"
 #include "gui_topmsg.h" 
+#include "net_desync.h"
 #include "post_inc.h"
 
 #ifdef __cplusplus
@@ -86,6 +88,9 @@ struct Thing *allocate_free_thing_structure_f(unsigned char allocflags, const ch
     }
     thing->alloc_flags |= TAlF_Exists;
     thing->index = game.free_things[i];
+    desync_tree_mark_thing(thing);
+    things_sweep.exists[thing->index] = 1;
+    things_sweep.generation[thing->index]++;
     game.free_things[game.free_things_start_index] = 0;
     game.free_things_start_index++;
     TRACE_THING(thing);
@@ -137,6 +142,8 @@ TbBool is_in_free_things_list(long tng_idx)
 void delete_thing_structure_f(struct Thing *thing, long a2, const char *func_name)
 {
     TRACE_THING(thing);
+    // Marked before the creature control is freed, so that both are hashed again
+    desync_tree_mark_thing(thing);
     if ((thing->alloc_flags & TAlF_InDungeonList) != 0) {
         remove_first_creature(thing);
     }
@@ -169,6 +176,7 @@ void delete_thing_structure_f(struct Thing *thing, long a2, const char *func_nam
     if (thing->index > 0) {
         game.free_things_start_index--;
         game.free_things[game.free_things_start_index] = thing->index;
+        things_sweep.exists[thing->index] = 0;
     } else {
 #if (BFDEBUG_LEVEL > 0)
         ERRORMSG("%s: Performed deleting of thing with bad index %d!",func_name,(int)thing->index);
@@ -626,27 +626,11 @@ void change_effect_element_into_another(struct Thing *thing, long nmodel)
     thing->max_frames = keepersprite_frames(thing->anim_sprite);
 }
 
-TngUpdateRet update_effect_element(struct Thing *elemtng)
+/**
+ * Updates effect element flags which depend on the terrain below it.
+ */
+static void update_effect_element_surface(struct Thing *elemtng, const struct EffectElementStats *eestats)
 {
-    long i;
-    SYNCDBG(18,"Starting");
-    TRACE_THING(elemtng);
-    struct EffectElementStats* eestats = get_effect_element_model_stats(elemtng->model);
-    // Check if effect health dropped to zero; delete it, or decrease health for the next check
-    long health = elemtng->health;
-    if (health <= 0)
-    {
-        if (eestats->transform_model != 0)
-        {
-            change_effect_element_into_another(elemtng, eestats->transform_model);
-        } else
-        {
-            delete_thing_structure(elemtng, 0);
-        }
-        return TUFRet_Deleted;
-    }
-    elemtng->health = health-1;
-    // Set dynamic properties of the effect
     if (!eestats->animate_on_floor)
     {
         if (elemtng->floor_height >= (int)elemtng->mappos.z.val)
@@ -658,7 +642,7 @@ TngUpdateRet update_effect_element(struct Thing *elemtng)
         elemtng->movement_flags &= ~TMvF_IsOnLava;
         if (thing_touching_floor(elemtng))
         {
-            i = get_top_cube_at(elemtng->mappos.x.stl.num, elemtng->mappos.y.stl.num, NULL);
+            long i = get_top_cube_at(elemtng->mappos.x.stl.num, elemtng->mappos.y.stl.num, NULL);
             if (cube_is_water(i)) {
                 elemtng->movement_flags |= TMvF_IsOnWater;
             } else
@@ -667,17 +651,19 @@ TngUpdateRet update_effect_element(struct Thing *elemtng)
             }
         }
     }
-    i = eestats->subeffect_delay;
-    if (i > 0)
-    {
-      if (((elemtng->creation_turn - game.play_gameturn) % i) == 0) {
-          create_effect_element(&elemtng->mappos, eestats->subeffect_model, elemtng->owner);
-      }
-    }
+}
+
+/**
+ * Changes effect element velocity according to its move type.
+ * @return False if the move type is invalid.
+ */
+static TbBool update_effect_element_velocity(struct Thing *elemtng, const struct EffectElementStats *eestats)
+{
+    long i;
+    long health;
     switch (eestats->move_type)
     {
     case 1:
-        move_effect_element(elemtng);
         break;
     case 2:
         i = elemtng->veloc_base.x.val;
@@ -704,11 +690,9 @@ TngUpdateRet update_effect_element(struct Thing *elemtng)
             if (i > 16) i = 16;
             elemtng->veloc_base.z.val = i;
         }
-        move_effect_element(elemtng);
         break;
     case 3:
         elemtng->veloc_base.z.val = 32;
-        move_effect_element(elemtng);
         break;
     case 4:
         health = elemtng->health;
@@ -719,19 +703,24 @@ TngUpdateRet update_effect_element(struct Thing *elemtng)
         {
             ERRORLOG("Illegal effect element bounce life: %d", (int)health);
         }
-        move_effect_element(elemtng);
         break;
     case 5:
         break;
     default:
         ERRORLOG("Invalid effect element move type %d!",(int)eestats->move_type);
-        move_effect_element(elemtng);
-        break;
+        return false;
     }
+    return true;
+}
 
+/**
+ * Turns unanimated effect element sprite in the direction it moves.
+ */
+static void update_effect_element_orientation(struct Thing *elemtng, const struct EffectElementStats *eestats)
+{
     if (eestats->unanimated != 1)
-      return TUFRet_Modified;
-    i = get_angle_yz_to_vec(&elemtng->veloc_base);
+      return;
+    long i = get_angle_yz_to_vec(&elemtng->veloc_base);
     if (i > LbFPMath_PI)
       i -= LbFPMath_PI;
     long prop_val = i / (LbFPMath_PI / 8);
@@ -739,10 +728,115 @@ TngUpdateRet update_effect_element(struct Thing *elemtng)
     elemtng->current_frame = prop_val;
     elemtng->anim_speed = 0;
     elemtng->anim_time = (prop_val & 0xff) << 8;
+}
+
+TngUpdateRet update_effect_element(struct Thing *elemtng)
+{
+    long i;
+    SYNCDBG(18,"Starting");
+    TRACE_THING(elemtng);
+    struct EffectElementStats* eestats = get_effect_element_model_stats(elemtng->model);
+    // Check if effect health dropped to zero; delete it, or decrease health for the next check
+    long health = elemtng->health;
+    if (health <= 0)
+    {
+        if (eestats->transform_model != 0)
+        {
+            change_effect_element_into_another(elemtng, eestats->transform_model);
+        } else
+        {
+            delete_thing_structure(elemtng, 0);
+        }
+        return TUFRet_Deleted;
+    }
+    elemtng->health = health-1;
+    // Set dynamic properties of the effect
+    update_effect_element_surface(elemtng, eestats);
+    i = eestats->subeffect_delay;
+    if (i > 0)
+    {
+      if (((elemtng->creation_turn - game.play_gameturn) % i) == 0) {
+          create_effect_element(&elemtng->mappos, eestats->subeffect_model, elemtng->owner);
+      }
+    }
+    update_effect_element_velocity(elemtng, eestats);
+    if (eestats->move_type != 5)
+        move_effect_element(elemtng);
+    update_effect_element_orientation(elemtng, eestats);
     SYNCDBG(18,"Finished");
     return TUFRet_Modified;
 }
 
+/**
+ * Checks if effect element can be updated by update_effect_element_unshared() this turn.
+ * Elements which will be deleted, spawn other things, or own lights or sounds cannot.
+ */
+TbBool effect_element_update_is_unshared(const struct Thing *elemtng)
+{
+    if ((elemtng->alloc_flags & (TAlF_IsFollowingLeader|TAlF_IsInLimbo)) != 0)
+        return false;
+    if ((elemtng->light_id != 0) || (elemtng->snd_emitter_id != 0))
+        return false;
+    const struct EffectElementStats* eestats = get_effect_element_model_stats(elemtng->model);
+    if (elemtng->health <= 0)
+        return false;
+    if ((eestats->move_type < 1) || (eestats->move_type > 5))
+        return false;
+    if ((eestats->move_type == 4) && (elemtng->health > 16))
+        return false;
+    long i = eestats->subeffect_delay;
+    if (i > 0)
+    {
+        if (((elemtng->creation_turn - game.play_gameturn) % i) == 0)
+            return false;
+    }
+    return true;
+}
+
+/**
+ * Makes the same update as update_thing() does for effect elements, but changes
+ * nothing except the element itself, so it can be called from worker threads.
+ * Moving between subtiles is only done on the coordinates; the caller has to
+ * move the thing in mapwho when it's back on the main thread.
+ * Requires effect_element_update_is_unshared() to be true.
+ * @param elemtng The effect element to update.
+ * @return True on success, false if the element hit a wall and needs regular update;
+ *  the thing is left untouched in that case.
+ */
+TbBool update_effect_element_unshared(struct Thing *elemtng)
+{
+    struct Thing prevtng = *elemtng;
+    const struct EffectElementStats* eestats = get_effect_element_model_stats(elemtng->model);
+    update_thing_velocity_before_class(elemtng);
+    elemtng->health--;
+    update_effect_element_surface(elemtng, eestats);
+    update_effect_element_velocity(elemtng, eestats);
+    if (eestats->move_type != 5)
+    {
+        // Same as move_effect_element(), except hitting walls and updating mapwho
+        struct Coord3d pos;
+        TbBool move_allowed = get_thing_next_position(&pos, elemtng);
+        if (!positions_equivalent(&elemtng->mappos, &pos))
+        {
+            if ((elemtng->movement_flags & TMvF_Unknown10) == 0)
+            {
+                if (!move_allowed || (!thing_covers_same_blocks_in_two_positions(elemtng, &elemtng->mappos, &pos)
+                  && thing_in_wall_at(elemtng, &pos)))
+                {
+                    *elemtng = prevtng;
+                    return false;
+                }
+            }
+            elemtng->mappos = pos;
+            elemtng->floor_height = get_thing_height_at(elemtng, &elemtng->mappos);
+        }
+    }
+    update_effect_element_orientation(elemtng, eestats);
+    update_thing_velocity_after_class(elemtng);
+    update_thing_animation(elemtng);
+    return true;
+}
+
 struct Thing *create_effect_generator(struct Coord3d *pos, unsigned short model, unsigned short range, unsigned short owner, long parent_idx)
 {
 
@@ -328,6 +328,8 @@ struct Thing *create_effect_generator(struct Coord3d *pos, unsigned short model,
 struct Thing *create_effect_element(const struct Coord3d *pos, unsigned short eelmodel, PlayerNumber owner);
 struct Thing* create_used_effect_or_element(const struct Coord3d* pos, short effect_id, long plyr_idx);
 TngUpdateRet update_effect_element(struct Thing *thing);
+TbBool effect_element_update_is_unshared(const struct Thing *elemtng);
+TbBool update_effect_element_unshared(struct Thing *elemtng);
 TngUpdateRet update_effect(struct Thing *thing);
 TngUpdateRet process_effect_generator(struct Thing *thing);
 void process_spells_affected_by_effect_elements(struct Thing *thing);
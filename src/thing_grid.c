@@ -0,0 +1,239 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file thing_grid.c
+ *     Per-slab counts of creatures, for bounding range searches.
+ * @par Purpose:
+ *     Keeps amount of creatures on every slab, separately for every owner,
+ *     so that searches around a position can skip empty parts of the map.
+ * @par Comment:
+ *     The grid follows mapwho - a creature is counted on the slab of the
+ *     subtile where it was placed in mapwho, under its owner at that time.
+ *     Derived data only; thing_grid_rebuild() recounts it after loading.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#include "pre_inc.h"
+#include "thing_grid.h"
+
+#include "globals.h"
+#include "bflib_basics.h"
+#include "bflib_memory.h"
+
+#include "thing_data.h"
+#include "thing_list.h"
+#include "thing_stats.h"
+#include "player_data.h"
+#include "map_data.h"
+#include "game_legacy.h"
+#include "post_inc.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Owners bucket for creatures whose owner is not a valid player index. */
+#define THING_GRID_OTHER_OWNER PLAYERS_EXT_COUNT
+#define THING_GRID_OWNERS_COUNT (PLAYERS_EXT_COUNT+1)
+#define THING_GRID_SLABS_X (MAX_TILES_X+1)
+#define THING_GRID_SLABS_Y (MAX_TILES_Y+1)
+
+enum ThingGridFlags {
+    TGrF_Placed = 0x01,
+    TGrF_Listed = 0x02,
+};
+
+struct ThingsGrid {
+    /** Amount of creatures on every slab, for every owner. */
+    unsigned short creatures[THING_GRID_SLABS_X*THING_GRID_SLABS_Y][THING_GRID_OWNERS_COUNT];
+    /** Amount of creatures on every slab, summed for all owners. */
+    unsigned short creatures_total[THING_GRID_SLABS_X*THING_GRID_SLABS_Y];
+    /** Grid cell and owner bucket where every thing is counted; valid if TGrF_Placed is set. */
+    unsigned short thing_cell[THINGS_COUNT];
+    unsigned char thing_owner[THINGS_COUNT];
+    unsigned char thing_flags[THINGS_COUNT];
+    /** Amount of things counted in the grid which are also in their class list. */
+    long listed_count;
+    /** Largest clipbox of creatures placed in the grid since it was rebuilt. */
+    unsigned short max_creature_size;
+};
+
+static struct ThingsGrid things_grid;
+/******************************************************************************/
+static unsigned char thing_grid_owner_bucket(PlayerNumber plyr_idx)
+{
+    if ((plyr_idx < 0) || (plyr_idx >= PLAYERS_EXT_COUNT))
+        return THING_GRID_OTHER_OWNER;
+    return plyr_idx;
+}
+
+static long thing_grid_cell_at_subtile(MapSubtlCoord stl_x, MapSubtlCoord stl_y)
+{
+    MapSlabCoord slb_x = subtile_slab(stl_x);
+    MapSlabCoord slb_y = subtile_slab(stl_y);
+    if ((slb_x < 0) || (slb_x >= THING_GRID_SLABS_X) || (slb_y < 0) || (slb_y >= THING_GRID_SLABS_Y))
+        return -1;
+    return slb_y * THING_GRID_SLABS_X + slb_x;
+}
+
+/**
+ * Clears the grid and fills it with creatures which are in mapwho.
+ * Needs to be called whenever the things are loaded or cleared without
+ * going through the mapwho functions.
+ */
+void thing_grid_rebuild(void)
+{
+    LbMemorySet(&things_grid, 0, sizeof(things_grid));
+    for (long tng_idx = 1; tng_idx < THINGS_COUNT; tng_idx++)
+    {
+        const struct Thing* thing = &game.things_data[tng_idx];
+        if ((thing->alloc_flags & (TAlF_Exists|TAlF_IsInMapWho)) != (TAlF_Exists|TAlF_IsInMapWho))
+            continue;
+        thing_grid_place(thing);
+    }
+}
+
+/**
+ * Counts the thing on slab of its current position.
+ * Only creatures are counted; for other classes, the function does nothing.
+ */
+void thing_grid_place(const struct Thing *thing)
+{
+    if ((thing->class_id != TCls_Creature) || (thing->index <= 0) || (thing->index >= THINGS_COUNT))
+        return;
+    if ((things_grid.thing_flags[thing->index] & TGrF_Placed) != 0)
+        thing_grid_remove(thing);
+    long cell = thing_grid_cell_at_subtile(thing->mappos.x.stl.num, thing->mappos.y.stl.num);
+    if (cell < 0)
+    {
+        ERRORLOG("Cannot place %s index %d at subtile (%d,%d) in grid",thing_model_name(thing),(int)thing->index,
+            (int)thing->mappos.x.stl.num,(int)thing->mappos.y.stl.num);
+        return;
+    }
+    unsigned char owner = thing_grid_owner_bucket(thing->owner);
+    things_grid.creatures[cell][owner]++;
+    things_grid.creatures_total[cell]++;
+    things_grid.thing_cell[thing->index] = cell;
+    things_grid.thing_owner[thing->index] = owner;
+    things_grid.thing_flags[thing->index] = TGrF_Placed;
+    if (things_grid.max_creature_size < thing->clipbox_size_xy)
+        things_grid.max_creature_size = thing->clipbox_size_xy;
+    thing_grid_update_listed(thing);
+}
+
+/**
+ * Removes the thing from the grid cell where it was counted.
+ * Uses the remembered cell and owner, so it works even if the thing has moved in the meantime.
+ */
+void thing_grid_remove(const struct Thing *thing)
+{
+    if ((thing->index <= 0) || (thing->index >= THINGS_COUNT))
+        return;
+    unsigned char flags = things_grid.thing_flags[thing->index];
+    if ((flags & TGrF_Placed) == 0)
+        return;
+    long cell = things_grid.thing_cell[thing->index];
+    unsigned char owner = things_grid.thing_owner[thing->index];
+    things_grid.creatures[cell][owner]--;
+    things_grid.creatures_total[cell]--;
+    if ((flags & TGrF_Listed) != 0)
+        things_grid.listed_count--;
+    things_grid.thing_flags[thing->index] = 0;
+}
+
+/**
+ * Moves the thing into bucket of its current owner.
+ * Should be called after owner of a creature is changed while it is in mapwho.
+ */
+void thing_grid_update_owner(const struct Thing *thing)
+{
+    if ((thing->index <= 0) || (thing->index >= THINGS_COUNT))
+        return;
+    if ((things_grid.thing_flags[thing->index] & TGrF_Placed) == 0)
+        return;
+    unsigned char owner = thing_grid_owner_bucket(thing->owner);
+    unsigned char prev_owner = things_grid.thing_owner[thing->index];
+    if (owner == prev_owner)
+        return;
+    long cell = things_grid.thing_cell[thing->index];
+    things_grid.creatures[cell][prev_owner]--;
+    things_grid.creatures[cell][owner]++;
+    things_grid.thing_owner[thing->index] = owner;
+}
+
+/**
+ * Updates whether the thing counted in the grid is also in its class list.
+ * Should be called after the thing is added to or removed from a StructureList.
+ */
+void thing_grid_update_listed(const struct Thing *thing)
+{
+    if ((thing->index <= 0) || (thing->index >= THINGS_COUNT))
+        return;
+    unsigned char flags = things_grid.thing_flags[thing->index];
+    if ((flags & TGrF_Placed) == 0)
+        return;
+    TbBool listed = ((thing->alloc_flags & TAlF_IsInStrucList) != 0);
+    if (listed == ((flags & TGrF_Listed) != 0))
+        return;
+    if (listed) {
+        things_grid.thing_flags[thing->index] |= TGrF_Listed;
+        things_grid.listed_count++;
+    } else {
+        things_grid.thing_flags[thing->index] &= ~TGrF_Listed;
+        things_grid.listed_count--;
+    }
+}
+
+/**
+ * Returns if there are creatures of any of given owners counted on given slab.
+ * Creatures with invalid owner index are matched by any mask.
+ */
+TbBool thing_grid_slab_has_creatures(MapSlabCoord slb_x, MapSlabCoord slb_y, unsigned long owners_mask)
+{
+    if ((slb_x < 0) || (slb_x >= THING_GRID_SLABS_X) || (slb_y < 0) || (slb_y >= THING_GRID_SLABS_Y))
+        return false;
+    long cell = slb_y * THING_GRID_SLABS_X + slb_x;
+    if (things_grid.creatures_total[cell] == 0)
+        return false;
+    if (owners_mask == THING_GRID_ANY_OWNER)
+        return true;
+    const unsigned short* counts = things_grid.creatures[cell];
+    if (counts[THING_GRID_OTHER_OWNER] != 0)
+        return true;
+    for (int i = 0; i < PLAYERS_EXT_COUNT; i++)
+    {
+        if (((owners_mask & THING_GRID_OWNER_FLAG(i)) != 0) && (counts[i] != 0))
+            return true;
+    }
+    return false;
+}
+
+TbBool thing_grid_subtile_has_creatures(MapSubtlCoord stl_x, MapSubtlCoord stl_y, unsigned long owners_mask)
+{
+    return thing_grid_slab_has_creatures(subtile_slab(stl_x), subtile_slab(stl_y), owners_mask);
+}
+
+/**
+ * Returns if every creature in the creatures list is counted in the grid.
+ * If not, some creatures are not in mapwho, and searches through the list
+ * cannot be replaced by searches through the grid.
+ */
+TbBool thing_grid_has_all_listed_creatures(void)
+{
+    return (things_grid.listed_count == game.thing_lists[TngList_Creatures].count);
+}
+
+unsigned short thing_grid_max_creature_size(void)
+{
+    return things_grid.max_creature_size;
+}
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
@@ -0,0 +1,50 @@
+/******************************************************************************/
+// Free implementation of Bullfrog's Dungeon Keeper strategy game.
+/******************************************************************************/
+/** @file thing_grid.h
+ *     Header file for thing_grid.c.
+ * @par Purpose:
+ *     Per-slab counts of creatures, for bounding range searches.
+ * @par Comment:
+ *     Just a header file - #defines, typedefs, function prototypes etc.
+ * @author   KeeperFX Team
+ * @date     17 Oct 2026 - 17 Oct 2026
+ * @par  Copying and copyrights:
+ *     This program is free software; you can redistribute it and/or modify
+ *     it under the terms of the GNU General Public License as published by
+ *     the Free Software Foundation; either version 2 of the License, or
+ *     (at your option) any later version.
+ */
+/******************************************************************************/
+#ifndef DK_THING_GRID_H
+#define DK_THING_GRID_H
+
+#include "globals.h"
+#include "bflib_basics.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+/******************************************************************************/
+/** Bit of given owner in grid owners masks. */
+#define THING_GRID_OWNER_FLAG(plyr_idx) (1UL << (plyr_idx))
+/** Owners mask which matches creatures of any owner. */
+#define THING_GRID_ANY_OWNER (~0UL)
+
+struct Thing;
+/******************************************************************************/
+void thing_grid_rebuild(void);
+void thing_grid_place(const struct Thing *thing);
+void thing_grid_remove(const struct Thing *thing);
+void thing_grid_update_owner(const struct Thing *thing);
+void thing_grid_update_listed(const struct Thing *thing);
+
+TbBool thing_grid_slab_has_creatures(MapSlabCoord slb_x, MapSlabCoord slb_y, unsigned long owners_mask);
+TbBool thing_grid_subtile_has_creatures(MapSubtlCoord stl_x, MapSubtlCoord stl_y, unsigned long owners_mask);
+TbBool thing_grid_has_all_listed_creatures(void);
+unsigned short thing_grid_max_creature_size(void);
+/******************************************************************************/
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -21,12 +21,14 @@
 
 #include "bflib_basics.h"
 #include "bflib_math.h"
+#include "bflib_jobs.h"
 #include "globals.h"
 #include "bflib_sound.h"
 #include "packets.h"
 #include "light_data.h"
 #include "thing_objects.h"
 #include "thing_effects.h"
+#include "thing_grid.h"
 #include "thing_traps.h"
 #include "thing_shots.h"
 #include "thing_corpses.h"
@@ -34,6 +36,7 @@
 #include "thing_physics.h"
 #include "thing_creature.h"
 #include "creature_senses.h"
+#include "ariadne.h"
 #include "spdigger_stack.h"
 #include "power_hand.h"
 #include "magic.h"
@@ -45,14 +48,29 @@
 #include "player_instances.h"
 #include "engine_camera.h"
 #include "game_legacy.h"
+#include "game_profiler.h"
 #include "keeperfx.hpp"
 #include "bflib_planar.h"
+#include "net_desync.h"
 #include "post_inc.h"
 
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+/******************************************************************************/
+/** Amount of effect elements given to a worker thread at once. */
+#define EFFECT_ELEMS_JOB_BATCH 64
+
+/** Effect element being updated by update_effect_elements_in_list(). */
+struct EffectElemSweepItem {
+    ThingIndex index;
+    unsigned short generation;
+    /** Whether the element is updated on a worker thread, and the update did succeed. */
+    TbBool unshared;
+    /** Position before the update, for moving the element in mapwho. */
+    struct Coord3d prev_pos;
+};
 /******************************************************************************/
 Thing_Class_Func class_functions[] = {
   NULL,//TCls_Empty
@@ -75,8 +93,16 @@ Thing_Class_Func class_functions[] = {
 };
 
 unsigned long thing_create_errors = 0;
+struct ThingsSweep things_sweep;
 /******************************************************************************/
 
+static inline void prefetch_thing(ThingIndex tng_idx)
+{
+#if defined(__GNUC__)
+    __builtin_prefetch(game.things.lookup[tng_idx]);
+#endif
+}
+
 void set_previous_thing_position(struct Thing *thing) {
     thing->previous_mappos = thing->mappos;
     thing->previous_floor_height = thing->floor_height;
@@ -102,10 +128,14 @@ void add_thing_to_list(struct Thing *thing, struct StructureList *list)
     thing->alloc_flags |= TAlF_IsInStrucList;
     thing->prev_of_class = 0;
     thing->next_of_class = list->index;
+    things_sweep.class_id[thing->index] = thing->class_id;
+    things_sweep.next_of_class[thing->index] = thing->next_of_class;
+    things_sweep.list_stamp[thing->index] = ++things_sweep.last_list_stamp;
     if (!thing_is_invalid(prevtng)) {
         prevtng->prev_of_class = thing->index;
     }
     list->index = thing->index;
+    thing_grid_update_listed(thing);
 }
 
 void remove_thing_from_list(struct Thing *thing, struct StructureList *slist)
@@ -134,6 +164,7 @@ void remove_thing_from_list(struct Thing *thing, struct StructureList *slist)
             if (!thing_is_invalid(sibtng))
             {
                 sibtng->next_of_class = thing->next_of_class;
+                things_sweep.next_of_class[sibtng->index] = sibtng->next_of_class;
             }
         }
         if (thing->next_of_class > 0)
@@ -148,6 +179,9 @@ void remove_thing_from_list(struct Thing *thing, struct StructureList *slist)
         thing->next_of_class = 0;
     }
     thing->alloc_flags &= ~TAlF_IsInStrucList;
+    things_sweep.class_id[thing->index] = TCls_Empty;
+    things_sweep.next_of_class[thing->index] = 0;
+    thing_grid_update_listed(thing);
     if (slist->count <= 0) {
         ERRORLOG("List has < 0 structures");
         return;
@@ -155,6 +189,44 @@ void remove_thing_from_list(struct Thing *thing, struct StructureList *slist)
     slist->count--;
 }
 
+/**
+ * Fills the dense sweep arrays from things_data.
+ * Needs to be called whenever the things are loaded or cleared without
+ * going through the allocation and list functions.
+ */
+void things_sweep_rebuild(void)
+{
+    for (long tng_idx = 0; tng_idx < THINGS_COUNT; tng_idx++)
+    {
+        const struct Thing* thing = &game.things_data[tng_idx];
+        things_sweep.exists[tng_idx] = ((thing->alloc_flags & TAlF_Exists) != 0);
+        if ((thing->alloc_flags & TAlF_IsInStrucList) != 0) {
+            things_sweep.class_id[tng_idx] = thing->class_id;
+        } else {
+            things_sweep.class_id[tng_idx] = TCls_Empty;
+        }
+        things_sweep.next_of_class[tng_idx] = thing->next_of_class;
+        things_sweep.list_stamp[tng_idx] = 0;
+    }
+    // Stamp the listed things so that the stamps decrease from head to tail of each list
+    things_sweep.last_list_stamp = 0;
+    for (int list_idx = TngList_Creatures; list_idx <= TngList_CaveIns; list_idx++)
+    {
+        const struct StructureList* slist = &game.thing_lists[list_idx];
+        unsigned long stamp = things_sweep.last_list_stamp + slist->count;
+        unsigned long k = 0;
+        ThingIndex i = slist->index;
+        while ((i > 0) && (i < THINGS_COUNT) && (k < slist->count))
+        {
+            things_sweep.list_stamp[i] = stamp - k;
+            i = game.things_data[i].next_of_class;
+            k++;
+        }
+        things_sweep.last_list_stamp = stamp;
+    }
+    thing_grid_rebuild();
+}
+
 struct StructureList *get_list_for_thing_class(ThingClass class_id)
 {
     switch (class_id)
@@ -1001,13 +1073,22 @@ TbBigChecksum update_things_in_list(struct StructureList *list)
     int i = list->index;
     while (i != 0)
     {
-        struct Thing* thing = thing_get(i);
-        if (thing_is_invalid(thing))
+        if ((i < 0) || (i >= THINGS_COUNT))
         {
             ERRORLOG("Jump to invalid thing detected");
             break;
       }
-      i = thing->next_of_class;
+      struct Thing* thing = game.things.lookup[i];
+#if (BFDEBUG_LEVEL > 0)
+      if (things_sweep.next_of_class[i] != thing->next_of_class)
+          ERRORLOG("Sweep data of thing %d out of date",(int)i);
+#endif
+      // Follow the dense links, and fetch the next things while this one is updated
+      i = things_sweep.next_of_class[i];
+      if (i != 0) {
+          prefetch_thing(i);
+          prefetch_thing(things_sweep.next_of_class[i]);
+      }
       // Per-thing code
       if ((thing->alloc_flags & TAlF_IsFollowingLeader) == 0)
       {
@@ -1018,6 +1099,7 @@ TbBigChecksum update_things_in_list(struct StructureList *list)
           }
       }
       set_previous_thing_position(thing);
+      desync_tree_mark_thing(thing);
       sum += get_thing_checksum(thing);
       // Per-thing code ends
       k++;
@@ -1031,6 +1113,97 @@ TbBigChecksum update_things_in_list(struct StructureList *list)
     return sum;
 }
 
+/**
+ * Updates one effect element from the unshared part of update_effect_elements_in_list().
+ * Runs on worker threads, so can't touch anything but the effect elements in given range.
+ */
+static void update_effect_elements_unshared_job(void *data, long first, long last)
+{
+    struct EffectElemSweepItem* items = (struct EffectElemSweepItem*)data;
+    for (long n = first; n < last; n++)
+    {
+        struct EffectElemSweepItem* item = &items[n];
+        if (!item->unshared)
+            continue;
+        struct Thing* thing = game.things.lookup[item->index];
+        item->prev_pos = thing->mappos;
+        item->unshared = update_effect_element_unshared(thing);
+    }
+}
+
+/**
+ * Makes per game turn update of effect elements list, giving the same results as update_things_in_list().
+ * Elements which only move and animate are updated on worker threads first. Then the list is
+ * processed in its order, moving these elements in mapwho and making regular update of the
+ * others, so that mapwho, thing allocation and random seeds change in exactly the same order
+ * as if all elements were updated one by one.
+ * @param list List of effect elements.
+ * @return Returns checksum computed from status of all things in list.
+ */
+TbBigChecksum update_effect_elements_in_list(struct StructureList *list)
+{
+    static struct EffectElemSweepItem items[THINGS_COUNT];
+    SYNCDBG(18,"Starting");
+    // Gather the elements in list order
+    long count = 0;
+    int i = list->index;
+    while (i != 0)
+    {
+        if ((i < 0) || (i >= THINGS_COUNT))
+        {
+            ERRORLOG("Jump to invalid thing detected");
+            break;
+        }
+        if (count >= THINGS_COUNT)
+        {
+            ERRORLOG("Infinite loop detected when sweeping things list");
+            break;
+        }
+        struct EffectElemSweepItem* item = &items[count];
+        item->index = i;
+        item->generation = things_sweep.generation[i];
+        item->unshared = effect_element_update_is_unshared(game.things.lookup[i]);
+        count++;
+        i = things_sweep.next_of_class[i];
+    }
+    // Update what can be done without touching anything shared
+    LbJobsParallelFor(update_effect_elements_unshared_job, items, count, EFFECT_ELEMS_JOB_BATCH);
+    // Finish updates in list order
+    TbBigChecksum sum = 0;
+    for (long n = 0; n < count; n++)
+    {
+        struct EffectElemSweepItem* item = &items[n];
+        i = item->index;
+        // Skip elements which were deleted while updating previous ones
+        if (!things_sweep.exists[i] || (things_sweep.generation[i] != item->generation))
+            continue;
+        struct Thing* thing = game.things.lookup[i];
+        if (item->unshared)
+        {
+            if ((item->prev_pos.x.stl.num != thing->mappos.x.stl.num) || (item->prev_pos.y.stl.num != thing->mappos.y.stl.num))
+            {
+                struct Coord3d pos = thing->mappos;
+                thing->mappos = item->prev_pos;
+                remove_thing_from_mapwho(thing);
+                thing->mappos = pos;
+                place_thing_in_mapwho(thing);
+            }
+        } else
+        if ((thing->alloc_flags & TAlF_IsFollowingLeader) == 0)
+        {
+            if ((thing->alloc_flags & TAlF_IsInLimbo) != 0) {
+                update_thing_animation(thing);
+            } else {
+                update_thing(thing);
+            }
+        }
+        set_previous_thing_position(thing);
+        sum += get_thing_checksum(thing);
+    }
+    SYNCDBG(19,"Finished, %d items, checksum %06lX",(int)count,(unsigned long)sum);
+    return sum;
+}
+
 /**
  * Makes per game turn update of cave in things, using proper StructureList.
  * @return Returns amount of cave in things in list.
@@ -1141,20 +1314,45 @@ void update_things(void)
     total_lights = 0;
     do_lights = game.lish.light_enabled;
     TbBigChecksum sum = 0;
+    PROFILER_BEGIN(PrfSec_ThingsCreatures);
     sum += update_things_in_list(&game.thing_lists[TngList_Creatures]);
+    PROFILER_END(PrfSec_ThingsCreatures);
+    PROFILER_BEGIN(PrfSec_ThingsCreaturesLimbo);
     update_creatures_not_in_list();
+    PROFILER_END(PrfSec_ThingsCreaturesLimbo);
+    ariadne_process_queued_routes();
     player_packet_checksum_add(my_player_number,sum,"creatures");
     sum = 0;
+    PROFILER_BEGIN(PrfSec_ThingsTraps);
     sum += update_things_in_list(&game.thing_lists[TngList_Traps]);
+    PROFILER_END(PrfSec_ThingsTraps);
+    PROFILER_BEGIN(PrfSec_ThingsShots);
     sum += update_things_in_list(&game.thing_lists[TngList_Shots]);
+    PROFILER_END(PrfSec_ThingsShots);
+    PROFILER_BEGIN(PrfSec_ThingsObjects);
     sum += update_things_in_list(&game.thing_lists[TngList_Objects]);
+    PROFILER_END(PrfSec_ThingsObjects);
+    PROFILER_BEGIN(PrfSec_ThingsEffects);
     sum += update_things_in_list(&game.thing_lists[TngList_Effects]);
-    sum += update_things_in_list(&game.thing_lists[TngList_EffectElems]);
+    PROFILER_END(PrfSec_ThingsEffects);
+    PROFILER_BEGIN(PrfSec_ThingsEffectElems);
+    sum += update_effect_elements_in_list(&game.thing_lists[TngList_EffectElems]);
+    PROFILER_END(PrfSec_ThingsEffectElems);
+    PROFILER_BEGIN(PrfSec_ThingsDeadCreatrs);
     sum += update_things_in_list(&game.thing_lists[TngList_DeadCreatrs]);
+    PROFILER_END(PrfSec_ThingsDeadCreatrs);
+    PROFILER_BEGIN(PrfSec_ThingsEffectGens);
     sum += update_things_in_list(&game.thing_lists[TngList_EffectGens]);
+    PROFILER_END(PrfSec_ThingsEffectGens);
+    PROFILER_BEGIN(PrfSec_ThingsDoors);
     sum += update_things_in_list(&game.thing_lists[TngList_Doors]);
+    PROFILER_END(PrfSec_ThingsDoors);
+    PROFILER_BEGIN(PrfSec_ThingsAmbientSnds);
     update_things_sounds_in_list(&game.thing_lists[TngList_AmbientSnds]);
+    PROFILER_END(PrfSec_ThingsAmbientSnds);
+    PROFILER_BEGIN(PrfSec_ThingsCaveIns);
     update_cave_in_things();
+    PROFILER_END(PrfSec_ThingsCaveIns);
     player_packet_checksum_add(my_player_number,sum,"things");
     SYNCDBG(9,"Finished");
 }
@@ -1381,6 +1579,7 @@ void remove_thing_from_mapwho(struct Thing *thing)
     thing->next_on_mapblk = 0;
     thing->prev_on_mapblk = 0;
     thing->alloc_flags &= ~TAlF_IsInMapWho;
+    thing_grid_remove(thing);
 }
 
 void place_thing_in_mapwho(struct Thing *thing)
@@ -1403,6 +1602,7 @@ void place_thing_in_mapwho(struct Thing *thing)
     set_mapwho_thing_index(mapblk, thing->index);
     thing->prev_on_mapblk = 0;
     thing->alloc_flags |= TAlF_IsInMapWho;
+    thing_grid_place(thing);
 }
 
 struct Thing *find_base_thing_on_mapwho(ThingClass oclass, ThingModel model, MapSubtlCoord stl_x, MapSubtlCoord stl_y)
@@ -1675,6 +1875,104 @@ struct Thing *get_nth_thing_of_class_with_filter(Thing_Maximizer_Filter filter,
     return retng;
 }
 
+static int compare_things_list_stamp_descending(const void *ptr1, const void *ptr2)
+{
+    unsigned long stamp1 = things_sweep.list_stamp[*(const ThingIndex *)ptr1];
+    unsigned long stamp2 = things_sweep.list_stamp[*(const ThingIndex *)ptr2];
+    return (stamp1 < stamp2) - (stamp1 > stamp2);
+}
+
+/**
+ * Works like get_nth_thing_of_class_with_filter() for creatures, but only checks the ones
+ * counted in grid on slabs in given range around given position.
+ * The creatures are checked in the same order as in their list, so the result is the same
+ * as of the list search, as long as the filter rejects every creature out of range.
+ * @param range Max distance in any axis from position to creature which filter may accept.
+ * @param searched Set to false if searching in range is not possible, and list search should be used.
+ * @return Returns thing, or invalid thing pointer if not found.
+ */
+static struct Thing *get_nth_creature_in_range_with_filter(Thing_Maximizer_Filter filter, MaxTngFilterParam param, long tngindex,
+    const struct Coord3d *pos, MapCoordDelta range, TbBool *searched)
+{
+    static ThingIndex candidates[THINGS_COUNT];
+    *searched = false;
+    struct StructureList* slist = get_list_for_thing_class(TCls_Creature);
+    if ((range < 0) || (range > gameadd.map_subtiles_x*COORD_PER_STL) || !thing_grid_has_all_listed_creatures()) {
+        return INVALID_THING;
+    }
+    MapSlabCoord slb_x1 = subtile_slab(coord_subtile(max(pos->x.val - range, 0)));
+    MapSlabCoord slb_y1 = subtile_slab(coord_subtile(max(pos->y.val - range, 0)));
+    MapSlabCoord slb_x2 = min(subtile_slab(coord_subtile(pos->x.val + range)), gameadd.map_tiles_x);
+    MapSlabCoord slb_y2 = min(subtile_slab(coord_subtile(pos->y.val + range)), gameadd.map_tiles_y);
+    // If the range covers many slabs per creature, sweeping the list is faster
+    if ((long)(slb_x2 - slb_x1 + 1) * (slb_y2 - slb_y1 + 1) > slist->count * STL_PER_SLB) {
+        return INVALID_THING;
+    }
+    *searched = true;
+    long count = 0;
+    for (MapSlabCoord slb_y = slb_y1; slb_y <= slb_y2; slb_y++)
+    {
+        for (MapSlabCoord slb_x = slb_x1; slb_x <= slb_x2; slb_x++)
+        {
+            if (!thing_grid_slab_has_creatures(slb_x, slb_y, THING_GRID_ANY_OWNER))
+                continue;
+            for (MapSubtlCoord stl_y = slab_subtile(slb_y,0); stl_y < slab_subtile(slb_y,STL_PER_SLB); stl_y++)
+            {
+                for (MapSubtlCoord stl_x = slab_subtile(slb_x,0); stl_x < slab_subtile(slb_x,STL_PER_SLB); stl_x++)
+                {
+                    struct Map* mapblk = get_map_block_at(stl_x, stl_y);
+                    if (map_block_invalid(mapblk))
+                        continue;
+                    unsigned long k = 0;
+                    long i = get_mapwho_thing_index(mapblk);
+                    while ((i > 0) && (i < THINGS_COUNT))
+                    {
+                        const struct Thing* thing = game.things.lookup[i];
+                        i = thing->next_on_mapblk;
+                        if ((thing->class_id == TCls_Creature) && ((thing->alloc_flags & TAlF_IsInStrucList) != 0)
+                          && (count < THINGS_COUNT)) {
+                            candidates[count] = thing->index;
+                            count++;
+                        }
+                        k++;
+                        if (k > THINGS_COUNT)
+                        {
+                            ERRORLOG("Infinite loop detected when sweeping things list");
+                            break;
+                        }
+                    }
+                }
+            }
+        }
+    }
+    qsort(candidates, count, sizeof(ThingIndex), compare_things_list_stamp_descending);
+    long maximizer = 0;
+    long curindex = 0;
+    struct Thing* retng = INVALID_THING;
+    for (long cand = 0; cand < count; cand++)
+    {
+        struct Thing* thing = thing_get(candidates[cand]);
+        long n = filter(thing, param, maximizer);
+        if (n > maximizer)
+        {
+            retng = thing;
+            maximizer = n;
+            curindex = 0;
+        } else
+        if (n == maximizer)
+        {
+            if (curindex <= tngindex) {
+                retng = thing;
+            }
+            if ((maximizer == LONG_MAX) && (curindex >= tngindex)) {
+                break;
+            }
+            curindex++;
+        }
+    }
+    return retng;
+}
+
 struct Thing *get_random_thing_of_class_with_filter(Thing_Maximizer_Filter filter, MaxTngFilterParam param, PlayerNumber plyr_idx)
 {
     SYNCDBG(19,"Starting");
@@ -1861,6 +2159,14 @@ struct Thing *get_highest_score_enemy_creature_within_distance_possible_to_attac
     param.num1 = creatng->index;
     param.num2 = dist;
     param.num3 = move_on_ground;
+    // The filter only accepts creatures with combat distance below dist, and combat distance is
+    // reduced by half of the clipboxes, so the range needs to be extended by the biggest ones
+    MapCoordDelta range = dist + (creatng->clipbox_size_xy + thing_grid_max_creature_size()) / 2 + 1;
+    TbBool searched;
+    struct Thing* thing = get_nth_creature_in_range_with_filter(filter, &param, 0, &creatng->mappos, range, &searched);
+    if (searched) {
+        return thing;
+    }
     return get_nth_thing_of_class_with_filter(filter, &param, 0);
 }
 
@@ -3020,6 +3326,107 @@ long count_things_spiral_near_map_block_with_filter(MapCoord x, MapCoord y, long
     return count;
 }
 
+/**
+ * Works like get_thing_spiral_near_map_block_with_filter(), but for filters which only accept
+ * creatures of given owners; subtiles on slabs without such creatures in grid are skipped.
+ */
+static struct Thing *get_creature_spiral_near_map_block_with_filter(MapCoord x, MapCoord y, long spiral_len,
+    Thing_Maximizer_Filter filter, MaxTngFilterParam param, unsigned long owners_mask)
+{
+    SYNCDBG(19,"Starting");
+    struct Thing* retng = INVALID_THING;
+    long maximizer = 0;
+    for (int around_val = 0; around_val < spiral_len; around_val++)
+    {
+        struct MapOffset* sstep = &spiral_step[around_val];
+        MapSubtlCoord sx = coord_subtile(x) + (MapSubtlCoord)sstep->h;
+        MapSubtlCoord sy = coord_subtile(y) + (MapSubtlCoord)sstep->v;
+        if (!thing_grid_subtile_has_creatures(sx, sy, owners_mask))
+            continue;
+        struct Map* mapblk = get_map_block_at(sx, sy);
+        if (!map_block_invalid(mapblk))
+        {
+            long i = get_mapwho_thing_index(mapblk);
+            long n = maximizer;
+            struct Thing* thing = get_thing_on_map_block_with_filter(i, filter, param, &n);
+            if (!thing_is_invalid(thing) && (n >= maximizer))
+            {
+                retng = thing;
+                maximizer = n;
+                if (maximizer == LONG_MAX)
+                    break;
+            }
+        }
+    }
+    return retng;
+}
+
+/**
+ * Works like count_things_spiral_near_map_block_with_filter(), but for filters which only accept
+ * creatures of given owners; subtiles on slabs without such creatures in grid are skipped.
+ */
+static long count_creatures_spiral_near_map_block_with_filter(MapCoord x, MapCoord y, long spiral_len,
+    Thing_Maximizer_Filter filter, MaxTngFilterParam param, unsigned long owners_mask)
+{
+    SYNCDBG(19,"Starting");
+    long count = 0;
+    long maximizer = 0;
+    for (int around_val = 0; around_val < spiral_len; around_val++)
+    {
+        struct MapOffset* sstep = &spiral_step[around_val];
+        MapSubtlCoord sx = coord_subtile(x) + (MapSubtlCoord)sstep->h;
+        MapSubtlCoord sy = coord_subtile(y) + (MapSubtlCoord)sstep->v;
+        if (!thing_grid_subtile_has_creatures(sx, sy, owners_mask))
+            continue;
+        struct Map* mapblk = get_map_block_at(sx, sy);
+        if (!map_block_invalid(mapblk))
+        {
+            long i = get_mapwho_thing_index(mapblk);
+            long n = maximizer;
+            struct Thing* thing = get_other_thing_on_map_block_with_filter(i, filter, param, &n);
+            if (!thing_is_invalid(thing) && (n >= maximizer))
+            {
+                maximizer = n;
+                if (maximizer == LONG_MAX)
+                {
+                    count++;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+/**
+ * Returns grid owners mask of players whose creatures are enemies of given player.
+ */
+static unsigned long grid_owners_mask_enemies_of(PlayerNumber plyr_idx)
+{
+    unsigned long owners_mask = 0;
+    for (PlayerNumber i = 0; i < PLAYERS_EXT_COUNT; i++)
+    {
+        if (players_are_enemies(plyr_idx, i))
+            owners_mask |= THING_GRID_OWNER_FLAG(i);
+    }
+    return owners_mask;
+}
+
+/**
+ * Returns grid owners mask of given player and players who are its mutual allies.
+ */
+static unsigned long grid_owners_mask_owned_by_or_allied_with(PlayerNumber plyr_idx)
+{
+    if (plyr_idx == -1)
+        return THING_GRID_ANY_OWNER;
+    unsigned long owners_mask = 0;
+    for (PlayerNumber i = 0; i < PLAYERS_EXT_COUNT; i++)
+    {
+        if (players_are_mutual_allies(i, plyr_idx))
+            owners_mask |= THING_GRID_OWNER_FLAG(i);
+    }
+    return owners_mask;
+}
+
 /**
  * Executes callback for all things on subtiles around given position up to given spiral length.
  * @return Gives amount of things for which callback returned true.
@@ -3108,14 +3515,11 @@ void stop_all_things_playing_samples(void)
   }
 }
 
-TbBool update_thing(struct Thing *thing)
+/**
+ * Applies pushes to the thing velocity; done before the class function is called.
+ */
+void update_thing_velocity_before_class(struct Thing *thing)
 {
-    Thing_Class_Func classfunc;
-    SYNCDBG(18,"Thing index %d, class %d",(int)thing->index,(int)thing->class_id);
-    TRACE_THING(thing);
-    if (thing_is_invalid(thing))
-        return false;
-
     if ((thing->movement_flags & TMvF_Immobile) == 0)
     {
         if ((thing->state_flags & TF1_PushAdd) != 0)
@@ -3142,16 +3546,13 @@ TbBool update_thing(struct Thing *thing)
           thing->state_flags &= ~TF1_PushOnce;
         }
     }
-    if (thing->class_id < sizeof(class_functions)/sizeof(class_functions[0]))
-        classfunc = class_functions[thing->class_id];
-    else
-        classfunc = NULL;
-    if (classfunc == NULL)
-        return false;
-    if (classfunc(thing) == TUFRet_Deleted) {
-        return false;
-    }
-    SYNCDBG(18,"Class function end ok");
+}
+
+/**
+ * Applies inertia and gravity to the thing velocity; done after the class function is called.
+ */
+void update_thing_velocity_after_class(struct Thing *thing)
+{
     if ((thing->movement_flags & TMvF_Immobile) == 0)
     {
         if (thing->mappos.z.val > thing->floor_height)
@@ -3193,6 +3594,28 @@ TbBool update_thing(struct Thing *thing)
             }
         }
     }
+}
+
+TbBool update_thing(struct Thing *thing)
+{
+    Thing_Class_Func classfunc;
+    SYNCDBG(18,"Thing index %d, class %d",(int)thing->index,(int)thing->class_id);
+    TRACE_THING(thing);
+    if (thing_is_invalid(thing))
+        return false;
+
+    update_thing_velocity_before_class(thing);
+    if (thing->class_id < sizeof(class_functions)/sizeof(class_functions[0]))
+        classfunc = class_functions[thing->class_id];
+    else
+        classfunc = NULL;
+    if (classfunc == NULL)
+        return false;
+    if (classfunc(thing) == TUFRet_Deleted) {
+        return false;
+    }
+    SYNCDBG(18,"Class function end ok");
+    update_thing_velocity_after_class(thing);
     update_thing_animation(thing);
     update_thing_sound(thing);
     if ((do_lights) && (thing->light_id != 0))
@@ -3684,7 +4107,8 @@ struct Thing *get_creature_in_range_who_is_enemy_of_able_to_attack_and_not_specd
     param.plyr_idx = plyr_idx;
     param.num1 = pos_x;
     param.num2 = pos_y;
-    return get_thing_spiral_near_map_block_with_filter(pos_x, pos_y, distance_stl*distance_stl, filter, &param);
+    return get_creature_spiral_near_map_block_with_filter(pos_x, pos_y, distance_stl*distance_stl, filter, &param,
+        grid_owners_mask_enemies_of(plyr_idx));
 }
 
 /** Finds nearest creature on subtiles in range around given position, who is owned by given player.
@@ -3805,7 +4229,8 @@ struct Thing *get_creature_in_range_and_owned_by_or_allied_with(MapCoord pos_x,
     param.plyr_idx = plyr_idx;
     param.num1 = pos_x;
     param.num2 = pos_y;
-    return get_thing_spiral_near_map_block_with_filter(pos_x, pos_y, distance_stl*distance_stl, filter, &param);
+    return get_creature_spiral_near_map_block_with_filter(pos_x, pos_y, distance_stl*distance_stl, filter, &param,
+        grid_owners_mask_owned_by_or_allied_with(plyr_idx));
 }
 
 /** Counts creatures on all subtiles around given position, who belongs to given player or allied one.
@@ -3826,7 +4251,8 @@ long count_creatures_near_and_owned_by_or_allied_with(MapCoord pos_x, MapCoord p
     param.plyr_idx = plyr_idx;
     param.num1 = pos_x;
     param.num2 = pos_y;
-    return count_things_spiral_near_map_block_with_filter(pos_x, pos_y, distance_stl*distance_stl, filter, &param);
+    return count_creatures_spiral_near_map_block_with_filter(pos_x, pos_y, distance_stl*distance_stl, filter, &param,
+        grid_owners_mask_owned_by_or_allied_with(plyr_idx));
 }
 
 // use this (or make similar one) instead of find_base_thing_on_mapwho_at_pos()
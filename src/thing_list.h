@@ -183,9 +183,29 @@ struct Things {
 
 
 #pragma pack()
+
+/** Dense copy of the thing fields which are read when sweeping through things.
+ * Sweeping these small arrays avoids touching whole Thing structs only to find
+ * where the next one is. Kept outside of Game; things_sweep_rebuild() refills it
+ * when things are loaded or cleared.
+ */
+struct ThingsSweep {
+    /** Copy of TAlF_Exists flag of every thing slot. */
+    unsigned char exists[THINGS_COUNT];
+    /** Class of every thing which is in a StructureList, TCls_Empty for the others. */
+    ThingClass class_id[THINGS_COUNT];
+    /** Copy of next_of_class of every thing. */
+    ThingIndex next_of_class[THINGS_COUNT];
+    /** Increased every time the slot is allocated, to detect things replaced by new ones. */
+    unsigned short generation[THINGS_COUNT];
+    /** Order in which things were added to their lists; within a list, higher stamps come first. */
+    unsigned long list_stamp[THINGS_COUNT];
+    unsigned long last_list_stamp;
+};
 /******************************************************************************/
 extern Thing_Class_Func class_functions[];
 extern unsigned long thing_create_errors;
+extern struct ThingsSweep things_sweep;
 /******************************************************************************/
 void add_thing_to_list(struct Thing *thing, struct StructureList *list);
 void remove_thing_from_list(struct Thing *thing, struct StructureList *slist);
@@ -193,6 +213,7 @@ void remove_thing_from_its_class_list(struct Thing *thing);
 void add_thing_to_its_class_list(struct Thing *thing);
 ThingIndex get_thing_class_list_head(ThingClass class_id);
 struct StructureList *get_list_for_thing_class(ThingClass class_id);
+void things_sweep_rebuild(void);
 
 long creature_near_filter_is_enemy_of_and_not_specdigger(const struct Thing *thing, FilterParam val);
 long creature_near_filter_is_owned_by(const struct Thing *thing, FilterParam val);
@@ -327,6 +348,8 @@ TbBool apply_anger_to_all_players_creatures_excluding(PlayerNumber plyr_idx, lon
 void break_mapwho_infinite_chain(const struct Map *mapblk);
 
 TbBool update_thing(struct Thing *thing);
+void update_thing_velocity_before_class(struct Thing *thing);
+void update_thing_velocity_after_class(struct Thing *thing);
 TbBigChecksum get_thing_checksum(const struct Thing *thing);
 short update_thing_sound(struct Thing *thing);
 struct Thing* find_players_dungeon_heart(PlayerNumber plyridx);
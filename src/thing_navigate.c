@@ -38,6 +38,7 @@
 #include "dungeon_data.h"
 #include "ariadne.h"
 #include "game_legacy.h"
+#include "net_desync.h"
 #include "post_inc.h"
 
 #ifdef __cplusplus
@@ -294,6 +295,7 @@ void move_thing_in_map_f(struct Thing *thing, const struct Coord3d *pos, const c
     {
         ERRORLOG("Moving deleted object (from %s)", func_name);
     }
+    desync_tree_mark_thing(thing);
     if ((thing->mappos.x.stl.num == pos->x.stl.num) && (thing->mappos.y.stl.num == pos->y.stl.num))
     {
         SYNCDBG(19,"Moving %s index %d from (%d,%d) to (%d,%d)",thing_model_name(thing),
@@ -342,7 +344,10 @@ TbBool creature_can_travel_over_lava(const struct Thing *creatng)
 }
 
 /**
- * Checks if a creature can navigate to target by tracing a complete route.
+ * Checks if a creature can navigate to target.
+ * Most answers come from labels of connected triangles; a route is traced only if these are not certain.
+ * Tracer limits may still make the route to a reachable target impossible to find; this is handled when
+ * the creature is sent to the chosen target, as its route is traced then anyway.
  * @param thing
  * @param dstpos
  * @param flags
@@ -352,6 +357,15 @@ TbBool creature_can_travel_over_lava(const struct Thing *creatng)
  */
 TbBool creature_can_navigate_to_f(const struct Thing *thing, struct Coord3d *dstpos, NaviRouteFlags flags, const char *func_name)
 {
+    switch (ariadne_creature_reachability_f(thing, &thing->mappos, dstpos, flags, func_name))
+    {
+    case AridRch_Unreachable:
+        return false;
+    case AridRch_Reachable:
+        return true;
+    default:
+        break;
+    }
     long waypoints_num = ariadne_count_waypoints_on_creature_route_to_target_f(thing, &thing->mappos, dstpos, flags, func_name);
     return (waypoints_num > 0);
 }
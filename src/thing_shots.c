@@ -47,6 +47,7 @@
 #include "engine_lenses.h"
 
 #include "keeperfx.hpp"
+#include "net_desync.h"
 #include "post_inc.h"
 
 #ifdef __cplusplus
@@ -426,6 +427,7 @@ SubtlCodedCoords process_dig_shot_hit_wall(struct Thing *thing, long blocked_fla
             if (!slab_kind_is_indestructible(slb->kind))
             {
                 slb->health -= damage;
+                desync_tree_mark_slab(slb);
             }
             if ((mapblk->flags & SlbAtFlg_Valuable) != 0)
             {
@@ -27,6 +27,10 @@
 /* Network packets debugging. */
 #define DEBUG_NETWORK_PACKETS 0
 #endif
+#ifndef PROFILER_ENABLED
+/* Game turn profiler; always on in heavy log builds, otherwise set in Makefile. */
+#define PROFILER_ENABLED (BFDEBUG_LEVEL > 9)
+#endif
 /* Version definitions */
 #include "../obj/ver_defs.h"
 //#define VER_MAJOR         1
@@ -0,0 +1,69 @@
+//
+// Tests of the loopback network service provider.
+//
+#include "tst_main.h"
+
+#include <string.h>
+#include "bflib_loopsp.h"
+#include "bflib_datetm.h"
+
+namespace
+{
+    NetUserId next_user = 1;
+
+    TbBool new_user(NetUserId *assigned_id)
+    {
+        *assigned_id = next_user++;
+        return true;
+    }
+
+    void echo_client(NetUserId id, const char *buffer, size_t size)
+    {
+        if (buffer != NULL)
+        {
+            LbLoopSP_ClientSend(id, buffer, size);
+        }
+    }
+
+    void start_loopback(unsigned long latency, unsigned long jitter, unsigned long loss)
+    {
+        struct LoopSPConfig config = {1, latency, jitter, loss};
+        LbLoopSP_Configure(&config, echo_client);
+        next_user = 1;
+        loopSP.init(NULL);
+        loopSP.host("", NULL);
+        loopSP.update(new_user);
+    }
+}
+
+ADD_TEST(test_loopsp_echo)
+{
+    char buffer[16];
+    start_loopback(0, 0, 0);
+    loopSP.sendmsg_single(1, "hello", 6);
+    CU_ASSERT(loopSP.msgready(1, 100) == 6);
+    CU_ASSERT(loopSP.readmsg(1, buffer, sizeof(buffer)) == 6);
+    CU_ASSERT(strcmp(buffer, "hello") == 0);
+    CU_ASSERT(loopSP.msgready(1, 0) == 0);
+    loopSP.exit();
+}
+
+ADD_TEST(test_loopsp_latency_keeps_order)
+{
+    char buffer[16];
+    start_loopback(30, 20, 10);
+    TbClockMSec started = LbTimerClock();
+    for (char i = 0; i < 10; i++)
+    {
+        loopSP.sendmsg_single(1, &i, 1);
+    }
+    CU_ASSERT(loopSP.msgready(1, 0) == 0);
+    for (char i = 0; i < 10; i++)
+    {
+        CU_ASSERT(loopSP.readmsg(1, buffer, sizeof(buffer)) == 1);
+        CU_ASSERT(buffer[0] == i);
+    }
+    // Way there and back
+    CU_ASSERT(LbTimerClock() - started >= 60);
+    loopSP.exit();
+}